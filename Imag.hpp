@@ -19,6 +19,8 @@ typedef double Real;
 
     Complex number, defined as Real[2] if FFT capability of latfield are not used, and with FFTW complex if it is use. Commun operation over complex number are also defined.
 
+    In both cases an Imag is two contiguous Real, real part first, which is the layout of std::complex<Real>: arrays of Imag (for instance the data of a Field<Imag>) can be used as arrays of std::complex<Real> through complexCast(). Bulk operations over Field<Imag> are in LATfield2_ImagOps.hpp.
+
  */
 
 class Imag
@@ -45,6 +47,10 @@ class Imag
   //CONSTRUCTORS
   Imag() {;};
   Imag(Real a,Real b) { data[0]=a; data[1]=b; };
+  Imag(const std::complex<Real> & z) { data[0]=z.real(); data[1]=z.imag(); };
+
+  //CONVERSION TO std::complex
+  operator std::complex<Real>() const { return std::complex<Real>(data[0],data[1]); }
 
   //NEGATION OPERATOR
   Imag operator-() { return Imag(-data[0],-data[1]); }
@@ -53,7 +59,7 @@ class Imag
   Imag operator+(Imag z) { return Imag( data[0]+z.real(), data[1]+z.imag() ); }
   Imag operator-(Imag z) { return Imag( data[0]-z.real(), data[1]-z.imag() ); }
   Imag operator*(Imag z) { return Imag( data[0]*z.real()-data[1]*z.imag(), data[0]*z.imag()+data[1]*z.real() ); }
-  Imag operator/(Imag z) { return Imag( (data[0]*z.real()+data[1]*z.imag())/z.norm(), (data[1]*z.real()-data[0]*z.imag())/z.norm() ); }
+  Imag operator/(Imag z) { Real n = z.norm(); return Imag( (data[0]*z.real()+data[1]*z.imag())/n, (data[1]*z.real()-data[0]*z.imag())/n ); }
 
   void operator=(Real r) {data[0]=r;data[1]=0;}
 
@@ -112,4 +118,10 @@ class Imag
 
 Imag expi(Real x);
 
+/*!
+ Access to an array of Imag as an array of std::complex<Real> (same layout), for standard algorithms and std::complex arithmetic.
+ */
+inline std::complex<Real> * complexCast(Imag * z) { return reinterpret_cast<std::complex<Real>*>(z); }
+inline const std::complex<Real> * complexCast(const Imag * z) { return reinterpret_cast<const std::complex<Real>*>(z); }
+
 #endif
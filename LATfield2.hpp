@@ -15,12 +15,19 @@
 #include <string>
 #include <typeinfo>
 #include <list>
+#include <vector>
 
 
 #ifdef FFT3D
 #include "fftw3.h"
 #endif
 
+#include <complex>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 #ifdef HDF5
 #include "hdf5.h"
@@ -95,9 +102,11 @@ namespace LATfield2
 {
         #include "int2string.hpp"
         #include "Imag.hpp"
+        #include "LATfield2_Random.hpp"
         #include "LATfield2_Lattice.hpp"
         #include "LATfield2_Site.hpp"
         #include "LATfield2_Field.hpp"
+        #include "LATfield2_ImagOps.hpp"
         #ifdef FFT3D
             #include "LATfield2_PlanFFT.hpp"
         #endif
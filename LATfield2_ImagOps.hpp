@@ -0,0 +1,233 @@
+#ifndef LATFIELD2_IMAGOPS_HPP
+#define LATFIELD2_IMAGOPS_HPP
+
+/*! \file LATfield2_ImagOps.hpp
+ \brief bulk complex arithmetic on Field<Imag>
+ LATfield2_ImagOps.hpp contain the bulk operations over complex fields: multiplication by a real or complex kernel, product with the conjugate of a field (cross spectra) and axpy.
+
+ The operations work on the local sites row by row: the sites of a row (direction 0 of the lattice) and their components are contiguous in memory, and each row is processed as an array of Real, which compilers vectorize (the Imag operators, which return by value, are not used). Halo sites are not modified. Every field must live on a lattice with the same local layout (size, halo).
+ */
+
+
+/*! \class latticeRows
+ \brief Rows of the local sites of a lattice: row r holds sizeLocal(0) contiguous sites, starting at site index first(r).
+ */
+class latticeRows
+{
+public:
+  latticeRows(Lattice & lat) : lat_(&lat)
+  {
+    rows_ = lat.sitesLocal() / lat.sizeLocal(0);
+  }
+
+  long rows() const { return rows_; }
+  int length() const { return lat_->sizeLocal(0); }
+
+  long first(long row) const
+  {
+    long index = lat_->siteFirst();
+    for(int i=1;i<lat_->dim();i++)
+    {
+      index += (row % lat_->sizeLocal(i)) * lat_->jump(i);
+      row /= lat_->sizeLocal(i);
+    }
+    return index;
+  }
+
+private:
+  Lattice * lat_;
+  long rows_;
+};
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+inline void checkImagOps(Lattice & a, Lattice & b, int compA, int compB, bool broadcast, const char * caller)
+{
+  bool same = (a.dim() == b.dim() && a.halo() == b.halo() && (compA == compB || (broadcast && compB == 1)));
+  for(int i=0;same && i<a.dim();i++) same = (a.sizeLocal(i) == b.sizeLocal(i));
+  if(!same)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::"<<caller<<" : fields do not have the same lattice layout or number of components"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+}
+
+#endif
+
+
+/*!
+ Multiplies each site of a complex field by a real kernel: f(x,c) *= kernel(x,c), or kernel(x) if the kernel has a single component (for instance a Green's function applied to every component of a Fourier space field).
+ \param f : complex field, modified.
+ \param kernel : real field on the same lattice layout, with 1 component or the components of f.
+ */
+inline void imagMultiply(Field<Imag> & f, Field<Real> & kernel)
+{
+  checkImagOps(f.lattice(),kernel.lattice(),f.components(),kernel.components(),true,"imagMultiply");
+
+  latticeRows rows(f.lattice());
+  int comp = f.components();
+  int kcomp = kernel.components();
+  long n = (long)rows.length()*comp;
+  long i;
+  int c;
+
+  for(long r=0;r<rows.rows();r++)
+  {
+    Real * z = (Real*)(f.data() + rows.first(r)*comp);
+    Real * k = kernel.data() + rows.first(r)*kcomp;
+    if(kcomp == comp)
+    {
+      for(i=0;i<n;i++)
+      {
+        z[2*i] *= k[i];
+        z[2*i+1] *= k[i];
+      }
+    }
+    else
+    {
+      for(i=0;i<rows.length();i++)
+      {
+        for(c=0;c<comp;c++)
+        {
+          z[2*(i*comp+c)] *= k[i];
+          z[2*(i*comp+c)+1] *= k[i];
+        }
+      }
+    }
+  }
+}
+
+/*!
+ Multiplies each site of a complex field by a complex kernel: f(x,c) *= kernel(x,c), or kernel(x) if the kernel has a single component.
+ \param f : complex field, modified.
+ \param kernel : complex field on the same lattice layout, with 1 component or the components of f.
+ */
+inline void imagMultiply(Field<Imag> & f, Field<Imag> & kernel)
+{
+  checkImagOps(f.lattice(),kernel.lattice(),f.components(),kernel.components(),true,"imagMultiply");
+
+  latticeRows rows(f.lattice());
+  int comp = f.components();
+  int kcomp = kernel.components();
+  long n = (long)rows.length()*comp;
+  long i;
+  int c;
+  Real re,im;
+
+  for(long r=0;r<rows.rows();r++)
+  {
+    Real * z = (Real*)(f.data() + rows.first(r)*comp);
+    Real * k = (Real*)(kernel.data() + rows.first(r)*kcomp);
+    if(kcomp == comp)
+    {
+      for(i=0;i<n;i++)
+      {
+        re = z[2*i]*k[2*i] - z[2*i+1]*k[2*i+1];
+        im = z[2*i]*k[2*i+1] + z[2*i+1]*k[2*i];
+        z[2*i] = re;
+        z[2*i+1] = im;
+      }
+    }
+    else
+    {
+      for(i=0;i<rows.length();i++)
+      {
+        for(c=0;c<comp;c++)
+        {
+          re = z[2*(i*comp+c)]*k[2*i] - z[2*(i*comp+c)+1]*k[2*i+1];
+          im = z[2*(i*comp+c)]*k[2*i+1] + z[2*(i*comp+c)+1]*k[2*i];
+          z[2*(i*comp+c)] = re;
+          z[2*(i*comp+c)+1] = im;
+        }
+      }
+    }
+  }
+}
+
+/*!
+ Product of a field with the conjugate of another: out(x,c) = a(x,c) * conj(b(x,c)). With a = b this is |a|^2 (in the real part), and the real part of the sum over a shell of modes is the cross spectrum of a and b. out can be a or b.
+ \param a : complex field.
+ \param b : complex field, same lattice layout and components.
+ \param out : complex field receiving the product, same lattice layout and components.
+ */
+inline void imagMultiplyConjugate(Field<Imag> & a, Field<Imag> & b, Field<Imag> & out)
+{
+  checkImagOps(a.lattice(),b.lattice(),a.components(),b.components(),false,"imagMultiplyConjugate");
+  checkImagOps(a.lattice(),out.lattice(),a.components(),out.components(),false,"imagMultiplyConjugate");
+
+  latticeRows rows(a.lattice());
+  int comp = a.components();
+  long n = (long)rows.length()*comp;
+  long i;
+  Real re,im;
+
+  for(long r=0;r<rows.rows();r++)
+  {
+    Real * x = (Real*)(a.data() + rows.first(r)*comp);
+    Real * y = (Real*)(b.data() + rows.first(r)*comp);
+    Real * z = (Real*)(out.data() + rows.first(r)*comp);
+    for(i=0;i<n;i++)
+    {
+      re = x[2*i]*y[2*i] + x[2*i+1]*y[2*i+1];
+      im = x[2*i+1]*y[2*i] - x[2*i]*y[2*i+1];
+      z[2*i] = re;
+      z[2*i+1] = im;
+    }
+  }
+}
+
+/*!
+ y(x,c) += alpha * x(x,c) for a complex factor alpha.
+ \param alpha : complex factor.
+ \param x : complex field.
+ \param y : complex field, modified, same lattice layout and components as x.
+ */
+inline void imagAxpy(Imag alpha, Field<Imag> & x, Field<Imag> & y)
+{
+  checkImagOps(x.lattice(),y.lattice(),x.components(),y.components(),false,"imagAxpy");
+
+  latticeRows rows(x.lattice());
+  int comp = x.components();
+  long n = (long)rows.length()*comp;
+  long i;
+  Real ar = alpha.real();
+  Real ai = alpha.imag();
+
+  for(long r=0;r<rows.rows();r++)
+  {
+    Real * u = (Real*)(x.data() + rows.first(r)*comp);
+    Real * v = (Real*)(y.data() + rows.first(r)*comp);
+    for(i=0;i<n;i++)
+    {
+      v[2*i] += ar*u[2*i] - ai*u[2*i+1];
+      v[2*i+1] += ar*u[2*i+1] + ai*u[2*i];
+    }
+  }
+}
+
+/*!
+ y(x,c) += alpha * x(x,c) for a real factor alpha.
+ */
+inline void imagAxpy(Real alpha, Field<Imag> & x, Field<Imag> & y)
+{
+  checkImagOps(x.lattice(),y.lattice(),x.components(),y.components(),false,"imagAxpy");
+
+  latticeRows rows(x.lattice());
+  int comp = x.components();
+  long n = 2*(long)rows.length()*comp;
+  long i;
+
+  for(long r=0;r<rows.rows();r++)
+  {
+    Real * u = (Real*)(x.data() + rows.first(r)*comp);
+    Real * v = (Real*)(y.data() + rows.first(r)*comp);
+    for(i=0;i<n;i++) v[i] += alpha*u[i];
+  }
+}
+
+#endif
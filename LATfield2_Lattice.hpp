@@ -22,12 +22,18 @@ Lattice::Lattice()
 {
 	status_=0;
 	arch_saved_=false;
+#ifdef FFT3D
+	kTables_=NULL;
+#endif
 }
 
 Lattice::Lattice(int dim, const int* size, int halo)
 {
 	status_=0;
 	arch_saved_=false;
+#ifdef FFT3D
+	kTables_=NULL;
+#endif
 	this->initialize(dim, size, halo);
 }  
 
@@ -36,6 +42,9 @@ Lattice::Lattice(int dim, const int size, int halo)
 {
 	status_=0;
 	arch_saved_=false;
+#ifdef FFT3D
+	kTables_=NULL;
+#endif
 	int* sizeArray=new int[dim];
 	for(int i=0; i<dim; i++) { sizeArray[i]=size; }
 	this->initialize(dim, sizeArray, halo);
@@ -56,6 +65,9 @@ Lattice::~Lattice()
         delete[] sizeLocalAllProcDim0_;
         delete[] sizeLocalAllProcDim1_;
     }
+#ifdef FFT3D
+	if(kTables_!=NULL) delete[] kTables_;
+#endif
 }
 //INITIALIZE=========================
 
@@ -78,6 +90,13 @@ void Lattice::initialize(int dim, const int* size, int halo)
         delete[] sizeLocalAllProcDim0_;
         delete[] sizeLocalAllProcDim1_;
     }
+#ifdef FFT3D
+	if(kTables_!=NULL)
+	{
+		delete[] kTables_;
+		kTables_=NULL;
+	}
+#endif
 	//Store input lattice properties
 	dim_ =dim;
 	size_=new int[dim_];
@@ -225,24 +244,41 @@ void Lattice::initialize(int dim, const int* size, int halo)
 void Lattice::initializeRealFFT(Lattice & lat_real, int halo)
 {
 	
-	if(lat_real.dim()!=3)
+	if(lat_real.dim()<2 || lat_real.dim()>4)
 	{
 		if(parallel.isRoot())
 		{
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : fft curently work only for 3d cubic lattice"<<endl;
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : coordinate lattice have not 3 dimensions"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeRealFFT : fft curently work only for 2d, 3d and 4d lattice"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeRealFFT : coordinate lattice have "<<lat_real.dim()<<" dimensions"<<endl;
 			cerr<<"Latfield2d : Abort Process Requested"<<endl;
 			
 		}
 		parallel.abortForce();
 	}
 	
-	if(lat_real.size(0)!=lat_real.size(1) | lat_real.size(2)!=lat_real.size(1))
+	int lat_size[4];
+	int directions[4];
+	int dim = lat_real.dim();
+	
+	//rKSite directions: kx, kz, ky (3d), ky, kx (2d), kx, kw, kz, ky (4d)
+	for(int i=0;i<dim;i++)lat_size[i]=lat_real.size(i);
+	lat_size[0]=lat_real.size(0)/2+1;
+	std::swap(lat_size[dim-1],lat_size[dim-2]);
+	for(int i=0;i<dim;i++)directions[i]=i;
+	std::swap(directions[dim-1],directions[dim-2]);
+	
+	this->initialize(dim, lat_size, halo);
+	this->initializeWaveNumbers(lat_real, directions);
+}
+void Lattice::initializeRealFFTTransposed(Lattice & lat_real, int halo)
+{
+	
+	if(lat_real.dim()!=3)
 	{
 		if(parallel.isRoot())
 		{
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : fft curently work only for 3d cubic lattice"<<endl;
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : coordinate lattice is not cubic"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeRealFFTTransposed : fft curently work only for 3d lattice"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeRealFFTTransposed : coordinate lattice have not 3 dimensions"<<endl;
 			cerr<<"Latfield2d : Abort Process Requested"<<endl;
 			
 		}
@@ -250,47 +286,85 @@ void Lattice::initializeRealFFT(Lattice & lat_real, int halo)
 	}
 	
 	int lat_size[3];
+	int directions[3] = {1,2,0};
 	
-	lat_size[0]=lat_real.size(0)/2+1;
-	lat_size[1]=lat_real.size(0);
-	lat_size[2]=lat_real.size(0);
+	//cKSite directions: kz, kx, ky
+	lat_size[0]=lat_real.size(2);
+	lat_size[1]=lat_real.size(0)/2+1;
+	lat_size[2]=lat_real.size(1);
 	
 	this->initialize(3, lat_size, halo);
+	this->initializeWaveNumbers(lat_real, directions);
 }
 void Lattice::initializeComplexFFT(Lattice & lat_real, int halo)
 {
 	
-	if(lat_real.dim()!=3)
+	if(lat_real.dim()<2 || lat_real.dim()>4)
 	{
 		if(parallel.isRoot())
 		{
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : fft curently work only for 3d cubic lattice"<<endl;
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : coordinate lattice have not 3 dimensions"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeComplexFFT : fft curently work only for 2d, 3d and 4d lattice"<<endl;
+			cerr<<"Latfield2d::Lattice::initializeComplexFFT : coordinate lattice have "<<lat_real.dim()<<" dimensions"<<endl;
 			cerr<<"Latfield2d : Abort Process Requested"<<endl;
 			
 		}
 		parallel.abortForce();
 	}
 	
-	if(lat_real.size(0)!=lat_real.size(1) | lat_real.size(2)!=lat_real.size(1))
+	int lat_size[4];
+	int directions[4];
+	int dim = lat_real.dim();
+	
+	if(dim==3)
 	{
-		if(parallel.isRoot())
-		{
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : fft curently work only for 3d cubic lattice"<<endl;
-			cerr<<"Latfield2d::Lattice::initializeRealFFT : coordinate lattice is not cubic"<<endl;
-			cerr<<"Latfield2d : Abort Process Requested"<<endl;
-			
-		}
-		parallel.abortForce();
+		//cKSite directions: kz, kx, ky
+		lat_size[0]=lat_real.size(2);
+		lat_size[1]=lat_real.size(0);
+		lat_size[2]=lat_real.size(1);
+		directions[0]=1;
+		directions[1]=2;
+		directions[2]=0;
+	}
+	else
+	{
+		//cKSite directions: ky, kx (2d), kx, kw, kz, ky (4d)
+		for(int i=0;i<dim;i++)lat_size[i]=lat_real.size(i);
+		std::swap(lat_size[dim-1],lat_size[dim-2]);
+		for(int i=0;i<dim;i++)directions[i]=i;
+		std::swap(directions[dim-1],directions[dim-2]);
 	}
 	
-	int lat_size[3];
+	this->initialize(dim, lat_size, halo);
+	this->initializeWaveNumbers(lat_real, directions);
+}
+void Lattice::initializeWaveNumbers(Lattice & lat_real, const int * directions)
+{
+	long length = 0;
+	int i,n,m,N,size;
 	
-	lat_size[0]=lat_real.size(0);
-	lat_size[1]=lat_real.size(0);
-	lat_size[2]=lat_real.size(0);
+	for(i=0;i<dim_;i++) length += size_[directions[i]];
+	kTables_ = new double[4*length];
 	
-	this->initialize(3, lat_size, halo);
+	double * table = kTables_;
+	for(i=0;i<dim_;i++)
+	{
+		kDirections_[i] = directions[i];
+		size = size_[directions[i]];
+		N = lat_real.size(i);
+		for(int t=0;t<4;t++)
+		{
+			kTable_[t][i] = table;
+			table += size;
+		}
+		for(n=0;n<size;n++)
+		{
+			m = (2*n > N ? n - N : n);
+			kTable_[0][i][n] = 2.*M_PI*m/N;
+			kTable_[1][i][n] = kTable_[0][i][n]*kTable_[0][i][n];
+			kTable_[2][i][n] = 2.*sin(M_PI*m/N);
+			kTable_[3][i][n] = kTable_[2][i][n]*kTable_[2][i][n];
+		}
+	}
 }
 #endif
 
@@ -430,6 +504,13 @@ long Lattice::siteLast() { return siteLast_; }
 
 int * Lattice::sizeLocalAllProcDim0(){ return sizeLocalAllProcDim0_; }
 int * Lattice::sizeLocalAllProcDim1(){ return sizeLocalAllProcDim1_; }
+#ifdef FFT3D
+double * Lattice::waveNumber(int i) { return (kTables_==NULL ? NULL : kTable_[0][i]); }
+double * Lattice::waveNumber2(int i) { return (kTables_==NULL ? NULL : kTable_[1][i]); }
+double * Lattice::latticeWaveNumber(int i) { return (kTables_==NULL ? NULL : kTable_[2][i]); }
+double * Lattice::latticeWaveNumber2(int i) { return (kTables_==NULL ? NULL : kTable_[3][i]); }
+int Lattice::fourierDirection(int i) { return kDirections_[i]; }
+#endif
 
 #endif
 
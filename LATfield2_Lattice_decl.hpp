@@ -60,18 +60,55 @@ public:
     
     
     /*!
-     Initialization of a lattice for Fourier space in case of real to complex transform. The Fourier space lattice size is defined according to the real space one. The fourier space lattice have "halo" ghost cells in each dimension (which can be different than the halo of the real space lattice).
+     Initialization of a lattice for Fourier space in case of real to complex transform. The Fourier space lattice size is defined according to the real space one, which can be anisotropic: a Nx x Ny x Nz real lattice gives a (Nx/2+1) x Nz x Ny Fourier lattice, rKSite::coord(i) returning the wave vector coordinate along the real space direction i. 2d and 4d real lattices give Ny x (Nx/2+1) and (Nx/2+1) x Nw x Nz x Ny Fourier lattices (the last two directions are swapped). The fourier space lattice have "halo" ghost cells in each dimension (which can be different than the halo of the real space lattice).
      \param lat_real : pointer to a real space lattice.
      \param halo : size of the halo (same for each dimension)
      */
     void initializeRealFFT(Lattice & lat_real, int halo);
     
     /*!
-     Initialization of a lattice for Fourier space in case of complex to complex transform. The Fourier space lattice size is defined according to the real space one.. The fourier space lattice have "halo" ghost cells in each dimension (which can be different than the halo of the real space lattice).
+     Initialization of a lattice for Fourier space in case of real to complex transform with the transposed fourier space layout (see PlanFFT::initialize). A Nx x Ny x Nz real lattice gives a Nz x (Nx/2+1) x Ny Fourier lattice, which has to be iterated with cKSite: cKSite::coord(i) returns the wave vector coordinate along the real space direction i. The fourier space lattice have "halo" ghost cells in each dimension (which can be different than the halo of the real space lattice).
+     \param lat_real : pointer to a real space lattice.
+     \param halo : size of the halo (same for each dimension)
+     */
+    void initializeRealFFTTransposed(Lattice & lat_real, int halo);
+    
+    /*!
+     Initialization of a lattice for Fourier space in case of complex to complex transform. The Fourier space lattice size is defined according to the real space one: a Nx x Ny x Nz real lattice gives a Nz x Nx x Ny Fourier lattice, cKSite::coord(i) returning the wave vector coordinate along the real space direction i. 2d and 4d real lattices give Ny x Nx and Nx x Nw x Nz x Ny Fourier lattices. The fourier space lattice have "halo" ghost cells in each dimension (which can be different than the halo of the real space lattice).
      \param lat_real : pointer to a real space lattice.
      \param halo : size of the halo (same for each dimension)
      */
     void initializeComplexFFT(Lattice & lat_real, int halo);
+    
+    /*!
+     Table of the wave numbers of a Fourier space lattice (initialized with initializeRealFFT, initializeRealFFTTransposed or initializeComplexFFT) along the real space direction "direction": k = 2*pi*n/N in units of the inverse lattice spacing, where N is the real space lattice size and n the signed wave number (n-N for n > N/2, the Nyquist mode is positive). The table is indexed by the wave number coordinate returned by rKSite::coord(direction) or cKSite::coord(direction), which runs along the direction fourierDirection(direction) of this lattice.
+     \param direction : real space direction.
+     \return double*. Pointer to the table, NULL if the lattice is not a Fourier space lattice.
+     */
+    double * waveNumber(int direction);
+    
+    /*!
+     \return double*. Table of the squared wave numbers k^2 along the real space direction "direction", same indexing as waveNumber().
+     */
+    double * waveNumber2(int direction);
+    
+    /*!
+     Table of the lattice wave numbers 2*sin(pi*n/N) along the real space direction "direction", same indexing as waveNumber(). Their squares are minus the eigenvalues of the 3 points finite difference Laplacian, so they give the lattice corrected Green's functions.
+     \param direction : real space direction.
+     \return double*. Pointer to the table, NULL if the lattice is not a Fourier space lattice.
+     */
+    double * latticeWaveNumber(int direction);
+    
+    /*!
+     \return double*. Table of the squared lattice wave numbers 4*sin^2(pi*n/N) along the real space direction "direction", same indexing as waveNumber().
+     */
+    double * latticeWaveNumber2(int direction);
+    
+    /*!
+     \param direction : real space direction.
+     \return int. Direction of this Fourier space lattice which holds the wave numbers along the real space direction "direction".
+     */
+    int fourierDirection(int direction);
 #endif
     
     
@@ -215,6 +252,14 @@ private:
     //save variable for fast save
     int arch_saved_;
     
+#ifdef FFT3D
+    //wave number tables of Fourier space lattices: k, k^2, 2sin(pi n/N), 4sin^2(pi n/N), per real space direction
+    void initializeWaveNumbers(Lattice & lat_real, const int * directions);
+    double * kTables_;
+    double * kTable_[4][4];
+    int kDirections_[4];
+#endif
+    
 };
 
 #endif
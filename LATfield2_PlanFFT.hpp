@@ -15,6 +15,8 @@ const int FFT_FORWARD = 1;
 const int FFT_BACKWARD = -1;
 const int FFT_IN_PLACE = 16;
 const int FFT_OUT_OF_PLACE = -16;
+const int PS_BIN_LINEAR = 0;
+const int PS_BIN_LOG = 1;
 
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -31,16 +33,16 @@ temporaryMemFFT::~temporaryMemFFT()
 	if(allocated_>0)
 	{
 #ifdef SINGLE
-		//if(temp1_!=NULL)fftwf_free(temp1_);
-		//if(temp2_!=NULL)fftwf_free(temp2_);
+		if(temp1_!=NULL)fftwf_free(temp1_);
+		if(temp2_!=NULL)fftwf_free(temp2_);
 #endif
 #ifndef SINGLE
-		//if(temp1_!=NULL)fftw_free(temp1_);
-		//if(temp2_!=NULL)fftw_free(temp2_);
+		if(temp1_!=NULL)fftw_free(temp1_);
+		if(temp2_!=NULL)fftw_free(temp2_);
 #endif
-		//allocated_ = 0;
-		//temp1_=NULL;
-		//temp2_=NULL;
+		allocated_ = 0;
+		temp1_=NULL;
+		temp2_=NULL;
 	}
 
 }
@@ -91,11 +93,256 @@ int temporaryMemFFT::setTemp(long size)
 	return 1;
 }
 
+//////////////////////Pencil splits///////////////////////////
+
+fftChunks::fftChunks()
+{
+	procs = 0;
+	size = NULL;
+	offset = NULL;
+}
+
+fftChunks::~fftChunks()
+{
+	if(size!=NULL)delete[] size;
+}
+
+void fftChunks::initialize(int length, int nprocs)
+{
+	if(size!=NULL)delete[] size;
+	procs = nprocs;
+	size = new int[2*nprocs];
+	offset = size + nprocs;
+
+	for(int i=0;i<nprocs;i++)
+	{
+		size[i] = int(ceil((nprocs-i)*length/float(nprocs))) - int(ceil((nprocs-i-1)*length/float(nprocs)));
+		offset[i] = (i==0 ? 0 : offset[i-1] + size[i-1]);
+	}
+}
+
+//////////////////////Stage timers///////////////////////////
+
+fftStageTimers::fftStageTimers()
+{
+	reset();
+}
+
+void fftStageTimers::reset()
+{
+	for(int i=0;i<STAGES;i++)
+	{
+		time[i] = 0;
+		bytes[i] = 0;
+		calls[i] = 0;
+	}
+}
+
+void fftStageTimers::add(int stage, double seconds, double volume)
+{
+	time[stage] += seconds;
+	bytes[stage] += volume;
+	calls[stage]++;
+}
+
+const char * fftStageTimers::name(int stage)
+{
+	static const char * names[STAGES] = {"fft_x","fft_y","fft_z","transpose_xy","transpose_yx","transpose_yz","transpose_zy","transpose_zk","transpose_kz","exchange_1","exchange_2","exchange_3","convert"};
+	return names[stage];
+}
+
+//////////////////////Plan registry///////////////////////////
+
+bool fftPlanKey::operator==(const fftPlanKey & other) const
+{
+	if(!sameLattice(other))return false;
+	if(type!=other.type || precision!=other.precision || components!=other.components || alignment!=other.alignment || transposed!=other.transposed)return false;
+	if(wJump[0]!=other.wJump[0] || wJump[1]!=other.wJump[1])return false;
+	for(int i=0;i<3;i++)
+	{
+		if(kSizeLocal[i]!=other.kSizeLocal[i] || rJump[i]!=other.rJump[i] || kJump[i]!=other.kJump[i] || r2rKinds[i]!=other.r2rKinds[i])return false;
+	}
+	return true;
+}
+
+bool fftPlanKey::sameLattice(const fftPlanKey & other) const
+{
+	if(padded!=other.padded || dim!=other.dim || wSize!=other.wSize || batch!=other.batch)return false;
+	for(int i=0;i<3;i++)
+	{
+		if(rSize[i]!=other.rSize[i] || rSizeLocal[i]!=other.rSizeLocal[i])return false;
+	}
+	return true;
+}
+
+fftPlanRegistry::fftPlanRegistry()
+{
+}
+
+fftPlanRegistry::~fftPlanRegistry()
+{
+	//plans still referenced at exit belong to PlanFFT which are never destroyed (leaked or static)
+	for(std::list<fftPlanSet*>::iterator it=planSets_.begin();it!=planSets_.end();++it)
+	{
+		destroyPlans(*it);
+		delete *it;
+	}
+	planSets_.clear();
+	for(std::list<fftScratch*>::iterator it=scratch_.begin();it!=scratch_.end();++it)
+	{
+		delete (*it)->memory;
+		delete *it;
+	}
+	scratch_.clear();
+}
+
+long fftPlanRegistry::scratchSize(const int * rSize, const int * rSizeLocal, int padded, int wSize, int batch)
+{
+	//largest pencil of the C2C and R2C transforms, with the largest chunk of the uneven splits.
+	//Padded transforms have twice the lattice size in each direction, the x transforms of 4d lattices also run over w
+	long t[3];
+	for(int i=0;i<3;i++) t[i] = (padded ? 2*(long)rSize[i] : rSize[i]);
+	t[0] *= wSize;
+	long nx = (t[0] + parallel.grid_size()[1] - 1) / parallel.grid_size()[1];
+	long ny = (t[1] + parallel.grid_size()[0] - 1) / parallel.grid_size()[0];
+	long nz = (t[2] + parallel.grid_size()[1] - 1) / parallel.grid_size()[1];
+	long size = (t[0]+1) * rSizeLocal[1] * rSizeLocal[2];
+	if(nx * t[1] * rSizeLocal[2] > size) size = nx * t[1] * rSizeLocal[2];
+	if(nx * ny * t[2] > size) size = nx * ny * t[2];
+	if((t[0]+1) * ny * nz > size) size = (t[0]+1) * ny * nz;
+	return size * batch;
+}
+
+fftPlanSet * fftPlanRegistry::acquire(const fftPlanKey & key, bool & created)
+{
+	for(std::list<fftPlanSet*>::iterator it=planSets_.begin();it!=planSets_.end();++it)
+	{
+		if((*it)->key == key)
+		{
+			(*it)->refCount++;
+			created = false;
+			return *it;
+		}
+	}
+
+	fftPlanSet * set = new fftPlanSet;
+	set->key = key;
+	set->refCount = 1;
+	set->scratch = acquireScratch(key);
+	set->fPlan_i = NULLFFTWPLAN;
+	set->fPlan_j = NULLFFTWPLAN;
+	set->fPlan_k = NULLFFTWPLAN;
+	set->fPlan_z = NULLFFTWPLAN;
+	set->bPlan_i = NULLFFTWPLAN;
+	set->bPlan_j = NULLFFTWPLAN;
+	set->bPlan_z = NULLFFTWPLAN;
+	set->bPlan_k = NULLFFTWPLAN;
+	planSets_.push_back(set);
+
+	created = true;
+	return set;
+}
+
+void fftPlanRegistry::release(fftPlanSet * set)
+{
+	if(set==NULL)return;
+	set->refCount--;
+	if(set->refCount>0)return;
+
+	planSets_.remove(set);
+	destroyPlans(set);
+	releaseScratch(set->scratch);
+	delete set;
+}
+
+fftScratch * fftPlanRegistry::acquireScratch(const fftPlanKey & key)
+{
+	for(std::list<fftScratch*>::iterator it=scratch_.begin();it!=scratch_.end();++it)
+	{
+		if((*it)->key.sameLattice(key))
+		{
+			(*it)->refCount++;
+			return *it;
+		}
+	}
+
+	fftScratch * scratch = new fftScratch;
+	scratch->key = key;
+	scratch->refCount = 1;
+	scratch->memory = new temporaryMemFFT(scratchSize(key.rSize,key.rSizeLocal,key.padded,key.wSize,key.batch));
+	scratch_.push_back(scratch);
+	return scratch;
+}
+
+void fftPlanRegistry::releaseScratch(fftScratch * scratch)
+{
+	scratch->refCount--;
+	if(scratch->refCount>0)return;
+
+	scratch_.remove(scratch);
+	delete scratch->memory;
+	delete scratch;
+}
+
+void fftPlanRegistry::destroyPlans(fftPlanSet * set)
+{
+#ifdef SINGLE
+	if(set->fPlan_i != NULLFFTWPLAN) fftwf_destroy_plan(set->fPlan_i);
+	if(set->fPlan_j != NULLFFTWPLAN) fftwf_destroy_plan(set->fPlan_j);
+	if(set->fPlan_k != NULLFFTWPLAN) fftwf_destroy_plan(set->fPlan_k);
+	if(set->fPlan_z != NULLFFTWPLAN) fftwf_destroy_plan(set->fPlan_z);
+	if(set->bPlan_i != NULLFFTWPLAN) fftwf_destroy_plan(set->bPlan_i);
+	if(set->bPlan_j != NULLFFTWPLAN) fftwf_destroy_plan(set->bPlan_j);
+	if(set->bPlan_z != NULLFFTWPLAN) fftwf_destroy_plan(set->bPlan_z);
+	if(set->bPlan_k != NULLFFTWPLAN) fftwf_destroy_plan(set->bPlan_k);
+#else
+	if(set->fPlan_i != NULLFFTWPLAN) fftw_destroy_plan(set->fPlan_i);
+	if(set->fPlan_j != NULLFFTWPLAN) fftw_destroy_plan(set->fPlan_j);
+	if(set->fPlan_k != NULLFFTWPLAN) fftw_destroy_plan(set->fPlan_k);
+	if(set->fPlan_z != NULLFFTWPLAN) fftw_destroy_plan(set->fPlan_z);
+	if(set->bPlan_i != NULLFFTWPLAN) fftw_destroy_plan(set->bPlan_i);
+	if(set->bPlan_j != NULLFFTWPLAN) fftw_destroy_plan(set->bPlan_j);
+	if(set->bPlan_z != NULLFFTWPLAN) fftw_destroy_plan(set->bPlan_z);
+	if(set->bPlan_k != NULLFFTWPLAN) fftw_destroy_plan(set->bPlan_k);
+#endif
+	set->fPlan_i = NULLFFTWPLAN;
+	set->fPlan_j = NULLFFTWPLAN;
+	set->fPlan_k = NULLFFTWPLAN;
+	set->fPlan_z = NULLFFTWPLAN;
+	set->bPlan_i = NULLFFTWPLAN;
+	set->bPlan_j = NULLFFTWPLAN;
+	set->bPlan_z = NULLFFTWPLAN;
+	set->bPlan_k = NULLFFTWPLAN;
+}
+
+int fftPlanRegistry::planSets()
+{
+	return planSets_.size();
+}
+
+int fftPlanRegistry::scratchBuffers()
+{
+	return scratch_.size();
+}
+
+long fftPlanRegistry::scratchMemory()
+{
+	long mem = 0;
+	for(std::list<fftScratch*>::iterator it=scratch_.begin();it!=scratch_.end();++it)
+	{
+#ifdef SINGLE
+		mem += 2 * (*it)->memory->allocated() * sizeof(fftwf_complex);
+#else
+		mem += 2 * (*it)->memory->allocated() * sizeof(fftw_complex);
+#endif
+	}
+	return mem;
+}
+
 
 #endif
-//////////////////////Temp memory///////////////////////////
 
-temporaryMemFFT tempMemory;
+fftPlanRegistry fftRegistry;
 
 
 
@@ -26,6 +26,8 @@ extern  const int FFT_FORWARD;
 extern  const int FFT_BACKWARD;
 extern  const int FFT_IN_PLACE;
 extern  const int FFT_OUT_OF_PLACE;
+extern  const int PS_BIN_LINEAR;
+extern  const int PS_BIN_LOG;
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
@@ -40,6 +42,7 @@ extern  const int FFT_OUT_OF_PLACE;
  		temporaryMemFFT(long size);
 
  		int setTemp(long size);
+ 		long allocated(){return allocated_;}
 
  #ifdef SINGLE
  		fftwf_complex* temp1(){return temp1_;}
@@ -65,15 +68,170 @@ extern  const int FFT_OUT_OF_PLACE;
  	};
 
 
-extern  temporaryMemFFT tempMemory;
+/*! \struct fftPlanKey
+ \brief Description of the data layout of a PlanFFT, used to identify plans which can be shared.
+ */
+struct fftPlanKey
+{
+	int type;
+	int precision;
+	int components;
+	int rSize[3];
+	int rSizeLocal[3];
+	int kSizeLocal[3];
+	int rJump[3];
+	int kJump[3];
+	int alignment;
+	int padded;
+	int transposed;
+	int dim;
+	int wSize;
+	int wJump[2];
+	int r2rKinds[3];
+	int batch;   //components transformed together in the pencils, 3 for the spectral derivatives (see PlanFFT::gradient)
+
+	bool operator==(const fftPlanKey & other) const;
+	bool sameLattice(const fftPlanKey & other) const;
+};
+
+/*! \struct fftScratch
+ \brief Work arrays shared by all the plans of a given real space lattice and batch.
+ */
+struct fftScratch
+{
+	fftPlanKey key;
+	temporaryMemFFT * memory;
+	int refCount;
+};
+
+/*! \struct fftPlanSet
+ \brief fftw plans of a PlanFFT, shared by every PlanFFT with the same fftPlanKey.
+ */
+struct fftPlanSet
+{
+	fftPlanKey key;
+	fftScratch * scratch;
+	int refCount;
+
+#ifdef SINGLE
+	fftwf_plan fPlan_i;
+	fftwf_plan fPlan_j;
+	fftwf_plan fPlan_k;
+	fftwf_plan fPlan_z;
+	fftwf_plan bPlan_i;
+	fftwf_plan bPlan_j;
+	fftwf_plan bPlan_z;
+	fftwf_plan bPlan_k;
+#else
+	fftw_plan fPlan_i;
+	fftw_plan fPlan_j;
+	fftw_plan fPlan_k;
+	fftw_plan fPlan_z;
+	fftw_plan bPlan_i;
+	fftw_plan bPlan_j;
+	fftw_plan bPlan_z;
+	fftw_plan bPlan_k;
+#endif
+};
+
+/*! \class fftPlanRegistry
+ \brief Registry of the fftw plans and work arrays used by PlanFFT.
+
+ Plans are deduplicated on the lattice geometry, the number of components and the precision: two PlanFFT on fields with the same layout execute the same fftw plans. The work arrays (temp_ and temp1_ of PlanFFT) are shared by all the plans of a real space lattice with the same batch, the plans of the spectral derivatives have their own, 3 times larger. Both are reference counted; plans are destroyed and work arrays freed as soon as the last PlanFFT using them is destroyed.
+ */
+class fftPlanRegistry
+{
+public:
+	fftPlanRegistry();
+	~fftPlanRegistry();
+
+	/*!
+	 Look for a plan set matching key and increase its reference count. If none exists, an empty set (all plans NULL) is created together with its work arrays; the caller then has to create the plans.
+	 \param key : layout of the transform.
+	 \param created : set to true if the returned set is new.
+	 \return pointer to the plan set.
+	 */
+	fftPlanSet * acquire(const fftPlanKey & key, bool & created);
+
+	/*!
+	 Decrease the reference count of a plan set. The plans are destroyed when it reaches 0, the work arrays when no plan set of the lattice remains.
+	 */
+	void release(fftPlanSet * set);
+
+	//! \return number of distinct plan sets alive.
+	int planSets();
+	//! \return number of work array pairs alive.
+	int scratchBuffers();
+	//! \return memory used by the work arrays, in bytes.
+	long scratchMemory();
+
+	/*!
+	 \return number of fftw(f)_complex of each work array for a given real space lattice. Large enough for both R2C and C2C transforms, so that a work array never has to be reallocated while plans point to it. padded selects the zero padded transforms (see PlanFFT::initializePadded), wSize is the length of the second local direction of 4d lattices (transformed together with x), batch the number of components held together in the pencils.
+	 */
+	static long scratchSize(const int * rSize, const int * rSizeLocal, int padded = 0, int wSize = 1, int batch = 1);
+
+private:
+	fftScratch * acquireScratch(const fftPlanKey & key);
+	void releaseScratch(fftScratch * scratch);
+	void destroyPlans(fftPlanSet * set);
+
+	std::list<fftPlanSet*> planSets_;
+	std::list<fftScratch*> scratch_;
+};
+
+extern  fftPlanRegistry fftRegistry;
+
+/*! \struct fftChunks
+ \brief Split of one lattice direction over one dimension of the process grid, with the same rule as the Lattice class.
+ */
+struct fftChunks
+{
+	int procs;
+	int * size;   //number of sites owned by each process
+	int * offset; //first site owned by each process
+
+	fftChunks();
+	~fftChunks();
+	void initialize(int length, int nprocs);
+};
+
+/*! \class fftStageTimers
+ \brief Wall clock time, data volume and number of calls of each stage of the PlanFFT transforms, filled by the plans given to PlanFFT::setStageTimers().
+
+ The stages are the local transforms along each direction (FFT_X, FFT_Y, FFT_Z), the local reorderings around the redistributions (TRANSPOSE_XY ... TRANSPOSE_KZ) and the redistributions themselves (EXCHANGE_1: x <-> y pencils, EXCHANGE_2: y <-> z pencils, EXCHANGE_3: z pencils <-> fourier space layout), plus CONVERT, with setSinglePrecisionTransport(true), the conversion to single precision of the transform output sent by a forward exchange and back to double precision of the data received by a backward one (the reorderings read and write the other side in single precision directly). The times are the ones of this process (an exchange includes the wait for the other processes of its communicator), bytes counts the data read and written by the local stages and the data sent by the exchanges. The counters accumulate until reset().
+ */
+class fftStageTimers
+{
+public:
+	enum { FFT_X, FFT_Y, FFT_Z, TRANSPOSE_XY, TRANSPOSE_YX, TRANSPOSE_YZ, TRANSPOSE_ZY, TRANSPOSE_ZK, TRANSPOSE_KZ, EXCHANGE_1, EXCHANGE_2, EXCHANGE_3, CONVERT, STAGES };
+
+	fftStageTimers();
+	//! Sets every counter to zero.
+	void reset();
+	void add(int stage, double seconds, double volume);
+	//! \return the name of a stage ("fft_x", "transpose_xy", "exchange_1", ...).
+	static const char * name(int stage);
+
+	double time[STAGES];  //seconds
+	double bytes[STAGES];
+	long calls[STAGES];
+};
 
 /*! \class PlanFFT
 
- \brief Class which handle fourier transforms of fields on 3d cubic lattices.
+ \brief Class which handle fourier transforms of fields on 2d, 3d and 4d lattices.
  This class allow to perform fourier transform of real and complex fields. See poissonSolver example to have have a short intro of usage.
 
  One should understand that first a plan is created then execute (in the FFTW fashion). The plan link to fields, one on fourier space, one on real space. Both field will be allocated by the planer. But need to be initialized.
 
+ The real space lattice can be anisotropic (Nx x Ny x Nz) and its sizes do not need to be multiples of the process grid sizes: the transform is a pencil decomposition whose redistributions (MPI_Alltoallv) follow the uneven split of the Lattice class. Every process must own at least one x frequency along dim1 of the process grid, one y frequency along dim0, and for real to complex transforms one z frequency along dim1.
+
+ 2d and 4d lattices are transformed with the same pencils, without embedding them in a 3d lattice. In 2d the x transform is followed by a single redistribution over dim0 and the y transform, which requires a process grid of size n x 1. In 4d (x, w, y, z lattice) the two local directions x and w are transformed together, and the Fourier space lattice is (kx, kw, kz, ky) for both real to complex and complex to complex transforms. 2d and 4d plans only support execute().
+
+ Zero padded plans (initializePadded) compute convolutions with isolated boundary conditions without allocating the padded lattice.
+
+ Real to real plans (initializeR2R) compute cosine and sine transforms, for boxes with Dirichlet or Neumann boundary conditions, with the pencils of the complex to complex transforms.
+
  One need to be carefull to corretly define the lattice and field.
  \sa void Lattice::initializeRealFFT(Lattice & lat_real, int halo);
  \sa void Lattice::initializeComplexFFT(Lattice & lat_real, int halo);
@@ -113,16 +271,21 @@ public:
    \param rfield : real space field
    \param kfield : fourier space field
    \param mem_type : memory type (FFT_OUT_OF_PLACE or FFT_IN_PLACE). In place mean that both fourier and real space field point to the same data array.
+   \param transposed : transposed fourier space layout, see initialize().
    */
-  PlanFFT(Field<double>* rfield, Field<compType>*  kfield,const int mem_type = FFT_OUT_OF_PLACE);
+  PlanFFT(Field<double>* rfield, Field<compType>*  kfield,const int mem_type = FFT_OUT_OF_PLACE, bool transposed = false);
   /*!
    initialization for real to complex tranform.
    For more detail see the QuickStart guide.
+
+   With transposed = true, the fourier space field is kept in the last pencil layout of the transform (kz fastest, the kx frequencies split over dim1 and the ky ones over dim0 of the process grid) instead of the (kx, kz, ky) layout: the forward transform skips its last redistribution and local reordering, and the backward transform starts directly from that layout. The fourier space lattice must then be built with Lattice::initializeRealFFTTransposed and iterated with cKSite, whose coord(0..2) are still kx (in [0,Nx/2]), ky and kz.
+
    \param rfield : real space field
    \param kfield : fourier space field
    \param mem_type : memory type (FFT_OUT_OF_PLACE or FFT_IN_PLACE). In place mean that both fourier and real space field point to the same data array.
+   \param transposed : transposed fourier space layout.
    */
-  void initialize(Field<double>*  rfield,Field<compType>*   kfield,const int mem_type = FFT_OUT_OF_PLACE);
+  void initialize(Field<double>*  rfield,Field<compType>*   kfield,const int mem_type = FFT_OUT_OF_PLACE, bool transposed = false);
 
 
 
@@ -134,35 +297,188 @@ public:
   void initialize(Field<compType>*  rfield,Field<compType>*   kfield,const int mem_type = FFT_OUT_OF_PLACE);
 
 
-  PlanFFT(Field<float>* rfield, Field<compType>*  kfield,const int mem_type = FFT_OUT_OF_PLACE);
-  void initialize(Field<float>*  rfield,Field<compType>*   kfield,const int mem_type = FFT_OUT_OF_PLACE);
+  PlanFFT(Field<float>* rfield, Field<compType>*  kfield,const int mem_type = FFT_OUT_OF_PLACE, bool transposed = false);
+  void initialize(Field<float>*  rfield,Field<compType>*   kfield,const int mem_type = FFT_OUT_OF_PLACE, bool transposed = false);
 
 
 #endif
 
+  /*!
+   Initialization for real to real transforms (cosine and sine transforms), for boxes with Dirichlet or Neumann boundary conditions. Each direction is transformed with the fftw r2r kind given for it (FFTW_REDFT10 for the DCT-II, FFTW_RODFT10 for the DST-II, their inverses FFTW_REDFT01 and FFTW_RODFT01, FFTW_REDFT00, ...), the backward transform uses the inverse kinds. The transforms go through the pencils of the complex to complex plans, two components at a time (as the real and imaginary parts of the work arrays), and the fourier space field has the complex to complex layout: its lattice must be built with Lattice::initializeComplexFFT and iterated with cKSite, whose coord(0..2) are the indices of the r2r coefficients along x, y and z. The wave numbers of Lattice::waveNumber() are the periodic ones and do not apply (the DCT-II/DST-II mode n has k = pi*n/N, resp. pi*(n+1)/N).
+
+   Only 3d lattices are supported, and the plan supports execute() and convolve(Field<Real>*,Field<Real>*,Kernel) with a real kernel. As for the fftw r2r transforms, nothing is normalized: a forward and backward transform multiply the field by the product of the logical sizes of the directions, 2N for the REDFT10/01/11 and RODFT10/01/11 kinds, 2(N-1) for FFTW_REDFT00, 2(N+1) for FFTW_RODFT00 and N for FFTW_R2HC/FFTW_HC2R/FFTW_DHT.
 
+   \param rfield : real space field
+   \param kfield : fourier space field, same number of components.
+   \param kinds : r2r kinds of the lattice directions 0, 1 and 2.
+   \param mem_type : memory type (FFT_OUT_OF_PLACE or FFT_IN_PLACE). In place mean that both fourier and real space field point to the same data array.
+   */
+  void initializeR2R(Field<Real>* rfield, Field<Real>* kfield, const fftw_r2r_kind * kinds, const int mem_type = FFT_OUT_OF_PLACE);
 
   void execute(int fft_type);
 
+  /*!
+   Enables the single precision transport of a double precision plan: the data exchanged between the pencil layouts travel as float, the transforms themselves stay in double precision. The local reorderings read the received blocks and write the sent ones in single precision, only the transform output sent by a forward exchange and the transform input received by a backward one take an extra conversion pass. This halves the communication volume at the price of a single precision rounding of each exchanged value (relative error of order 1e-7 on the result). Disabled by default, no effect when compiled with SINGLE.
+
+   \param enable : true to exchange the data in single precision, false to restore full precision.
+   */
+  void setSinglePrecisionTransport(bool enable = true);
+
+  /*!
+   Enables the timing of the stages of the transforms (local transforms, local reorderings and redistributions) executed by this plan, for benchmarks. The plan adds the time of each stage to timers, which is owned by the caller and can be shared by several plans. The timing costs two MPI_Wtime calls per stage, NULL (the default) disables it.
+
+   \param timers : counters receiving the stage times, or NULL.
+   */
+  void setStageTimers(fftStageTimers * timers);
+
+  /*!
+   Fused convolution for real to complex plans: forward transform of rfield_in, multiplication of each Fourier mode by kernel(k) and backward transform into rfield_out, in a single call.
+
+   The kernel is applied while the data sits in the last pencil layout of the forward transform, and the backward transform starts directly from that layout: the Fourier space field of the plan is neither written nor read, and the final redistribution of the forward transform and the first one of the backward transform are skipped.
+
+   The kernel is any callable kernel(k0,k1,k2) returning a Real or an Imag; k0,k1,k2 are the integer wave vector coordinates as returned by rKSite::coord(0..2) (in [0,Nx/2] for k0, [0,Ny[ for k1 and [0,Nz[ for k2). As for execute(), the transforms are not normalized. rfield_in and rfield_out (which can be the same field) must have the same lattice and number of components as the real space field of the plan.
+
+   Real to real plans (initializeR2R) are also accepted: k0,k1,k2 are then the indices of the r2r coefficients (the cKSite coordinates) and the kernel must be real, only the real part of an Imag kernel is used.
+
+   \param rfield_in : real space field to convolve.
+   \param rfield_out : real space field receiving the result.
+   \param kernel : callable kernel(int,int,int).
+   */
+  template<class Kernel>
+  void convolve(Field<Real>* rfield_in, Field<Real>* rfield_out, Kernel kernel);
+
+  /*!
+   Fused convolution for complex to complex plans, same as the real to complex version. The k coordinates given to the kernel are the ones returned by cKSite::coord(0..2).
+   */
+  template<class Kernel>
+  void convolve(Field<compType>* rfield_in, Field<compType>* rfield_out, Kernel kernel);
+
+  /*!
+   Spectral gradient for real to complex plans of a scalar field: phi is transformed forward once, then the three components i*k_i*phi(k) are built from that single spectrum and transformed back together into grad, the pencils holding the 3 components so that each redistribution is a single exchange. As for convolve(), the Fourier space field of the plan is not used and the redistribution between the last pencil layout and the Fourier space layout is skipped.
+
+   The wave numbers are k_i = 2*pi*n_i/N_i in units of the inverse lattice spacing, the Nyquist mode is dropped. The result is not normalized (divide by the number of lattice sites).
+
+   \param phi : scalar field with the layout of the real space field of the plan (which must have 1 component).
+   \param grad : 3 components field on the same lattice, component i receives the derivative along the lattice direction i.
+   */
+  void gradient(Field<Real>* phi, Field<Real>* grad);
+
+  /*!
+   Spectral divergence for real to complex plans of a scalar field: the three components of vec are transformed forward together (one exchange per redistribution, as in gradient()), i*k_i*vec_i(k) is summed in k space and a single backward transform writes div. Same conventions as gradient().
+
+   \param vec : 3 components field on the lattice of the real space field of the plan.
+   \param div : scalar field with the layout of the real space field of the plan.
+   */
+  void divergence(Field<Real>* vec, Field<Real>* div);
+
+  /*!
+   Spectral Laplacian -k^2*phi(k) for real to complex plans, computed with convolve(). Same conventions as gradient(), the Nyquist mode is kept.
+
+   \param phi : real space field to differentiate.
+   \param lap : real space field receiving the result (can be phi).
+   */
+  void laplacian(Field<Real>* phi, Field<Real>* lap);
+
+  /*!
+   Power spectra and cross spectra of Fourier space fields, binned in |k| in a single pass over the Fourier lattice and a single reduction. Every component of every field is an input of the estimator; with n inputs, the n*(n+1)/2 pairs (a,b), a<=b, are ordered (0,0),(0,1)...(0,n-1),(1,1)...
+
+   |k| = 2*pi*sqrt(sum_i (n_i/N_i)^2) in units of the inverse lattice spacing, the zero mode is excluded. For real to complex plans each mode of the stored half space counts twice, except the kx=0 and kx=Nx/2 planes which hold their own conjugates. As for execute(), nothing is normalized: pk is the average of Re(f_a(k) f_b(k)^*) over the modes of the bin.
+
+   \param kfields : array of nfields fields on the Fourier space lattice of the plan.
+   \param nfields : number of fields.
+   \param nbins : number of bins.
+   \param kmin : lower edge of the first bin (must be >0 for PS_BIN_LOG).
+   \param kmax : upper edge of the last bin.
+   \param pk : output, nbins*npairs values, pk[bin + nbins*pair]. Empty bins are set to 0.
+   \param kbin : output (can be NULL), nbins values, mean |k| of the modes of each bin.
+   \param modes : output (can be NULL), nbins values, number of modes of each bin.
+   \param binning : PS_BIN_LINEAR or PS_BIN_LOG.
+   \param window : order of the mass assignment window deconvolved from the spectra (0 none, 1 NGP, 2 CIC, 3 TSC): each pair is divided by prod_i sinc(pi*n_i/N_i)^(2*window).
+   */
+  void powerSpectrum(Field<compType>** kfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin = NULL, double * modes = NULL, int binning = PS_BIN_LINEAR, int window = 0);
+
+  /*!
+   Same as powerSpectrum() from real space fields with the layout of the real space field of the plan. The components of all the fields are transformed forward together, one redistribution per stage, on work arrays shared through the registry, and binned straight from the last pencil layout: the Fourier space field of the plan is not used and the final redistribution of the forward transform is skipped. The spectra are the ones of the fields execute() would produce.
+   */
+  void transformPowerSpectrum(Field<Real>** rfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin = NULL, double * modes = NULL, int binning = PS_BIN_LINEAR, int window = 0);
+
+  /*!
+   Complex to complex version of transformPowerSpectrum().
+   */
+  void transformPowerSpectrum(Field<compType>** rfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin = NULL, double * modes = NULL, int binning = PS_BIN_LINEAR, int window = 0);
+
+  /*!
+   Gaussian random field for real to complex plans: the Fourier modes are drawn with a counter-based generator keyed on the global wave vector, so that the field does not depend on the process grid, and are multiplied by sqrt(spectrum(k)) in the same pass. The modes are generated directly in the last pencil layout and transformed backward into rfield; the Fourier space field of the plan is not used.
+
+   The modes are delta(k) = sqrt(P(k)/2)*(g1 + i*g2) with g1,g2 standard normal deviates, so that <|delta(k)|^2> = P(k), and the real field is the backward transform f(x) = sum_k delta(k) exp(i*k*x) (as for execute(), without normalization). The Hermitian symmetry of the kx=0 and kx=Nx/2 planes is enforced, self-conjugate modes being real with variance P(k): on these planes only one mode of each pair k, -k is drawn, with the spectrum evaluated at its coordinates, and the other one is its conjugate, so spectrum does not need to be symmetric under k -> N-k. Each component of rfield is an independent realization.
+
+   \param rfield : real space field with the layout of the real space field of the plan.
+   \param spectrum : callable spectrum(k0,k1,k2) returning P(k), with the rKSite coordinates of the mode (as the kernels of convolve()).
+   \param seed : seed of the generator.
+   */
+  template<class Spectrum>
+  void gaussianRandomField(Field<Real>* rfield, Spectrum spectrum, unsigned long long seed);
+
+  /*!
+   Complex to complex version of gaussianRandomField(), every mode is an independent complex deviate with <|delta(k)|^2> = P(k). The coordinates given to spectrum are the cKSite ones.
+   */
+  template<class Spectrum>
+  void gaussianRandomField(Field<compType>* rfield, Spectrum spectrum, unsigned long long seed);
+
+  /*!
+   Writes the modes gaussianRandomField() would generate in a Fourier space field of the plan layout, for instance to apply further operations before calling execute(FFT_BACKWARD).
+
+   \param kfield : field on the Fourier space lattice of the plan.
+   \param spectrum : callable spectrum(k0,k1,k2) returning P(k).
+   \param seed : seed of the generator.
+   */
+  template<class Spectrum>
+  void gaussianRandomModes(Field<compType>* kfield, Spectrum spectrum, unsigned long long seed);
+
+  /*!
+   Initialization of a zero padded plan, for convolutions with isolated (non periodic) boundary conditions. The transforms are done on a lattice twice as large as the lattice of rfield in each direction, rfield being the corner [0,Nx[x[0,Ny[x[0,Nz[ of it and the rest of the padded lattice being zero. The padded lattice is never allocated: only the rows holding data are transformed along x and y, the zeros are added locally before the y and z transforms, and only the data (not the padding) is redistributed between the pencil layouts. On the way back, only the part of the result which lies in rfield is transformed and redistributed.
+
+   Zero padded plans are real to complex and only support the convolutions: convolve(Field<Real>*,Field<Real>*) with the Green's function given to setGreenFunction(), and convolve(Field<Real>*,Field<Real>*,Kernel) with a kernel on the padded Fourier lattice (k0 in [0,Nx], k1 in [0,2Ny[, k2 in [0,2Nz[).
+
+   \param rfield : real space field, allocated by the planer if needed. Fields given to convolve() must have the same lattice and number of components.
+   */
+  void initializePadded(Field<Real>* rfield);
+
+  /*!
+   Transforms a Green's function on the padded lattice and keeps it for the subsequent convolutions of a zero padded plan. green(dx,dy,dz) is called with every displacement of the padded lattice, -Nx <= dx < Nx (and similarly for y and z); its transform is computed once here, with 8 padded transforms, and reused by each convolve() call.
+
+   \param green : callable green(int,int,int) returning a Real.
+   */
+  template<class Green>
+  void setGreenFunction(Green green);
+
+  /*!
+   Isolated convolution of a zero padded plan with the Green's function given to setGreenFunction(): rfield_out(x) = sum_y green(x-y) rfield_in(y), the sum running over the lattice of rfield_in. The result is normalized (unlike the transforms of execute()). rfield_in and rfield_out can be the same field.
+
+   \param rfield_in : real space field to convolve.
+   \param rfield_out : real space field receiving the result.
+   */
+  void convolve(Field<Real>* rfield_in, Field<Real>* rfield_out);
+
 private:
   void PrintPlans() {
 #ifndef SINGLE
     std::cout << fPlan_i_ << " "; fftw_print_plan(fPlan_i_); std::cout << std::endl;
     std::cout << fPlan_j_ << " "; fftw_print_plan(fPlan_j_); std::cout << std::endl;
-    std::cout << fPlan_k_ << " "; fftw_print_plan(fPlan_k_); std::cout << std::endl;
-    std::cout << fPlan_k_real_ << " "; fftw_print_plan(fPlan_k_real_); std::cout << std::endl;
-    std::cout << bPlan_k_ << " "; fftw_print_plan(bPlan_k_); std::cout << std::endl;
+    std::cout << fPlan_z_ << " "; fftw_print_plan(fPlan_z_); std::cout << std::endl;
+    if(fPlan_k_ != NULLFFTWPLAN){std::cout << fPlan_k_ << " "; fftw_print_plan(fPlan_k_); std::cout << std::endl;}
+    if(bPlan_k_ != NULLFFTWPLAN){std::cout << bPlan_k_ << " "; fftw_print_plan(bPlan_k_); std::cout << std::endl;}
+    std::cout << bPlan_z_ << " "; fftw_print_plan(bPlan_z_); std::cout << std::endl;
     std::cout << bPlan_j_ << " "; fftw_print_plan(bPlan_j_); std::cout << std::endl;
-    std::cout << bPlan_j_real_ << " "; fftw_print_plan(bPlan_j_real_); std::cout << std::endl;
     std::cout << bPlan_i_ << " "; fftw_print_plan(bPlan_i_); std::cout << std::endl;
 #else
     std::cout << fPlan_i_ << " "; fftwf_print_plan(fPlan_i_); std::cout << std::endl;
     std::cout << fPlan_j_ << " "; fftwf_print_plan(fPlan_j_); std::cout << std::endl;
-    std::cout << fPlan_k_ << " "; fftwf_print_plan(fPlan_k_); std::cout << std::endl;
-    std::cout << fPlan_k_real_ << " "; fftwf_print_plan(fPlan_k_real_); std::cout << std::endl;
-    std::cout << bPlan_k_ << " "; fftwf_print_plan(bPlan_k_); std::cout << std::endl;
+    std::cout << fPlan_z_ << " "; fftwf_print_plan(fPlan_z_); std::cout << std::endl;
+    if(fPlan_k_ != NULLFFTWPLAN){std::cout << fPlan_k_ << " "; fftwf_print_plan(fPlan_k_); std::cout << std::endl;}
+    if(bPlan_k_ != NULLFFTWPLAN){std::cout << bPlan_k_ << " "; fftwf_print_plan(bPlan_k_); std::cout << std::endl;}
+    std::cout << bPlan_z_ << " "; fftwf_print_plan(bPlan_z_); std::cout << std::endl;
     std::cout << bPlan_j_ << " "; fftwf_print_plan(bPlan_j_); std::cout << std::endl;
-    std::cout << bPlan_j_real_ << " "; fftwf_print_plan(bPlan_j_real_); std::cout << std::endl;
     std::cout << bPlan_i_ << " "; fftwf_print_plan(bPlan_i_); std::cout << std::endl;
 #endif
 
@@ -188,48 +504,195 @@ private:
   int kJump_[3];
   int rSizeLocal_[3];
   int kSizeLocal_[3];
-  int r2cSize_;  //of 0 dimension
-  int r2cSizeLocal_; //of r2csize on proc_dim[1]
-  int r2cSizeLocal_as_;
   int rHalo_;
   int kHalo_;
 
+  //rSize_, rJump_, ... describe the x, y, z directions of the pencils, the lattice directions 0, dim-2 and dim-1 (see setLayout)
+  int dim_;
+  //4d lattices: the second local direction w is transformed with x (xRank_ = 2), the x frequencies are then (kx,kw) pairs
+  int wSize_;
+  int rwJump_;
+  int kwJump_;
+  int xRank_;
+  int xShape_[2];
+  int xrEmbed_[2];
+  int xkEmbed_[2];
+
+  //zero padded plans (see initializePadded): tSize_ is the length of the transforms, twice rSize_ when padded_
+  bool padded_;
+  int tSize_[3];
+  //real to complex plans with the fourier space field in the z pencil layout (initialize(...,transposed))
+  bool transposed_;
+  //real to real plans (initializeR2R): type_ is C2C, the pencils carry the components c and c+1 in the real and
+  //imaginary parts of the work arrays, the r2r kinds are the forward ones of the x, y, z directions
+  bool r2r_;
+  fftw_r2r_kind r2rKind_[3];
+  static fftw_r2r_kind inverseKind(fftw_r2r_kind kind)
+  {
+    switch(kind)
+    {
+      case FFTW_REDFT10: return FFTW_REDFT01;
+      case FFTW_REDFT01: return FFTW_REDFT10;
+      case FFTW_RODFT10: return FFTW_RODFT01;
+      case FFTW_RODFT01: return FFTW_RODFT10;
+      case FFTW_R2HC: return FFTW_HC2R;
+      case FFTW_HC2R: return FFTW_R2HC;
+      default: return kind;
+    }
+  }
+
+  //pencil decomposition. The x transform is done on the real space layout, then the x frequencies are
+  //split over dim1 of the process grid for the y transform, then the y frequencies over dim0 for the
+  //z transform. For real to complex plans the z frequencies are finally split over dim1 (fourier space layout).
+  int xSize_;            //number of x frequencies: Nx/2+1 (R2C) or Nx (C2C), times Nw in 4d
+  int xSizeLocal_;       //x frequencies of this process in the y and z pencils
+  int xOffset_;
+  int kySizeLocal_;      //y frequencies of this process in the z pencils
+  int kyOffset_;
+  int kzSizeLocal_;      //z frequencies of this process in the fourier space layout (R2C)
+  fftChunks xChunks_;    //x frequencies over dim1 (dim0 in 2d)
+  fftChunks yChunks_;    //real space y over dim1 (dim0 in 2d)
+  fftChunks zChunks_;    //real space z over dim0
+  fftChunks kyChunks_;   //y frequencies over dim0
+  fftChunks kzChunks_;   //z frequencies over dim1 (R2C)
+  int * sendCounts_;
+  int * sendDispls_;
+  int * recvCounts_;
+  int * recvDispls_;
+  void setLayout(Lattice & rlat, Lattice & klat);
+  void setLayout(Lattice & rlat);
+  void checkPeriodic(const char * caller);
+  void checkDimension(const char * caller);
+  void checkR2R(const char * caller);
+  void releasePadding();
+
+  //shared plans and work arrays, see fftPlanRegistry
+  fftPlanSet * planSet_;
+  bool acquirePlans();
+  void registerPlans();
+  void releasePlans();
+
+  //transform stages, the fourier space layout is only used by execute()
+  //forward_pencils leaves the z pencils (x freq. fastest, then y freq., then z) in temp_, backward_pencils starts from them
+  void forward_pencils(int comp);
+  void backward_pencils(int comp);
+  //forward_x transforms the components comp to comp+count-1 of the field into the batch slots slot to slot+count-1 of the
+  //x pencils (count = 0: batch_ components into all the slots)
+  void forward_x(int comp, int slot = 0, int count = 0);
+  void backward_x(int comp);
+  void forward_yz();
+  //zero padded plans: the x transform works on padRows_, which holds the local x rows followed by the padding
+  void load_rows(int comp);
+  void store_rows(int comp);
+  //signed displacement of a padded lattice coordinate, in [-N,N[
+  int padDisplacement(int x, int dir) const { return (x < rSize_[dir] ? x : x - tSize_[dir]); }
+  void transform_z(int fft_type);
+  template<class Kernel>
+  void apply_kernel(Kernel & kernel, Real (*src)[2], Real (*dst)[2], bool accumulate = false);
+  //real to real plans: both parts of the z pencils are multiplied by the (real) kernel
+  template<class Kernel>
+  void apply_real_kernel(Kernel & kernel, Real (*data)[2]);
+  static Real realKernel(Real w) { return w; }
+  static Real realKernel(Imag w) { return w.real(); }
+  bool sameLayout(Lattice & lat, int components);
+  bool sameFourierLayout(Lattice & lat);
+
+  //spectral derivatives, wave number of the rKSite coordinate n along dir, the Nyquist mode is dropped
+  Real derivativeWaveNumber(int n, int dir) const
+  {
+    if(2*n == rSize_[dir]) return 0;
+    if(2*n > rSize_[dir]) n -= rSize_[dir];
+    return 2.*M_PI*n/rSize_[dir];
+  }
+  struct laplacianKernel
+  {
+    int size[3];
+    Real operator()(int k0, int k1, int k2) const
+    {
+      int k[3] = {k0,k1,k2};
+      Real k2sum = 0;
+      for(int i=0;i<3;i++)
+      {
+        if(2*k[i] > size[i]) k[i] -= size[i];
+        k2sum += (2.*M_PI*k[i]/size[i])*(2.*M_PI*k[i]/size[i]);
+      }
+      return -k2sum;
+    }
+  };
+  void checkSpectral(Field<Real>* scalar, Field<Real>* vector, const char * caller);
+  //the pencil stages run on the plans and work arrays of the bound set: planSet_, or vecSet_ while the 3 components of a
+  //vector field are transformed together (batch_ = 3, the component is the index just below the split one of each layout),
+  //or spectrumSet_ while the inputs of transformPowerSpectrum are (batch_ = number of inputs, forward plans only)
+  void bindPlans(fftPlanSet * set);
+  void bindVectorPlans(Field<Real>* vector);
+  void bindSpectrumPlans(int inputs);
+  //gradient: vector = i*k*scalar, divergence: scalar = i*k.vector, between the z pencils of a scalar and of a 3 components field
+  void derivative_pencils(Real (*scalar)[2], Real (*vector)[2], bool divergence);
+
+  //power spectrum binning: sums holds the pair sums, then the |k| sums and the mode counts of each bin
+  struct spectrumBinning
+  {
+    int nbins;
+    int binning;
+    int window;
+    int inputs;
+    double kmin;
+    double kmax;
+    int size[3];
+    bool halfSpace;
+    double * sums;
+    void accumulate(int k0, int k1, int k2, Imag * values);
+  };
+  void spectrumSetup(spectrumBinning & bins, int inputs, int nbins, double kmin, double kmax, int binning, int window);
+  void spectrumReduce(spectrumBinning & bins, double * pk, double * kbin, double * modes);
+  void spectrumPencils(spectrumBinning & bins, Real (*spectra)[2]);
+
+  //gaussian random modes, see gaussianRandomField()
+  template<class Spectrum>
+  Imag randomMode(counterRNG & rng, Spectrum & spectrum, int k0, int k1, int k2, int comp);
+  template<class Spectrum>
+  void random_pencils(counterRNG & rng, Spectrum & spectrum, int comp);
+
+  //redistributions between pencil layouts. stage 1: x pencils <-> y pencils (dim1, dim0 in 2d), stage 2: y pencils <-> z pencils (dim0),
+  //stage 3: z pencils <-> fourier space layout (dim1, R2C and 4d only)
+  void exchange(int stage, int fft_type, Real (*send)[2], Real (*recv)[2]);
+  int exchangeProcs(int stage);
+  //single precision transport of a stage: the blocks travel in transportSend_ and transportRecv_
+  bool transported(int stage);
+  float * transportBuffer(long size);
+
+  //local reordering around the redistributions, from the received blocks to the next pencils and back.
+  //The blocks are in the work arrays or, for a transported stage, in the float buffers
+  template<class T> void transpose_xy(T (*in)[2], Real (*out)[2]);
+  template<class T> void transpose_yx(Real (*in)[2], T (*out)[2]);
+  template<class T> void transpose_yz(T (*in)[2], Real (*out)[2]);
+  template<class T> void transpose_zy(Real (*in)[2], T (*out)[2]);
+  template<class T> void transpose_zk(T (*in)[2], int comp);
+  template<class T> void transpose_kz(T (*out)[2], int comp);
+  //copy of n complex values, converted when the precisions differ
+  template<class S, class D> static void copyComplex(S (*src)[2], D (*dst)[2], long n);
+  static void copyComplex(Real (*src)[2], Real (*dst)[2], long n);
+
 #ifdef SINGLE
   float * rData_; //pointer to start of data (halo skip)
   fftwf_complex * cData_; //pointer to start of data (halo skip)
   fftwf_complex * kData_; //pointer to start of data (halo skip)
   fftwf_complex * temp_;
   fftwf_complex * temp1_;//needed if field got more than 1 component
+  //temp_ and temp1_ are swapped in place of a redistribution when the communicator holds a single process
+  //(slab decomposition), so every plan is executed with the new-array interface on the current buffers
 
 
   fftwf_plan fPlan_i_;
   fftwf_plan fPlan_j_;
+  fftwf_plan fPlan_z_;
   fftwf_plan fPlan_k_;
-  fftwf_plan fPlan_k_real_;
 
   fftwf_plan bPlan_i_;
   fftwf_plan bPlan_j_;
-  fftwf_plan bPlan_j_real_;
+  fftwf_plan bPlan_z_;
   fftwf_plan bPlan_k_;
 
-  ///transpostion fonction
-
-  /// forward real to complex
-  // first transopsition
-  void transpose_0_2( fftwf_complex * in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k);
-  void transpose_0_2_last_proc( fftwf_complex * in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k);
-  void implement_local_0_last_proc( fftwf_complex * in, fftwf_complex * out,int proc_dim_i,int proc_dim_j,int proc_dim_k,int proc_size);
-  // second transposition
-  void transpose_1_2(fftwf_complex * in , fftwf_complex * out  ,int dim_i,int dim_j ,int dim_k);
-  //third transposition
-  void transpose_back_0_3(fftwf_complex * in, fftwf_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size,int halo,int components,int comp);
-  void implement_0(fftwf_complex * in, fftwf_complex * out,int r2c_size,int local_size_j,int local_size_k,int halo,int components,int comp);
-  ////backward real to complex
-  void b_arrange_data_0(fftwf_complex *in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k, int khalo, int components, int comp);
-  void b_transpose_back_0_1(fftwf_complex * in, fftwf_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size);
-  void b_implement_0(fftwf_complex * in, fftwf_complex * out,int r2c_size,int local_size_j,int local_size_k);
-
-
 #endif
 #ifndef SINGLE
 
@@ -239,40 +702,55 @@ private:
   fftw_complex * kData_; //pointer to start of data (halo skip)
   fftw_complex * temp_;
   fftw_complex * temp1_;//needed if field got more than 1 component
+  //temp_ and temp1_ are swapped in place of a redistribution when the communicator holds a single process
+  //(slab decomposition), so every plan is executed with the new-array interface on the current buffers
 
 
   fftw_plan fPlan_i_;
   fftw_plan fPlan_j_;
+  fftw_plan fPlan_z_;
   fftw_plan fPlan_k_;
-  fftw_plan fPlan_k_real_;
 
   fftw_plan bPlan_i_;
   fftw_plan bPlan_j_;
-  fftw_plan bPlan_j_real_;
+  fftw_plan bPlan_z_;
   fftw_plan bPlan_k_;
 
-  ///transpostion fonction
-
-  /// forward real to complex
-  // first transopsition
-  void transpose_0_2( fftw_complex * in, fftw_complex * out,int dim_i,int dim_j ,int dim_k);
-  void transpose_0_2_last_proc( fftw_complex * in, fftw_complex * out,int dim_i,int dim_j ,int dim_k);
-  void implement_local_0_last_proc( fftw_complex * in, fftw_complex * out,int proc_dim_i,int proc_dim_j,int proc_dim_k,int proc_size);
-  // second transposition
-  void transpose_1_2(fftw_complex * in , fftw_complex * out  ,int dim_i,int dim_j ,int dim_k);
-  //third transposition
-  void transpose_back_0_3(fftw_complex * in, fftw_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size,int halo,int components,int comp);
-  void implement_0(fftw_complex * in, fftw_complex * out,int r2c_size,int local_size_j,int local_size_k,int halo,int components,int comp);
-  ////backward real to complex
-  void b_arrange_data_0(fftw_complex *in, fftw_complex * out,int dim_i,int dim_j ,int dim_k, int khalo, int components, int comp);
-  void b_transpose_back_0_1(fftw_complex * in, fftw_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size);
-  void b_implement_0(fftw_complex * in, fftw_complex * out,int r2c_size,int local_size_j,int local_size_k);
-
+#endif
 
+  //spectral derivatives: shared plans of the 3 components pencils, acquired on first use, and number of components in the pencils
+  fftPlanSet * vecSet_;
+  int vecComponents_;
+  int batch_;
+  //power spectra: shared plans of the z pencils of all the inputs, acquired on first use
+  fftPlanSet * spectrumSet_;
 
+  //real to real plans: fourier space field (halo skip), rData_ being the real space one
+  Real * kReal_;
 
+  //zero padded plans: x rows of length 2Nx and transformed Green's function (z pencils)
+  Real * padRows_;
+#ifdef SINGLE
+  fftwf_complex * green_;
+#else
+  fftw_complex * green_;
 #endif
 
+  //single precision transport of double precision plans
+  bool singleTransport_;
+  float * transport_;
+  long transportSize_;
+  float (*transportSend_)[2];
+  float (*transportRecv_)[2];
+
+  //stage timers, see setStageTimers(). The local stages count their complex values twice (read and write)
+  fftStageTimers * timers_;
+  double startStage() const { return (timers_ == NULL ? 0 : MPI_Wtime()); }
+  void stopStage(int stage, double start, double values)
+  {
+    if(timers_ != NULL) timers_->add(stage, MPI_Wtime() - start, 4. * sizeof(Real) * values);
+  }
+
 };
 
 //constants
@@ -287,281 +765,452 @@ bool PlanFFT<compType>::C2C=true;
 
 template<class compType>
 PlanFFT<compType>::~PlanFFT() {
-#ifndef SINGLE
-  //if (fPlan_i_ != NULLFFTWPLAN) { fftw_destroy_plan(fPlan_i_); }
-  //if (fPlan_j_ != NULLFFTWPLAN) { fftw_destroy_plan(fPlan_j_); }
-  //if (fPlan_k_ != NULLFFTWPLAN) { fftw_destroy_plan(fPlan_k_); }
-  //if (fPlan_k_real_ != NULLFFTWPLAN) { fftw_destroy_plan(fPlan_k_real_); }
-  //if (bPlan_k_ != NULLFFTWPLAN) { fftw_destroy_plan(bPlan_k_); }
-  //if (bPlan_j_ != NULLFFTWPLAN) { fftw_destroy_plan(bPlan_j_); }
-  //if (bPlan_j_real_ != NULLFFTWPLAN) { fftw_destroy_plan(bPlan_j_real_); }
-  //if (bPlan_i_ != NULLFFTWPLAN) { fftw_destroy_plan(bPlan_i_); }
-#else
-  //if (fPlan_i_ != NULLFFTWPLAN) { fftwf_destroy_plan(fPlan_i_); }
-  //if (fPlan_j_ != NULLFFTWPLAN) { fftwf_destroy_plan(fPlan_j_); }
-  //if (fPlan_k_ != NULLFFTWPLAN) { fftwf_destroy_plan(fPlan_k_); }
-  //if (fPlan_k_real_ != NULLFFTWPLAN) { fftwf_destroy_plan(fPlan_k_real_); }
-  //if (bPlan_k_ != NULLFFTWPLAN) { fftwf_destroy_plan(bPlan_k_); }
-  //if (bPlan_j_ != NULLFFTWPLAN) { fftwf_destroy_plan(bPlan_j_); }
-  //if (bPlan_j_real_ != NULLFFTWPLAN) { fftwf_destroy_plan(bPlan_j_real_); }
-  //if (bPlan_i_ != NULLFFTWPLAN) { fftwf_destroy_plan(bPlan_i_); }
-#endif
-
-
-
+  releasePlans();
+  releasePadding();
+  if(sendCounts_ != NULL) delete[] sendCounts_;
 }
 
 
 template<class compType>
 PlanFFT<compType>::PlanFFT() :
+padded_(false),
+transposed_(false),
+r2r_(false),
+sendCounts_(NULL),
+sendDispls_(NULL),
+recvCounts_(NULL),
+recvDispls_(NULL),
+planSet_(NULL),
 fPlan_i_(NULLFFTWPLAN),
 fPlan_j_(NULLFFTWPLAN),
+fPlan_z_(NULLFFTWPLAN),
 fPlan_k_(NULLFFTWPLAN),
-fPlan_k_real_(NULLFFTWPLAN),
-bPlan_k_(NULLFFTWPLAN),
+bPlan_i_(NULLFFTWPLAN),
 bPlan_j_(NULLFFTWPLAN),
-bPlan_j_real_(NULLFFTWPLAN),
-bPlan_i_(NULLFFTWPLAN)
-{
-  status_ = false;
-}
-
-
-#ifdef SINGLE
-
-
-
-template<class compType>
-PlanFFT<compType>::PlanFFT(Field<compType>*  rfield,Field<compType>* kfield,const int mem_type) : PlanFFT()
+bPlan_z_(NULLFFTWPLAN),
+bPlan_k_(NULLFFTWPLAN),
+vecSet_(NULL),
+vecComponents_(3),
+batch_(1),
+spectrumSet_(NULL),
+kReal_(NULL),
+padRows_(NULL),
+green_(NULL),
+singleTransport_(false),
+transport_(NULL),
+transportSize_(0),
+transportSend_(NULL),
+transportRecv_(NULL),
+timers_(NULL)
 {
   status_ = false;
-  initialize(rfield,kfield,mem_type);
 }
 
 template<class compType>
-void PlanFFT<compType>::initialize(Field<compType>*  rfield,Field<compType>*  kfield,const int mem_type )
+bool PlanFFT<compType>::acquirePlans()
 {
-  type_ = C2C;
-  mem_type_=mem_type;
+  fftPlanKey key;
+  bool created;
 
-  //general variable
-
-  if(rfield->components() != kfield->components())
-  {
-    cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for fields with same number of components"<<endl;
-    cerr<<"Latfield2d::PlanFFT::initialize : coordinate and fourier space fields have not the same number of components"<<endl;
-    cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-  }
-  else components_ = rfield->components();
+  releasePlans();
 
+  key.type = (r2r_ ? 3 : (type_ == R2C ? 1 : 2));
+#ifdef SINGLE
+  key.precision = sizeof(float);
+#else
+  key.precision = sizeof(double);
+#endif
+  key.components = components_;
+  key.padded = (padded_ ? 1 : 0);
+  key.transposed = (transposed_ ? 1 : 0);
+  key.dim = dim_;
+  key.wSize = wSize_;
+  key.wJump[0] = rwJump_;
+  key.wJump[1] = kwJump_;
   for(int i = 0; i<3; i++)
   {
-    rSize_[i]=rfield->lattice().size(i);
-    kSize_[i]=kfield->lattice().size(i);
-    rSizeLocal_[i]=rfield->lattice().sizeLocal(i);
-    kSizeLocal_[i]=kfield->lattice().sizeLocal(i);
-    rJump_[i]=rfield->lattice().jump(i);
-    kJump_[i]=kfield->lattice().jump(i);
+    key.rSize[i] = rSize_[i];
+    key.rSizeLocal[i] = rSizeLocal_[i];
+    key.kSizeLocal[i] = kSizeLocal_[i];
+    key.rJump[i] = rJump_[i];
+    key.kJump[i] = kJump_[i];
+    key.r2rKinds[i] = (r2r_ ? (int)r2rKind_[i] : -1);
   }
-  r2cSize_ = 0;
-  r2cSizeLocal_as_ = 0;
-  r2cSizeLocal_ = 0;
-  rHalo_ = rfield->lattice().halo();
-  kHalo_ = kfield->lattice().halo();
-
-  /////from latfield2d_IO
-  tempMemory.setTemp((long)(rSize_[0]+2)  * (long)(rSizeLocal_[1]+2) * (long)(rSizeLocal_[2]+2));
-
-  	temp_  = tempMemory.temp1();
-  	temp1_ = tempMemory.temp2();
-
-  	if(rfield->lattice().dim()!=3)
-  	{
-  		if(parallel.isRoot())
-  		{
-  			cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-  			cerr<<"Latfield2d::PlanFFT::initialize : real lattice have not 3 dimensions"<<endl;
-  			cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-  		}
-  		parallel.abortForce();
-  	}
-
-
-  	if(rSize_[0]!=rSize_[1] | rSize_[1]!=rSize_[2])
-  	{
-  		if(parallel.isRoot())
-  		{
-  			cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-  			cerr<<"Latfield2d::PlanFFT::initialize : real lattice is not cubic"<<endl;
-  			cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-   		}
-  		parallel.abortForce();
-  	}
-
-  	//initialization of fftw plan
-
-
-  	//Forward plan
-  	fPlan_i_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,cData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  	fPlan_j_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1]*rSizeLocal_[2],temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE);
-  	fPlan_k_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,kData_,NULL,components_, rJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
-  	//Backward plan
-
-  	bPlan_k_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,kData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  	bPlan_j_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1]*rSizeLocal_[2],temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  	bPlan_i_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,kData_,NULL,components_, rJump_[1]*components_,FFTW_BACKWARD,FFTW_ESTIMATE);
-
-  	//allocation of field
-
-  	long rfield_size = rfield->lattice().sitesLocalGross();
-  	long kfield_size = kfield->lattice().sitesLocalGross();
-
-  	if(mem_type_ == FFT_IN_PLACE)
-  	{
-  		if(rfield_size>=kfield_size)
-  		{
-  			rfield->alloc();
-  			kfield->data() = (Imag*)rfield->data();
-  		}
-  		else
-  		{
-  			kfield->alloc();
-  			rfield->data() = (Imag*)kfield->data();
-  		}
-  	}
-  	if(mem_type_ == FFT_OUT_OF_PLACE)
-  	{
-  		rfield->alloc();
-  		kfield->alloc();
-  	}
-
-  	//Pointer to data
+  key.batch = 1;
+  //fftw requires the arrays given to the new-array execute functions to have the alignment of the planned ones
+  //(zero padded plans only run on the fftw_malloc'ed padRows_ and work arrays)
+  if(padded_) key.alignment = 0;
+  else if(r2r_) key.alignment = (int)(((size_t)rData_ % 32) * 32 + (size_t)kReal_ % 32);
+  else if(type_ == R2C) key.alignment = (int)(((size_t)rData_ % 32) * 32 + (size_t)kData_ % 32);
+  else key.alignment = (int)(((size_t)cData_ % 32) * 32 + (size_t)kData_ % 32);
 
-  	rData_ = (float*)rfield->data(); //to be sure that rData is instantiate !
-  	cData_ = (fftwf_complex*)rfield->data();
-  	cData_ += rfield->lattice().siteFirst()*components_;
-  	kData_ = (fftwf_complex*)kfield->data();
-  	kData_ += kfield->lattice().siteFirst()*components_;
+  planSet_ = fftRegistry.acquire(key,created);
 
+  //a new set has no plans yet, the caller creates them on its work arrays
+  bindPlans(planSet_);
 
-  ///end of from latfield2d_IO
+  return created;
+}
 
+template<class compType>
+void PlanFFT<compType>::bindPlans(fftPlanSet * set)
+{
+  temp_  = set->scratch->memory->temp1();
+  temp1_ = set->scratch->memory->temp2();
+
+  fPlan_i_ = set->fPlan_i;
+  fPlan_j_ = set->fPlan_j;
+  fPlan_z_ = set->fPlan_z;
+  fPlan_k_ = set->fPlan_k;
+  bPlan_i_ = set->bPlan_i;
+  bPlan_j_ = set->bPlan_j;
+  bPlan_z_ = set->bPlan_z;
+  bPlan_k_ = set->bPlan_k;
+
+  components_ = set->key.components;
+  batch_ = set->key.batch;
+}
 
+template<class compType>
+void PlanFFT<compType>::registerPlans()
+{
+  planSet_->fPlan_i = fPlan_i_;
+  planSet_->fPlan_j = fPlan_j_;
+  planSet_->fPlan_z = fPlan_z_;
+  planSet_->fPlan_k = fPlan_k_;
+  planSet_->bPlan_i = bPlan_i_;
+  planSet_->bPlan_j = bPlan_j_;
+  planSet_->bPlan_z = bPlan_z_;
+  planSet_->bPlan_k = bPlan_k_;
+}
 
+template<class compType>
+void PlanFFT<compType>::releasePlans()
+{
+  if(planSet_ != NULL) fftRegistry.release(planSet_);
+  if(vecSet_ != NULL) fftRegistry.release(vecSet_);
+  if(spectrumSet_ != NULL) fftRegistry.release(spectrumSet_);
+  planSet_ = NULL;
+  vecSet_ = NULL;
+  spectrumSet_ = NULL;
+
+  fPlan_i_ = NULLFFTWPLAN;
+  fPlan_j_ = NULLFFTWPLAN;
+  fPlan_z_ = NULLFFTWPLAN;
+  fPlan_k_ = NULLFFTWPLAN;
+  bPlan_k_ = NULLFFTWPLAN;
+  bPlan_z_ = NULLFFTWPLAN;
+  bPlan_j_ = NULLFFTWPLAN;
+  bPlan_i_ = NULLFFTWPLAN;
+
+  if(transport_ != NULL) delete[] transport_;
+  transport_ = NULL;
+  transportSize_ = 0;
+  transportSend_ = NULL;
+  transportRecv_ = NULL;
 }
 
 template<class compType>
-PlanFFT<compType>::PlanFFT(Field<float>* rfield, Field<compType>*  kfield,const int mem_type )  : PlanFFT()
+void PlanFFT<compType>::releasePadding()
 {
-  status_ = false;
-  initialize(rfield,kfield,mem_type);
+#ifdef SINGLE
+  if(padRows_ != NULL) fftwf_free(padRows_);
+  if(green_ != NULL) fftwf_free(green_);
+#else
+  if(padRows_ != NULL) fftw_free(padRows_);
+  if(green_ != NULL) fftw_free(green_);
+#endif
+  padRows_ = NULL;
+  green_ = NULL;
 }
 
 template<class compType>
-void PlanFFT<compType>::initialize(Field<float>*  rfield,Field<compType>*   kfield,const int mem_type )
+void PlanFFT<compType>::setLayout(Lattice & rlat)
 {
-  type_ = R2C;
-  mem_type_=mem_type;
+  int i;
 
-  //general variable
-  if(rfield->components() != kfield->components())
+  dim_ = rlat.dim();
+  if(dim_<2 || dim_>4)
   {
-    cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for fields with same number of components"<<endl;
-    cerr<<"Latfield2d::PlanFFT::initialize : coordinate and fourier space fields have not the same number of components"<<endl;
-    cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 2d, 3d and 4d lattice"<<endl;
+      cerr<<"Latfield2d::PlanFFT::initialize : real lattice have "<<dim_<<" dimensions"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
   }
-  else components_ = rfield->components();
-
-  for(int i = 0; i<3; i++)
+  if(dim_==2 && parallel.grid_size()[1]!=1)
   {
-    rSize_[i]=rfield->lattice().size(i);
-    kSize_[i]=kfield->lattice().size(i);
-    rSizeLocal_[i]=rfield->lattice().sizeLocal(i);
-    kSizeLocal_[i]=kfield->lattice().sizeLocal(i);
-    rJump_[i]=rfield->lattice().jump(i);
-    kJump_[i]=kfield->lattice().jump(i);
-  }
-  r2cSize_ = rfield->lattice().size(0)/2 + 1;
-  r2cSizeLocal_as_ = rfield->lattice().sizeLocal(0)/(2*parallel.grid_size()[1]);
-  if(parallel.last_proc()[1]) r2cSizeLocal_ = r2cSizeLocal_as_ + 1;
-  else r2cSizeLocal_ = r2cSizeLocal_as_;
-  rHalo_ = rfield->lattice().halo();
-  kHalo_ = kfield->lattice().halo();
-
-
-
-
-
-  tempMemory.setTemp((r2cSize_+2) * (rSizeLocal_[1]+2) * (rSizeLocal_[2]+2));
-
-
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::initialize : 2d fft need a process grid of size n x 1"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
-  temp_  = tempMemory.temp1();
-  temp1_ = tempMemory.temp2();
+  //the pencils are built on 3 directions x, y, z: the last two lattice directions are y and z (split over dim1 and dim0
+  //of the process grid). 4d lattices have a second local direction w, transformed together with x (rank 2 transform,
+  //x fastest). 2d lattices have no z: a single redistribution (over dim0) between the x and y transforms.
+  int dir[3] = {0, (dim_==2 ? 1 : dim_-2), dim_-1};
+  for(i = 0; i<3; i++)
+  {
+    if(dim_==2 && i==2)
+    {
+      rSize_[i]=1;
+      rSizeLocal_[i]=1;
+      rJump_[i]=0;
+    }
+    else
+    {
+      rSize_[i]=rlat.size(dir[i]);
+      rSizeLocal_[i]=rlat.sizeLocal(dir[i]);
+      rJump_[i]=rlat.jump(dir[i]);
+    }
+    tSize_[i]=(padded_ ? 2*rSize_[i] : rSize_[i]);
+    kSize_[i]=0;
+    kSizeLocal_[i]=0;
+    kJump_[i]=0;
+  }
+  wSize_ = (dim_==4 ? rlat.size(1) : 1);
+  rwJump_ = (dim_==4 ? rlat.jump(1) : 0);
+  kwJump_ = 0;
+  rHalo_ = rlat.halo();
+  kHalo_ = 0;
+
+  xSize_ = (type_ == R2C ? tSize_[0]/2 + 1 : tSize_[0]) * wSize_;
+
+  //shape of the x transforms, (w,x) arrays for 4d lattices
+  xRank_ = (dim_==4 ? 2 : 1);
+  xShape_[0] = (dim_==4 ? wSize_ : tSize_[0]);
+  xShape_[1] = tSize_[0];
+  xrEmbed_[0] = xShape_[0];
+  xrEmbed_[1] = rwJump_;
+  xkEmbed_[0] = xShape_[0];
+  xkEmbed_[1] = xSize_/wSize_;
+
+  int xProcs = parallel.grid_size()[dim_==2 ? 0 : 1];
+  int xRank = parallel.grid_rank()[dim_==2 ? 0 : 1];
+
+  if(xSize_ < xProcs || (dim_ > 2 && (tSize_[1] < parallel.grid_size()[0] || ((type_ == R2C || dim_ == 4) && tSize_[2] < parallel.grid_size()[1]))))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::initialize : lattice too small for the process grid"<<endl;
+      cerr<<"Latfield2d::PlanFFT::initialize : each process needs at least one frequency in each pencil layout"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
+  //the real space directions are split as the data (the padding is never redistributed), the frequencies over the transform lengths
+  xChunks_.initialize(xSize_,xProcs);
+  yChunks_.initialize(rSize_[1],xProcs);
+  zChunks_.initialize(rSize_[2],parallel.grid_size()[0]);
+  kyChunks_.initialize(tSize_[1],parallel.grid_size()[0]);
+  kzChunks_.initialize(tSize_[2],parallel.grid_size()[1]);
+
+  xSizeLocal_ = xChunks_.size[xRank];
+  xOffset_ = xChunks_.offset[xRank];
+  kySizeLocal_ = kyChunks_.size[parallel.grid_rank()[0]];
+  kyOffset_ = kyChunks_.offset[parallel.grid_rank()[0]];
+  kzSizeLocal_ = kzChunks_.size[parallel.grid_rank()[1]];
+
+  int procs = (parallel.grid_size()[0] > parallel.grid_size()[1] ? parallel.grid_size()[0] : parallel.grid_size()[1]);
+  if(sendCounts_ != NULL) delete[] sendCounts_;
+  sendCounts_ = new int[4*procs];
+  sendDispls_ = sendCounts_ + procs;
+  recvCounts_ = sendCounts_ + 2*procs;
+  recvDispls_ = sendCounts_ + 3*procs;
+}
 
+template<class compType>
+void PlanFFT<compType>::setLayout(Lattice & rlat, Lattice & klat)
+{
+  padded_ = false;
+  releasePadding();
+  setLayout(rlat);
+  if(transposed_) checkDimension("initialize (transposed)");
 
+  bool kLayout = (klat.dim()==dim_);
+  if(kLayout && dim_==2)
+  {
+    //y pencils: (ky, kx) lattice, the x frequencies split over dim0
+    kSize_[0]=klat.size(0);
+    kSize_[1]=klat.size(1);
+    kSize_[2]=1;
+    kSizeLocal_[0]=klat.sizeLocal(0);
+    kSizeLocal_[1]=klat.sizeLocal(1);
+    kSizeLocal_[2]=1;
+    kJump_[0]=klat.jump(0);
+    kJump_[1]=klat.jump(1);
+    kJump_[2]=0;
+    kLayout = (kSize_[0]==rSize_[1] && kSize_[1]==xSize_ && kSizeLocal_[1]==xSizeLocal_);
+  }
+  else if(kLayout)
+  {
+    int dir[3] = {0, dim_-2, dim_-1};
+    for(int i = 0; i<3; i++)
+    {
+      kSize_[i]=klat.size(dir[i]);
+      kSizeLocal_[i]=klat.sizeLocal(dir[i]);
+      kJump_[i]=klat.jump(dir[i]);
+    }
+    kwJump_ = (dim_==4 ? klat.jump(1) : 0);
+
+    //the fourier space lattice has to be the one built by Lattice::initializeRealFFT, Lattice::initializeRealFFTTransposed
+    //or Lattice::initializeComplexFFT. The last two are the z pencils (kz, kx, ky) in 3d. 4d lattices are (kx, kw, kz, ky)
+    //for both transforms
+    if((type_ == R2C && !transposed_) || dim_ == 4) kLayout = (kSize_[0]*wSize_==xSize_ && kSize_[1]==rSize_[2] && kSize_[2]==rSize_[1] && kSizeLocal_[1]==kzSizeLocal_ && kSizeLocal_[2]==kySizeLocal_);
+    else kLayout = (kSize_[0]==rSize_[2] && kSize_[1]==xSize_ && kSize_[2]==rSize_[1] && kSizeLocal_[1]==xSizeLocal_ && kSizeLocal_[2]==kySizeLocal_);
+    if(dim_ == 4) kLayout = kLayout && (klat.size(1)==wSize_);
+  }
+  kHalo_ = klat.halo();
 
-  if(rfield->lattice().dim()!=3)
+  if(!kLayout)
   {
     if(parallel.isRoot())
     {
-      cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-      cerr<<"Latfield2d::PlanFFT::initialize : real lattice have not 3 dimensions"<<endl;
+      cerr<<"Latfield2d::PlanFFT::initialize : fourier space lattice does not match the real space lattice"<<endl;
+      cerr<<"Latfield2d::PlanFFT::initialize : use Lattice::initializeRealFFT, Lattice::initializeRealFFTTransposed or Lattice::initializeComplexFFT"<<endl;
       cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
     }
     parallel.abortForce();
   }
+}
 
-  //COUT << rSize_[0] << "   "<< rSize_[1]<< "   "<< rSize_[2] <<endl;
+template<class compType>
+void PlanFFT<compType>::checkDimension(const char * caller)
+{
+  if(dim_ != 3)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::"<<caller<<" : only available for 3d lattices, 2d and 4d plans only support execute"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+}
 
-  if(rSize_[0]!=rSize_[1] | rSize_[1]!=rSize_[2])
+template<class compType>
+void PlanFFT<compType>::checkPeriodic(const char * caller)
+{
+  if(padded_)
   {
     if(parallel.isRoot())
     {
-      cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-      cerr<<"Latfield2d::PlanFFT::initialize : real lattice is not cubic"<<endl;
+      cerr<<"Latfield2d::PlanFFT::"<<caller<<" : not available for zero padded plans, which only support convolve"<<endl;
       cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+}
 
+template<class compType>
+void PlanFFT<compType>::checkR2R(const char * caller)
+{
+  if(r2r_)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::"<<caller<<" : not available for real to real plans, which only support execute and convolve"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
     }
     parallel.abortForce();
   }
+}
 
-  //create the fftw_plan
+template<class compType>
+void PlanFFT<compType>::initializePadded(Field<Real>* rfield)
+{
+  type_ = R2C;
+  transposed_ = false;
+  r2r_ = false;
+  mem_type_ = FFT_OUT_OF_PLACE;
+  components_ = rfield->components();
+  padded_ = true;
 
-  fPlan_i_ = fftwf_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,rData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  fPlan_j_ = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[2]*r2cSizeLocal_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,FFTW_FORWARD,FFTW_ESTIMATE);
-  fPlan_k_ = fftwf_plan_many_dft(1,&rSize_[0],r2cSizeLocal_as_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp1_,NULL,rSizeLocal_[2]*r2cSizeLocal_as_,1,FFTW_FORWARD,FFTW_ESTIMATE);
-  fPlan_k_real_ =  fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[2],&temp_[r2cSizeLocal_as_],NULL,rSizeLocal_[2]*r2cSizeLocal_,r2cSizeLocal_,&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]],NULL,rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE);
+  setLayout(rfield->lattice());
+  checkDimension("initializePadded");
 
-  bPlan_k_ = fftwf_plan_many_dft(1,&rSize_[0],kSizeLocal_[2]*r2cSizeLocal_,temp_,NULL,kSizeLocal_[2]*r2cSizeLocal_,1,temp_,NULL,kSizeLocal_[2]*r2cSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_j_ = fftwf_plan_many_dft(1,&rSize_[0],r2cSizeLocal_as_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp1_,NULL,rSizeLocal_[2]*r2cSizeLocal_as_,1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_j_real_ =  fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[2],&temp_[r2cSizeLocal_as_],NULL,rSizeLocal_[2]*r2cSizeLocal_,r2cSizeLocal_,&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]],NULL,rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_i_ = fftwf_plan_many_dft_c2r(1,&rSize_[0],rSizeLocal_[1] ,temp1_,NULL,1, r2cSize_,rData_,NULL,components_,rJump_[1]*components_,FFTW_ESTIMATE);
+  rfield->alloc();
 
-//  PrintPlans();
+  rData_ = rfield->data() + rfield->lattice().siteFirst()*components_;
+  cData_ = NULL;
+  kData_ = NULL;
 
-  //allocation of field
+  releasePadding();
+  long rows = (long)rSizeLocal_[1]*rSizeLocal_[2];
+#ifdef SINGLE
+  padRows_ = (float*)fftwf_malloc(sizeof(float)*tSize_[0]*rows);
+#else
+  padRows_ = (double*)fftw_malloc(sizeof(double)*tSize_[0]*rows);
+#endif
 
-  long rfield_size = rfield->lattice().sitesLocalGross();
-  long kfield_size = kfield->lattice().sitesLocalGross()*2; //*2 for complex type
+  if(acquirePlans())
+  {
+    int xy = rSizeLocal_[1]*rSizeLocal_[2];
+    int yz = xSizeLocal_*rSizeLocal_[2];
+    int zx = xSizeLocal_*kySizeLocal_;
 
-  if(mem_type_==FFT_IN_PLACE)
+    //all the x rows in one call: padRows_ (row stride 2Nx) to temp_ (y + ny*(z + nz*kx))
+#ifdef SINGLE
+    fPlan_i_ = fftwf_plan_many_dft_r2c(1,&tSize_[0],xy,padRows_,NULL,1,tSize_[0],temp_,NULL,xy,1,FFTW_ESTIMATE);
+    fPlan_j_ = fftwf_plan_many_dft(1,&tSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+    fPlan_z_ = fftwf_plan_many_dft(1,&tSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+    bPlan_z_ = fftwf_plan_many_dft(1,&tSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    bPlan_j_ = fftwf_plan_many_dft(1,&tSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    bPlan_i_ = fftwf_plan_many_dft_c2r(1,&tSize_[0],xy,temp_,NULL,xy,1,padRows_,NULL,1,tSize_[0],FFTW_ESTIMATE);
+#else
+    fPlan_i_ = fftw_plan_many_dft_r2c(1,&tSize_[0],xy,padRows_,NULL,1,tSize_[0],temp_,NULL,xy,1,FFTW_ESTIMATE);
+    fPlan_j_ = fftw_plan_many_dft(1,&tSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+    fPlan_z_ = fftw_plan_many_dft(1,&tSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+    bPlan_z_ = fftw_plan_many_dft(1,&tSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    bPlan_j_ = fftw_plan_many_dft(1,&tSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    bPlan_i_ = fftw_plan_many_dft_c2r(1,&tSize_[0],xy,temp_,NULL,xy,1,padRows_,NULL,1,tSize_[0],FFTW_ESTIMATE);
+#endif
+    fPlan_k_ = NULLFFTWPLAN;
+    bPlan_k_ = NULLFFTWPLAN;
+
+    registerPlans();
+  }
+}
+
+template<class compType>
+void PlanFFT<compType>::initializeR2R(Field<Real>* rfield, Field<Real>* kfield, const fftw_r2r_kind * kinds, const int mem_type)
+{
+  type_ = C2C;
+  transposed_ = false;
+  r2r_ = true;
+  mem_type_ = mem_type;
+
+  if(rfield->components() != kfield->components())
   {
-    if(rfield_size>kfield_size)
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::initializeR2R : coordinate and fourier space fields have not the same number of components"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  components_ = rfield->components();
+
+  setLayout(rfield->lattice(),kfield->lattice());
+  checkDimension("initializeR2R");
+
+  if(mem_type_ == FFT_IN_PLACE)
+  {
+    if(rfield->lattice().sitesLocalGross() >= kfield->lattice().sitesLocalGross())
     {
       rfield->alloc();
-      kfield->data() = (Imag *)rfield->data();
+      kfield->data() = rfield->data();
     }
     else
     {
       kfield->alloc();
-      rfield->data() = (float *)kfield->data();
+      rfield->data() = kfield->data();
     }
   }
   if(mem_type_ == FFT_OUT_OF_PLACE)
@@ -570,34 +1219,68 @@ void PlanFFT<compType>::initialize(Field<float>*  rfield,Field<compType>*   kfie
     kfield->alloc();
   }
 
+  rData_ = rfield->data() + rfield->lattice().siteFirst()*components_;
+  cData_ = NULL;
+  kData_ = NULL;
+  kReal_ = kfield->data() + kfield->lattice().siteFirst()*components_;
 
-  //Pointer to data
-
-  rData_ = rfield->data();
-  rData_ += rfield->lattice().siteFirst()*components_;//usefull point !!
-  cData_ = (fftwf_complex*)kfield->data(); //to be sure that cData is instantiate !
-  kData_ = (fftwf_complex*)kfield->data();
-  kData_ += kfield->lattice().siteFirst()*components_;
+  fftw_r2r_kind bKinds[3];
+  for(int i=0;i<3;i++)
+  {
+    r2rKind_[i] = kinds[i];
+    bKinds[i] = inverseKind(kinds[i]);
+  }
 
+  if(acquirePlans())
+  {
+    int xy = rSizeLocal_[1]*rSizeLocal_[2];
+    int yz = xSizeLocal_*rSizeLocal_[2];
+    int zx = xSizeLocal_*kySizeLocal_;
+    Real * temp = (Real*)temp_;
 
+    //the work arrays are seen as arrays of Real: the x and k plans are executed once per part (offset 0 or 1, hence
+    //FFTW_UNALIGNED), the y and z ones transform both parts in place (2*yz, resp. 2*zx, interleaved transforms)
+#ifdef SINGLE
+    fPlan_i_ = fftwf_plan_many_r2r(1,&rSize_[0],rSizeLocal_[1],rData_,NULL,components_,rJump_[1]*components_,temp,NULL,2*xy,2,&r2rKind_[0],FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+    fPlan_j_ = fftwf_plan_many_r2r(1,&rSize_[1],2*yz,temp,NULL,2*yz,1,temp,NULL,2*yz,1,&r2rKind_[1],FFTW_ESTIMATE);
+    fPlan_z_ = fftwf_plan_many_r2r(1,&rSize_[2],2*zx,temp,NULL,2*zx,1,temp,NULL,2*zx,1,&r2rKind_[2],FFTW_ESTIMATE);
+    fPlan_k_ = fftwf_plan_many_r2r(1,&rSize_[2],xSizeLocal_,temp,NULL,2*zx,2,kReal_,NULL,components_,kJump_[1]*components_,&r2rKind_[2],FFTW_ESTIMATE | FFTW_UNALIGNED);
+    bPlan_k_ = fftwf_plan_many_r2r(1,&rSize_[2],xSizeLocal_,kReal_,NULL,components_,kJump_[1]*components_,temp,NULL,2*zx,2,&bKinds[2],FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+    bPlan_z_ = fftwf_plan_many_r2r(1,&rSize_[2],2*zx,temp,NULL,2*zx,1,temp,NULL,2*zx,1,&bKinds[2],FFTW_ESTIMATE);
+    bPlan_j_ = fftwf_plan_many_r2r(1,&rSize_[1],2*yz,temp,NULL,2*yz,1,temp,NULL,2*yz,1,&bKinds[1],FFTW_ESTIMATE);
+    bPlan_i_ = fftwf_plan_many_r2r(1,&rSize_[0],rSizeLocal_[1],temp,NULL,2*xy,2,rData_,NULL,components_,rJump_[1]*components_,&bKinds[0],FFTW_ESTIMATE | FFTW_UNALIGNED);
+#else
+    fPlan_i_ = fftw_plan_many_r2r(1,&rSize_[0],rSizeLocal_[1],rData_,NULL,components_,rJump_[1]*components_,temp,NULL,2*xy,2,&r2rKind_[0],FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+    fPlan_j_ = fftw_plan_many_r2r(1,&rSize_[1],2*yz,temp,NULL,2*yz,1,temp,NULL,2*yz,1,&r2rKind_[1],FFTW_ESTIMATE);
+    fPlan_z_ = fftw_plan_many_r2r(1,&rSize_[2],2*zx,temp,NULL,2*zx,1,temp,NULL,2*zx,1,&r2rKind_[2],FFTW_ESTIMATE);
+    fPlan_k_ = fftw_plan_many_r2r(1,&rSize_[2],xSizeLocal_,temp,NULL,2*zx,2,kReal_,NULL,components_,kJump_[1]*components_,&r2rKind_[2],FFTW_ESTIMATE | FFTW_UNALIGNED);
+    bPlan_k_ = fftw_plan_many_r2r(1,&rSize_[2],xSizeLocal_,kReal_,NULL,components_,kJump_[1]*components_,temp,NULL,2*zx,2,&bKinds[2],FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+    bPlan_z_ = fftw_plan_many_r2r(1,&rSize_[2],2*zx,temp,NULL,2*zx,1,temp,NULL,2*zx,1,&bKinds[2],FFTW_ESTIMATE);
+    bPlan_j_ = fftw_plan_many_r2r(1,&rSize_[1],2*yz,temp,NULL,2*yz,1,temp,NULL,2*yz,1,&bKinds[1],FFTW_ESTIMATE);
+    bPlan_i_ = fftw_plan_many_r2r(1,&rSize_[0],rSizeLocal_[1],temp,NULL,2*xy,2,rData_,NULL,components_,rJump_[1]*components_,&bKinds[0],FFTW_ESTIMATE | FFTW_UNALIGNED);
+#endif
 
+    registerPlans();
+  }
 }
 
-#endif
+#ifdef SINGLE
+
 
-#ifndef SINGLE
 
 template<class compType>
-PlanFFT<compType>::PlanFFT(Field<compType>*  rfield,Field<compType>* kfield,const int mem_type)
+PlanFFT<compType>::PlanFFT(Field<compType>*  rfield,Field<compType>* kfield,const int mem_type) : PlanFFT()
 {
-	status_ = false;
-	initialize(rfield,kfield,mem_type);
+  status_ = false;
+  initialize(rfield,kfield,mem_type);
 }
 
 template<class compType>
 void PlanFFT<compType>::initialize(Field<compType>*  rfield,Field<compType>*  kfield,const int mem_type )
 {
   type_ = C2C;
+  transposed_ = false;
+  r2r_ = false;
   mem_type_=mem_type;
 
   //general variable
@@ -611,64 +1294,7 @@ void PlanFFT<compType>::initialize(Field<compType>*  rfield,Field<compType>*  kf
   }
   else components_ = rfield->components();
 
-  for(int i = 0; i<3; i++)
-  {
-    rSize_[i]=rfield->lattice().size(i);
-    kSize_[i]=kfield->lattice().size(i);
-    rSizeLocal_[i]=rfield->lattice().sizeLocal(i);
-    kSizeLocal_[i]=kfield->lattice().sizeLocal(i);
-    rJump_[i]=rfield->lattice().jump(i);
-    kJump_[i]=kfield->lattice().jump(i);
-  }
-  r2cSize_ = 0;
-  r2cSizeLocal_as_ = 0;
-  r2cSizeLocal_ = 0;
-  rHalo_ = rfield->lattice().halo();
-  kHalo_ = kfield->lattice().halo();
-
-  /////from latfield2d_IO
-  tempMemory.setTemp((long)(rSize_[0]+10)  * (long)(rSizeLocal_[1]+10) * (long)(rSizeLocal_[2]+10));
-
-  	temp_  = tempMemory.temp1();
-  	temp1_ = tempMemory.temp2();
-
-  	if(rfield->lattice().dim()!=3)
-  	{
-  		if(parallel.isRoot())
-  		{
-  			cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-  			cerr<<"Latfield2d::PlanFFT::initialize : real lattice have not 3 dimensions"<<endl;
-  			cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-  		}
-  		parallel.abortForce();
-  	}
-
-
-  	if(rSize_[0]!=rSize_[1] | rSize_[1]!=rSize_[2])
-  	{
-  		if(parallel.isRoot())
-  		{
-  			cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-  			cerr<<"Latfield2d::PlanFFT::initialize : real lattice is not cubic"<<endl;
-  			cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-   		}
-  		parallel.abortForce();
-  	}
-
-  	//initialization of fftw plan
-
-
-  	//Forward plan
-  	fPlan_i_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,cData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  	fPlan_j_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1]*rSizeLocal_[2],temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE);
-  	fPlan_k_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,kData_,NULL,components_, rJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
-  	//Backward plan
-
-  	bPlan_k_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,kData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  	bPlan_j_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1]*rSizeLocal_[2],temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  	bPlan_i_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,kData_,NULL,components_, rJump_[1]*components_,FFTW_BACKWARD,FFTW_ESTIMATE);
+  setLayout(rfield->lattice(),kfield->lattice());
 
   	//allocation of field
 
@@ -696,27 +1322,63 @@ void PlanFFT<compType>::initialize(Field<compType>*  rfield,Field<compType>*  kf
 
   	//Pointer to data
 
-  	rData_ = (double*)rfield->data(); //to be sure that rData is instantiate !
-  	cData_ = (fftw_complex*)rfield->data();
+  	rData_ = (float*)rfield->data(); //to be sure that rData is instantiate !
+  	cData_ = (fftwf_complex*)rfield->data();
   	cData_ += rfield->lattice().siteFirst()*components_;
-  	kData_ = (fftw_complex*)kfield->data();
+  	kData_ = (fftwf_complex*)kfield->data();
   	kData_ += kfield->lattice().siteFirst()*components_;
 
+  	//initialization of fftw plan, shared with every plan of same layout
+
+  	if(acquirePlans())
+  	{
+  		int xy = rSizeLocal_[1]*rSizeLocal_[2];
+  		int yz = xSizeLocal_*rSizeLocal_[2];
+  		int zx = xSizeLocal_*kySizeLocal_;
+  		//Forward plan
+  		fPlan_i_ = fftwf_plan_many_dft(xRank_,xShape_,rSizeLocal_[1] ,cData_,xrEmbed_,components_, rJump_[1]*components_,temp_,xkEmbed_,xy,1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+  		if(dim_ == 2)
+  		{
+  			//single y transform, from the y pencils (kx fastest) to the fourier space field (ky, kx lattice)
+  			fPlan_k_ = fftwf_plan_many_dft(1,&rSize_[1],xSizeLocal_,temp_,NULL,xSizeLocal_,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
+  			bPlan_k_ = fftwf_plan_many_dft(1,&rSize_[1],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,xSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+  		}
+  		else
+  		{
+  			fPlan_j_ = fftwf_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+  			fPlan_z_ = fftwf_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+  			//4d plans end with the real to complex layout (kx, kw, kz, ky)
+  			fPlan_k_ = (dim_ == 3 ? fftwf_plan_many_dft(1,&rSize_[2],xSizeLocal_,temp_,NULL,zx,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE) : NULLFFTWPLAN);
+  			bPlan_k_ = (dim_ == 3 ? fftwf_plan_many_dft(1,&rSize_[2],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT) : NULLFFTWPLAN);
+  			bPlan_z_ = fftwf_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+  			bPlan_j_ = fftwf_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+  		}
+  		//Backward plan
+  		bPlan_i_ = fftwf_plan_many_dft(xRank_,xShape_,rSizeLocal_[1] ,temp_,xkEmbed_,xy,1,cData_,xrEmbed_,components_,rJump_[1]*components_,FFTW_BACKWARD,FFTW_ESTIMATE);
+
+  		registerPlans();
+  	}
+
+
+  ///end of from latfield2d_IO
+
+
+
 }
 
 template<class compType>
-PlanFFT<compType>::PlanFFT(Field<double>* rfield, Field<compType>*  kfield,const int mem_type )
+PlanFFT<compType>::PlanFFT(Field<float>* rfield, Field<compType>*  kfield,const int mem_type, bool transposed) : PlanFFT()
 {
   status_ = false;
-  initialize(rfield,kfield,mem_type);
+  initialize(rfield,kfield,mem_type,transposed);
 }
 
-
-
 template<class compType>
-void PlanFFT<compType>::initialize(Field<double>*  rfield,Field<compType>*   kfield,const int mem_type )
+void PlanFFT<compType>::initialize(Field<float>*  rfield,Field<compType>*   kfield,const int mem_type, bool transposed)
 {
   type_ = R2C;
+  transposed_ = transposed;
+  r2r_ = false;
   mem_type_=mem_type;
 
   //general variable
@@ -729,63 +1391,10 @@ void PlanFFT<compType>::initialize(Field<double>*  rfield,Field<compType>*   kfi
   }
   else components_ = rfield->components();
 
-  for(int i = 0; i<3; i++)
-  {
-    rSize_[i]=rfield->lattice().size(i);
-    kSize_[i]=kfield->lattice().size(i);
-    rSizeLocal_[i]=rfield->lattice().sizeLocal(i);
-    kSizeLocal_[i]=kfield->lattice().sizeLocal(i);
-    rJump_[i]=rfield->lattice().jump(i);
-    kJump_[i]=kfield->lattice().jump(i);
-  }
-  r2cSize_ = rfield->lattice().size(0)/2 + 1;
-  r2cSizeLocal_as_ = rfield->lattice().sizeLocal(0)/(2*parallel.grid_size()[1]);
-  if(parallel.last_proc()[1]) r2cSizeLocal_ = r2cSizeLocal_as_ + 1;
-  else r2cSizeLocal_ = r2cSizeLocal_as_;
-  rHalo_ = rfield->lattice().halo();
-  kHalo_ = kfield->lattice().halo();
-
-
-
-
-
-  tempMemory.setTemp((r2cSize_+2) * (rSizeLocal_[1]+2) * (rSizeLocal_[2]+2));
-
-
-
-  temp_  = tempMemory.temp1();
-  temp1_ = tempMemory.temp2();
-
-
-
+  setLayout(rfield->lattice(),kfield->lattice());
 
-  if(rfield->lattice().dim()!=3)
-  {
-    if(parallel.isRoot())
-    {
-      cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-      cerr<<"Latfield2d::PlanFFT::initialize : real lattice have not 3 dimensions"<<endl;
-      cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-    }
-    parallel.abortForce();
-  }
-
-  //COUT << rSize_[0] << "   "<< rSize_[1]<< "   "<< rSize_[2] <<endl;
-
-  if(rSize_[0]!=rSize_[1] | rSize_[1]!=rSize_[2])
-  {
-    if(parallel.isRoot())
-    {
-      cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for 3d cubic lattice"<<endl;
-      cerr<<"Latfield2d::PlanFFT::initialize : real lattice is not cubic"<<endl;
-      cerr<<"Latfield2d : Abort Process Requested"<<endl;
-
-    }
-    parallel.abortForce();
-  }
 
-  //create the fftw_plan
+  //allocation of field
 
   long rfield_size = rfield->lattice().sitesLocalGross();
   long kfield_size = kfield->lattice().sitesLocalGross()*2; //*2 for complex type
@@ -800,7 +1409,7 @@ void PlanFFT<compType>::initialize(Field<double>*  rfield,Field<compType>*   kfi
     else
     {
       kfield->alloc();
-      rfield->data() = (double *)kfield->data();
+      rfield->data() = (float *)kfield->data();
     }
   }
   if(mem_type_ == FFT_OUT_OF_PLACE)
@@ -814,749 +1423,1908 @@ void PlanFFT<compType>::initialize(Field<double>*  rfield,Field<compType>*   kfi
 
   rData_ = rfield->data();
   rData_ += rfield->lattice().siteFirst()*components_;//usefull point !!
-  cData_ = (fftw_complex*)kfield->data(); //to be sure that cData is instantiate !
-  kData_ = (fftw_complex*)kfield->data();
+  cData_ = (fftwf_complex*)kfield->data(); //to be sure that cData is instantiate !
+  kData_ = (fftwf_complex*)kfield->data();
   kData_ += kfield->lattice().siteFirst()*components_;
 
-  fPlan_i_ = fftw_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,rData_,NULL,components_, rJump_[1]*components_,temp_,NULL,rSizeLocal_[1]*rSizeLocal_[2],1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
-  fPlan_j_ = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[2]*r2cSizeLocal_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,FFTW_FORWARD,FFTW_ESTIMATE);
-  fPlan_k_ = fftw_plan_many_dft(1,&rSize_[0],r2cSizeLocal_as_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp1_,NULL,rSizeLocal_[2]*r2cSizeLocal_as_,1,FFTW_FORWARD,FFTW_ESTIMATE);
-  fPlan_k_real_ =  fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[2],&temp_[r2cSizeLocal_as_],NULL,rSizeLocal_[2]*r2cSizeLocal_,r2cSizeLocal_,&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]],NULL,rSizeLocal_[2],1,FFTW_FORWARD,FFTW_ESTIMATE);
+  //create the fftw_plan, shared with every plan of same layout
 
-  bPlan_k_ = fftw_plan_many_dft(1,&rSize_[0],kSizeLocal_[2]*r2cSizeLocal_,temp_,NULL,kSizeLocal_[2]*r2cSizeLocal_,1,temp_,NULL,kSizeLocal_[2]*r2cSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_j_ = fftw_plan_many_dft(1,&rSize_[0],r2cSizeLocal_as_,temp_,NULL,rSizeLocal_[2]*r2cSizeLocal_,1,temp1_,NULL,rSizeLocal_[2]*r2cSizeLocal_as_,1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_j_real_ =  fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[2],&temp_[r2cSizeLocal_as_],NULL,rSizeLocal_[2]*r2cSizeLocal_,r2cSizeLocal_,&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]],NULL,rSizeLocal_[2],1,FFTW_BACKWARD,FFTW_ESTIMATE);
-  bPlan_i_ = fftw_plan_many_dft_c2r(1,&rSize_[0],rSizeLocal_[1] ,temp1_,NULL,1, r2cSize_,rData_,NULL,components_,rJump_[1]*components_,FFTW_ESTIMATE);
+  if(acquirePlans())
+  {
+    int xy = rSizeLocal_[1]*rSizeLocal_[2];
+    int yz = xSizeLocal_*rSizeLocal_[2];
+    int zx = xSizeLocal_*kySizeLocal_;
 
-//  PrintPlans();
-}
+    fPlan_i_ = fftwf_plan_many_dft_r2c(xRank_,xShape_,rSizeLocal_[1] ,rData_,xrEmbed_,components_, rJump_[1]*components_,temp_,xkEmbed_,xy,1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    bPlan_i_ = fftwf_plan_many_dft_c2r(xRank_,xShape_,rSizeLocal_[1] ,temp_,xkEmbed_,xy,1,rData_,xrEmbed_,components_,rJump_[1]*components_,FFTW_ESTIMATE);
+    if(dim_ == 2)
+    {
+      //single y transform, from the y pencils (kx fastest) to the fourier space field (ky, kx lattice)
+      fPlan_k_ = fftwf_plan_many_dft(1,&rSize_[1],xSizeLocal_,temp_,NULL,xSizeLocal_,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
+      bPlan_k_ = fftwf_plan_many_dft(1,&rSize_[1],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,xSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    }
+    else
+    {
+      fPlan_j_ = fftwf_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      fPlan_z_ = fftwf_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      fPlan_k_ = (transposed_ ? fftwf_plan_many_dft(1,&rSize_[2],xSizeLocal_,temp_,NULL,zx,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE) : NULLFFTWPLAN);
+      bPlan_k_ = (transposed_ ? fftwf_plan_many_dft(1,&rSize_[2],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT) : NULLFFTWPLAN);
+      bPlan_z_ = fftwf_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+      bPlan_j_ = fftwf_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    }
 
-#endif
+    registerPlans();
+  }
 
-template<class compType>
-void PlanFFT<compType>::execute(int fft_type)
-{
 
-  //#ifdef SINGLE
-  if(type_ == R2C)
-  {
 
-    if(fft_type == FFT_FORWARD)
-    {
-      int i,j,k;
-      int comp;
-      int comm_rank;
+}
 
-#ifdef SINGLE
-      float *p_in;
-      fftwf_complex *p_out;
-#else
-      double *p_in;
-      fftw_complex *p_out;
 #endif
 
-      for(comp=0;comp<components_;comp++)
-      {
+#ifndef SINGLE
 
+template<class compType>
+PlanFFT<compType>::PlanFFT(Field<compType>*  rfield,Field<compType>* kfield,const int mem_type) : PlanFFT()
+{
+	status_ = false;
+	initialize(rfield,kfield,mem_type);
+}
 
-        //execute first dimension fft, prepar rData in temp_ to be send via AlltoAll + gather
+template<class compType>
+void PlanFFT<compType>::initialize(Field<compType>*  rfield,Field<compType>*  kfield,const int mem_type )
+{
+  type_ = C2C;
+  transposed_ = false;
+  r2r_ = false;
+  mem_type_=mem_type;
 
-#ifdef SINGLE
-        for(int l = 0;l< rSizeLocal_[2] ;l++)
-        {
-          p_in = &rData_[rJump_[2]*l*components_ + comp];
-          p_out = &temp_[l*rSizeLocal_[1]];
-          fftwf_execute_dft_r2c(fPlan_i_,p_in,p_out);
-        }
+  //general variable
 
-#else
-        for(int l = 0;l< rSizeLocal_[2] ;l++)
-        {
-          p_in = &rData_[rJump_[2]*l*components_ + comp];
-          p_out = &temp_[l*rSizeLocal_[1]];
-          fftw_execute_dft_r2c(fPlan_i_,p_in,p_out);
-        }
-#endif
+  if(rfield->components() != kfield->components())
+  {
+    cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for fields with same number of components"<<endl;
+    cerr<<"Latfield2d::PlanFFT::initialize : coordinate and fourier space fields have not the same number of components"<<endl;
+    cerr<<"Latfield2d : Abort Process Requested"<<endl;
 
-        MPI_Alltoall(temp_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Gather(&temp_[(r2cSize_-1)*rSizeLocal_[1]*rSizeLocal_[2]][0], 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC, &temp1_[rSize_[0]/2*rSizeLocal_[1]*rSizeLocal_[2]][0] , 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC ,parallel.grid_size()[1]-1, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Barrier(parallel.dim1_comm()[parallel.grid_rank()[0]]);
+  }
+  else components_ = rfield->components();
 
-        if(parallel.last_proc()[1])
-        {
-          for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2_last_proc(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_],rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_);
-          implement_local_0_last_proc(&temp1_[rSize_[0]/2*rSizeLocal_[1]*rSizeLocal_[2]],temp_,rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_,parallel.grid_size()[1]);
-        }
-        else for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_);
+  setLayout(rfield->lattice(),kfield->lattice());
 
-#ifdef SINGLE
-        fftwf_execute(fPlan_j_);
-#else
-        fftw_execute(fPlan_j_);
-#endif
+  	//allocation of field
 
-        MPI_Barrier(parallel.lat_world_comm());
-        MPI_Alltoall(temp_, (2*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_), MPI_DATA_PREC, temp1_, (2*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_), MPI_DATA_PREC, parallel.dim0_comm()[parallel.grid_rank()[1]]);
-        MPI_Barrier(parallel.dim0_comm()[parallel.grid_rank()[1]]);
+  	long rfield_size = rfield->lattice().sitesLocalGross();
+  	long kfield_size = kfield->lattice().sitesLocalGross();
 
+  	if(mem_type_ == FFT_IN_PLACE)
+  	{
+  		if(rfield_size>=kfield_size)
+  		{
+  			rfield->alloc();
+  			kfield->data() = (Imag*)rfield->data();
+  		}
+  		else
+  		{
+  			kfield->alloc();
+  			rfield->data() = (Imag*)kfield->data();
+  		}
+  	}
+  	if(mem_type_ == FFT_OUT_OF_PLACE)
+  	{
+  		rfield->alloc();
+  		kfield->alloc();
+  	}
 
-        for(i=0;i<parallel.grid_size()[0];i++)transpose_1_2(&temp1_[i*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_],&temp_[i*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_], r2cSizeLocal_,rSizeLocal_[2],rSizeLocal_[2]);
+  	//Pointer to data
 
-#ifdef SINGLE
-        for(int l=0;l<rSizeLocal_[2];l++)
-        {
-          fftwf_execute_dft(fPlan_k_,&temp_[l*r2cSizeLocal_],&temp1_[l*r2cSizeLocal_as_]);
-        }
+  	rData_ = (double*)rfield->data(); //to be sure that rData is instantiate !
+  	cData_ = (fftw_complex*)rfield->data();
+  	cData_ += rfield->lattice().siteFirst()*components_;
+  	kData_ = (fftw_complex*)kfield->data();
+  	kData_ += kfield->lattice().siteFirst()*components_;
 
-        if(parallel.last_proc()[1])fftwf_execute(fPlan_k_real_);
-#else
-        for(int l=0;l<rSizeLocal_[2];l++)
-        {
-          fftw_execute_dft(fPlan_k_,&temp_[l*r2cSizeLocal_],&temp1_[l*r2cSizeLocal_as_]);
-        }
+  	//initialization of fftw plan, shared with every plan of same layout
 
-        if(parallel.last_proc()[1])fftw_execute(fPlan_k_real_);
+  	if(acquirePlans())
+  	{
+  		int xy = rSizeLocal_[1]*rSizeLocal_[2];
+  		int yz = xSizeLocal_*rSizeLocal_[2];
+  		int zx = xSizeLocal_*kySizeLocal_;
+  		//Forward plan
+  		fPlan_i_ = fftw_plan_many_dft(xRank_,xShape_,rSizeLocal_[1] ,cData_,xrEmbed_,components_, rJump_[1]*components_,temp_,xkEmbed_,xy,1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+  		if(dim_ == 2)
+  		{
+  			//single y transform, from the y pencils (kx fastest) to the fourier space field (ky, kx lattice)
+  			fPlan_k_ = fftw_plan_many_dft(1,&rSize_[1],xSizeLocal_,temp_,NULL,xSizeLocal_,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
+  			bPlan_k_ = fftw_plan_many_dft(1,&rSize_[1],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,xSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+  		}
+  		else
+  		{
+  			fPlan_j_ = fftw_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+  			fPlan_z_ = fftw_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+  			//4d plans end with the real to complex layout (kx, kw, kz, ky)
+  			fPlan_k_ = (dim_ == 3 ? fftw_plan_many_dft(1,&rSize_[2],xSizeLocal_,temp_,NULL,zx,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE) : NULLFFTWPLAN);
+  			bPlan_k_ = (dim_ == 3 ? fftw_plan_many_dft(1,&rSize_[2],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT) : NULLFFTWPLAN);
+  			bPlan_z_ = fftw_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+  			bPlan_j_ = fftw_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+  		}
+  		//Backward plan
+  		bPlan_i_ = fftw_plan_many_dft(xRank_,xShape_,rSizeLocal_[1] ,temp_,xkEmbed_,xy,1,cData_,xrEmbed_,components_,rJump_[1]*components_,FFTW_BACKWARD,FFTW_ESTIMATE);
 
-#endif
+  		registerPlans();
+  	}
 
+}
 
+template<class compType>
+PlanFFT<compType>::PlanFFT(Field<double>* rfield, Field<compType>*  kfield,const int mem_type, bool transposed) : PlanFFT()
+{
+  status_ = false;
+  initialize(rfield,kfield,mem_type,transposed);
+}
 
-        MPI_Alltoall(temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, temp_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Scatter(&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]][0], 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC, &temp_[(r2cSize_-1)*rSizeLocal_[1]*rSizeLocal_[2]][0] , 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC ,parallel.grid_size()[1]-1, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Barrier(parallel.dim1_comm()[parallel.grid_rank()[0]]);
 
 
-        transpose_back_0_3(temp_, kData_,r2cSize_,r2cSizeLocal_as_,rSizeLocal_[2],rSizeLocal_[1],parallel.grid_size()[1],kHalo_,components_,comp);
-        implement_0(&temp_[(r2cSize_-1)*rSizeLocal_[1]*rSizeLocal_[2]], kData_,r2cSize_,rSizeLocal_[2],rSizeLocal_[1],kHalo_,components_,comp);
+template<class compType>
+void PlanFFT<compType>::initialize(Field<double>*  rfield,Field<compType>*   kfield,const int mem_type, bool transposed)
+{
+  type_ = R2C;
+  transposed_ = transposed;
+  r2r_ = false;
+  mem_type_=mem_type;
 
+  //general variable
+  if(rfield->components() != kfield->components())
+  {
+    cerr<<"Latfield2d::PlanFFT::initialize : fft curently work only for fields with same number of components"<<endl;
+    cerr<<"Latfield2d::PlanFFT::initialize : coordinate and fourier space fields have not the same number of components"<<endl;
+    cerr<<"Latfield2d : Abort Process Requested"<<endl;
 
-      }
+  }
+  else components_ = rfield->components();
 
+  setLayout(rfield->lattice(),kfield->lattice());
 
+  long rfield_size = rfield->lattice().sitesLocalGross();
+  long kfield_size = kfield->lattice().sitesLocalGross()*2; //*2 for complex type
+
+  if(mem_type_==FFT_IN_PLACE)
+  {
+    if(rfield_size>kfield_size)
+    {
+      rfield->alloc();
+      kfield->data() = (Imag *)rfield->data();
     }
-    if(fft_type == FFT_BACKWARD)
+    else
     {
-      int i,j,k,comp;
-      int comm_rank;
+      kfield->alloc();
+      rfield->data() = (double *)kfield->data();
+    }
+  }
+  if(mem_type_ == FFT_OUT_OF_PLACE)
+  {
+    rfield->alloc();
+    kfield->alloc();
+  }
 
-#ifdef SINGLE
-      float *p_out;
-      fftwf_complex *p_in;
-#else
-      double *p_out;
-      fftw_complex *p_in;
-#endif
 
-      for(comp=0;comp<components_;comp++)
-      {
-        b_arrange_data_0(kData_, temp_,kSizeLocal_[0],kSizeLocal_[1] ,kSizeLocal_[2], kHalo_, components_, comp);
-        MPI_Barrier(parallel.lat_world_comm());
+  //Pointer to data
 
+  rData_ = rfield->data();
+  rData_ += rfield->lattice().siteFirst()*components_;//usefull point !!
+  cData_ = (fftw_complex*)kfield->data(); //to be sure that cData is instantiate !
+  kData_ = (fftw_complex*)kfield->data();
+  kData_ += kfield->lattice().siteFirst()*components_;
 
+  //create the fftw_plan, shared with every plan of same layout
 
+  if(acquirePlans())
+  {
+    int xy = rSizeLocal_[1]*rSizeLocal_[2];
+    int yz = xSizeLocal_*rSizeLocal_[2];
+    int zx = xSizeLocal_*kySizeLocal_;
 
+    fPlan_i_ = fftw_plan_many_dft_r2c(xRank_,xShape_,rSizeLocal_[1] ,rData_,xrEmbed_,components_, rJump_[1]*components_,temp_,xkEmbed_,xy,1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    bPlan_i_ = fftw_plan_many_dft_c2r(xRank_,xShape_,rSizeLocal_[1] ,temp_,xkEmbed_,xy,1,rData_,xrEmbed_,components_,rJump_[1]*components_,FFTW_ESTIMATE);
+    if(dim_ == 2)
+    {
+      //single y transform, from the y pencils (kx fastest) to the fourier space field (ky, kx lattice)
+      fPlan_k_ = fftw_plan_many_dft(1,&rSize_[1],xSizeLocal_,temp_,NULL,xSizeLocal_,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE);
+      bPlan_k_ = fftw_plan_many_dft(1,&rSize_[1],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,xSizeLocal_,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+    }
+    else
+    {
+      fPlan_j_ = fftw_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      fPlan_z_ = fftw_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      fPlan_k_ = (transposed_ ? fftw_plan_many_dft(1,&rSize_[2],xSizeLocal_,temp_,NULL,zx,1,kData_,NULL,components_, kJump_[1]*components_,FFTW_FORWARD,FFTW_ESTIMATE) : NULLFFTWPLAN);
+      bPlan_k_ = (transposed_ ? fftw_plan_many_dft(1,&rSize_[2],xSizeLocal_,kData_,NULL,components_, kJump_[1]*components_,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT) : NULLFFTWPLAN);
+      bPlan_z_ = fftw_plan_many_dft(1,&rSize_[2],zx,temp_,NULL,zx,1,temp_,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+      bPlan_j_ = fftw_plan_many_dft(1,&rSize_[1],yz,temp_,NULL,yz,1,temp_,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+    }
 
-        MPI_Alltoall(temp_,2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Gather(&temp_[rSize_[0]/2*rSizeLocal_[1]*rSizeLocal_[2]][0], 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC, &temp1_[rSize_[0]/2*rSizeLocal_[1]*rSizeLocal_[2]][0] , 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC ,parallel.grid_size()[1]-1, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Barrier(parallel.dim1_comm()[parallel.grid_rank()[0]]);
+    registerPlans();
+  }
+}
 
+#endif
 
+template<class compType>
+bool PlanFFT<compType>::sameLayout(Lattice & lat, int components)
+{
+  if(lat.dim()!=3 || components!=components_)return false;
+  for(int i=0;i<3;i++)
+  {
+    if(lat.size(i)!=rSize_[i] || lat.sizeLocal(i)!=rSizeLocal_[i] || lat.jump(i)!=rJump_[i])return false;
+  }
+  return true;
+}
+
+template<class compType>
+bool PlanFFT<compType>::sameFourierLayout(Lattice & lat)
+{
+  if(lat.dim()!=3)return false;
+  for(int i=0;i<3;i++)
+  {
+    if(lat.size(i)!=kSize_[i] || lat.sizeLocal(i)!=kSizeLocal_[i])return false;
+  }
+  return true;
+}
+
+template<class compType>
+template<class Kernel>
+void PlanFFT<compType>::apply_kernel(Kernel & kernel, Real (*src_data)[2], Real (*dst_data)[2], bool accumulate)
+{
+  //src_data and dst_data have the layout of the z pencils. The kernel takes the wave vector in real space
+  //direction order, which are the rKSite and the cKSite coordinates
+  int i,j,k;
+  long idx = 0;
+  Imag z;
 
-        if(parallel.last_proc()[1])
+  for(k=0;k<tSize_[2];k++)
+  {
+    for(j=kyOffset_;j<kyOffset_+kySizeLocal_;j++)
+    {
+      for(i=xOffset_;i<xOffset_+xSizeLocal_;i++,idx++)
+      {
+        z = Imag(src_data[idx][0],src_data[idx][1]);
+        z *= kernel(i,j,k);
+        if(accumulate)
         {
-          for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2_last_proc(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_],rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_);
-          implement_local_0_last_proc(&temp1_[rSize_[0]/2*rSizeLocal_[1]*rSizeLocal_[2]],temp_,rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_,parallel.grid_size()[1]);
+          dst_data[idx][0] += z.real();
+          dst_data[idx][1] += z.imag();
         }
-        else for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_],rSizeLocal_[1],rSizeLocal_[2],r2cSizeLocal_as_);
+        else
+        {
+          dst_data[idx][0] = z.real();
+          dst_data[idx][1] = z.imag();
+        }
+      }
+    }
+  }
+}
 
+template<class compType>
+template<class Kernel>
+void PlanFFT<compType>::apply_real_kernel(Kernel & kernel, Real (*data)[2])
+{
+  int i,j,k;
+  long idx = 0;
+  Real w;
 
+  for(k=0;k<tSize_[2];k++)
+  {
+    for(j=kyOffset_;j<kyOffset_+kySizeLocal_;j++)
+    {
+      for(i=xOffset_;i<xOffset_+xSizeLocal_;i++,idx++)
+      {
+        w = realKernel(kernel(i,j,k));
+        data[idx][0] *= w;
+        data[idx][1] *= w;
+      }
+    }
+  }
+}
 
+template<class compType>
+template<class Kernel>
+void PlanFFT<compType>::convolve(Field<Real>* rfield_in, Field<Real>* rfield_out, Kernel kernel)
+{
+  checkDimension("convolve");
+  if(type_ != R2C && !r2r_)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : real fields given to a complex to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(rfield_in->lattice(),rfield_in->components()) || !sameLayout(rfield_out->lattice(),rfield_out->components()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : fields do not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
+  Real * rData = rData_;
+
+  //real to real plans transform two components per pass
+  for(int comp=0;comp<components_;comp+=(r2r_ ? 2 : 1))
+  {
+    rData_ = rfield_in->data() + rfield_in->lattice().siteFirst()*components_;
+    forward_pencils(comp);
+    transform_z(FFT_FORWARD);
+
+    if(r2r_) apply_real_kernel(kernel,temp_);
+    else apply_kernel(kernel,temp_,temp_);
+
+    transform_z(FFT_BACKWARD);
+    rData_ = rfield_out->data() + rfield_out->lattice().siteFirst()*components_;
+    backward_pencils(comp);
+  }
+
+  rData_ = rData;
+}
+
+template<class compType>
+template<class Kernel>
+void PlanFFT<compType>::convolve(Field<compType>* rfield_in, Field<compType>* rfield_out, Kernel kernel)
+{
+  checkDimension("convolve");
+  checkR2R("convolve");
+  if(type_ != C2C)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : complex fields given to a real to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(rfield_in->lattice(),rfield_in->components()) || !sameLayout(rfield_out->lattice(),rfield_out->components()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : fields do not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
+#ifdef SINGLE
+  fftwf_complex * cData = cData_;
+#else
+  fftw_complex * cData = cData_;
+#endif
 
+  for(int comp=0;comp<components_;comp++)
+  {
 #ifdef SINGLE
-        fftwf_execute(bPlan_k_);
+    cData_ = (fftwf_complex*)rfield_in->data() + rfield_in->lattice().siteFirst()*components_;
 #else
-        fftw_execute(bPlan_k_);
+    cData_ = (fftw_complex*)rfield_in->data() + rfield_in->lattice().siteFirst()*components_;
 #endif
+    forward_pencils(comp);
+    transform_z(FFT_FORWARD);
 
+    apply_kernel(kernel,temp_,temp_);
 
-        MPI_Alltoall(temp_, (2*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_), MPI_DATA_PREC, temp1_, (2*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_), MPI_DATA_PREC, parallel.dim0_comm()[parallel.grid_rank()[1]]);
-        MPI_Barrier(parallel.dim0_comm()[parallel.grid_rank()[1]]);
+    transform_z(FFT_BACKWARD);
+#ifdef SINGLE
+    cData_ = (fftwf_complex*)rfield_out->data() + rfield_out->lattice().siteFirst()*components_;
+#else
+    cData_ = (fftw_complex*)rfield_out->data() + rfield_out->lattice().siteFirst()*components_;
+#endif
+    backward_pencils(comp);
+  }
 
+  cData_ = cData;
+}
 
-        for(i=0;i<parallel.grid_size()[0];i++)transpose_1_2(&temp1_[i*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_],&temp_[i*rSizeLocal_[2]*rSizeLocal_[2]*r2cSizeLocal_], r2cSizeLocal_,rSizeLocal_[2],rSizeLocal_[2]);
+template<class compType>
+void PlanFFT<compType>::checkSpectral(Field<Real>* scalar, Field<Real>* vector, const char * caller)
+{
+  checkDimension(caller);
+  checkPeriodic(caller);
+  if(type_ != R2C || components_ != 1)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::"<<caller<<" : only available for real to complex plans of 1 component fields"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(scalar->lattice(),scalar->components()) || vector->components() != vecComponents_ || !sameLayout(vector->lattice(),components_))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::"<<caller<<" : fields do not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+}
 
+template<class compType>
+void PlanFFT<compType>::bindVectorPlans(Field<Real>* vector)
+{
+  Real * data = vector->data() + vector->lattice().siteFirst()*vecComponents_;
+  fftPlanKey key = planSet_->key;
+  bool created;
 
+  //same layout as the plan, 3 components transformed together on work arrays 3 times larger
+  key.components = vecComponents_;
+  key.batch = vecComponents_;
+  key.alignment = (int)(((size_t)data % 32) * 32);
 
+  if(vecSet_ == NULL || !(vecSet_->key == key))
+  {
+    if(vecSet_ != NULL) fftRegistry.release(vecSet_);
+    vecSet_ = fftRegistry.acquire(key,created);
+
+    if(created)
+    {
+      //component c of the x pencils starts xy values after component c-1, the y and z transforms run over all the components
+      int xy = rSizeLocal_[1]*rSizeLocal_[2];
+      int yz = vecComponents_*xSizeLocal_*rSizeLocal_[2];
+      int zx = vecComponents_*xSizeLocal_*kySizeLocal_;
+      int xStride = vecComponents_*xy;
 #ifdef SINGLE
+      fftwf_complex * temp = vecSet_->scratch->memory->temp1();
+      vecSet_->fPlan_i = fftwf_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,data,NULL,vecComponents_, rJump_[1]*vecComponents_,temp,NULL,xStride,1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+      vecSet_->bPlan_i = fftwf_plan_many_dft_c2r(1,&rSize_[0],rSizeLocal_[1] ,temp,NULL,xStride,1,data,NULL,vecComponents_,rJump_[1]*vecComponents_,FFTW_ESTIMATE);
+      vecSet_->fPlan_j = fftwf_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      vecSet_->fPlan_z = fftwf_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      vecSet_->bPlan_z = fftwf_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+      vecSet_->bPlan_j = fftwf_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+#else
+      fftw_complex * temp = vecSet_->scratch->memory->temp1();
+      vecSet_->fPlan_i = fftw_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,data,NULL,vecComponents_, rJump_[1]*vecComponents_,temp,NULL,xStride,1,FFTW_ESTIMATE | FFTW_PRESERVE_INPUT);
+      vecSet_->bPlan_i = fftw_plan_many_dft_c2r(1,&rSize_[0],rSizeLocal_[1] ,temp,NULL,xStride,1,data,NULL,vecComponents_,rJump_[1]*vecComponents_,FFTW_ESTIMATE);
+      vecSet_->fPlan_j = fftw_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      vecSet_->fPlan_z = fftw_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      vecSet_->bPlan_z = fftw_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+      vecSet_->bPlan_j = fftw_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_BACKWARD,FFTW_ESTIMATE);
+#endif
+    }
+  }
 
-        for(int l=0;l<rSizeLocal_[2];l++)
-        {
-          fftwf_execute_dft(bPlan_j_,&temp_[l*r2cSizeLocal_],&temp1_[l*r2cSizeLocal_as_]);
-        }
+  bindPlans(vecSet_);
+  rData_ = data;
+}
 
-        if(parallel.last_proc()[1])fftwf_execute(bPlan_j_real_);
+template<class compType>
+void PlanFFT<compType>::bindSpectrumPlans(int inputs)
+{
+  fftPlanKey key = planSet_->key;
+  bool created;
 
+  //same layout as the plan, the inputs transformed together on work arrays inputs times larger. The x transforms read
+  //other fields than the ones of the plan and are planned unaligned
+  key.batch = inputs;
+  key.alignment = -1;
+
+  if(spectrumSet_ == NULL || !(spectrumSet_->key == key))
+  {
+    if(spectrumSet_ != NULL) fftRegistry.release(spectrumSet_);
+    spectrumSet_ = fftRegistry.acquire(key,created);
+
+    if(created)
+    {
+      //input a of the x pencils starts xy values after input a-1, the y and z transforms run over all the inputs
+      int xy = rSizeLocal_[1]*rSizeLocal_[2];
+      int yz = inputs*xSizeLocal_*rSizeLocal_[2];
+      int zx = inputs*xSizeLocal_*kySizeLocal_;
+      int xStride = inputs*xy;
+#ifdef SINGLE
+      fftwf_complex * temp = spectrumSet_->scratch->memory->temp1();
+      if(type_ == R2C) spectrumSet_->fPlan_i = fftwf_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,rData_,NULL,components_, rJump_[1]*components_,temp,NULL,xStride,1,FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+      else spectrumSet_->fPlan_i = fftwf_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,cData_,NULL,components_, rJump_[1]*components_,temp,NULL,xStride,1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+      spectrumSet_->fPlan_j = fftwf_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      spectrumSet_->fPlan_z = fftwf_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
 #else
-        for(int l=0;l<rSizeLocal_[2];l++)
+      fftw_complex * temp = spectrumSet_->scratch->memory->temp1();
+      if(type_ == R2C) spectrumSet_->fPlan_i = fftw_plan_many_dft_r2c(1,&rSize_[0],rSizeLocal_[1] ,rData_,NULL,components_, rJump_[1]*components_,temp,NULL,xStride,1,FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+      else spectrumSet_->fPlan_i = fftw_plan_many_dft(1,&rSize_[0],rSizeLocal_[1] ,cData_,NULL,components_, rJump_[1]*components_,temp,NULL,xStride,1,FFTW_FORWARD,FFTW_ESTIMATE | FFTW_UNALIGNED | FFTW_PRESERVE_INPUT);
+      spectrumSet_->fPlan_j = fftw_plan_many_dft(1,&rSize_[1],yz,temp,NULL,yz,1,temp,NULL,yz,1,FFTW_FORWARD,FFTW_ESTIMATE);
+      spectrumSet_->fPlan_z = fftw_plan_many_dft(1,&rSize_[2],zx,temp,NULL,zx,1,temp,NULL,zx,1,FFTW_FORWARD,FFTW_ESTIMATE);
+#endif
+    }
+  }
+
+  bindPlans(spectrumSet_);
+}
+
+template<class compType>
+void PlanFFT<compType>::derivative_pencils(Real (*scalar)[2], Real (*vector)[2], bool divergence)
+{
+  //z pencils of the scalar: kx + nx*(ky + ny*z), of the vector: kx + nx*(ky + ny*(c + 3*z))
+  int i,j,k,c;
+  long zx = (long)xSizeLocal_*kySizeLocal_;
+  long idx;
+  Real kw[3];
+  Real (*s)[2];
+  Real (*v)[2];
+  Real re,im;
+
+  for(k=0;k<rSize_[2];k++)
+  {
+    kw[2] = derivativeWaveNumber(k,2);
+    for(j=0;j<kySizeLocal_;j++)
+    {
+      kw[1] = derivativeWaveNumber(kyOffset_+j,1);
+      for(i=0;i<xSizeLocal_;i++)
+      {
+        kw[0] = derivativeWaveNumber(xOffset_+i,0);
+        idx = i + (long)xSizeLocal_*j;
+        s = scalar + idx + zx*k;
+        if(divergence)
+        {
+          re = 0;
+          im = 0;
+          for(c=0;c<vecComponents_;c++)
+          {
+            v = vector + idx + zx*(c + vecComponents_*k);
+            re -= kw[c]*v[0][1];
+            im += kw[c]*v[0][0];
+          }
+          s[0][0] = re;
+          s[0][1] = im;
+        }
+        else
         {
-          fftw_execute_dft(bPlan_j_,&temp_[l*r2cSizeLocal_],&temp1_[l*r2cSizeLocal_as_]);
+          for(c=0;c<vecComponents_;c++)
+          {
+            v = vector + idx + zx*(c + vecComponents_*k);
+            v[0][0] = -kw[c]*s[0][1];
+            v[0][1] = kw[c]*s[0][0];
+          }
         }
+      }
+    }
+  }
+}
 
-        if(parallel.last_proc()[1])fftw_execute(bPlan_j_real_);
-#endif
+template<class compType>
+void PlanFFT<compType>::gradient(Field<Real>* phi, Field<Real>* grad)
+{
+  checkSpectral(phi,grad,"gradient");
 
+  Real * rData = rData_;
 
+  rData_ = phi->data() + phi->lattice().siteFirst();
+  forward_pencils(0);
+  transform_z(FFT_FORWARD);
 
+  //the spectrum stays in the work arrays of the plan, the 3 components are built in the ones of vecSet_
+  Real (*spectrum)[2] = temp_;
+  bindVectorPlans(grad);
+  derivative_pencils(spectrum,temp_,false);
+  transform_z(FFT_BACKWARD);
+  backward_pencils(0);
+  bindPlans(planSet_);
 
+  rData_ = rData;
+}
 
-        MPI_Alltoall(temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, temp_, 2* rSizeLocal_[1]*rSizeLocal_[2]*r2cSizeLocal_as_, MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Scatter(&temp1_[r2cSizeLocal_as_*rSizeLocal_[2]*rSize_[0]][0], 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC, &temp_[(r2cSize_-1)*rSizeLocal_[1]*rSizeLocal_[2]][0] , 2*rSizeLocal_[1]*rSizeLocal_[2], MPI_DATA_PREC ,parallel.grid_size()[1]-1, parallel.dim1_comm()[parallel.grid_rank()[0]]);
-        MPI_Barrier(parallel.dim1_comm()[parallel.grid_rank()[0]]);
+template<class compType>
+void PlanFFT<compType>::divergence(Field<Real>* vec, Field<Real>* div)
+{
+  checkSpectral(div,vec,"divergence");
 
+  Real * rData = rData_;
 
+  bindVectorPlans(vec);
+  forward_pencils(0);
+  transform_z(FFT_FORWARD);
+  Real (*spectra)[2] = temp_;
+  bindPlans(planSet_);
 
-        b_transpose_back_0_1(temp_, temp1_,r2cSize_,r2cSizeLocal_as_,rSizeLocal_[2],rSizeLocal_[1],parallel.grid_size()[1]);
-        b_implement_0(&temp_[(r2cSize_-1)*rSizeLocal_[1]*rSizeLocal_[2]], temp1_,r2cSize_,rSizeLocal_[2],rSizeLocal_[1]);
+  derivative_pencils(temp_,spectra,true);
+  transform_z(FFT_BACKWARD);
+  rData_ = div->data() + div->lattice().siteFirst();
+  backward_pencils(0);
 
+  rData_ = rData;
+}
 
-#ifdef SINGLE
-        for(int l = 0;l< rSizeLocal_[2] ;l++)
-        {
-          p_in = &temp1_[ l*r2cSize_*rSizeLocal_[1] ];
-          p_out = &rData_[l*rJump_[2]*components_ + comp];
-          fftwf_execute_dft_c2r(bPlan_i_,p_in,p_out);
-        }
-#else
-        for(int l = 0;l< rSizeLocal_[2] ;l++)
-        {
-          p_in = &temp1_[ l*r2cSize_*rSizeLocal_[1] ];
-          p_out = &rData_[l*rJump_[2]*components_ + comp];
-          fftw_execute_dft_c2r(bPlan_i_,p_in,p_out);
-        }
-#endif
+template<class compType>
+void PlanFFT<compType>::laplacian(Field<Real>* phi, Field<Real>* lap)
+{
+  laplacianKernel kernel;
+  kernel.size[0] = rSize_[0];
+  kernel.size[1] = rSize_[1];
+  kernel.size[2] = rSize_[2];
+  convolve(phi,lap,kernel);
+}
 
+template<class compType>
+void PlanFFT<compType>::spectrumBinning::accumulate(int k0, int k1, int k2, Imag * values)
+{
+  int n[3] = {k0,k1,k2};
+  int i,a,b,p;
+  int bin;
+  double x,k2sum = 0;
+  double deconv = 1;
+  double weight,kmod,sinc;
+
+  for(i=0;i<3;i++)
+  {
+    if(2*n[i] > size[i]) n[i] -= size[i];
+    x = (double)n[i]/size[i];
+    k2sum += x*x;
+    if(window > 0 && n[i] != 0)
+    {
+      sinc = sin(M_PI*x)/(M_PI*x);
+      deconv /= pow(sinc,2*window);
+    }
+  }
+  if(k2sum == 0) return;
 
-      }
+  kmod = 2.*M_PI*sqrt(k2sum);
+  if(kmod < kmin || kmod >= kmax) return;
+  if(binning == PS_BIN_LOG) bin = (int)(nbins*log(kmod/kmin)/log(kmax/kmin));
+  else bin = (int)(nbins*(kmod-kmin)/(kmax-kmin));
+  if(bin >= nbins) return;
+
+  weight = ((halfSpace && k0 != 0 && 2*k0 != size[0]) ? 2. : 1.);
+
+  for(a=0,p=0;a<inputs;a++)
+  {
+    for(b=a;b<inputs;b++,p++)
+    {
+      sums[bin + nbins*p] += weight*deconv*(values[a].real()*values[b].real() + values[a].imag()*values[b].imag());
     }
+  }
+  sums[bin + nbins*p] += weight*kmod;
+  sums[bin + nbins*(p+1)] += weight;
+}
 
+template<class compType>
+void PlanFFT<compType>::spectrumSetup(spectrumBinning & bins, int inputs, int nbins, double kmin, double kmax, int binning, int window)
+{
+  if(nbins < 1 || kmax <= kmin || (binning == PS_BIN_LOG && kmin <= 0))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::powerSpectrum : invalid binning, need nbins>0, kmax>kmin, and kmin>0 for logarithmic bins"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
   }
-  if(type_ == C2C)
+
+  bins.nbins = nbins;
+  bins.binning = binning;
+  bins.window = window;
+  bins.inputs = inputs;
+  bins.kmin = kmin;
+  bins.kmax = kmax;
+  for(int i=0;i<3;i++) bins.size[i] = rSize_[i];
+  bins.halfSpace = (type_ == R2C);
+
+  long length = (long)nbins*(inputs*(inputs+1)/2 + 2);
+  bins.sums = new double[length];
+  for(long i=0;i<length;i++) bins.sums[i] = 0;
+}
+
+template<class compType>
+void PlanFFT<compType>::spectrumReduce(spectrumBinning & bins, double * pk, double * kbin, double * modes)
+{
+  int pairs = bins.inputs*(bins.inputs+1)/2;
+  int nbins = bins.nbins;
+  double count;
+
+  parallel.sum(bins.sums,nbins*(pairs+2));
+
+  for(int bin=0;bin<nbins;bin++)
   {
+    count = bins.sums[bin + nbins*(pairs+1)];
+    for(int p=0;p<pairs;p++) pk[bin + nbins*p] = (count > 0 ? bins.sums[bin + nbins*p]/count : 0);
+    if(kbin != NULL) kbin[bin] = (count > 0 ? bins.sums[bin + nbins*pairs]/count : 0);
+    if(modes != NULL) modes[bin] = count;
+  }
 
-    		if(fft_type == FFT_FORWARD)
-  			{
+  delete[] bins.sums;
+  bins.sums = NULL;
+}
 
-  			         int i,j,k;
-  				 int comp;
-  				 int comm_rank;
+template<class compType>
+void PlanFFT<compType>::spectrumPencils(spectrumBinning & bins, Real (*spectra)[2])
+{
+  //batched z pencils of the inputs: kx + nx*(ky + ny*(a + inputs*z))
+  long zx = (long)xSizeLocal_*kySizeLocal_;
+  long idx;
+  Imag * values = new Imag[bins.inputs];
 
-  #ifdef SINGLE
-  				 fftwf_complex *p_in;
-  				 fftwf_complex *p_out;
-  #else
-  				 fftw_complex *p_in;
-  				 fftw_complex *p_out;
-  #endif
+  for(int k=0;k<rSize_[2];k++)
+  {
+    for(int j=0;j<kySizeLocal_;j++)
+    {
+      for(int i=0;i<xSizeLocal_;i++)
+      {
+        idx = i + xSizeLocal_*j + zx*bins.inputs*k;
+        for(int a=0;a<bins.inputs;a++) values[a] = Imag(spectra[idx + zx*a][0],spectra[idx + zx*a][1]);
+        bins.accumulate(xOffset_+i,kyOffset_+j,k,values);
+      }
+    }
+  }
 
-  				 for(comp=0;comp<components_;comp++)
-  				 {
+  delete[] values;
+}
 
-  					for(int l = 0;l< rSizeLocal_[2] ;l++)
-  					{
+template<class compType>
+void PlanFFT<compType>::powerSpectrum(Field<compType>** kfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin, double * modes, int binning, int window)
+{
+  int f,c,a,inputs = 0;
+  spectrumBinning bins;
 
-  					    p_in =  &cData_[rJump_[2]*l*components_ + comp];
-  					    p_out = &temp_[l*rSizeLocal_[1]];
-  #ifdef SINGLE
-  					    fftwf_execute_dft(fPlan_i_,p_in,p_out);
+  checkDimension("powerSpectrum");
+  checkR2R("powerSpectrum");
+  for(f=0;f<nfields;f++)
+  {
+    inputs += kfields[f]->components();
+    if(!sameFourierLayout(kfields[f]->lattice()))
+    {
+      if(parallel.isRoot())
+      {
+        cerr<<"Latfield2d::PlanFFT::powerSpectrum : fields do not live on the fourier space lattice of the plan"<<endl;
+        cerr<<"Latfield2d : Abort Process Requested"<<endl;
+      }
+      parallel.abortForce();
+    }
+  }
 
-  #else
-  					    fftw_execute_dft(fPlan_i_,p_in,p_out);
-  #endif
-  					}
+  spectrumSetup(bins,inputs,nbins,kmin,kmax,binning,window);
+  Imag * values = new Imag[inputs];
 
+  if(type_ == R2C && !transposed_)
+  {
+    rKSite k(kfields[0]->lattice());
+    for(k.first();k.test();k.next())
+    {
+      for(f=0,a=0;f<nfields;f++) for(c=0;c<kfields[f]->components();c++,a++) values[a] = (*kfields[f])(k,c);
+      bins.accumulate(k.coord(0),k.coord(1),k.coord(2),values);
+    }
+  }
+  else
+  {
+    cKSite k(kfields[0]->lattice());
+    for(k.first();k.test();k.next())
+    {
+      for(f=0,a=0;f<nfields;f++) for(c=0;c<kfields[f]->components();c++,a++) values[a] = (*kfields[f])(k,c);
+      bins.accumulate(k.coord(0),k.coord(1),k.coord(2),values);
+    }
+  }
 
-  				   MPI_Alltoall(temp_, 2* rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
+  delete[] values;
+  spectrumReduce(bins,pk,kbin,modes);
+}
 
-  				   for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1]],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1]],rSizeLocal_[1],rSizeLocal_[2],rSizeLocal_[1]);
+template<class compType>
+void PlanFFT<compType>::transformPowerSpectrum(Field<Real>** rfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin, double * modes, int binning, int window)
+{
+  checkDimension("transformPowerSpectrum");
+  checkPeriodic("transformPowerSpectrum");
+  if(type_ != R2C)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::transformPowerSpectrum : real fields given to a complex to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  for(int f=0;f<nfields;f++)
+  {
+    if(!sameLayout(rfields[f]->lattice(),rfields[f]->components()))
+    {
+      if(parallel.isRoot())
+      {
+        cerr<<"Latfield2d::PlanFFT::transformPowerSpectrum : fields do not have the layout of the real space field of the plan"<<endl;
+        cerr<<"Latfield2d : Abort Process Requested"<<endl;
+      }
+      parallel.abortForce();
+    }
+  }
 
-  #ifdef SINGLE
-  				   fftwf_execute(fPlan_j_);
-  #else
-  				   fftw_execute(fPlan_j_);
-  #endif
+  spectrumBinning bins;
+  spectrumSetup(bins,nfields*components_,nbins,kmin,kmax,binning,window);
 
+  //all the inputs are transformed together and binned from the z pencils
+  Real * rData = rData_;
+  bindSpectrumPlans(bins.inputs);
+  for(int f=0;f<nfields;f++)
+  {
+    rData_ = rfields[f]->data() + rfields[f]->lattice().siteFirst()*components_;
+    forward_x(0,f*components_,components_);
+  }
+  forward_yz();
+  transform_z(FFT_FORWARD);
+  spectrumPencils(bins,temp_);
+  bindPlans(planSet_);
+  rData_ = rData;
 
-  				   MPI_Alltoall(temp_,2*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1],MPI_DATA_PREC,temp1_,2*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, parallel.dim0_comm()[parallel.grid_rank()[1]]);
+  spectrumReduce(bins,pk,kbin,modes);
+}
 
-  				   for(i=0;i<parallel.grid_size()[0];i++)transpose_1_2(&temp1_[i*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1]],&temp_[i*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1]], rSizeLocal_[1],rSizeLocal_[2],rSizeLocal_[2]);
+template<class compType>
+void PlanFFT<compType>::transformPowerSpectrum(Field<compType>** rfields, int nfields, int nbins, double kmin, double kmax, double * pk, double * kbin, double * modes, int binning, int window)
+{
+  checkDimension("transformPowerSpectrum");
+  checkR2R("transformPowerSpectrum");
+  if(type_ != C2C)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::transformPowerSpectrum : complex fields given to a real to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  for(int f=0;f<nfields;f++)
+  {
+    if(!sameLayout(rfields[f]->lattice(),rfields[f]->components()))
+    {
+      if(parallel.isRoot())
+      {
+        cerr<<"Latfield2d::PlanFFT::transformPowerSpectrum : fields do not have the layout of the real space field of the plan"<<endl;
+        cerr<<"Latfield2d : Abort Process Requested"<<endl;
+      }
+      parallel.abortForce();
+    }
+  }
+
+  spectrumBinning bins;
+  spectrumSetup(bins,nfields*components_,nbins,kmin,kmax,binning,window);
+
+  //all the inputs are transformed together and binned from the z pencils
+#ifdef SINGLE
+  fftwf_complex * cData = cData_;
+#else
+  fftw_complex * cData = cData_;
+#endif
+  bindSpectrumPlans(bins.inputs);
+  for(int f=0;f<nfields;f++)
+  {
+#ifdef SINGLE
+    cData_ = (fftwf_complex*)rfields[f]->data() + rfields[f]->lattice().siteFirst()*components_;
+#else
+    cData_ = (fftw_complex*)rfields[f]->data() + rfields[f]->lattice().siteFirst()*components_;
+#endif
+    forward_x(0,f*components_,components_);
+  }
+  forward_yz();
+  transform_z(FFT_FORWARD);
+  spectrumPencils(bins,temp_);
+  bindPlans(planSet_);
+  cData_ = cData;
+
+  spectrumReduce(bins,pk,kbin,modes);
+}
 
+template<class compType>
+template<class Spectrum>
+Imag PlanFFT<compType>::randomMode(counterRNG & rng, Spectrum & spectrum, int k0, int k1, int k2, int comp)
+{
+  int c1 = k1;
+  int c2 = k2;
+  Real sign = 1;
+  bool self = false;
+  unsigned int r[4];
+  double g,phase;
+  double amp;
+
+  if(type_ == R2C && (k0 == 0 || 2*k0 == rSize_[0]))
+  {
+    //k and -k are both stored on these planes: the mode with the smallest (kz,ky) is drawn, the other one is its conjugate
+    int m1 = (rSize_[1] - k1) % rSize_[1];
+    int m2 = (rSize_[2] - k2) % rSize_[2];
+    if(m1 == k1 && m2 == k2) self = true;
+    else if(m2 < k2 || (m2 == k2 && m1 < k1))
+    {
+      c1 = m1;
+      c2 = m2;
+      sign = -1;
+    }
+  }
 
-  				  for(int l = 0;l< rSizeLocal_[2] ;l++)
-            //for(int l = 0;l< 13 ;l++)
-  					{
+  //the amplitude is the one of the drawn mode, so that both partners get the same even if the spectrum is not symmetric under k -> N-k
+  amp = sqrt((double)spectrum(k0,c1,c2));
+  rng.random(k0,c1,c2,comp,r);
+  g = sqrt(-2. * log((r[0] + 0.5) * 2.3283064365386963e-10));
+  phase = 2. * M_PI * (r[1] + 0.5) * 2.3283064365386963e-10;
 
-  					    p_in  = &temp_[l*rSizeLocal_[1]];
-  					    p_out = &kData_[rJump_[2]*l*components_ + comp];
-                //p_out = &kData_[0];
-  #ifdef SINGLE
-  					    fftwf_execute_dft(fPlan_k_,p_in,p_out);
-  #else
-  					    fftw_execute_dft(fPlan_k_,p_in,p_out);
-  #endif
-  					}
+  if(self) return Imag(amp * g * cos(phase), 0);
+  amp *= M_SQRT1_2;
+  return Imag(amp * g * cos(phase), sign * amp * g * sin(phase));
+}
 
-            //p_in = NULL;
-            //p_out = NULL;
-  				 }
+template<class compType>
+template<class Spectrum>
+void PlanFFT<compType>::random_pencils(counterRNG & rng, Spectrum & spectrum, int comp)
+{
+  //every mode only depends on its global wave vector, rows along kx are independent
+  long idx = 0;
+  Imag z;
 
-  			}
-  			if(fft_type == FFT_BACKWARD)
-  			{
+  for(int k=0;k<rSize_[2];k++)
+  {
+    for(int j=kyOffset_;j<kyOffset_+kySizeLocal_;j++)
+    {
+      for(int i=xOffset_;i<xOffset_+xSizeLocal_;i++,idx++)
+      {
+        z = randomMode(rng,spectrum,i,j,k,comp);
+        temp_[idx][0] = z.real();
+        temp_[idx][1] = z.imag();
+      }
+    }
+  }
+}
+
+template<class compType>
+template<class Spectrum>
+void PlanFFT<compType>::gaussianRandomField(Field<Real>* rfield, Spectrum spectrum, unsigned long long seed)
+{
+  checkDimension("gaussianRandomField");
+  checkPeriodic("gaussianRandomField");
+  if(type_ != R2C)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::gaussianRandomField : real field given to a complex to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(rfield->lattice(),rfield->components()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::gaussianRandomField : field does not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+
+  counterRNG rng(seed);
+  Real * rData = rData_;
+
+  rData_ = rfield->data() + rfield->lattice().siteFirst()*components_;
+  for(int comp=0;comp<components_;comp++)
+  {
+    random_pencils(rng,spectrum,comp);
+    transform_z(FFT_BACKWARD);
+    backward_pencils(comp);
+  }
 
-  			         int i,j,k;
-  				 int comp;
-  				 int comm_rank;
+  rData_ = rData;
+}
 
-  #ifdef SINGLE
-  				 fftwf_complex *p_in;
-  				 fftwf_complex *p_out;
-  #else
-  				 fftw_complex *p_in;
-  				 fftw_complex *p_out;
-  #endif
+template<class compType>
+template<class Spectrum>
+void PlanFFT<compType>::gaussianRandomField(Field<compType>* rfield, Spectrum spectrum, unsigned long long seed)
+{
+  checkDimension("gaussianRandomField");
+  checkR2R("gaussianRandomField");
+  if(type_ != C2C)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::gaussianRandomField : complex field given to a real to complex plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(rfield->lattice(),rfield->components()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::gaussianRandomField : field does not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
-  				 //STEP 1 : SAME AS STEP ONE OF FORWARD
+  counterRNG rng(seed);
+#ifdef SINGLE
+  fftwf_complex * cData = cData_;
+  cData_ = (fftwf_complex*)rfield->data() + rfield->lattice().siteFirst()*components_;
+#else
+  fftw_complex * cData = cData_;
+  cData_ = (fftw_complex*)rfield->data() + rfield->lattice().siteFirst()*components_;
+#endif
 
-  				  for(comp=0;comp<components_;comp++)
-  				 {
-  					for(int l = 0;l< rSizeLocal_[2] ;l++)
-  					{
+  for(int comp=0;comp<components_;comp++)
+  {
+    random_pencils(rng,spectrum,comp);
+    transform_z(FFT_BACKWARD);
+    backward_pencils(comp);
+  }
 
-  					    p_in =  &kData_[rJump_[2]*l*components_ + comp];
-  					    p_out = &temp_[l*rSizeLocal_[1]];
-  #ifdef SINGLE
-  					    fftwf_execute_dft(bPlan_k_,p_in,p_out);
+  cData_ = cData;
+}
 
-  #else
-  					    fftw_execute_dft(bPlan_k_,p_in,p_out);
-  #endif
-  					}
+template<class compType>
+template<class Spectrum>
+void PlanFFT<compType>::gaussianRandomModes(Field<compType>* kfield, Spectrum spectrum, unsigned long long seed)
+{
+  checkDimension("gaussianRandomModes");
+  checkR2R("gaussianRandomModes");
+  if(!sameFourierLayout(kfield->lattice()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::gaussianRandomModes : field does not live on the fourier space lattice of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
+  counterRNG rng(seed);
 
-  				  //step 2 : same as step 4 of forward
+  if(type_ == R2C && !transposed_)
+  {
+    rKSite k(kfield->lattice());
+    for(k.first();k.test();k.next())
+      for(int c=0;c<kfield->components();c++) (*kfield)(k,c) = randomMode(rng,spectrum,k.coord(0),k.coord(1),k.coord(2),c);
+  }
+  else
+  {
+    cKSite k(kfield->lattice());
+    for(k.first();k.test();k.next())
+      for(int c=0;c<kfield->components();c++) (*kfield)(k,c) = randomMode(rng,spectrum,k.coord(0),k.coord(1),k.coord(2),c);
+  }
+}
 
+template<class compType>
+template<class Green>
+void PlanFFT<compType>::setGreenFunction(Green green)
+{
+  if(!padded_)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::setGreenFunction : the plan is not zero padded, see initializePadded"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
-  				  MPI_Alltoall(temp_,2*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1],MPI_DATA_PREC,temp1_,2*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, parallel.dim0_comm()[parallel.grid_rank()[1]]);
+  int i,j,k,l,s;
+  int shift[3];
+  int y0 = yChunks_.offset[parallel.grid_rank()[1]];
+  int z0 = zChunks_.offset[parallel.grid_rank()[0]];
+  long size = (long)xSizeLocal_*kySizeLocal_*tSize_[2];
+  long idx;
+  Real sign;
+  Real norm = 1. / ((Real)tSize_[0]*tSize_[1]*tSize_[2]);
+  Real * row;
 
-  				   for(i=0;i<parallel.grid_size()[0];i++)transpose_1_2(&temp1_[i*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1]],&temp_[i*rSizeLocal_[2]*rSizeLocal_[2]*rSizeLocal_[1]], rSizeLocal_[1],rSizeLocal_[2],rSizeLocal_[2]);
+#ifdef SINGLE
+  if(green_ == NULL) green_ = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex)*size);
+#else
+  if(green_ == NULL) green_ = (fftw_complex*)fftw_malloc(sizeof(fftw_complex)*size);
+#endif
+  memset(green_,0,sizeof(Real)*2*size);
 
+  //the padded lattice is the sum of 8 blocks of the size of the real lattice, shifted by 0 or N in each
+  //direction: each block goes through the zero padded transform, a shift by N multiplies mode k by (-1)^k
+  for(s=0;s<8;s++)
+  {
+    for(i=0;i<3;i++) shift[i] = ((s >> i) & 1) * rSize_[i];
 
-  #ifdef SINGLE
-  				   fftwf_execute(bPlan_j_);
-  #else
-  				   fftw_execute(bPlan_j_);
-  #endif
+    for(l=0;l<rSizeLocal_[2];l++)
+    {
+      for(j=0;j<rSizeLocal_[1];j++)
+      {
+        row = padRows_ + (long)tSize_[0]*(j + (long)rSizeLocal_[1]*l);
+        for(i=0;i<rSize_[0];i++) row[i] = green(padDisplacement(i + shift[0],0),padDisplacement(y0 + j + shift[1],1),padDisplacement(z0 + l + shift[2],2));
+        for(;i<tSize_[0];i++) row[i] = 0;
+      }
+    }
 
+#ifdef SINGLE
+    fftwf_execute_dft_r2c(fPlan_i_,padRows_,temp_);
+#else
+    fftw_execute_dft_r2c(fPlan_i_,padRows_,temp_);
+#endif
+    forward_yz();
+    transform_z(FFT_FORWARD);
 
-  				   MPI_Alltoall(temp_, 2* rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, temp1_, 2* rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1], MPI_DATA_PREC, parallel.dim1_comm()[parallel.grid_rank()[0]]);
+    idx = 0;
+    for(k=0;k<tSize_[2];k++)
+    {
+      for(j=kyOffset_;j<kyOffset_+kySizeLocal_;j++)
+      {
+        for(i=xOffset_;i<xOffset_+xSizeLocal_;i++,idx++)
+        {
+          sign = ((((s & 1) ? i : 0) + ((s & 2) ? j : 0) + ((s & 4) ? k : 0)) % 2 ? -norm : norm);
+          green_[idx][0] += sign * temp_[idx][0];
+          green_[idx][1] += sign * temp_[idx][1];
+        }
+      }
+    }
+  }
+}
 
-  				   for(i=0;i<parallel.grid_size()[1];i++)transpose_0_2(&temp1_[i*rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1]],&temp_[i*rSizeLocal_[1]*rSizeLocal_[2]*rSizeLocal_[1]],rSizeLocal_[1],rSizeLocal_[2],rSizeLocal_[1]);
+template<class compType>
+void PlanFFT<compType>::convolve(Field<Real>* rfield_in, Field<Real>* rfield_out)
+{
+  if(green_ == NULL)
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : no Green's function, see initializePadded and setGreenFunction"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
+  if(!sameLayout(rfield_in->lattice(),rfield_in->components()) || !sameLayout(rfield_out->lattice(),rfield_out->components()))
+  {
+    if(parallel.isRoot())
+    {
+      cerr<<"Latfield2d::PlanFFT::convolve : fields do not have the layout of the real space field of the plan"<<endl;
+      cerr<<"Latfield2d : Abort Process Requested"<<endl;
+    }
+    parallel.abortForce();
+  }
 
+  Real * rData = rData_;
+  long size = (long)xSizeLocal_*kySizeLocal_*tSize_[2];
+  Real re;
 
-  				    for(int l = 0;l< rSizeLocal_[2] ;l++)
-  					{
+  for(int comp=0;comp<components_;comp++)
+  {
+    rData_ = rfield_in->data() + rfield_in->lattice().siteFirst()*components_;
+    forward_pencils(comp);
+    transform_z(FFT_FORWARD);
 
-  					    p_in = &temp_[l*rSizeLocal_[1]];
-  					    p_out =  &cData_[rJump_[2]*l*components_ + comp];
+    for(long idx=0;idx<size;idx++)
+    {
+      re = temp_[idx][0]*green_[idx][0] - temp_[idx][1]*green_[idx][1];
+      temp_[idx][1] = temp_[idx][0]*green_[idx][1] + temp_[idx][1]*green_[idx][0];
+      temp_[idx][0] = re;
+    }
 
-  #ifdef SINGLE
-  					    fftwf_execute_dft(bPlan_i_,p_in,p_out);
-  #else
-  					    fftw_execute_dft(bPlan_i_,p_in,p_out);
-  #endif
-  					}
-  				 }
+    transform_z(FFT_BACKWARD);
+    rData_ = rfield_out->data() + rfield_out->lattice().siteFirst()*components_;
+    backward_pencils(comp);
+  }
 
-  			}
-      }
+  rData_ = rData;
+}
 
+template<class compType>
+void PlanFFT<compType>::setSinglePrecisionTransport(bool enable)
+{
+  singleTransport_ = enable;
+}
 
+template<class compType>
+void PlanFFT<compType>::setStageTimers(fftStageTimers * timers)
+{
+  timers_ = timers;
+}
 
+template<class compType>
+float * PlanFFT<compType>::transportBuffer(long size)
+{
+  if(size > transportSize_)
+  {
+    if(transport_ != NULL) delete[] transport_;
+    transport_ = new float[size];
+    transportSize_ = size;
+  }
+  return transport_;
+}
 
+template<class compType>
+int PlanFFT<compType>::exchangeProcs(int stage)
+{
+  if(stage == 2 || (stage == 1 && dim_ == 2)) return parallel.grid_size()[0];
+  else return parallel.grid_size()[1];
 }
 
-//transposition function
+template<class compType>
+bool PlanFFT<compType>::transported(int stage)
+{
 #ifdef SINGLE
+  return false;
+#else
+  if(!singleTransport_ || exchangeProcs(stage) == 1) return false;
+  //the blocks of every stage fit in a work array of the bound plans
+  long size = fftPlanRegistry::scratchSize(rSize_,rSizeLocal_,padded_,wSize_,batch_);
+  transportSend_ = (float (*)[2])transportBuffer(4*size);
+  transportRecv_ = transportSend_ + size;
+  return true;
+#endif
+}
 
-/////
 template<class compType>
-void PlanFFT<compType>::transpose_0_2( fftwf_complex * in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k)
+template<class S, class D>
+void PlanFFT<compType>::copyComplex(S (*src)[2], D (*dst)[2], long n)
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
+  for(long i=0;i<n;i++)
   {
-    for(j=0;j<dim_j;j++)
-    {
-      for(k=0;k<dim_k;k++)
-      {
-
-        out[k+dim_k*(j+i*dim_j)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[k+dim_k*(j+i*dim_j)][1]=in[i+dim_i*(j+k*dim_j)][1];
-
-      }
-    }
+    dst[i][0] = src[i][0];
+    dst[i][1] = src[i][1];
   }
+}
 
+template<class compType>
+void PlanFFT<compType>::copyComplex(Real (*src)[2], Real (*dst)[2], long n)
+{
+  memcpy(dst,src,sizeof(Real)*2*n);
 }
 
 template<class compType>
-void PlanFFT<compType>::transpose_0_2_last_proc( fftwf_complex * in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k)
+void PlanFFT<compType>::exchange(int stage, int fft_type, Real (*send)[2], Real (*recv)[2])
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
+  int p;
+  int procs = exchangeProcs(stage);
+  long fwdSend,fwdRecv;
+  MPI_Comm comm;
+  double start = startStage();
+  int stageTimer = fftStageTimers::EXCHANGE_1 + stage - 1;
+
+  if(stage == 2 || (stage == 1 && dim_ == 2)) comm = parallel.dim0_comm()[parallel.grid_rank()[1]];
+  else comm = parallel.dim1_comm()[parallel.grid_rank()[0]];
+
+  //number of complex values sent to each process by the forward transform, the backward one sends them back.
+  //The batch_ components are below the split index of every layout, a block holds them all
+  for(p=0;p<procs;p++)
+  {
+    if(stage == 1)
+    {
+      fwdSend = (long)rSizeLocal_[1]*rSizeLocal_[2]*xChunks_.size[p];
+      fwdRecv = (long)yChunks_.size[p]*rSizeLocal_[2]*xSizeLocal_;
+    }
+    else if(stage == 2)
+    {
+      fwdSend = (long)xSizeLocal_*rSizeLocal_[2]*kyChunks_.size[p];
+      fwdRecv = (long)xSizeLocal_*zChunks_.size[p]*kySizeLocal_;
+    }
+    else
+    {
+      fwdSend = (long)xSizeLocal_*kySizeLocal_*kzChunks_.size[p];
+      fwdRecv = (long)xChunks_.size[p]*kySizeLocal_*kzSizeLocal_;
+    }
+    sendCounts_[p] = 2*batch_*(fft_type == FFT_FORWARD ? fwdSend : fwdRecv);
+    recvCounts_[p] = 2*batch_*(fft_type == FFT_FORWARD ? fwdRecv : fwdSend);
+    sendDispls_[p] = (p == 0 ? 0 : sendDispls_[p-1] + sendCounts_[p-1]);
+    recvDispls_[p] = (p == 0 ? 0 : recvDispls_[p-1] + recvCounts_[p-1]);
+  }
+
+  if(procs == 1)
+  {
+    //slab decomposition: the redistribution is the identity
+    if(send == temp_ && recv == temp1_) std::swap(temp_,temp1_);
+    else if(send == temp1_ && recv == temp_) std::swap(temp_,temp1_);
+    else memcpy(recv,send,sizeof(Real)*sendCounts_[0]);
+    if(timers_ != NULL) timers_->add(stageTimer, MPI_Wtime() - start, 0);
+    return;
+  }
+
+  if(transported(stage))
   {
-    for(j=0;j<dim_j;j++)
+    //the reorderings write the blocks sent by a backward exchange in transportSend_ and read the ones received by a
+    //forward exchange from transportRecv_. The other side is the transform output (forward) or input (backward),
+    //converted here in an extra pass timed apart from the exchange
+    long sendTotal = sendDispls_[procs-1] + sendCounts_[procs-1];
+    long recvTotal = recvDispls_[procs-1] + recvCounts_[procs-1];
+    double convert;
+
+    if(fft_type == FFT_FORWARD)
     {
-      for(k=0;k<dim_k;k++)
+      convert = startStage();
+      copyComplex(send,transportSend_,sendTotal/2);
+      if(timers_ != NULL)
       {
-        out[k+(dim_k+1)*(j+i*dim_j)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[k+(dim_k+1)*(j+i*dim_j)][1]=in[i+dim_i*(j+k*dim_j)][1];
+        timers_->add(fftStageTimers::CONVERT, MPI_Wtime() - convert, (double)(sizeof(Real) + sizeof(float)) * sendTotal);
+        start += MPI_Wtime() - convert;
       }
     }
+    MPI_Alltoallv(transportSend_, sendCounts_, sendDispls_, MPI_FLOAT, transportRecv_, recvCounts_, recvDispls_, MPI_FLOAT, comm);
+    if(timers_ != NULL) timers_->add(stageTimer, MPI_Wtime() - start, (double)sizeof(float) * sendTotal);
+    if(fft_type == FFT_BACKWARD)
+    {
+      convert = startStage();
+      copyComplex(transportRecv_,recv,recvTotal/2);
+      if(timers_ != NULL) timers_->add(fftStageTimers::CONVERT, MPI_Wtime() - convert, (double)(sizeof(Real) + sizeof(float)) * recvTotal);
+    }
+    return;
   }
+  MPI_Alltoallv(send, sendCounts_, sendDispls_, MPI_DATA_PREC, recv, recvCounts_, recvDispls_, MPI_DATA_PREC, comm);
+  if(timers_ != NULL) timers_->add(stageTimer, MPI_Wtime() - start, (double)sizeof(Real) * (sendDispls_[procs-1] + sendCounts_[procs-1]));
 }
 
+//x pencils in temp_ (y fastest, then z, then x frequencies) are sent by blocks of x frequencies. The block received from
+//process p of dim1 (dim0 in 2d) holds its y rows: y + ny_p*(z + nz*kx), and is placed in the y pencils (kx fastest, then z, then y).
+//With batch_ components c: y + ny_p*(z + nz*(c + batch_*kx)) and kx + nx*(z + nz*(c + batch_*y)).
 template<class compType>
-void PlanFFT<compType>::implement_local_0_last_proc( fftwf_complex * in, fftwf_complex * out,int proc_dim_i,int proc_dim_j,int proc_dim_k,int proc_size)
+template<class T>
+void PlanFFT<compType>::transpose_xy(T (*in)[2], Real (*out)[2])
 {
-  int i_in,i_out,j,rank;
-  for(i_in=0;i_in<proc_dim_i;i_in++)
+  int i,j,k,c,p;
+  int ny;
+  long yz = (long)xSizeLocal_*rSizeLocal_[2];
+  T (*block)[2];
+  Real (*dst)[2];
+  double start = startStage();
+
+  for(p=0;p<yChunks_.procs;p++)
   {
-    for(j=0;j<proc_dim_j;j++)
+    ny = yChunks_.size[p];
+    block = in + yz*batch_*yChunks_.offset[p];
+    for(j=0;j<ny;j++)
     {
-      for(rank=0;rank<proc_size;rank++)
+      for(c=0;c<batch_;c++)
       {
-        i_out=i_in+rank*proc_dim_i;
-        out[proc_dim_k + (proc_dim_k+1)*(j+i_out*proc_dim_j)][0]=in[i_in+proc_dim_i*(j+proc_dim_j*rank)][0];
-        out[proc_dim_k + (proc_dim_k+1)*(j+i_out*proc_dim_j)][1]=in[i_in+proc_dim_i*(j+proc_dim_j*rank)][1];
+        dst = out + yz*(c + batch_*(yChunks_.offset[p]+j));
+        for(k=0;k<rSizeLocal_[2];k++)
+        {
+          for(i=0;i<xSizeLocal_;i++)
+          {
+            dst[i + xSizeLocal_*k][0] = block[j + ny*(k + rSizeLocal_[2]*(c + batch_*i))][0];
+            dst[i + xSizeLocal_*k][1] = block[j + ny*(k + rSizeLocal_[2]*(c + batch_*i))][1];
+          }
+        }
       }
     }
   }
+  stopStage(fftStageTimers::TRANSPOSE_XY,start,(double)batch_*xSizeLocal_*rSizeLocal_[2]*rSize_[1]);
 }
 
-
 template<class compType>
-void PlanFFT<compType>::transpose_1_2(fftwf_complex * in , fftwf_complex * out ,int dim_i,int dim_j ,int dim_k )
+template<class T>
+void PlanFFT<compType>::transpose_yx(Real (*in)[2], T (*out)[2])
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
+  int i,j,k,c,p;
+  int ny;
+  long yz = (long)xSizeLocal_*rSizeLocal_[2];
+  T (*block)[2];
+  Real (*src)[2];
+  double start = startStage();
+
+  for(p=0;p<yChunks_.procs;p++)
   {
-    for(j=0;j<dim_j;j++)
+    ny = yChunks_.size[p];
+    block = out + yz*batch_*yChunks_.offset[p];
+    for(j=0;j<ny;j++)
     {
-      for(k=0;k<dim_k;k++)
+      for(c=0;c<batch_;c++)
       {
-        out[i+dim_i*(k+j*dim_k)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[i+dim_i*(k+j*dim_k)][1]=in[i+dim_i*(j+k*dim_j)][1];
+        src = in + yz*(c + batch_*(yChunks_.offset[p]+j));
+        for(k=0;k<rSizeLocal_[2];k++)
+        {
+          for(i=0;i<xSizeLocal_;i++)
+          {
+            block[j + ny*(k + rSizeLocal_[2]*(c + batch_*i))][0] = src[i + xSizeLocal_*k][0];
+            block[j + ny*(k + rSizeLocal_[2]*(c + batch_*i))][1] = src[i + xSizeLocal_*k][1];
+          }
+        }
       }
     }
   }
+  stopStage(fftStageTimers::TRANSPOSE_YX,start,(double)batch_*xSizeLocal_*rSizeLocal_[2]*rSize_[1]);
 }
 
+//y pencils are sent by blocks of y frequencies. The block received from process q of dim0 holds its z planes:
+//kx + nx*(z + nz_q*ky), and is placed in the z pencils (kx fastest, then ky, then z).
+//With batch_ components c: kx + nx*(z + nz_q*(c + batch_*ky)) and kx + nx*(ky + ny*(c + batch_*z)).
 template<class compType>
-void PlanFFT<compType>::transpose_back_0_3( fftwf_complex * in, fftwf_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size,int halo,int components, int comp)
+template<class T>
+void PlanFFT<compType>::transpose_yz(T (*in)[2], Real (*out)[2])
 {
-  int i,j,k,l, i_t, j_t, k_t;
-  int r2c_halo = r2c + 2*halo;
-  int local_size_k_halo = local_size_k + 2*halo;
-  for (i=0;i<local_r2c;i++)
+  int j,k,c,q;
+  int nz;
+  long zx = (long)xSizeLocal_*kySizeLocal_;
+  T (*block)[2];
+  double start = startStage();
+
+  for(q=0;q<parallel.grid_size()[0];q++)
   {
-    for(k=0;k<local_size_k;k++)
+    nz = zChunks_.size[q];
+    block = in + zx*batch_*zChunks_.offset[q];
+    for(k=0;k<nz;k++)
     {
-      for(j=0;j<local_size_j;j++)
+      for(c=0;c<batch_;c++)
       {
-        for(l=0;l<proc_size;l++)
+        for(j=0;j<kySizeLocal_;j++)
         {
-          i_t = i + l*local_r2c;
-          j_t = j ;
-          k_t = k ;
-          out[comp+components*(i_t + r2c_halo * (k_t + local_size_k_halo * j_t))][0]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][0];
-          out[comp+components*(i_t + r2c_halo * (k_t + local_size_k_halo * j_t))][1]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][1];
+          copyComplex(block + xSizeLocal_*(k + nz*(c + batch_*j)),out + xSizeLocal_*j + zx*(c + batch_*(zChunks_.offset[q]+k)),xSizeLocal_);
         }
       }
     }
   }
+  stopStage(fftStageTimers::TRANSPOSE_YZ,start,(double)batch_*xSizeLocal_*kySizeLocal_*rSize_[2]);
 }
 
 template<class compType>
-void PlanFFT<compType>::implement_0(fftwf_complex * in, fftwf_complex * out,int r2c_size,int local_size_j,int local_size_k, int halo,int components, int comp)
+template<class T>
+void PlanFFT<compType>::transpose_zy(Real (*in)[2], T (*out)[2])
 {
-  int i,j,k;
-  i=r2c_size-1;
-  int r2c_halo = r2c_size + 2*halo;
-  int local_size_k_halo = local_size_k + 2*halo;
+  int j,k,c,q;
+  int nz;
+  long zx = (long)xSizeLocal_*kySizeLocal_;
+  T (*block)[2];
+  double start = startStage();
 
-  for(j=0;j<local_size_j;j++)
+  for(q=0;q<parallel.grid_size()[0];q++)
   {
-    for(k=0;k<local_size_k;k++)
+    nz = zChunks_.size[q];
+    block = out + zx*batch_*zChunks_.offset[q];
+    for(k=0;k<nz;k++)
     {
-      out[comp+components*(i + r2c_halo * (k + local_size_k_halo *j))][0]=in[j + local_size_j *k][0];
-      out[comp+components*(i + r2c_halo * (k + local_size_k_halo *j))][1]=in[j + local_size_j *k][1];
+      for(c=0;c<batch_;c++)
+      {
+        for(j=0;j<kySizeLocal_;j++)
+        {
+          copyComplex(in + xSizeLocal_*j + zx*(c + batch_*(zChunks_.offset[q]+k)),block + xSizeLocal_*(k + nz*(c + batch_*j)),xSizeLocal_);
+        }
+      }
     }
   }
-
+  stopStage(fftStageTimers::TRANSPOSE_ZY,start,(double)batch_*xSizeLocal_*kySizeLocal_*rSize_[2]);
 }
 
-
+//R2C and 4d: z pencils are sent by blocks of z frequencies. The block received from process p of dim1 holds its x frequencies:
+//kx + nx_p*(ky + ny*kz), and is written in the fourier space field (kx, kz, ky lattice). In 4d the x frequencies are the
+//(kx,kw) pairs, kx fastest, and the block rows are split over the kx and kw directions of the (kx, kw, kz, ky) lattice.
 template<class compType>
-void PlanFFT<compType>::b_arrange_data_0(fftwf_complex *in, fftwf_complex * out,int dim_i,int dim_j ,int dim_k, int khalo, int components, int comp)
+template<class T>
+void PlanFFT<compType>::transpose_zk(T (*in)[2], int comp)
 {
-  int i,j,k;
-  int jump_i=(dim_i+ 2 *khalo);
-  int jump_j=dim_j+ 2 *khalo;
-  for(i=0;i<dim_i;i++)
+  int i,j,k,p;
+  int nx,x,x0,w0;
+  long w;
+  T (*block)[2];
+  Real (*dst)[2];
+  double start = startStage();
+
+  for(p=0;p<parallel.grid_size()[1];p++)
   {
-    for(j=0;j<dim_j;j++)
+    nx = xChunks_.size[p];
+    x0 = xChunks_.offset[p] % kSize_[0];
+    w0 = xChunks_.offset[p] / kSize_[0];
+    block = in + (long)kySizeLocal_*kzSizeLocal_*xChunks_.offset[p];
+    for(k=0;k<kzSizeLocal_;k++)
     {
-      for(k=0;k<dim_k;k++)
+      for(j=0;j<kySizeLocal_;j++)
       {
-        out[j + dim_j * (k + dim_k * i)][0]=in[comp+components*(i + jump_i * (j + jump_j*k))][0];
-        out[j + dim_j * (k + dim_k * i)][1]=in[comp+components*(i + jump_i * (j + jump_j*k))][1];
+        dst = kData_ + ((long)kJump_[1]*k + (long)kJump_[2]*j)*components_ + comp;
+        for(i=0,x=x0,w=w0;i<nx;i++)
+        {
+          dst[(x + kwJump_*w)*components_][0] = block[i + nx*(j + kySizeLocal_*k)][0];
+          dst[(x + kwJump_*w)*components_][1] = block[i + nx*(j + kySizeLocal_*k)][1];
+          if(++x == kSize_[0])
+          {
+            x = 0;
+            w++;
+          }
+        }
       }
     }
   }
-
+  stopStage(fftStageTimers::TRANSPOSE_ZK,start,(double)xSize_*kySizeLocal_*kzSizeLocal_);
 }
 
 template<class compType>
-void PlanFFT<compType>::b_transpose_back_0_1( fftwf_complex * in, fftwf_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size)
+template<class T>
+void PlanFFT<compType>::transpose_kz(T (*out)[2], int comp)
 {
-  int i,j,k,l, i_t, j_t, k_t;
-
-  for (i=0;i<local_r2c;i++)
+  int i,j,k,p;
+  int nx,x,x0,w0;
+  long w;
+  T (*block)[2];
+  Real (*src)[2];
+  double start = startStage();
+
+  for(p=0;p<parallel.grid_size()[1];p++)
   {
-    for(k=0;k<local_size_k;k++)
+    nx = xChunks_.size[p];
+    x0 = xChunks_.offset[p] % kSize_[0];
+    w0 = xChunks_.offset[p] / kSize_[0];
+    block = out + (long)kySizeLocal_*kzSizeLocal_*xChunks_.offset[p];
+    for(k=0;k<kzSizeLocal_;k++)
     {
-      for(j=0;j<local_size_j;j++)
+      for(j=0;j<kySizeLocal_;j++)
       {
-        for(l=0;l<proc_size;l++)
+        src = kData_ + ((long)kJump_[1]*k + (long)kJump_[2]*j)*components_ + comp;
+        for(i=0,x=x0,w=w0;i<nx;i++)
         {
-          i_t = i + l*local_r2c;
-          j_t = j ;
-          k_t = k ;
-          out[i_t + r2c * (k_t + local_size_k * j_t)][0]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][0];
-          out[i_t + r2c * (k_t + local_size_k * j_t)][1]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][1];
+          block[i + nx*(j + kySizeLocal_*k)][0] = src[(x + kwJump_*w)*components_][0];
+          block[i + nx*(j + kySizeLocal_*k)][1] = src[(x + kwJump_*w)*components_][1];
+          if(++x == kSize_[0])
+          {
+            x = 0;
+            w++;
+          }
         }
       }
     }
   }
+  stopStage(fftStageTimers::TRANSPOSE_KZ,start,(double)xSize_*kySizeLocal_*kzSizeLocal_);
 }
 
 template<class compType>
-void PlanFFT<compType>::b_implement_0(fftwf_complex * in, fftwf_complex * out,int r2c_size,int local_size_j,int local_size_k)
+void PlanFFT<compType>::load_rows(int comp)
 {
-  int i,j,k;
-  i=r2c_size-1;
-
+  //x rows of the field followed by Nx zeros, row y + ny*z
+  int i,j,l;
+  Real * src;
+  Real * dst;
 
-  for(j=0;j<local_size_j;j++)
+  for(l=0;l<rSizeLocal_[2];l++)
   {
-    for(k=0;k<local_size_k;k++)
+    for(j=0;j<rSizeLocal_[1];j++)
     {
-      out[i + r2c_size * (k + local_size_k *j)][0]=in[j + local_size_j *k][0];
-      out[i + r2c_size * (k + local_size_k *j)][1]=in[j + local_size_j *k][1];
+      src = rData_ + ((long)rJump_[1]*j + (long)rJump_[2]*l)*components_ + comp;
+      dst = padRows_ + (long)tSize_[0]*(j + (long)rSizeLocal_[1]*l);
+      for(i=0;i<rSize_[0];i++) dst[i] = src[i*components_];
+      for(;i<tSize_[0];i++) dst[i] = 0;
     }
   }
-
 }
 
-
-#endif
-
-#ifndef SINGLE
-
-/////
 template<class compType>
-void PlanFFT<compType>::transpose_0_2( fftw_complex * in, fftw_complex * out,int dim_i,int dim_j ,int dim_k)
+void PlanFFT<compType>::store_rows(int comp)
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
+  //the padding part of the backward x transform is dropped
+  int i,j,l;
+  Real * src;
+  Real * dst;
+
+  for(l=0;l<rSizeLocal_[2];l++)
   {
-    for(j=0;j<dim_j;j++)
+    for(j=0;j<rSizeLocal_[1];j++)
     {
-      for(k=0;k<dim_k;k++)
-      {
-
-        out[k+dim_k*(j+i*dim_j)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[k+dim_k*(j+i*dim_j)][1]=in[i+dim_i*(j+k*dim_j)][1];
-
-      }
+      src = padRows_ + (long)tSize_[0]*(j + (long)rSizeLocal_[1]*l);
+      dst = rData_ + ((long)rJump_[1]*j + (long)rJump_[2]*l)*components_ + comp;
+      for(i=0;i<rSize_[0];i++) dst[i*components_] = src[i];
     }
   }
+}
 
+template<class compType>
+void PlanFFT<compType>::forward_pencils(int comp)
+{
+  forward_x(comp);
+  forward_yz();
 }
 
 template<class compType>
-void PlanFFT<compType>::transpose_0_2_last_proc( fftw_complex * in, fftw_complex * out,int dim_i,int dim_j ,int dim_k)
+void PlanFFT<compType>::forward_x(int comp, int slot, int count)
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
+  //x transform of each z plane, written in temp_ as y + ny*(z + nz*kx)
+  double start = startStage();
+  if(padded_)
+  {
+    load_rows(comp);
+#ifdef SINGLE
+    fftwf_execute_dft_r2c(fPlan_i_,padRows_,temp_);
+#else
+    fftw_execute_dft_r2c(fPlan_i_,padRows_,temp_);
+#endif
+    stopStage(fftStageTimers::FFT_X,start,(double)xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
+    return;
+  }
+  if(r2r_)
   {
-    for(j=0;j<dim_j;j++)
+    //components comp and comp+1 into the real and imaginary parts of temp_
+    for(int l = 0;l< rSizeLocal_[2] ;l++)
     {
-      for(k=0;k<dim_k;k++)
+      for(int part = 0;part < 2 && comp + part < components_;part++)
       {
-        out[k+(dim_k+1)*(j+i*dim_j)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[k+(dim_k+1)*(j+i*dim_j)][1]=in[i+dim_i*(j+k*dim_j)][1];
+#ifdef SINGLE
+        fftwf_execute_r2r(fPlan_i_,&rData_[rJump_[2]*l*components_ + comp + part],(float*)&temp_[l*rSizeLocal_[1]] + part);
+#else
+        fftw_execute_r2r(fPlan_i_,&rData_[rJump_[2]*l*components_ + comp + part],(double*)&temp_[l*rSizeLocal_[1]] + part);
+#endif
       }
     }
+    stopStage(fftStageTimers::FFT_X,start,(double)xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
+    return;
   }
-}
 
-template<class compType>
-void PlanFFT<compType>::implement_local_0_last_proc( fftw_complex * in, fftw_complex * out,int proc_dim_i,int proc_dim_j,int proc_dim_k,int proc_size)
-{
-  int i_in,i_out,j,rank;
-  for(i_in=0;i_in<proc_dim_i;i_in++)
+  //the components comp+c go to the x pencils of the slot slot+c, xy values apart
+  long xy = (long)rSizeLocal_[1]*rSizeLocal_[2];
+  if(count == 0) count = batch_;
+  for(int l = 0;l< rSizeLocal_[2] ;l++)
   {
-    for(j=0;j<proc_dim_j;j++)
+    for(int c = 0;c < count;c++)
     {
-      for(rank=0;rank<proc_size;rank++)
-      {
-        i_out=i_in+rank*proc_dim_i;
-        out[proc_dim_k + (proc_dim_k+1)*(j+i_out*proc_dim_j)][0]=in[i_in+proc_dim_i*(j+proc_dim_j*rank)][0];
-        out[proc_dim_k + (proc_dim_k+1)*(j+i_out*proc_dim_j)][1]=in[i_in+proc_dim_i*(j+proc_dim_j*rank)][1];
-      }
+#ifdef SINGLE
+      if(type_ == R2C) fftwf_execute_dft_r2c(fPlan_i_,&rData_[rJump_[2]*l*components_ + comp + c],&temp_[l*rSizeLocal_[1] + (slot + c)*xy]);
+      else fftwf_execute_dft(fPlan_i_,&cData_[rJump_[2]*l*components_ + comp + c],&temp_[l*rSizeLocal_[1] + (slot + c)*xy]);
+#else
+      if(type_ == R2C) fftw_execute_dft_r2c(fPlan_i_,&rData_[rJump_[2]*l*components_ + comp + c],&temp_[l*rSizeLocal_[1] + (slot + c)*xy]);
+      else fftw_execute_dft(fPlan_i_,&cData_[rJump_[2]*l*components_ + comp + c],&temp_[l*rSizeLocal_[1] + (slot + c)*xy]);
+#endif
     }
   }
+  stopStage(fftStageTimers::FFT_X,start,(double)count*xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
 }
 
+template<class compType>
+void PlanFFT<compType>::forward_yz()
+{
+  long yz = (long)batch_*xSizeLocal_*rSizeLocal_[2];
+  long zx = (long)batch_*xSizeLocal_*kySizeLocal_;
+
+  exchange(1,FFT_FORWARD,temp_,temp1_);
+  if(transported(1)) transpose_xy(transportRecv_,temp_);
+  else transpose_xy(temp1_,temp_);
+  //zero padded plans: y is the slowest index of the y pencils, the padding is the end of the array
+  if(padded_) memset(temp_[yz*rSize_[1]],0,sizeof(Real)*2*yz*(tSize_[1]-rSize_[1]));
+
+  double start = startStage();
+#ifdef SINGLE
+  if(r2r_) fftwf_execute_r2r(fPlan_j_,(float*)temp_,(float*)temp_);
+  else fftwf_execute_dft(fPlan_j_,temp_,temp_);
+#else
+  if(r2r_) fftw_execute_r2r(fPlan_j_,(double*)temp_,(double*)temp_);
+  else fftw_execute_dft(fPlan_j_,temp_,temp_);
+#endif
+  stopStage(fftStageTimers::FFT_Y,start,(double)yz*tSize_[1]);
+
+  exchange(2,FFT_FORWARD,temp_,temp1_);
+  if(transported(2)) transpose_yz(transportRecv_,temp_);
+  else transpose_yz(temp1_,temp_);
+  if(padded_) memset(temp_[zx*rSize_[2]],0,sizeof(Real)*2*zx*(tSize_[2]-rSize_[2]));
+}
 
 template<class compType>
-void PlanFFT<compType>::transpose_1_2(fftw_complex * in , fftw_complex * out ,int dim_i,int dim_j ,int dim_k )
+void PlanFFT<compType>::backward_pencils(int comp)
 {
-  int i,j,k;
-  for(i=0;i<dim_i;i++)
-  {
-    for(j=0;j<dim_j;j++)
-    {
-      for(k=0;k<dim_k;k++)
-      {
-        out[i+dim_i*(k+j*dim_k)][0]=in[i+dim_i*(j+k*dim_j)][0];
-        out[i+dim_i*(k+j*dim_k)][1]=in[i+dim_i*(j+k*dim_j)][1];
-      }
-    }
-  }
+  if(transported(2)) transpose_zy(temp_,transportSend_);
+  else transpose_zy(temp_,temp1_);
+  exchange(2,FFT_BACKWARD,temp1_,temp_);
+
+  double start = startStage();
+#ifdef SINGLE
+  if(r2r_) fftwf_execute_r2r(bPlan_j_,(float*)temp_,(float*)temp_);
+  else fftwf_execute_dft(bPlan_j_,temp_,temp_);
+#else
+  if(r2r_) fftw_execute_r2r(bPlan_j_,(double*)temp_,(double*)temp_);
+  else fftw_execute_dft(bPlan_j_,temp_,temp_);
+#endif
+  stopStage(fftStageTimers::FFT_Y,start,(double)batch_*xSizeLocal_*rSizeLocal_[2]*tSize_[1]);
+
+  if(transported(1)) transpose_yx(temp_,transportSend_);
+  else transpose_yx(temp_,temp1_);
+  exchange(1,FFT_BACKWARD,temp1_,temp_);
+  backward_x(comp);
 }
 
 template<class compType>
-void PlanFFT<compType>::transpose_back_0_3( fftw_complex * in, fftw_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size,int halo,int components, int comp)
+void PlanFFT<compType>::backward_x(int comp)
 {
-  int i,j,k,l, i_t, j_t, k_t;
-  int r2c_halo = r2c + 2*halo;
-  int local_size_k_halo = local_size_k + 2*halo;
-  for (i=0;i<local_r2c;i++)
+  double start = startStage();
+  if(padded_)
+  {
+#ifdef SINGLE
+    fftwf_execute_dft_c2r(bPlan_i_,temp_,padRows_);
+#else
+    fftw_execute_dft_c2r(bPlan_i_,temp_,padRows_);
+#endif
+    store_rows(comp);
+    stopStage(fftStageTimers::FFT_X,start,(double)xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
+    return;
+  }
+  if(r2r_)
   {
-    for(k=0;k<local_size_k;k++)
+    for(int l = 0;l< rSizeLocal_[2] ;l++)
     {
-      for(j=0;j<local_size_j;j++)
+      for(int part = 0;part < 2 && comp + part < components_;part++)
       {
-        for(l=0;l<proc_size;l++)
-        {
-          i_t = i + l*local_r2c;
-          j_t = j ;
-          k_t = k ;
-          out[comp+components*(i_t + r2c_halo * (k_t + local_size_k_halo * j_t))][0]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][0];
-          out[comp+components*(i_t + r2c_halo * (k_t + local_size_k_halo * j_t))][1]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][1];
-        }
+#ifdef SINGLE
+        fftwf_execute_r2r(bPlan_i_,(float*)&temp_[l*rSizeLocal_[1]] + part,&rData_[rJump_[2]*l*components_ + comp + part]);
+#else
+        fftw_execute_r2r(bPlan_i_,(double*)&temp_[l*rSizeLocal_[1]] + part,&rData_[rJump_[2]*l*components_ + comp + part]);
+#endif
       }
     }
+    stopStage(fftStageTimers::FFT_X,start,(double)xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
+    return;
   }
-}
-
-template<class compType>
-void PlanFFT<compType>::implement_0(fftw_complex * in, fftw_complex * out,int r2c_size,int local_size_j,int local_size_k, int halo,int components, int comp)
-{
-  int i,j,k;
-  i=r2c_size-1;
-  int r2c_halo = r2c_size + 2*halo;
-  int local_size_k_halo = local_size_k + 2*halo;
 
-  for(j=0;j<local_size_j;j++)
+  long xy = (long)rSizeLocal_[1]*rSizeLocal_[2];
+  for(int l = 0;l< rSizeLocal_[2] ;l++)
   {
-    for(k=0;k<local_size_k;k++)
+    for(int c = 0;c < batch_;c++)
     {
-      out[comp+components*(i + r2c_halo * (k + local_size_k_halo *j))][0]=in[j + local_size_j *k][0];
-      out[comp+components*(i + r2c_halo * (k + local_size_k_halo *j))][1]=in[j + local_size_j *k][1];
+#ifdef SINGLE
+      if(type_ == R2C) fftwf_execute_dft_c2r(bPlan_i_,&temp_[l*rSizeLocal_[1] + c*xy],&rData_[rJump_[2]*l*components_ + comp + c]);
+      else fftwf_execute_dft(bPlan_i_,&temp_[l*rSizeLocal_[1] + c*xy],&cData_[rJump_[2]*l*components_ + comp + c]);
+#else
+      if(type_ == R2C) fftw_execute_dft_c2r(bPlan_i_,&temp_[l*rSizeLocal_[1] + c*xy],&rData_[rJump_[2]*l*components_ + comp + c]);
+      else fftw_execute_dft(bPlan_i_,&temp_[l*rSizeLocal_[1] + c*xy],&cData_[rJump_[2]*l*components_ + comp + c]);
+#endif
     }
   }
-
+  stopStage(fftStageTimers::FFT_X,start,(double)batch_*xSize_*rSizeLocal_[1]*rSizeLocal_[2]);
 }
 
+template<class compType>
+void PlanFFT<compType>::transform_z(int fft_type)
+{
+  //in place z transform of the z pencils
+  double start = startStage();
+#ifdef SINGLE
+  if(r2r_) fftwf_execute_r2r((fft_type == FFT_FORWARD ? fPlan_z_ : bPlan_z_),(float*)temp_,(float*)temp_);
+  else fftwf_execute_dft((fft_type == FFT_FORWARD ? fPlan_z_ : bPlan_z_),temp_,temp_);
+#else
+  if(r2r_) fftw_execute_r2r((fft_type == FFT_FORWARD ? fPlan_z_ : bPlan_z_),(double*)temp_,(double*)temp_);
+  else fftw_execute_dft((fft_type == FFT_FORWARD ? fPlan_z_ : bPlan_z_),temp_,temp_);
+#endif
+  stopStage(fftStageTimers::FFT_Z,start,(double)batch_*xSizeLocal_*kySizeLocal_*tSize_[2]);
+}
 
 template<class compType>
-void PlanFFT<compType>::b_arrange_data_0(fftw_complex *in, fftw_complex * out,int dim_i,int dim_j ,int dim_k, int khalo, int components, int comp)
+void PlanFFT<compType>::execute(int fft_type)
 {
-  int i,j,k;
-  int jump_i=(dim_i+ 2 *khalo);
-  int jump_j=dim_j+ 2 *khalo;
-  for(i=0;i<dim_i;i++)
+  int comp;
+  double start;
+
+  checkPeriodic("execute");
+
+  if(dim_ == 2)
   {
-    for(j=0;j<dim_j;j++)
+    //x transform, a single redistribution over dim0, then the y transform writes the fourier space field (ky, kx lattice)
+    if(fft_type == FFT_FORWARD)
+    {
+      for(comp=0;comp<components_;comp++)
+      {
+        forward_x(comp);
+        exchange(1,FFT_FORWARD,temp_,temp1_);
+        if(transported(1)) transpose_xy(transportRecv_,temp_);
+        else transpose_xy(temp1_,temp_);
+        start = startStage();
+#ifdef SINGLE
+        fftwf_execute_dft(fPlan_k_,temp_,&kData_[comp]);
+#else
+        fftw_execute_dft(fPlan_k_,temp_,&kData_[comp]);
+#endif
+        stopStage(fftStageTimers::FFT_Y,start,(double)xSizeLocal_*tSize_[1]);
+      }
+    }
+    if(fft_type == FFT_BACKWARD)
     {
-      for(k=0;k<dim_k;k++)
+      for(comp=0;comp<components_;comp++)
       {
-        out[j + dim_j * (k + dim_k * i)][0]=in[comp+components*(i + jump_i * (j + jump_j*k))][0];
-        out[j + dim_j * (k + dim_k * i)][1]=in[comp+components*(i + jump_i * (j + jump_j*k))][1];
+        start = startStage();
+#ifdef SINGLE
+        fftwf_execute_dft(bPlan_k_,&kData_[comp],temp_);
+#else
+        fftw_execute_dft(bPlan_k_,&kData_[comp],temp_);
+#endif
+        stopStage(fftStageTimers::FFT_Y,start,(double)xSizeLocal_*tSize_[1]);
+        if(transported(1)) transpose_yx(temp_,transportSend_);
+        else transpose_yx(temp_,temp1_);
+        exchange(1,FFT_BACKWARD,temp1_,temp_);
+        backward_x(comp);
       }
     }
+    return;
   }
 
-}
-
-template<class compType>
-void PlanFFT<compType>::b_transpose_back_0_1( fftw_complex * in, fftw_complex * out,int r2c,int local_r2c,int local_size_j,int local_size_k,int proc_size)
-{
-  int i,j,k,l, i_t, j_t, k_t;
-
-  for (i=0;i<local_r2c;i++)
+  if(r2r_)
   {
-    for(k=0;k<local_size_k;k++)
+    //as the complex to complex transform below, with the components comp and comp+1 in the two parts of the pencils
+    if(fft_type == FFT_FORWARD)
+    {
+      for(comp=0;comp<components_;comp+=2)
+      {
+        forward_pencils(comp);
+        start = startStage();
+        for(int j=0;j<kySizeLocal_;j++)
+        {
+          for(int part=0;part<2 && comp+part<components_;part++)
+          {
+#ifdef SINGLE
+            fftwf_execute_r2r(fPlan_k_,(float*)&temp_[j*xSizeLocal_] + part,&kReal_[kJump_[2]*j*components_ + comp + part]);
+#else
+            fftw_execute_r2r(fPlan_k_,(double*)&temp_[j*xSizeLocal_] + part,&kReal_[kJump_[2]*j*components_ + comp + part]);
+#endif
+          }
+        }
+        stopStage(fftStageTimers::FFT_Z,start,(double)xSizeLocal_*kySizeLocal_*tSize_[2]);
+      }
+    }
+    if(fft_type == FFT_BACKWARD)
     {
-      for(j=0;j<local_size_j;j++)
+      for(comp=0;comp<components_;comp+=2)
       {
-        for(l=0;l<proc_size;l++)
+        start = startStage();
+        for(int j=0;j<kySizeLocal_;j++)
         {
-          i_t = i + l*local_r2c;
-          j_t = j ;
-          k_t = k ;
-          out[i_t + r2c * (k_t + local_size_k * j_t)][0]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][0];
-          out[i_t + r2c * (k_t + local_size_k * j_t)][1]=in[i + local_r2c * (j + local_size_j * (k + local_size_k *l)) ][1];
+          for(int part=0;part<2 && comp+part<components_;part++)
+          {
+#ifdef SINGLE
+            fftwf_execute_r2r(bPlan_k_,&kReal_[kJump_[2]*j*components_ + comp + part],(float*)&temp_[j*xSizeLocal_] + part);
+#else
+            fftw_execute_r2r(bPlan_k_,&kReal_[kJump_[2]*j*components_ + comp + part],(double*)&temp_[j*xSizeLocal_] + part);
+#endif
+          }
         }
+        stopStage(fftStageTimers::FFT_Z,start,(double)xSizeLocal_*kySizeLocal_*tSize_[2]);
+        backward_pencils(comp);
       }
     }
+    return;
   }
-}
 
-template<class compType>
-void PlanFFT<compType>::b_implement_0(fftw_complex * in, fftw_complex * out,int r2c_size,int local_size_j,int local_size_k)
-{
-  int i,j,k;
-  i=r2c_size-1;
-
-
-  for(j=0;j<local_size_j;j++)
+  if((type_ == R2C && !transposed_) || dim_ == 4)
+  {
+    if(fft_type == FFT_FORWARD)
+    {
+      for(comp=0;comp<components_;comp++)
+      {
+        forward_pencils(comp);
+        transform_z(FFT_FORWARD);
+        exchange(3,FFT_FORWARD,temp_,temp1_);
+        if(transported(3)) transpose_zk(transportRecv_,comp);
+        else transpose_zk(temp1_,comp);
+      }
+    }
+    if(fft_type == FFT_BACKWARD)
+    {
+      for(comp=0;comp<components_;comp++)
+      {
+        if(transported(3)) transpose_kz(transportSend_,comp);
+        else transpose_kz(temp1_,comp);
+        exchange(3,FFT_BACKWARD,temp1_,temp_);
+        transform_z(FFT_BACKWARD);
+        backward_pencils(comp);
+      }
+    }
+  }
+  else
   {
-    for(k=0;k<local_size_k;k++)
+    //the z transform reads the z pencils and writes directly the fourier space field (kz, kx, ky lattice), one ky at a time
+    if(fft_type == FFT_FORWARD)
+    {
+      for(comp=0;comp<components_;comp++)
+      {
+        forward_pencils(comp);
+        start = startStage();
+        for(int j=0;j<kySizeLocal_;j++)
+        {
+#ifdef SINGLE
+          fftwf_execute_dft(fPlan_k_,&temp_[j*xSizeLocal_],&kData_[kJump_[2]*j*components_ + comp]);
+#else
+          fftw_execute_dft(fPlan_k_,&temp_[j*xSizeLocal_],&kData_[kJump_[2]*j*components_ + comp]);
+#endif
+        }
+        stopStage(fftStageTimers::FFT_Z,start,(double)xSizeLocal_*kySizeLocal_*tSize_[2]);
+      }
+    }
+    if(fft_type == FFT_BACKWARD)
     {
-      out[i + r2c_size * (k + local_size_k *j)][0]=in[j + local_size_j *k][0];
-      out[i + r2c_size * (k + local_size_k *j)][1]=in[j + local_size_j *k][1];
+      for(comp=0;comp<components_;comp++)
+      {
+        start = startStage();
+        for(int j=0;j<kySizeLocal_;j++)
+        {
+#ifdef SINGLE
+          fftwf_execute_dft(bPlan_k_,&kData_[kJump_[2]*j*components_ + comp],&temp_[j*xSizeLocal_]);
+#else
+          fftw_execute_dft(bPlan_k_,&kData_[kJump_[2]*j*components_ + comp],&temp_[j*xSizeLocal_]);
+#endif
+        }
+        stopStage(fftStageTimers::FFT_Z,start,(double)xSizeLocal_*kySizeLocal_*tSize_[2]);
+        backward_pencils(comp);
+      }
     }
   }
 
 }
-#endif
 
 
 #endif
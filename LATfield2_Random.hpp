@@ -0,0 +1,99 @@
+#ifndef LATFIELD2_RANDOM_HPP
+#define LATFIELD2_RANDOM_HPP
+
+/*! \file LATfield2_Random.hpp
+ \brief counter-based random number generator
+ LATfield2_Random.hpp contain the class counterRNG definition.
+ */
+
+
+/*! \class counterRNG
+
+ \brief Counter-based random number generator (Philox4x32-10, Salmon et al. 2011).
+
+ The generator has no state: the random numbers are a function of a 64 bits seed and of a 128 bits counter, given as four unsigned 32 bits integers. Using a global lattice coordinate as counter gives random numbers which do not depend on the order of the draws, hence on the parallel decomposition, and loops over sites can be vectorized as iterations are independent.
+
+ Each call returns 4 independent uniform deviates or 4 independent standard normal deviates, a different last counter word (for instance a component index or a time step) gives a different stream.
+ */
+class counterRNG
+{
+public:
+  //! Constructor.
+  counterRNG(unsigned long long seed = 0)
+  {
+    setSeed(seed);
+  }
+
+  //! Change the seed.
+  void setSeed(unsigned long long seed)
+  {
+    key_[0] = (unsigned int)(seed & 0xFFFFFFFFULL);
+    key_[1] = (unsigned int)(seed >> 32);
+  }
+
+  /*!
+   Raw 32 bits random integers.
+   \param c0,c1,c2,c3 : counter.
+   \param out : 4 random integers.
+   */
+  void random(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3, unsigned int * out) const
+  {
+    unsigned int k0 = key_[0];
+    unsigned int k1 = key_[1];
+    unsigned long long p0,p1;
+
+    for(int r=0;r<10;r++)
+    {
+      if(r>0)
+      {
+        k0 += 0x9E3779B9U;
+        k1 += 0xBB67AE85U;
+      }
+      p0 = 0xD2511F53ULL * c0;
+      p1 = 0xCD9E8D57ULL * c2;
+      c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+      c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+      c1 = (unsigned int)p1;
+      c3 = (unsigned int)p0;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+  }
+
+  /*!
+   Uniform deviates in ]0,1[.
+   \param c0,c1,c2,c3 : counter.
+   \param out : 4 uniform deviates.
+   */
+  void uniform(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3, double * out) const
+  {
+    unsigned int r[4];
+    random(c0,c1,c2,c3,r);
+    for(int i=0;i<4;i++) out[i] = (r[i] + 0.5) * 2.3283064365386963e-10;
+  }
+
+  /*!
+   Standard normal deviates (Box-Muller transform of uniform()).
+   \param c0,c1,c2,c3 : counter.
+   \param out : 4 normal deviates.
+   */
+  void gaussian(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3, double * out) const
+  {
+    double u[4];
+    double r;
+    uniform(c0,c1,c2,c3,u);
+    for(int i=0;i<4;i+=2)
+    {
+      r = sqrt(-2. * log(u[i]));
+      out[i] = r * cos(2. * M_PI * u[i+1]);
+      out[i+1] = r * sin(2. * M_PI * u[i+1]);
+    }
+  }
+
+private:
+  unsigned int key_[2];
+};
+
+#endif
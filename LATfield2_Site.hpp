@@ -1,7 +1,7 @@
 #ifndef LATFIELD2_SITE_HPP
 #define LATFIELD2_SITE_HPP
 /*! \file LATfield2_Site.hpp
- \brief LATfield2_Site.hpp contains the Site, rKSite, and cKSite definition.
+ \brief LATfield2_Site.hpp contains the Site, rKSite, cKSite and kSite definition.
  \author David Daveio, Neil Bevis, with modifications by Wessel Valkenburg
 
  */
@@ -216,8 +216,23 @@ ostream& operator<<(ostream& os,  Site& x)
 
 /* ckSite implmentation */
 
-void cKSite::initialize(Lattice& lattice) { lattice_=&lattice; directions_[0]=1; directions_[1]=2; directions_[2]=0;}
-void cKSite::initialize(Lattice& lattice, long index) { lattice_ = &lattice; index_ = index; directions_[0]=1; directions_[1]=2; directions_[2]=0; }
+void cKSite::initialize(Lattice& lattice) { lattice_=&lattice; setDirections();}
+void cKSite::initialize(Lattice& lattice, long index) { lattice_ = &lattice; index_ = index; setDirections(); }
+
+void cKSite::setDirections()
+{
+	//3d: kz, kx, ky lattice. 2d and 4d: last two directions swapped (ky, kx and kx, kw, kz, ky)
+	if(lattice_->dim()==3)
+	{
+		directions_[0]=1; directions_[1]=2; directions_[2]=0;
+	}
+	else
+	{
+		for(int i=0;i<lattice_->dim();i++) directions_[i]=i;
+		directions_[lattice_->dim()-1]=lattice_->dim()-2;
+		directions_[lattice_->dim()-2]=lattice_->dim()-1;
+	}
+}
 
 cKSite cKSite::operator+(int asked_direction)
 {
@@ -281,10 +296,8 @@ int cKSite::latCoordLocal(int direction)
 
 bool cKSite::setCoord(int* r_asked)
 {
-    int r[3];
-	r[0]=r_asked[2];
-	r[1]=r_asked[0];
-	r[2]=r_asked[1];
+    int r[4];
+	for(int i=0;i<lattice_->dim();i++) r[directions_[i]]=r_asked[i];
 	this->first();
 	//Check site is local
 	if(r[lattice_->dim()-1]<this->latCoord(lattice_->dim()-1) || r[lattice_->dim()-1]>=this->latCoord(lattice_->dim()-1)+lattice_->sizeLocal(lattice_->dim()-1)
@@ -308,16 +321,25 @@ bool cKSite::setCoord(int* r_asked)
 }
 bool cKSite::setCoord(int x, int y=0, int z=0)
 {
-	int r[3];
+	int r[4];
 	r[0]=x;
 	r[1]=y;
 	r[2]=z;
+	r[3]=0;
 	return this->setCoord(r);
 }
 
 /* rkSite implmentation */
-void rKSite::initialize(Lattice& lattice) { lattice_=&lattice; directions_[0]=0; directions_[1]=2; directions_[2]=1;}
-void rKSite::initialize(Lattice& lattice, long index) { lattice_ = &lattice; index_ = index; directions_[0]=0; directions_[1]=2; directions_[2]=1; }
+void rKSite::initialize(Lattice& lattice) { lattice_=&lattice; setDirections();}
+void rKSite::initialize(Lattice& lattice, long index) { lattice_ = &lattice; index_ = index; setDirections(); }
+
+void rKSite::setDirections()
+{
+	//last two directions swapped: kx, kz, ky lattice (3d), ky, kx (2d), kx, kw, kz, ky (4d)
+	for(int i=0;i<lattice_->dim();i++) directions_[i]=i;
+	directions_[lattice_->dim()-1]=lattice_->dim()-2;
+	directions_[lattice_->dim()-2]=lattice_->dim()-1;
+}
 
 rKSite rKSite::operator+(int asked_direction)
 {
@@ -381,10 +403,8 @@ int rKSite::latCoordLocal(int direction)
 
 bool rKSite::setCoord(int* r_asked)
 {
-    int r[3];
-	r[0]=r_asked[0];
-	r[1]=r_asked[2];
-	r[2]=r_asked[1];
+    int r[4];
+	for(int i=0;i<lattice_->dim();i++) r[directions_[i]]=r_asked[i];
 	this->first();
 	//Check site is local
 	if(r[lattice_->dim()-1]<this->latCoord(lattice_->dim()-1) || r[lattice_->dim()-1]>=this->latCoord(lattice_->dim()-1)+lattice_->sizeLocal(lattice_->dim()-1)
@@ -408,13 +428,96 @@ bool rKSite::setCoord(int* r_asked)
 }
 bool rKSite::setCoord(int x, int y=0, int z=0)
 {
-	int r[3];
+	int r[4];
 	r[0]=x;
 	r[1]=y;
 	r[2]=z;
+	r[3]=0;
 	return this->setCoord(r);
 }
 
+/* kSite implmentation */
+
+void kSite::initialize(Lattice& lattice)
+{
+	lattice_=&lattice;
+	index_=0;
+	if(lattice.waveNumber(0)==NULL)
+	{
+		if(parallel.isRoot())
+		{
+			cerr<<"Latfield2d::kSite::initialize : the lattice is not a Fourier space lattice"<<endl;
+			cerr<<"Latfield2d : Abort Process Requested"<<endl;
+		}
+		parallel.abortForce();
+	}
+	int dim = lattice.dim();
+	int d;
+	for(int i=0;i<dim;i++)
+	{
+		d = lattice.fourierDirection(i);
+		if(d<dim-2) offset_[d] = 0;
+		else if(d==dim-2) offset_[d] = lattice.coordSkip()[1];
+		else offset_[d] = lattice.coordSkip()[0];
+		k_[d] = lattice.waveNumber(i) + offset_[d];
+		k2_[d] = lattice.waveNumber2(i) + offset_[d];
+		kLat_[d] = lattice.latticeWaveNumber(i) + offset_[d];
+		kLat2_[d] = lattice.latticeWaveNumber2(i) + offset_[d];
+	}
+	sum2_[dim] = 0;
+	sumLat2_[dim] = 0;
+}
+
+void kSite::updateSums(int direction)
+{
+	for(int i=direction;i>0;i--)
+	{
+		sum2_[i] = sum2_[i+1] + k2_[i][coord_[i]];
+		sumLat2_[i] = sumLat2_[i+1] + kLat2_[i][coord_[i]];
+	}
+}
+
+void kSite::first()
+{
+	index_=lattice_->siteFirst();
+	for(int i=0;i<lattice_->dim();i++) coord_[i]=0;
+	if(lattice_->sitesLocal()>0) updateSums(lattice_->dim()-1);
+}
+
+void kSite::next()
+{
+	index_++;
+	coord_[0]++;
+	if(coord_[0] != lattice_->sizeLocal(0)) { return; }
+
+	index_ -= lattice_->sizeLocal(0);
+	coord_[0] = 0;
+	for(int i=1; i<lattice_->dim(); i++)
+	{
+		index_ += lattice_->jump(i);
+		coord_[i]++;
+		if(coord_[i] != lattice_->sizeLocal(i))
+		{
+			updateSums(i);
+			return;
+		}
+		index_ -= lattice_->sizeLocal(i) * lattice_->jump(i);
+		coord_[i] = 0;
+	}
+	index_ = lattice_->siteLast() + 1;
+}
+
+int kSite::coord(int direction)
+{
+	int d = lattice_->fourierDirection(direction);
+	return coord_[d] + offset_[d];
+}
+
+inline double kSite::k(int direction) { return k_[lattice_->fourierDirection(direction)][coord_[lattice_->fourierDirection(direction)]]; }
+inline double kSite::kLattice(int direction) { return kLat_[lattice_->fourierDirection(direction)][coord_[lattice_->fourierDirection(direction)]]; }
+inline double kSite::k2() { return sum2_[1] + k2_[0][coord_[0]]; }
+inline double kSite::k2Lattice() { return sumLat2_[1] + kLat2_[0][coord_[0]]; }
+
 
 #endif
 
@@ -206,7 +206,7 @@ protected:
 
  A class which simplify the map of the field data array index. This class allow to get coordinate on the lattice, loop over each site of the lattice and perform displacment on the lattice.
 
- WARNING: this site class must be used only on lattice initialized using initializeComplexFFT() method of the Lattice class.
+ WARNING: this site class must be used only on lattice initialized using the initializeComplexFFT() or initializeRealFFTTransposed() methods of the Lattice class. On 2d and 4d lattices coord(i) is the wave number along the real space direction i, as for rKSite.
 
  This class have same binding that the Site class, so one can refer to the Site class for the documentation.
 
@@ -235,7 +235,8 @@ public:
   bool setCoord(int x, int y, int z);
 
 private:
-  int directions_[3];
+  void setDirections();
+  int directions_[4];
 };
 
 
@@ -244,7 +245,7 @@ private:
 
  A class which simplifies the map of the field data array index. This class allow to get coordinate on the Lattice, loop over each site of the Lattice and access neighboring lattices sites
 
- WARNING: the rKSite class must be used only on Lattice initialized using initializeRealFFT() method of the Lattice class.
+ WARNING: the rKSite class must be used only on Lattice initialized using initializeRealFFT() method of the Lattice class. coord(i) is the wave number along the real space direction i, for 2d, 3d and 4d lattices.
 
  This class has same binding as the Site class, please refer to the Site class for the documentation.
 
@@ -273,7 +274,64 @@ public:
   bool setCoord(int x, int y, int z);
 
 private:
-  int directions_[3];
+  void setDirections();
+  int directions_[4];
+};
+
+
+/*! \class kSite
+ \brief A child of Site looping over a Fourier space Lattice, with the wave vector of the current site updated incrementally.
+
+ kSite works on the lattices initialized with the initializeRealFFT(), initializeRealFFTTransposed() and initializeComplexFFT() methods of the Lattice class, and can be used as a Site to access the fields defined on them. The wave vector is read from the tables of the Lattice (Lattice::waveNumber(), Lattice::latticeWaveNumber()), and the sums over the slower directions are only updated when the loop leaves a row: k2() and k2Lattice() cost one table read and one addition. coord(i) is the wave number along the real space direction i, as for rKSite and cKSite. A Poisson solver reads:
+
+ for(k.first();k.test();k.next()) phiK(k) = rhoK(k) * (-1./k.k2Lattice()); (with the k=0 mode treated apart)
+
+ Only first() and next() update the wave vector: the site must not be moved with indexAdvance() or setIndex() inside such a loop.
+
+ */
+class kSite:public Site{
+public:
+
+  kSite(){;}
+  kSite(Lattice& lattice){initialize(lattice);}
+
+  void initialize(Lattice& lattice);
+
+  void first();
+  void next();
+
+  /*!
+   \param direction : real space direction.
+   \return wave number coordinate along the real space direction "direction".
+   */
+  int coord(int direction);
+  /*!
+   \param direction : real space direction.
+   \return wave vector component 2*pi*n/N along the real space direction "direction", see Lattice::waveNumber().
+   */
+  double k(int direction);
+  /*!
+   \param direction : real space direction.
+   \return lattice wave vector component 2*sin(pi*n/N) along the real space direction "direction", see Lattice::latticeWaveNumber().
+   */
+  double kLattice(int direction);
+  //! \return squared norm of the wave vector.
+  double k2();
+  //! \return squared norm of the lattice wave vector (minus the eigenvalue of the finite difference Laplacian).
+  double k2Lattice();
+
+private:
+  void updateSums(int direction);
+  //local coordinate and wave number tables (shifted to be indexed by the local coordinate) along each direction of the Fourier lattice
+  int coord_[4];
+  int offset_[4];
+  double * k_[4];
+  double * k2_[4];
+  double * kLat_[4];
+  double * kLat2_[4];
+  //sums of the squares over the lattice directions >= i
+  double sum2_[5];
+  double sumLat2_[5];
 };
 
 #endif
@@ -0,0 +1,337 @@
+/*! file fft_benchmark.cpp
+
+    PlanFFT benchmark: time and bandwidth of each stage of the transforms (local transforms, local reorderings
+    and redistributions) for real to complex and complex to complex plans with 1 to 6 components. The double
+    precision build also runs the real to complex plans with the single precision transport
+    (PlanFFT::setSinglePrecisionTransport()) and measures its error. The Gaussian random field generator
+    (PlanFFT::gaussianRandomField()) is timed with a power law spectrum.
+
+    usage: mpirun -np n*m ./fft_benchmark -n n -m m [-b BoxSize] [-r runs] [-c maxComponents] [-o file.csv]
+
+    The process grid defaults to 1x1 (n = m = 1), the benchmark aborts if n*m differs from the number of processes.
+
+    The output is CSV (one line per plan type, components, direction and stage, appended to file.csv if given,
+    printed otherwise), compile with and without -DSINGLE to get both precisions and run fft_benchmark_sweep.sh
+    to scan the process grids. Columns:
+
+    precision,transport,type,n,m,Nx,Ny,Nz,components,direction,stage,calls,time_max,time_avg,bytes,bandwidth,error,checksum
+
+    time_max and time_avg are the maximum and the average over the processes of the time spent in the stage
+    per transform (seconds), bytes is the data volume of the stage per transform summed over the processes
+    (read + written for the local stages, sent for the exchanges) and bandwidth = bytes / time_max (GB/s).
+    The stage "total" is the wall clock time of execute(). transport is the precision of the exchanged data,
+    with the single precision transport the stage "convert" is the extra pass converting the transform output
+    sent by a forward exchange, or the data received by a backward one (the reorderings convert the other side).
+    error is the largest difference between the transforms with the single and the double precision transport
+    divided by the largest modulus of the double precision one (0 for the double transport).
+
+    The rows of type "grf" are the backward transforms of gaussianRandomField(), the stage "total" including
+    the generation of the modes. Their checksum is sum_x,c w(x,c) phi(x,c)^2 for the field drawn with a fixed
+    seed, with weights depending on the global coordinates: the field must not depend on the process grid, so
+    the checksums of every grid must agree with the 1x1 one up to rounding (fft_benchmark_sweep.sh checks it).
+    The checksum is 0 on the other rows.
+
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include "LATfield2.hpp"
+
+using namespace LATfield2;
+
+
+void report(ostream & out, bool singleTransport, const char * type, int components, const char * direction, const char * stage,
+            long calls, double time, double bytes, int runs, int * N, double error, double checksum = 0)
+{
+    double timeMax = time / runs;
+    double timeAvg = time / runs;
+    double volume = bytes / runs;
+
+    parallel.max(timeMax);
+    parallel.sum(timeAvg);
+    parallel.sum(volume);
+    timeAvg /= parallel.size();
+
+    if(parallel.isRoot())
+    {
+#ifdef SINGLE
+        out << "single,single,";
+#else
+        out << "double," << (singleTransport ? "single," : "double,");
+#endif
+        out << type << "," << parallel.grid_size()[0] << "," << parallel.grid_size()[1] << ",";
+        out << N[0] << "," << N[1] << "," << N[2] << "," << components << "," << direction << "," << stage << ",";
+        out << calls / runs << "," << timeMax << "," << timeAvg << "," << volume << ",";
+        out << (timeMax > 0 ? 1.e-9 * volume / timeMax : 0) << "," << error << ",";
+        out << setprecision(15) << checksum << setprecision(6) << endl;
+    }
+}
+
+//power law spectrum P(k) = |k|^-3 for the gaussian random field, the wave numbers are the rKSite coordinates
+struct powerLawSpectrum
+{
+    int size[3];
+    Real operator()(int k0, int k1, int k2) const
+    {
+        int k[3] = {k0,k1,k2};
+        double k2tot = 0;
+        for(int i=0;i<3;i++)
+        {
+            int q = (2*k[i] > size[i] ? k[i]-size[i] : k[i]);
+            k2tot += q*q;
+        }
+        return (k2tot > 0 ? pow(k2tot,-1.5) : 0);
+    }
+};
+
+double modulus2(Real value) { return value * value; }
+double modulus2(Imag value) { return value.norm(); }
+
+//largest difference between the field and the reference over the largest modulus of the reference
+template<class FieldType>
+double relativeError(Field<FieldType> & field, Field<FieldType> & reference)
+{
+    Site x(field.lattice());
+    double diff = 0;
+    double ref = 0;
+
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<field.components();c++)
+        {
+            diff = max(diff, modulus2(field(x,c) - reference(x,c)));
+            ref = max(ref, modulus2(reference(x,c)));
+        }
+    }
+    parallel.max(diff);
+    parallel.max(ref);
+
+    return (ref > 0 ? sqrt(diff / ref) : 0);
+}
+
+template<class FieldType>
+void copyField(Field<FieldType> & from, Field<FieldType> & to)
+{
+    Site x(from.lattice());
+    for(x.first();x.test();x.next())
+        for(int c=0;c<from.components();c++) to(x,c) = from(x,c);
+}
+
+//error of the forward and backward transforms with the single precision transport, the plan is left with it enabled
+template<class RField>
+void transportError(PlanFFT<Imag> & plan, Field<RField> & phi, Field<Imag> & phiK, double * error)
+{
+    Field<RField> phiSingle(phi.lattice(),phi.components());
+    Field<Imag> phiKDouble(phiK.lattice(),phiK.components());
+
+    //same input for both forward transforms
+    plan.setSinglePrecisionTransport(false);
+    plan.execute(FFT_FORWARD);
+    copyField(phiK,phiKDouble);
+    plan.setSinglePrecisionTransport(true);
+    plan.execute(FFT_FORWARD);
+    error[0] = relativeError(phiK,phiKDouble);
+
+    //same modes for both backward transforms
+    copyField(phiKDouble,phiK);
+    plan.execute(FFT_BACKWARD);
+    copyField(phi,phiSingle);
+    copyField(phiKDouble,phiK);
+    plan.setSinglePrecisionTransport(false);
+    plan.execute(FFT_BACKWARD);
+    error[1] = relativeError(phiSingle,phi);
+
+    plan.setSinglePrecisionTransport(true);
+}
+
+template<class RField>
+void benchmark(ostream & out, const char * type, Lattice & lat, Lattice & latK, int components, int runs, int * N,
+               bool singleTransport = false)
+{
+    Field<RField> phi(lat,components);
+    Field<Imag> phiK(latK,components);
+    PlanFFT<Imag> plan(&phi,&phiK);
+    fftStageTimers timers;
+    Site x(lat);
+    double ref,total;
+    double error[2] = {0,0};
+    int fft_type[2] = {FFT_FORWARD,FFT_BACKWARD};
+    const char * direction[2] = {"forward","backward"};
+
+    for(x.first();x.test();x.next())
+        for(int c=0;c<components;c++) phi(x,c) = sin(0.1 * x.coord(0)) * cos(0.2 * x.coord(1) + c) + x.coord(2);
+
+    if(singleTransport) transportError(plan,phi,phiK,error);
+
+    //warm up, the stage timers are only attached for the measured transforms
+    plan.execute(FFT_FORWARD);
+    plan.execute(FFT_BACKWARD);
+    plan.setStageTimers(&timers);
+
+    for(int d=0;d<2;d++)
+    {
+        timers.reset();
+        total = 0;
+        for(int r=0;r<runs;r++)
+        {
+            parallel.barrier();
+            ref = MPI_Wtime();
+            plan.execute(fft_type[d]);
+            total += MPI_Wtime() - ref;
+        }
+
+        for(int s=0;s<fftStageTimers::STAGES;s++)
+        {
+            //the call counts are the same on every process, skip the stages this plan does not use
+            if(timers.calls[s] == 0) continue;
+            report(out,singleTransport,type,components,direction[d],fftStageTimers::name(s),timers.calls[s],timers.time[s],timers.bytes[s],runs,N,error[d]);
+        }
+        report(out,singleTransport,type,components,direction[d],"total",runs,total,0,runs,N,error[d]);
+    }
+}
+
+
+//weighted sum of squares of the field, the weights depend on the global coordinates only
+double checksum(Field<Real> & phi)
+{
+    Site x(phi.lattice());
+    double sum = 0;
+
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<phi.components();c++)
+        {
+            double w = 1 + (x.coord(0) + 3 * x.coord(1) + 7 * x.coord(2) + 11 * c) % 13;
+            sum += w * phi(x,c) * phi(x,c);
+        }
+    }
+    parallel.sum(sum);
+
+    return sum;
+}
+
+void grfBenchmark(ostream & out, Lattice & lat, Lattice & latK, int components, int runs, int * N)
+{
+    Field<Real> phi(lat,components);
+    Field<Imag> phiK(latK,components);
+    PlanFFT<Imag> plan(&phi,&phiK);
+    fftStageTimers timers;
+    powerLawSpectrum spectrum;
+    double ref,total;
+
+    for(int i=0;i<3;i++) spectrum.size[i] = N[i];
+
+    //warm up with the seed of the checksum
+    plan.gaussianRandomField(&phi,spectrum,1234);
+    double sum = checksum(phi);
+    plan.setStageTimers(&timers);
+
+    total = 0;
+    for(int r=0;r<runs;r++)
+    {
+        parallel.barrier();
+        ref = MPI_Wtime();
+        plan.gaussianRandomField(&phi,spectrum,1235+r);
+        total += MPI_Wtime() - ref;
+    }
+
+    for(int s=0;s<fftStageTimers::STAGES;s++)
+    {
+        if(timers.calls[s] == 0) continue;
+        report(out,false,"grf",components,"backward",fftStageTimers::name(s),timers.calls[s],timers.time[s],timers.bytes[s],runs,N,0,sum);
+    }
+    report(out,false,"grf",components,"backward","total",runs,total,0,runs,N,0,sum);
+}
+
+int main(int argc, char **argv)
+{
+    int n = 1;
+    int m = 1;
+    int BoxSize = 64;
+    int runs = 10;
+    int maxComponents = 6;
+    string str_filename;
+
+    for (int i=1 ; i < argc ; i++ ){
+		if ( argv[i][0] != '-' )
+			continue;
+		switch(argv[i][1]) {
+			case 'n':
+				n = atoi(argv[++i]);
+				break;
+			case 'm':
+				m =  atoi(argv[++i]);
+				break;
+            case 'b':
+				BoxSize =  atoi(argv[++i]);
+				break;
+            case 'r':
+                runs = atoi(argv[++i]);
+                break;
+            case 'c':
+                maxComponents = atoi(argv[++i]);
+                break;
+            case 'o':
+                str_filename = argv[++i];
+                break;
+		}
+	}
+
+    if(n * m != parallel.world_size())
+    {
+        if(parallel.world_rank() == 0)
+        {
+            cerr<<"Latfield2d::fft_benchmark : wrong number of process, the process grid is "<<n<<"x"<<m<<" ("<<n*m<<" processes)"<<endl;
+            cerr<<"Latfield2d::fft_benchmark : but mpirun started "<<parallel.world_size()<<", use -n and -m with n*m equal to the number of processes"<<endl;
+            cerr<<"Latfield2d : Abort Process Requested"<<endl;
+        }
+        parallel.abortForce();
+    }
+
+    parallel.initialize(n,m);
+
+    int dim = 3;
+    int halo = 1;
+    int khalo = 0;
+    int N[3] = {BoxSize,BoxSize,BoxSize};
+
+    ofstream file;
+    if(parallel.isRoot() && str_filename.size() > 0)
+    {
+        file.open(str_filename.c_str(), fstream::out | fstream::app);
+        if(!file.is_open())
+        {
+            cerr<<"Latfield2d::fft_benchmark : could not open "<<str_filename<<endl;
+            cerr<<"Latfield2d : Abort Process Requested"<<endl;
+        }
+    }
+    if(str_filename.size() > 0)
+    {
+        bool opened = file.is_open();
+        parallel.broadcast(opened,parallel.root());
+        if(!opened) parallel.abortForce();
+    }
+    ostream & out = (str_filename.size() > 0 ? (ostream &)file : cout);
+
+    if(parallel.isRoot() && str_filename.size() == 0)
+        out << "precision,transport,type,n,m,Nx,Ny,Nz,components,direction,stage,calls,time_max,time_avg,bytes,bandwidth,error,checksum" << endl;
+
+    Lattice lat(dim,N,halo);
+    Lattice latKReal,latKImag;
+    latKReal.initializeRealFFT(lat, khalo);
+    latKImag.initializeComplexFFT(lat, khalo);
+
+    for(int c=1;c<=maxComponents;c++)
+    {
+        benchmark<Real>(out,"r2c",lat,latKReal,c,runs,N);
+        benchmark<Imag>(out,"c2c",lat,latKImag,c,runs,N);
+#ifndef SINGLE
+        benchmark<Real>(out,"r2c",lat,latKReal,c,runs,N,true);
+#endif
+    }
+
+    for(int c=1;c<=maxComponents;c++) grfBenchmark(out,lat,latKReal,c,runs,N);
+
+    if(file.is_open()) file.close();
+}
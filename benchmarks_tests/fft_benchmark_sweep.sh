@@ -0,0 +1,54 @@
+#!/bin/bash
+# Runs fft_benchmark_double and fft_benchmark_single on the 1x1 grid and on every n x m process grid
+# with n*m = NPROCS and collects the results in a single CSV file.
+#
+# The gaussian random field must not depend on the process grid: the checksums of the "grf" rows of
+# every grid are compared with the 1x1 ones and the script exits with 1 if they differ.
+#
+# usage: ./fft_benchmark_sweep.sh NPROCS [BoxSize] [runs] [output.csv]
+# the MPI launcher can be changed with the MPIRUN variable (default: mpirun -np)
+
+NPROCS=$1
+BOXSIZE=${2:-64}
+RUNS=${3:-10}
+OUTPUT=${4:-fft_benchmark.csv}
+MPIRUN=${MPIRUN:-"mpirun -np"}
+
+if [ -z "$NPROCS" ]; then
+    echo "usage: $0 NPROCS [BoxSize] [runs] [output.csv]"
+    exit 1
+fi
+
+echo "precision,transport,type,n,m,Nx,Ny,Nz,components,direction,stage,calls,time_max,time_avg,bytes,bandwidth,error,checksum" > $OUTPUT
+
+GRIDS="1x1"
+for (( n=1; n<=NPROCS; n++ )); do
+    if (( NPROCS % n != 0 )); then continue; fi
+    m=$(( NPROCS / n ))
+    if (( n * m > 1 )); then GRIDS="$GRIDS ${n}x${m}"; fi
+done
+
+for grid in $GRIDS; do
+    n=${grid%x*}
+    m=${grid#*x}
+    for exe in ./fft_benchmark_double ./fft_benchmark_single; do
+        if [ ! -x $exe ]; then continue; fi
+        echo "$exe on a ${n}x${m} grid"
+        $MPIRUN $(( n * m )) $exe -n $n -m $m -b $BOXSIZE -r $RUNS -o $OUTPUT || echo "$exe failed on a ${n}x${m} grid"
+    done
+done
+
+# relative tolerance of the checksums: rounding of the transforms and of the sums
+awk -F, '$3 == "grf" && $11 == "total" {
+    key = $1 "," $9
+    tol = ($1 == "single" ? 1e-4 : 1e-10)
+    if ($4 == 1 && $5 == 1) { ref[key] = $18; next }
+    if (!(key in ref)) next
+    diff = $18 - ref[key]; if (diff < 0) diff = -diff
+    if (diff > tol * (ref[key] < 0 ? -ref[key] : ref[key])) {
+        print "gaussian random field checksum differs on the " $4 "x" $5 " grid (" $1 ", " $9 " components): " $18 " instead of " ref[key]
+        failed = 1
+    }
+}
+END { exit failed }' $OUTPUT || exit 1
+echo "gaussian random field checksums agree on every grid"
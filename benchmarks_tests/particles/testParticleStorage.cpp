@@ -0,0 +1,493 @@
+/*! file testParticleStorage.cpp
+
+    Consistency tests of the particle handler:
+
+    - storage: after addParticle_global and after each move, every particle is in the cell of its position, the cells
+      are contiguous and in site order in the particle array, field()(x).size is the number of particles of the cell
+      and every particle is held exactly once;
+    - migration: the positions after the drifts match a serial integration, with MIGRATION_NEIGHBOUR (moveParticles,
+      updateVelMove) and MIGRATION_MULTIHOP (particles crossing more than one process);
+    - updateVelMove: same particles as updateVel followed by moveParticles;
+    - batch kernels: updateVelBatch with updateVel_gravity_batch compared with updateVel with updateVel_gravity;
+    - projections: scalarProjectionTSC / PCS and gatherBatch (CIC, TSC, PCS) compared with a serial projection and
+      interpolation.
+
+    usage: mpirun -np n*m ./testParticleStorage -n n -m m [-b BoxSize] [-p numParticles] [-s steps]
+
+    n and m are either both 1 or both at least 2 (updateHalo). Each test prints PASSED or FAILED, the exit code is
+    the number of failed tests.
+
+ */
+
+#include <stdlib.h>
+#include <vector>
+#include "LATfield2.hpp"
+
+using namespace LATfield2;
+
+#ifndef HDF5
+struct part_simple_dataType{};
+#endif
+
+#ifdef SINGLE
+#define TEST_TOLERANCE 1e-4
+#else
+#define TEST_TOLERANCE 1e-10
+#endif
+
+typedef Particles<part_simple,part_simple_info,part_simple_dataType> partSimple;
+
+//deterministic pseudo random number in [0,1) for the particle i and the property c
+double testValue(long i, int c)
+{
+    unsigned long u = (unsigned long)i * 2654435761ul ^ (unsigned long)(c + 1) * 40503ul;
+    u ^= u >> 13;
+    u *= 0x5bd1e995ul;
+    u ^= u >> 15;
+    return (double)(u % 1000000) / 1000000.;
+}
+
+void initParticles(partSimple & parts, long numParts, double vmax)
+{
+    part_simple pcl;
+    for(long i=0;i<numParts;i++)
+    {
+        pcl.ID = i;
+        for(int l=0;l<3;l++)
+        {
+            pcl.pos[l] = testValue(i,l) * 0.999999;
+            pcl.vel[l] = (2. * testValue(i,l+3) - 1.) * vmax;
+        }
+        parts.addParticle_global(pcl);
+    }
+}
+
+/*
+ Checks the cells of the particle array and gathers the particles on all processes: state[7*ID] to state[7*ID+5] are
+ the position and velocity of the particle ID, state[7*ID+6] the number of copies of the particle. Returns the number
+ of errors.
+ */
+long checkStorage(partSimple & parts, long numParts, std::vector<double> & state)
+{
+    Site x(parts.lattice());
+    partSimple::iterator it;
+    partSimple::iterator previousEnd = NULL;
+    long errors = 0;
+    int coord[3];
+
+    state.assign(7 * numParts, 0.);
+
+    for(x.first();x.test();x.next())
+    {
+        it = parts.field()(x).parts.begin();
+        if(previousEnd != NULL && it != previousEnd) errors++;
+        if(parts.field()(x).parts.end() - it != parts.field()(x).size) errors++;
+
+        for(;it != parts.field()(x).parts.end();++it)
+        {
+            parts.getPartCoord(*it,coord);
+            for(int l=0;l<3;l++) if(coord[l] != x.coord(l)) errors++;
+            if((*it).ID < 0 || (*it).ID >= numParts)
+            {
+                errors++;
+                continue;
+            }
+            for(int l=0;l<3;l++)
+            {
+                state[7 * (*it).ID + l] = (*it).pos[l];
+                state[7 * (*it).ID + 3 + l] = (*it).vel[l];
+            }
+            state[7 * (*it).ID + 6] += 1.;
+        }
+        previousEnd = parts.field()(x).parts.end();
+    }
+
+    parallel.sum(&state[0],7 * numParts);
+    for(long i=0;i<numParts;i++) if(state[7 * i + 6] != 1.) errors++;
+    parallel.sum(errors);
+
+    return errors;
+}
+
+//largest (periodic) distance between the positions of state and the serial positions
+double positionError(std::vector<double> & state, std::vector<double> & pos, long numParts)
+{
+    double d,error = 0.;
+    for(long i=0;i<numParts;i++)
+        for(int l=0;l<3;l++)
+        {
+            d = fabs(state[7 * i + l] - pos[3 * i + l]);
+            if(d > 0.5) d = 1. - d;
+            if(d > error) error = d;
+        }
+    return error;
+}
+
+//serial drift of move_particles_simple, the box size is 1
+void serialDrift(std::vector<double> & pos, std::vector<double> & vel, double dtau)
+{
+    for(size_t i=0;i<pos.size();i++)
+    {
+        Real p = (Real)pos[i];
+        p += (Real)dtau * (Real)vel[i];
+        if(p < 0) p += 1;
+        if(p >= 1) p -= 1;
+        pos[i] = p;
+    }
+}
+
+int report(const char * test, bool passed, double error)
+{
+    COUT << test << " : " << (passed ? "PASSED" : "FAILED") << " (" << error << ")" << endl;
+    return passed ? 0 : 1;
+}
+
+/*
+ Migration: numParts particles drifted over steps steps of dtau, checking the storage after each step. vmax is in
+ units of the box size per unit of dtau.
+ */
+int testMigration(Lattice & lat_part, part_simple_info & info, long numParts, int steps, int mode, double vmax, const char * name)
+{
+    part_simple_dataType dataType;
+    Real boxSize[3] = {1.,1.,1.};
+    partSimple parts;
+    std::vector<double> state,pos(3 * numParts),vel(3 * numParts);
+    long errors;
+    double error;
+
+    parts.initialize(info,dataType,&lat_part,boxSize);
+    parts.setMigrationMode(mode);
+    initParticles(parts,numParts,vmax);
+
+    errors = checkStorage(parts,numParts,state);
+    for(long i=0;i<numParts;i++)
+        for(int l=0;l<3;l++)
+        {
+            pos[3 * i + l] = state[7 * i + l];
+            vel[3 * i + l] = state[7 * i + 3 + l];
+        }
+    error = positionError(state,pos,numParts);
+
+    for(int s=0;s<steps;s++)
+    {
+        parts.moveParticles(&move_particles_simple,1.);
+        serialDrift(pos,vel,1.);
+        errors += checkStorage(parts,numParts,state);
+        error = max(error,positionError(state,pos,numParts));
+    }
+
+    long count = parts.numParticles();
+    COUT << name << " : " << errors << " storage errors, " << count << " particles" << endl;
+    return report(name, errors == 0 && count == numParts && error < TEST_TOLERANCE, error);
+}
+
+Real kickTest(double dtau,
+              double lat_resolution,
+              part_simple * part,
+              double * frac,
+              part_simple_info partInfo,
+              Field<Real> ** fields,
+              Site * sites,
+              int nfield,
+              double * params,
+              double * outputs,
+              int noutputs)
+{
+    Real v2 = 0.;
+    Real phi = (*fields[0])(sites[0]);
+
+    for(int l=0;l<3;l++)
+    {
+        (*part).vel[l] += dtau * params[0] * (phi + frac[l] - 0.5);
+        v2 += (*part).vel[l] * (*part).vel[l];
+    }
+    outputs[0] = v2;
+    outputs[1] = phi;
+
+    return v2;
+}
+
+//updateVelMove compared with updateVel followed by moveParticles
+int testUpdateVelMove(Lattice & lat_part, Lattice & lat, part_simple_info & info, long numParts, int steps, double vmax)
+{
+    part_simple_dataType dataType;
+    Real boxSize[3] = {1.,1.,1.};
+    partSimple parts,partsFused;
+    std::vector<double> state,stateFused;
+    Field<Real> phi(lat,1);
+    Field<Real> * fields[1] = {&phi};
+    Site x(lat);
+    double params[1] = {0.001};
+    int reduce[2] = {MAX,SUM};
+    double output[2],outputFused[2];
+    Real maxvel,maxvelFused;
+    long errors = 0;
+    double error = 0.;
+
+    for(x.first();x.test();x.next()) phi(x) = sin(0.4 * x.coord(0)) + cos(0.3 * x.coord(1) + 0.2 * x.coord(2));
+    phi.updateHalo();
+
+    parts.initialize(info,dataType,&lat_part,boxSize);
+    partsFused.initialize(info,dataType,&lat_part,boxSize);
+    initParticles(parts,numParts,vmax);
+    initParticles(partsFused,numParts,vmax);
+
+    for(int s=0;s<steps;s++)
+    {
+        maxvel = parts.updateVel(&kickTest,0.5,fields,1,params,output,reduce,2);
+        parts.moveParticles(&move_particles_simple,1.);
+        maxvelFused = partsFused.updateVelMove(&kickTest,&move_particles_simple,0.5,1.,fields,1,params,outputFused,reduce,2);
+
+        errors += checkStorage(parts,numParts,state);
+        errors += checkStorage(partsFused,numParts,stateFused);
+        for(long i=0;i<7 * numParts;i++) error = max(error,fabs(state[i] - stateFused[i]));
+        error = max(error,(double)fabs(maxvel - maxvelFused));
+        for(int i=0;i<2;i++) error = max(error,fabs(output[i] - outputFused[i]) / (fabs(output[i]) + 1.));
+    }
+    parallel.max(error);
+
+    return report("updateVelMove", errors == 0 && error < TEST_TOLERANCE, error);
+}
+
+//gravity kick of the batch kernel compared with the one of the per particle kernel
+int testGravityBatch(Lattice & lat_part, Lattice & lat, part_simple_info & info, long numParts, int steps, double vmax)
+{
+    part_simple_dataType dataType;
+    Real boxSize[3] = {1.,1.,1.};
+    partSimple parts,partsBatch;
+    std::vector<double> state,stateBatch;
+    Field<Real> g(lat,3);
+    Field<Real> * fields[1] = {&g};
+    Site x(lat);
+    Real maxvel,maxvelBatch;
+    long errors = 0;
+    double error = 0.;
+
+    for(x.first();x.test();x.next())
+        for(int l=0;l<3;l++) g(x,l) = 0.01 * sin(0.4 * x.coord(0) + l) * cos(0.3 * x.coord(1) - 0.2 * x.coord(2));
+    g.updateHalo();
+
+    parts.initialize(info,dataType,&lat_part,boxSize);
+    partsBatch.initialize(info,dataType,&lat_part,boxSize);
+    initParticles(parts,numParts,vmax);
+    initParticles(partsBatch,numParts,vmax);
+
+    for(int s=0;s<steps;s++)
+    {
+        maxvel = parts.updateVel(&updateVel_gravity,0.5,fields,1);
+        parts.moveParticles(&move_particles_simple,1.);
+        maxvelBatch = partsBatch.updateVelBatch(&updateVel_gravity_batch,0.5,fields,1,NULL);
+        partsBatch.moveParticlesBatch(&move_particles_simple_batch,1.,NULL,0,NULL);
+
+        errors += checkStorage(parts,numParts,state);
+        errors += checkStorage(partsBatch,numParts,stateBatch);
+        for(long i=0;i<7 * numParts;i++) error = max(error,fabs(state[i] - stateBatch[i]));
+        error = max(error,(double)fabs(maxvel - maxvelBatch));
+    }
+    parallel.max(error);
+
+    return report("updateVel_gravity_batch", errors == 0 && error < TEST_TOLERANCE, error);
+}
+
+/*
+ Serial projection of all the particles (TSC, order 3, or PCS, order 4) on the N^3 sites of the box, and serial
+ interpolation (CIC, order 2, TSC or PCS) of such an array at a position (in units of the lattice resolution).
+ */
+void serialWeights(int order, double x, int & base, double * weight)
+{
+    int cell = (int)floor(x);
+    double u = x - cell;
+
+    if(order == 2)
+    {
+        base = cell;
+        weight[0] = 1. - u;
+        weight[1] = u;
+        weight[2] = 0.;
+        weight[3] = 0.;
+    }
+    else
+    {
+        base = cell - 1;
+        projection_stencil4Weights(order,u,weight);
+    }
+}
+
+void serialProjection(int order, std::vector<double> & state, long numParts, int N, double mass, std::vector<double> & rho)
+{
+    double w[3][4];
+    int base[3];
+
+    rho.assign((long)N * N * N, 0.);
+    for(long p=0;p<numParts;p++)
+    {
+        for(int l=0;l<3;l++) serialWeights(order,state[7 * p + l] * N,base[l],w[l]);
+        for(int i=0;i<4;i++)
+            for(int j=0;j<4;j++)
+                for(int k=0;k<4;k++)
+                    rho[(base[0] + i + N) % N + N * ((base[1] + j + N) % N + (long)N * ((base[2] + k + N) % N))] += w[0][i] * w[1][j] * w[2][k] * mass;
+    }
+}
+
+double serialInterpolation(int order, double * pos, std::vector<double> & rho, int N)
+{
+    double w[3][4];
+    int base[3];
+    double value = 0.;
+
+    for(int l=0;l<3;l++) serialWeights(order,pos[l] * N,base[l],w[l]);
+    for(int i=0;i<4;i++)
+        for(int j=0;j<4;j++)
+            for(int k=0;k<4;k++)
+                value += w[0][i] * w[1][j] * w[2][k] * rho[(base[0] + i + N) % N + N * ((base[1] + j + N) % N + (long)N * ((base[2] + k + N) % N))];
+
+    return value;
+}
+
+//serial density and largest relative error of gatherBatch, set by the batch kernel gatherTest
+std::vector<double> gatherRho;
+int gatherOrder;
+double gatherError;
+
+void gatherTest(double dtau,
+                double lat_resolution,
+                partBatch<part_simple> * batch,
+                part_simple_info partInfo,
+                Field<Real> ** fields,
+                int nfield,
+                double * params)
+{
+    std::vector<Real> buffer(batch->size);
+    Real * values[1] = {&buffer[0]};
+    double pos[3],ref;
+    int N = fields[0]->lattice().size(0);
+
+    gatherBatch(fields[0],batch,values,1,NULL,gatherOrder);
+
+    for(long p=0;p<batch->size;p++)
+    {
+        for(int l=0;l<3;l++) pos[l] = batch->pos[l][p];
+        ref = serialInterpolation(gatherOrder,pos,gatherRho,N);
+        gatherError = max(gatherError,fabs(values[0][p] - ref) / (fabs(ref) + 1.));
+    }
+}
+
+int testProjections(Lattice & lat_part, Lattice & lat, part_simple_info & info, long numParts)
+{
+    part_simple_dataType dataType;
+    Real boxSize[3] = {1.,1.,1.};
+    partSimple parts;
+    std::vector<double> state;
+    Field<Real> rho(lat,1);
+    Field<Real> * fields[1] = {&rho};
+    Site x(lat);
+    int N = lat.size(0);
+    double mass = info.mass * N * N * N;
+    double error;
+    int failed = 0;
+
+    parts.initialize(info,dataType,&lat_part,boxSize);
+    initParticles(parts,numParts,0.);
+    checkStorage(parts,numParts,state);
+
+    for(int order=3;order<=4;order++)
+    {
+        projection_init(&rho);
+        if(order == 3)
+        {
+            scalarProjectionTSC_project(&parts,&rho);
+            scalarProjectionTSC_comm(&rho);
+        }
+        else
+        {
+            scalarProjectionPCS_project(&parts,&rho);
+            scalarProjectionPCS_comm(&rho);
+        }
+
+        serialProjection(order,state,numParts,N,mass,gatherRho);
+        error = 0.;
+        for(x.first();x.test();x.next())
+            error = max(error,fabs(rho(x) - gatherRho[x.coord(0) + N * (x.coord(1) + (long)N * x.coord(2))]) / mass);
+        parallel.max(error);
+        failed += report(order == 3 ? "scalarProjectionTSC" : "scalarProjectionPCS", error < TEST_TOLERANCE, error);
+    }
+
+    //gathers of the PCS density
+    rho.updateHalo();
+    for(gatherOrder=GATHER_CIC;gatherOrder<=GATHER_PCS;gatherOrder++)
+    {
+        gatherError = 0.;
+        parts.updateVelBatch(&gatherTest,0.,fields,1,NULL);
+        parallel.max(gatherError);
+        failed += report(gatherOrder == GATHER_CIC ? "gatherBatch CIC" : (gatherOrder == GATHER_TSC ? "gatherBatch TSC" : "gatherBatch PCS"), gatherError < TEST_TOLERANCE, gatherError);
+    }
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int n = 1;
+    int m = 1;
+    int BoxSize = 16;
+    long numParts = 4096;
+    int steps = 4;
+    int failed = 0;
+
+    for (int i=1 ; i < argc ; i++ ){
+        if ( argv[i][0] != '-' )
+            continue;
+        switch(argv[i][1]) {
+            case 'n':
+                n = atoi(argv[++i]);
+                break;
+            case 'm':
+                m =  atoi(argv[++i]);
+                break;
+            case 'b':
+                BoxSize = atoi(argv[++i]);
+                break;
+            case 'p':
+                numParts = atol(argv[++i]);
+                break;
+            case 's':
+                steps = atoi(argv[++i]);
+                break;
+        }
+    }
+
+    if(n * m != parallel.world_size())
+    {
+        if(parallel.world_rank() == 0)
+        {
+            cerr<<"Latfield2d::testParticleStorage : wrong number of process, n*m must be equal to the number of processes"<<endl;
+            cerr<<"Latfield2d : Abort Process Requested"<<endl;
+        }
+        parallel.abortForce();
+    }
+
+    parallel.initialize(n,m);
+
+    Lattice lat_part(3,BoxSize,0);
+    Lattice lat(3,BoxSize,2);
+
+    part_simple_info info;
+    info.mass = 0.1;
+    info.relativistic = false;
+    set_parts_typename(&info,"part_simple");
+
+    //displacements per step: a quarter of a process, and up to 2.5 processes (at most 0.45 box) for the multihop mode
+    int gridMax = max(parallel.grid_size()[0],parallel.grid_size()[1]);
+    double vNeighbour = 0.25 / gridMax;
+    double vMultihop = min(0.45,2.5 / gridMax);
+
+    failed += testMigration(lat_part,info,numParts,steps,MIGRATION_NEIGHBOUR,vNeighbour,"moveParticles neighbour");
+    failed += testMigration(lat_part,info,numParts,steps,MIGRATION_MULTIHOP,vMultihop,"moveParticles multihop");
+    failed += testUpdateVelMove(lat_part,lat,info,numParts,steps,vNeighbour);
+    failed += testGravityBatch(lat_part,lat,info,numParts,steps,vNeighbour);
+    failed += testProjections(lat_part,lat,info,numParts);
+
+    COUT << failed << " test(s) failed" << endl;
+
+    return failed;
+}
@@ -105,7 +105,7 @@ int main(int argc, char **argv)
          
          Site xpart(parts.lattice());
          
-         std::list<part_simple>::iterator it,it_verif;
+         partList<part_simple>::iterator it,it_verif;
          
         
          for(xpart.first();xpart.test();xpart.next())
@@ -0,0 +1,220 @@
+/*! file testImagOps.cpp
+
+    Tests of the bulk complex operations of LATfield2_ImagOps.hpp on a small odd sized lattice with a halo: each
+    operation is compared with the same operation written as a loop over the sites with the Imag operators.
+
+    - imagMultiply: real and complex kernels with the components of the field and with a single component (applied
+      to every component);
+    - imagMultiplyConjugate: into a third field and in place (out = a);
+    - imagAxpy: complex and real factors.
+
+    The halo sites are filled as well and must not be modified.
+
+    usage: mpirun -np n*m ./testImagOps -n n -m m [-x Nx] [-y Ny] [-z Nz]
+
+    Each test prints PASSED or FAILED, the exit code is the number of failed tests.
+
+ */
+
+#include <stdlib.h>
+#include "LATfield2.hpp"
+
+using namespace LATfield2;
+
+#ifdef SINGLE
+#define TEST_TOLERANCE 1e-6
+#else
+#define TEST_TOLERANCE 1e-14
+#endif
+
+#define COMPONENTS 3
+
+//deterministic value in [-0.5,0.5) for the element i of the local data array of a field, different on each process
+double testValue(long i, int seed)
+{
+    unsigned int u = i * 73856093u ^ seed * 19349663u ^ parallel.rank() * 83492791u;
+    u ^= u >> 13;
+    u *= 0x5bd1e995u;
+    u ^= u >> 15;
+    return (u % 10000) / 10000. - 0.5;
+}
+
+//fills the whole local data array, halo included
+void fill(Field<Imag> & f, int seed)
+{
+    long size = f.lattice().sitesLocalGross() * f.components();
+    for(long i=0;i<size;i++) f.data()[i] = Imag(testValue(i,2*seed),testValue(i,2*seed+1));
+}
+
+void fill(Field<Real> & f, int seed)
+{
+    long size = f.lattice().sitesLocalGross() * f.components();
+    for(long i=0;i<size;i++) f.data()[i] = testValue(i,2*seed);
+}
+
+//largest difference over the whole local data arrays (halo included) relative to the largest value, on all processes
+int compare(const char * test, Field<Imag> & f, Field<Imag> & ref)
+{
+    long size = f.lattice().sitesLocalGross() * f.components();
+    double diff = 0, scale = 0;
+    for(long i=0;i<size;i++)
+    {
+        Imag d = f.data()[i] - ref.data()[i];
+        diff = max(diff,(double)fabs(d.real()) + fabs(d.imag()));
+        scale = max(scale,(double)fabs(ref.data()[i].real()) + fabs(ref.data()[i].imag()));
+    }
+    parallel.max(diff);
+    parallel.max(scale);
+    bool passed = (diff <= TEST_TOLERANCE * scale);
+    COUT << test << " : " << (passed ? "PASSED" : "FAILED") << " (" << diff / scale << ")" << endl;
+    return passed ? 0 : 1;
+}
+
+int testMultiply(Lattice & lat)
+{
+    Field<Imag> f(lat,COMPONENTS);
+    Field<Imag> ref(lat,COMPONENTS);
+    Field<Real> kr(lat,COMPONENTS);
+    Field<Real> kr1(lat,1);
+    Field<Imag> ki(lat,COMPONENTS);
+    Field<Imag> ki1(lat,1);
+    Site x(lat);
+    int c;
+    int failed = 0;
+
+    fill(kr,1);
+    fill(kr1,2);
+    fill(ki,3);
+    fill(ki1,4);
+
+    fill(f,0);
+    fill(ref,0);
+    imagMultiply(f,kr);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) * kr(x,c);
+    failed += compare("imagMultiply real kernel",f,ref);
+
+    fill(f,0);
+    fill(ref,0);
+    imagMultiply(f,kr1);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) * kr1(x);
+    failed += compare("imagMultiply real kernel, 1 component",f,ref);
+
+    fill(f,0);
+    fill(ref,0);
+    imagMultiply(f,ki);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) * ki(x,c);
+    failed += compare("imagMultiply complex kernel",f,ref);
+
+    fill(f,0);
+    fill(ref,0);
+    imagMultiply(f,ki1);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) * ki1(x);
+    failed += compare("imagMultiply complex kernel, 1 component",f,ref);
+
+    return failed;
+}
+
+int testMultiplyConjugate(Lattice & lat)
+{
+    Field<Imag> a(lat,COMPONENTS);
+    Field<Imag> b(lat,COMPONENTS);
+    Field<Imag> out(lat,COMPONENTS);
+    Field<Imag> ref(lat,COMPONENTS);
+    Site x(lat);
+    int c;
+    int failed = 0;
+
+    fill(a,0);
+    fill(b,1);
+    fill(out,2);
+    fill(ref,2);
+    imagMultiplyConjugate(a,b,out);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = a(x,c) * b(x,c).conj();
+    failed += compare("imagMultiplyConjugate",out,ref);
+
+    fill(ref,0);
+    imagMultiplyConjugate(a,b,a);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) * b(x,c).conj();
+    failed += compare("imagMultiplyConjugate in place",a,ref);
+
+    return failed;
+}
+
+int testAxpy(Lattice & lat)
+{
+    Field<Imag> u(lat,COMPONENTS);
+    Field<Imag> v(lat,COMPONENTS);
+    Field<Imag> ref(lat,COMPONENTS);
+    Site x(lat);
+    Imag alpha(0.7,-1.3);
+    Real beta = -2.1;
+    int c;
+    int failed = 0;
+
+    fill(u,0);
+    fill(v,1);
+    fill(ref,1);
+    imagAxpy(alpha,u,v);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) + alpha * u(x,c);
+    failed += compare("imagAxpy complex factor",v,ref);
+
+    fill(v,1);
+    fill(ref,1);
+    imagAxpy(beta,u,v);
+    for(x.first();x.test();x.next()) for(c=0;c<COMPONENTS;c++) ref(x,c) = ref(x,c) + beta * u(x,c);
+    failed += compare("imagAxpy real factor",v,ref);
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int n = 1;
+    int m = 1;
+    int size[3] = {9,7,11};
+    int failed = 0;
+
+    for (int i=1 ; i < argc ; i++ ){
+        if ( argv[i][0] != '-' )
+            continue;
+        switch(argv[i][1]) {
+            case 'n':
+                n = atoi(argv[++i]);
+                break;
+            case 'm':
+                m =  atoi(argv[++i]);
+                break;
+            case 'x':
+                size[0] = atoi(argv[++i]);
+                break;
+            case 'y':
+                size[1] = atoi(argv[++i]);
+                break;
+            case 'z':
+                size[2] = atoi(argv[++i]);
+                break;
+        }
+    }
+
+    if(n * m != parallel.world_size())
+    {
+        if(parallel.world_rank() == 0)
+        {
+            cerr<<"Latfield2d::testImagOps : wrong number of process, n*m must be equal to the number of processes"<<endl;
+            cerr<<"Latfield2d : Abort Process Requested"<<endl;
+        }
+        parallel.abortForce();
+    }
+
+    parallel.initialize(n,m);
+
+    Lattice lat(3,size,1);
+
+    failed += testMultiply(lat);
+    failed += testMultiplyConjugate(lat);
+    failed += testAxpy(lat);
+
+    COUT << failed << " test(s) failed" << endl;
+
+    return failed;
+}
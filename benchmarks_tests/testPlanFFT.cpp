@@ -0,0 +1,855 @@
+/*! file testPlanFFT.cpp
+
+    Tests of PlanFFT on a small odd sized anisotropic lattice, against direct sums computed on every process from the
+    same deterministic input:
+
+    - convolve: real to complex and complex to complex convolutions, out of place and in place, compared with
+      execute(FFT_FORWARD), the kernel applied on the Fourier space field and execute(FFT_BACKWARD);
+    - execute: real to complex and complex to complex transforms of fields of 2 components compared with a direct
+      Fourier sum, and backward transforms compared with the input;
+    - real to real transforms: fields of 3 components transformed with different cosine and sine kinds along each
+      direction compared with the direct sums of the fftw definitions, backward transforms compared with the input
+      times the logical size, and convolve compared with execute and the kernel;
+    - 2d and 4d lattices: same checks for Nx x Ny and Nx x 5 x Nz x 5 lattices, the 2d ones only on n x 1 grids;
+    - single precision transport: the same checks with setSinglePrecisionTransport(), to the single precision rounding;
+    - transposed Fourier layout: same checks for a real to complex plan with the transposed layout;
+    - zero padded convolve: isolated convolution with a Green's function compared with the direct sum over the
+      sources, and convolution with a kernel equal to 1, which gives back the field times the padded lattice size;
+    - powerSpectrum, transformPowerSpectrum: spectra and cross spectra of real to complex (in both Fourier space
+      layouts) and complex to complex fields compared with a direct binning of the direct Fourier sums over the full
+      Fourier space, with linear bins and with logarithmic bins and a CIC window;
+    - gaussianRandomField, gaussianRandomModes: with a spectrum that is not symmetric under k -> N-k, the forward
+      transform of the real field must give back the modes (Hermitian symmetry of the kx=0 and kx=Nx/2 planes), and
+      the modes must not depend on the process grid: their checksum is printed, and compared with the one given with
+      -c (testPlanFFT.sh passes the one of the 1x1 grid);
+    - gradient, divergence, laplacian: spectral derivatives of sums of plane waves compared with their closed forms.
+
+    usage: mpirun -np n*m ./testPlanFFT -n n -m m [-x Nx] [-y Ny] [-z Nz] [-c checksum]
+
+    Each direction must hold at least one frequency per process in every pencil layout, Nx/2+1 >= m for instance.
+    testPlanFFT.sh runs it on every process grid of a given number of processes. Each test prints PASSED or FAILED,
+    the exit code is the number of failed tests.
+
+ */
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "LATfield2.hpp"
+
+using namespace LATfield2;
+
+#ifdef SINGLE
+#define TEST_TOLERANCE 1e-4
+#define TRANSPORT_TOLERANCE 1e-4
+#else
+#define TEST_TOLERANCE 1e-10
+//single precision rounding of the exchanged values
+#define TRANSPORT_TOLERANCE 1e-5
+#endif
+
+//deterministic value in [-0.5,0.5) at the site r of a lattice of up to 4 dimensions, for the component c
+double testValue(const int * r, int c)
+{
+    unsigned int u = r[0] * 73856093u ^ r[1] * 19349663u ^ r[2] * 83492791u ^ r[3] * 1500450271u ^ c * 2654435761u;
+    u ^= u >> 13;
+    u *= 0x5bd1e995u;
+    u ^= u >> 15;
+    return (u % 10000) / 10000. - 0.5;
+}
+
+double testValue(int x, int y, int z, int c)
+{
+    int r[4] = {x,y,z,0};
+    return testValue(r,c);
+}
+
+int report(const char * test, bool passed, double error)
+{
+    COUT << test << " : " << (passed ? "PASSED" : "FAILED") << " (" << error << ")" << endl;
+    return passed ? 0 : 1;
+}
+
+//relative error of a test: largest difference over largest reference value, on all processes
+int reportRelative(const char * test, double diff, double scale, double tolerance = TEST_TOLERANCE)
+{
+    parallel.max(diff);
+    parallel.max(scale);
+    return report(test, diff <= tolerance * scale, diff / scale);
+}
+
+double magnitude(Imag z)
+{
+    return sqrt(z.real() * z.real() + z.imag() * z.imag());
+}
+
+/*
+ Direct Fourier sum of the test values over a lattice of dim dimensions, sum_x f(x) exp(-2 i pi sum_d k_d x_d / N_d),
+ with f(x) = testValue(x,re) + i testValue(x,im), or f(x) = testValue(x,re) if im < 0.
+ */
+Imag directTransform(int dim, const int * size, const int * k, int re, int im)
+{
+    int r[4] = {0,0,0,0};
+    long sites = 1;
+    double phase, value[2], sum[2] = {0,0};
+
+    for(int d=0;d<dim;d++) sites *= size[d];
+
+    for(long i=0;i<sites;i++)
+    {
+        long l = i;
+        phase = 0;
+        for(int d=0;d<dim;d++)
+        {
+            r[d] = l % size[d];
+            l /= size[d];
+            phase -= 2. * M_PI * ((double)k[d] * r[d] / size[d]);
+        }
+        value[0] = testValue(r,re);
+        value[1] = (im < 0 ? 0 : testValue(r,im));
+        sum[0] += value[0] * cos(phase) - value[1] * sin(phase);
+        sum[1] += value[0] * sin(phase) + value[1] * cos(phase);
+    }
+
+    return Imag(sum[0],sum[1]);
+}
+
+//real to complex and complex to complex transforms of a lattice of any dimension, checked with directTransform(),
+//with the data exchanged in single precision if singleTransport is true
+int testTransforms(Lattice & lat, const char * name, bool singleTransport = false)
+{
+    Lattice latK, latC;
+    latK.initializeRealFFT(lat,0);
+    latC.initializeComplexFFT(lat,0);
+
+    int dim = lat.dim();
+    int size[4], r[4] = {0,0,0,0}, q[4] = {0,0,0,0};
+    Field<Real> f(lat,2);
+    Field<Imag> fk(latK,2);
+    Field<Imag> g(lat,2);
+    Field<Imag> gk(latC,2);
+    PlanFFT<Imag> plan(&f,&fk);
+    PlanFFT<Imag> planC(&g,&gk);
+    Site x(lat);
+    rKSite k(latK);
+    cKSite kc(latC);
+    double sites = lat.sites();
+    double diff = 0, scale = 0, diffBack = 0, diffC = 0, scaleC = 0, diffCBack = 0;
+    double tolerance = (singleTransport ? TRANSPORT_TOLERANCE : TEST_TOLERANCE);
+    std::string test;
+    int failed = 0;
+
+    plan.setSinglePrecisionTransport(singleTransport);
+    planC.setSinglePrecisionTransport(singleTransport);
+
+    for(int d=0;d<dim;d++) size[d] = lat.size(d);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int d=0;d<dim;d++) r[d] = x.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            f(x,c) = testValue(r,c);
+            g(x,c) = Imag(testValue(r,2*c+2),testValue(r,2*c+3));
+        }
+    }
+
+    plan.execute(FFT_FORWARD);
+    planC.execute(FFT_FORWARD);
+
+    for(k.first();k.test();k.next())
+    {
+        for(int d=0;d<dim;d++) q[d] = k.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            Imag exact = directTransform(dim,size,q,c,-1);
+            diff = max(diff,magnitude(fk(k,c) - exact));
+            scale = max(scale,magnitude(exact));
+        }
+    }
+    for(kc.first();kc.test();kc.next())
+    {
+        for(int d=0;d<dim;d++) q[d] = kc.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            Imag exact = directTransform(dim,size,q,2*c+2,2*c+3);
+            diffC = max(diffC,magnitude(gk(kc,c) - exact));
+            scaleC = max(scaleC,magnitude(exact));
+        }
+    }
+
+    plan.execute(FFT_BACKWARD);
+    planC.execute(FFT_BACKWARD);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int d=0;d<dim;d++) r[d] = x.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            diffBack = max(diffBack,fabs(f(x,c)/sites - testValue(r,c)));
+            diffCBack = max(diffCBack,magnitude(g(x,c)/sites - Imag(testValue(r,2*c+2),testValue(r,2*c+3))));
+        }
+    }
+
+    test = std::string(name) + " R2C forward";
+    failed += reportRelative(test.c_str(),diff,scale,tolerance);
+    test = std::string(name) + " R2C backward";
+    failed += reportRelative(test.c_str(),diffBack,0.5,tolerance);
+    test = std::string(name) + " C2C forward";
+    failed += reportRelative(test.c_str(),diffC,scaleC,tolerance);
+    test = std::string(name) + " C2C backward";
+    failed += reportRelative(test.c_str(),diffCBack,0.5,tolerance);
+
+    return failed;
+}
+
+//term j of the fftw r2r transform of the kind kind of size n, for the output k
+double r2rBasis(fftw_r2r_kind kind, int j, int k, int n)
+{
+    switch(kind)
+    {
+        case FFTW_REDFT10: return 2. * cos(M_PI * (j + 0.5) * k / n);
+        case FFTW_REDFT01: return (j == 0 ? 1. : 2. * cos(M_PI * j * (k + 0.5) / n));
+        case FFTW_RODFT10: return 2. * sin(M_PI * (j + 0.5) * (k + 1) / n);
+        case FFTW_REDFT00: return (j == 0 ? 1. : (j == n - 1 ? (k % 2 ? -1. : 1.) : 2. * cos(M_PI * j * k / (n - 1))));
+        case FFTW_RODFT00: return 2. * sin(M_PI * (j + 1) * (k + 1) / (n + 1));
+        default: return 0;
+    }
+}
+
+//logical size of the fftw r2r transform of the kind kind of size n
+double r2rLogicalSize(fftw_r2r_kind kind, int n)
+{
+    if(kind == FFTW_REDFT00) return 2. * (n - 1);
+    if(kind == FFTW_RODFT00) return 2. * (n + 1);
+    return 2. * n;
+}
+
+struct r2rKernel
+{
+    Real operator()(int k0, int k1, int k2) const
+    {
+        return 1. / (1. + k0 + 2 * k1 + 3 * k2);
+    }
+};
+
+int testRealToReal(Lattice & lat, const fftw_r2r_kind * kinds, const char * name)
+{
+    Lattice latC;
+    latC.initializeComplexFFT(lat,0);
+
+    Field<Real> f(lat,3), out(lat,3);
+    Field<Real> fk(latC,3);
+    PlanFFT<Imag> plan;
+    r2rKernel kernel;
+    Site x(lat);
+    cKSite k(latC);
+    double logical = 1, exact, diff = 0, scale = 0, diffBack = 0, diffConv = 0, scaleConv = 0;
+    std::string test;
+    int failed = 0;
+
+    plan.initializeR2R(&f,&fk,kinds);
+    for(int d=0;d<3;d++) logical *= r2rLogicalSize(kinds[d],lat.size(d));
+
+    for(x.first();x.test();x.next()) for(int c=0;c<3;c++) f(x,c) = testValue(x.coord(0),x.coord(1),x.coord(2),c);
+
+    plan.execute(FFT_FORWARD);
+
+    for(k.first();k.test();k.next())
+    {
+        for(int c=0;c<3;c++)
+        {
+            exact = 0;
+            for(int l=0;l<lat.size(2);l++)
+                for(int j=0;j<lat.size(1);j++)
+                    for(int i=0;i<lat.size(0);i++)
+                        exact += testValue(i,j,l,c) * r2rBasis(kinds[0],i,k.coord(0),lat.size(0))
+                                 * r2rBasis(kinds[1],j,k.coord(1),lat.size(1)) * r2rBasis(kinds[2],l,k.coord(2),lat.size(2));
+            diff = max(diff,fabs(fk(k,c) - exact));
+            scale = max(scale,fabs(exact));
+            fk(k,c) *= kernel(k.coord(0),k.coord(1),k.coord(2));
+        }
+    }
+
+    //reference of the convolution: the kernel applied on the Fourier space field, then the backward transform
+    plan.execute(FFT_BACKWARD);
+    for(x.first();x.test();x.next()) for(int c=0;c<3;c++) out(x,c) = f(x,c);
+
+    for(x.first();x.test();x.next()) for(int c=0;c<3;c++) f(x,c) = testValue(x.coord(0),x.coord(1),x.coord(2),c);
+    plan.execute(FFT_FORWARD);
+    plan.execute(FFT_BACKWARD);
+    for(x.first();x.test();x.next()) for(int c=0;c<3;c++) diffBack = max(diffBack,fabs(f(x,c)/logical - testValue(x.coord(0),x.coord(1),x.coord(2),c)));
+
+    for(x.first();x.test();x.next()) for(int c=0;c<3;c++) f(x,c) = testValue(x.coord(0),x.coord(1),x.coord(2),c);
+    plan.convolve(&f,&f,kernel);
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<3;c++)
+        {
+            diffConv = max(diffConv,(double)fabs(f(x,c) - out(x,c)));
+            scaleConv = max(scaleConv,(double)fabs(out(x,c)));
+        }
+    }
+
+    test = std::string(name) + " forward";
+    failed += reportRelative(test.c_str(),diff,scale);
+    test = std::string(name) + " backward";
+    failed += reportRelative(test.c_str(),diffBack,0.5);
+    test = std::string(name) + " convolve";
+    failed += reportRelative(test.c_str(),diffConv,scaleConv);
+
+    return failed;
+}
+
+//Green's function of the zero padded convolution, not symmetric under dx -> -dx
+struct isolatedGreen
+{
+    Real operator()(int dx, int dy, int dz) const
+    {
+        return 1. / (1. + dx * dx + 2 * dy * dy + 0.5 * dz * dz) + 0.1 * dx;
+    }
+};
+
+struct unitKernel
+{
+    Real operator()(int k0, int k1, int k2) const
+    {
+        return 1;
+    }
+};
+
+int testPaddedConvolve(Lattice & lat)
+{
+    Field<Real> f(lat,2), out(lat,2);
+    PlanFFT<Imag> plan;
+    isolatedGreen green;
+    Site x(lat);
+    double padded = 8. * lat.sites();
+    double exact, diff = 0, scale = 0, diffUnit = 0;
+    int failed = 0;
+
+    plan.initializePadded(&f);
+    plan.setGreenFunction(green);
+
+    for(x.first();x.test();x.next()) for(int c=0;c<2;c++) f(x,c) = testValue(x.coord(0),x.coord(1),x.coord(2),c);
+
+    plan.convolve(&f,&out);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<2;c++)
+        {
+            exact = 0;
+            for(int k=0;k<lat.size(2);k++)
+                for(int j=0;j<lat.size(1);j++)
+                    for(int i=0;i<lat.size(0);i++)
+                        exact += green(x.coord(0)-i,x.coord(1)-j,x.coord(2)-k) * testValue(i,j,k,c);
+            diff = max(diff,fabs(out(x,c) - exact));
+            scale = max(scale,fabs(exact));
+        }
+    }
+
+    plan.convolve(&f,&out,unitKernel());
+    for(x.first();x.test();x.next()) for(int c=0;c<2;c++) diffUnit = max(diffUnit,fabs(out(x,c)/padded - f(x,c)));
+
+    failed += reportRelative("convolve zero padded",diff,scale);
+    failed += reportRelative("convolve zero padded unit kernel",diffUnit,0.5);
+
+    return failed;
+}
+
+/*
+ Direct binning of the spectra of the inputs a, f_a(x) = testValue(x,re[a]) + i testValue(x,im[a]), over all the
+ modes of the lattice, with the conventions of PlanFFT::powerSpectrum.
+ */
+void directSpectrum(Lattice & lat, int inputs, const int * re, const int * im, int nbins, double kmin, double kmax, int binning, int window,
+                    double * pk, double * kbin, double * modes)
+{
+    int size[3], k[3];
+    int pairs = inputs * (inputs + 1) / 2;
+    int bin, p;
+    double x, k2sum, kmod, deconv;
+    std::vector<Imag> values(inputs);
+
+    for(int d=0;d<3;d++) size[d] = lat.size(d);
+    for(int i=0;i<nbins*pairs;i++) pk[i] = 0;
+    for(int i=0;i<nbins;i++) kbin[i] = modes[i] = 0;
+
+    for(k[2]=0;k[2]<size[2];k[2]++)
+    {
+        for(k[1]=0;k[1]<size[1];k[1]++)
+        {
+            for(k[0]=0;k[0]<size[0];k[0]++)
+            {
+                k2sum = 0;
+                deconv = 1;
+                for(int d=0;d<3;d++)
+                {
+                    x = (double)(2 * k[d] > size[d] ? k[d] - size[d] : k[d]) / size[d];
+                    k2sum += x * x;
+                    if(window > 0 && x != 0) deconv /= pow(sin(M_PI * x) / (M_PI * x),2 * window);
+                }
+                kmod = 2. * M_PI * sqrt(k2sum);
+                if(k2sum == 0 || kmod < kmin || kmod >= kmax) continue;
+                if(binning == PS_BIN_LOG) bin = (int)(nbins * log(kmod / kmin) / log(kmax / kmin));
+                else bin = (int)(nbins * (kmod - kmin) / (kmax - kmin));
+                if(bin >= nbins) continue;
+
+                for(int a=0;a<inputs;a++) values[a] = directTransform(3,size,k,re[a],im[a]);
+                p = 0;
+                for(int a=0;a<inputs;a++)
+                {
+                    for(int b=a;b<inputs;b++,p++)
+                        pk[bin + nbins * p] += deconv * (values[a].real() * values[b].real() + values[a].imag() * values[b].imag());
+                }
+                kbin[bin] += kmod;
+                modes[bin] += 1;
+            }
+        }
+    }
+
+    for(bin=0;bin<nbins;bin++)
+    {
+        if(modes[bin] == 0) continue;
+        for(p=0;p<pairs;p++) pk[bin + nbins * p] /= modes[bin];
+        kbin[bin] /= modes[bin];
+    }
+}
+
+//largest relative difference of the spectra and of the mean wave numbers, the numbers of modes must be equal
+int compareSpectra(const char * test, int nbins, int pairs, const double * pk, const double * kbin, const double * modes,
+                   const double * pkRef, const double * kbinRef, const double * modesRef)
+{
+    double diff = 0, scale = 0, diffK = 0, scaleK = 0;
+    bool sameModes = true;
+
+    for(int i=0;i<nbins*pairs;i++)
+    {
+        diff = max(diff,fabs(pk[i] - pkRef[i]));
+        scale = max(scale,fabs(pkRef[i]));
+    }
+    for(int i=0;i<nbins;i++)
+    {
+        sameModes = sameModes && (modes[i] == modesRef[i]);
+        diffK = max(diffK,fabs(kbin[i] - kbinRef[i]));
+        scaleK = max(scaleK,kbinRef[i]);
+    }
+
+    diff = max(diff / scale,diffK / scaleK);
+    return report(test, sameModes && diff <= TEST_TOLERANCE, diff);
+}
+
+int testPowerSpectrum(Lattice & lat)
+{
+    Lattice latK, latT, latC;
+    latK.initializeRealFFT(lat,0);
+    latT.initializeRealFFTTransposed(lat,0);
+    latC.initializeComplexFFT(lat,0);
+
+    Field<Real> f0(lat,2), f1(lat,2);
+    Field<Imag> fk0(latK,2), fk1(latK,2);
+    Field<Imag> ft0(latT,2), ft1(latT,2);
+    Field<Imag> g0(lat,1), g1(lat,1);
+    Field<Imag> gk0(latC,1), gk1(latC,1);
+    PlanFFT<Imag> plan0(&f0,&fk0), plan1(&f1,&fk1);
+    PlanFFT<Imag> planT0(&f0,&ft0,FFT_OUT_OF_PLACE,true), planT1(&f1,&ft1,FFT_OUT_OF_PLACE,true);
+    PlanFFT<Imag> planC0(&g0,&gk0), planC1(&g1,&gk1);
+    Field<Real> * rfields[2] = {&f0,&f1};
+    Field<Imag> * kfields[2] = {&fk0,&fk1};
+    Field<Imag> * tfields[2] = {&ft0,&ft1};
+    Field<Imag> * cfields[2] = {&g0,&g1};
+    Field<Imag> * ckfields[2] = {&gk0,&gk1};
+    int re[4] = {0,1,2,3}, im[4] = {-1,-1,-1,-1};
+    int reC[2] = {4,6}, imC[2] = {5,7};
+    const int nbins = 6;
+    double pk[10*nbins], kbin[nbins], modes[nbins];
+    double pkRef[10*nbins], kbinRef[nbins], modesRef[nbins];
+    double pkLogRef[10*nbins], kbinLogRef[nbins], modesLogRef[nbins];
+    double pkCRef[3*nbins], kbinCRef[nbins], modesCRef[nbins];
+    Site x(lat);
+    int r[4] = {0,0,0,0};
+    int failed = 0;
+
+    for(x.first();x.test();x.next())
+    {
+        for(int d=0;d<3;d++) r[d] = x.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            f0(x,c) = testValue(r,c);
+            f1(x,c) = testValue(r,c+2);
+        }
+        g0(x) = Imag(testValue(r,4),testValue(r,5));
+        g1(x) = Imag(testValue(r,6),testValue(r,7));
+    }
+
+    directSpectrum(lat,4,re,im,nbins,0.5,5.,PS_BIN_LINEAR,0,pkRef,kbinRef,modesRef);
+    directSpectrum(lat,4,re,im,nbins,0.4,5.5,PS_BIN_LOG,2,pkLogRef,kbinLogRef,modesLogRef);
+    directSpectrum(lat,2,reC,imC,nbins,0.5,5.,PS_BIN_LINEAR,0,pkCRef,kbinCRef,modesCRef);
+
+    plan0.transformPowerSpectrum(rfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("transformPowerSpectrum R2C",nbins,10,pk,kbin,modes,pkRef,kbinRef,modesRef);
+    plan0.transformPowerSpectrum(rfields,2,nbins,0.4,5.5,pk,kbin,modes,PS_BIN_LOG,2);
+    failed += compareSpectra("transformPowerSpectrum R2C log CIC",nbins,10,pk,kbin,modes,pkLogRef,kbinLogRef,modesLogRef);
+    planT0.transformPowerSpectrum(rfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("transformPowerSpectrum R2C transposed",nbins,10,pk,kbin,modes,pkRef,kbinRef,modesRef);
+    planC0.transformPowerSpectrum(cfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("transformPowerSpectrum C2C",nbins,3,pk,kbin,modes,pkCRef,kbinCRef,modesCRef);
+
+    plan0.execute(FFT_FORWARD);
+    plan1.execute(FFT_FORWARD);
+    planT0.execute(FFT_FORWARD);
+    planT1.execute(FFT_FORWARD);
+    planC0.execute(FFT_FORWARD);
+    planC1.execute(FFT_FORWARD);
+
+    plan0.powerSpectrum(kfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("powerSpectrum R2C",nbins,10,pk,kbin,modes,pkRef,kbinRef,modesRef);
+    plan0.powerSpectrum(kfields,2,nbins,0.4,5.5,pk,kbin,modes,PS_BIN_LOG,2);
+    failed += compareSpectra("powerSpectrum R2C log CIC",nbins,10,pk,kbin,modes,pkLogRef,kbinLogRef,modesLogRef);
+    planT0.powerSpectrum(tfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("powerSpectrum R2C transposed",nbins,10,pk,kbin,modes,pkRef,kbinRef,modesRef);
+    planC0.powerSpectrum(ckfields,2,nbins,0.5,5.,pk,kbin,modes);
+    failed += compareSpectra("powerSpectrum C2C",nbins,3,pk,kbin,modes,pkCRef,kbinCRef,modesCRef);
+
+    return failed;
+}
+
+//spectrum which is not symmetric under k -> N-k in the rKSite coordinates
+struct asymmetricSpectrum
+{
+    Real operator()(int k0, int k1, int k2) const
+    {
+        return 1. + 0.5 * k0 + 0.3 * k1 + 0.1 * k1 * k2;
+    }
+};
+
+//weight of the mode k in the checksum of the modes
+double checksumWeight(int k0, int k1, int k2)
+{
+    return cos(0.37 * k0 + 1.1 * k1 * k1 + 0.23 * k2 * k0) + 0.1 * k2;
+}
+
+int testRandomField(Lattice & lat, bool hasReference, double reference)
+{
+    Lattice latK, latC;
+    latK.initializeRealFFT(lat,0);
+    latC.initializeComplexFFT(lat,0);
+
+    Field<Real> f(lat,2);
+    Field<Imag> fk(latK,2), modes(latK,2);
+    Field<Imag> g(lat,1), h(lat,1);
+    Field<Imag> gk(latC,1);
+    PlanFFT<Imag> plan(&f,&fk);
+    PlanFFT<Imag> planC(&h,&gk);
+    asymmetricSpectrum spectrum;
+    Site x(lat);
+    rKSite k(latK);
+    double sites = lat.sites();
+    double diff = 0, scale = 0, diffC = 0, scaleC = 0, checksum = 0;
+    int failed = 0;
+
+    plan.gaussianRandomField(&f,spectrum,1234ULL);
+    plan.gaussianRandomModes(&modes,spectrum,1234ULL);
+    plan.execute(FFT_FORWARD);
+
+    for(k.first();k.test();k.next())
+    {
+        for(int c=0;c<2;c++)
+        {
+            diff = max(diff,magnitude(fk(k,c) / sites - modes(k,c)));
+            scale = max(scale,magnitude(modes(k,c)));
+            checksum += checksumWeight(k.coord(0),k.coord(1),k.coord(2)) * (modes(k,c).real() + (c + 2) * modes(k,c).imag());
+        }
+    }
+
+    planC.gaussianRandomField(&g,spectrum,77ULL);
+    planC.gaussianRandomModes(&gk,spectrum,77ULL);
+    planC.execute(FFT_BACKWARD);
+
+    for(x.first();x.test();x.next())
+    {
+        diffC = max(diffC,magnitude(g(x) - h(x)));
+        scaleC = max(scaleC,magnitude(h(x)));
+    }
+
+    failed += reportRelative("gaussianRandomField R2C forward",diff,scale);
+    failed += reportRelative("gaussianRandomField C2C",diffC,scaleC);
+
+    parallel.sum(checksum);
+    COUT.precision(17);
+    COUT << "gaussianRandomModes checksum : " << checksum << endl;
+    COUT.precision(6);
+    if(hasReference) failed += report("gaussianRandomModes grid independence",fabs(checksum - reference) <= TEST_TOLERANCE * fabs(reference),fabs(checksum / reference - 1.));
+
+    return failed;
+}
+
+int testTransposed(Lattice & lat)
+{
+    Lattice latT;
+    latT.initializeRealFFTTransposed(lat,0);
+
+    int size[3] = {lat.size(0),lat.size(1),lat.size(2)};
+    int r[4] = {0,0,0,0}, q[3];
+    Field<Real> f(lat,2);
+    Field<Imag> fk(latT,2);
+    PlanFFT<Imag> plan(&f,&fk,FFT_OUT_OF_PLACE,true);
+    Site x(lat);
+    cKSite k(latT);
+    double sites = lat.sites();
+    double diff = 0, scale = 0, diffBack = 0;
+    long count = 0;
+    int failed = 0;
+
+    for(x.first();x.test();x.next())
+    {
+        for(int d=0;d<3;d++) r[d] = x.coord(d);
+        for(int c=0;c<2;c++) f(x,c) = testValue(r,c);
+    }
+
+    plan.execute(FFT_FORWARD);
+
+    for(k.first();k.test();k.next())
+    {
+        count++;
+        for(int d=0;d<3;d++) q[d] = k.coord(d);
+        for(int c=0;c<2;c++)
+        {
+            Imag exact = directTransform(3,size,q,c,-1);
+            diff = max(diff,magnitude(fk(k,c) - exact));
+            scale = max(scale,magnitude(exact));
+        }
+    }
+
+    plan.execute(FFT_BACKWARD);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int d=0;d<3;d++) r[d] = x.coord(d);
+        for(int c=0;c<2;c++) diffBack = max(diffBack,fabs(f(x,c)/sites - testValue(r,c)));
+    }
+
+    //every mode of the half space is held once
+    parallel.sum(count);
+    if(count != (long)(size[0]/2 + 1) * size[1] * size[2]) diff = scale;
+
+    failed += reportRelative("execute R2C transposed forward",diff,scale);
+    failed += reportRelative("execute R2C transposed backward",diffBack,0.5);
+
+    return failed;
+}
+
+struct convolutionKernel
+{
+    Imag operator()(int k0, int k1, int k2) const
+    {
+        double t = 0.1 * k0 + 0.37 * k1 + 0.71 * k2;
+        return Imag(cos(t) / (1. + k0 + k1 * k1 + k2), sin(t));
+    }
+};
+
+int testConvolve(Lattice & lat)
+{
+    Lattice latK, latC;
+    latK.initializeRealFFT(lat,0);
+    latC.initializeComplexFFT(lat,0);
+
+    Field<Real> f(lat,3), out(lat,3), ref(lat,3);
+    Field<Imag> fk(latK,3);
+    Field<Imag> g(lat,2), gout(lat,2), gref(lat,2);
+    Field<Imag> gk(latC,2);
+    PlanFFT<Imag> plan(&f,&fk), planRef(&ref,&fk);
+    PlanFFT<Imag> planC(&g,&gk), planRefC(&gref,&gk);
+    convolutionKernel kernel;
+    Site x(lat);
+    rKSite k(latK);
+    cKSite kc(latC);
+    double diff = 0, diffInPlace = 0, scale = 0;
+    double diffC = 0, diffCInPlace = 0, scaleC = 0;
+    int failed = 0;
+
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<3;c++) ref(x,c) = f(x,c) = testValue(x.coord(0),x.coord(1),x.coord(2),c);
+        for(int c=0;c<2;c++) gref(x,c) = g(x,c) = Imag(testValue(x.coord(0),x.coord(1),x.coord(2),c+3),testValue(x.coord(0),x.coord(1),x.coord(2),c+5));
+    }
+
+    plan.convolve(&f,&out,kernel);
+    planC.convolve(&g,&gout,kernel);
+
+    planRef.execute(FFT_FORWARD);
+    for(k.first();k.test();k.next()) for(int c=0;c<3;c++) fk(k,c) *= kernel(k.coord(0),k.coord(1),k.coord(2));
+    planRef.execute(FFT_BACKWARD);
+    planRefC.execute(FFT_FORWARD);
+    for(kc.first();kc.test();kc.next()) for(int c=0;c<2;c++) gk(kc,c) *= kernel(kc.coord(0),kc.coord(1),kc.coord(2));
+    planRefC.execute(FFT_BACKWARD);
+
+    plan.convolve(&f,&f,kernel);
+    planC.convolve(&g,&g,kernel);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int c=0;c<3;c++)
+        {
+            diff = max(diff,(double)fabs(out(x,c) - ref(x,c)));
+            diffInPlace = max(diffInPlace,(double)fabs(f(x,c) - ref(x,c)));
+            scale = max(scale,(double)fabs(ref(x,c)));
+        }
+        for(int c=0;c<2;c++)
+        {
+            diffC = max(diffC,magnitude(gout(x,c) - gref(x,c)));
+            diffCInPlace = max(diffCInPlace,magnitude(g(x,c) - gref(x,c)));
+            scaleC = max(scaleC,magnitude(gref(x,c)));
+        }
+    }
+
+    failed += reportRelative("convolve R2C",diff,scale);
+    failed += reportRelative("convolve R2C in place",diffInPlace,scale);
+    failed += reportRelative("convolve C2C",diffC,scaleC);
+    failed += reportRelative("convolve C2C in place",diffCInPlace,scaleC);
+
+    return failed;
+}
+
+int testDerivatives(Lattice & lat)
+{
+    Lattice latK;
+    latK.initializeRealFFT(lat,0);
+
+    Field<Real> phi(lat,1), lap(lat,1), div(lat,1);
+    Field<Real> vec(lat,3), grad(lat,3);
+    Field<Imag> phik(latK,1);
+    PlanFFT<Imag> plan(&phi,&phik);
+    Site x(lat);
+    double w[3], r[3];
+    double sites = lat.sites();
+    double exact, diffGrad = 0, scaleGrad = 0, diffDiv = 0, scaleDiv = 0, diffLap = 0, scaleLap = 0;
+    int failed = 0;
+
+    for(int i=0;i<3;i++) w[i] = 2. * M_PI / lat.size(i);
+
+    //phi = sin(w0 x) + cos(2 w1 y) + sin(3 w2 z + w0 x), vec = (sin(w0 x + w1 y), cos(2 w1 y + w0 x), sin(w2 z - w1 y))
+    for(x.first();x.test();x.next())
+    {
+        for(int i=0;i<3;i++) r[i] = x.coord(i);
+        phi(x) = sin(w[0]*r[0]) + cos(2*w[1]*r[1]) + sin(3*w[2]*r[2] + w[0]*r[0]);
+        vec(x,0) = sin(w[0]*r[0] + w[1]*r[1]);
+        vec(x,1) = cos(2*w[1]*r[1] + w[0]*r[0]);
+        vec(x,2) = sin(w[2]*r[2] - w[1]*r[1]);
+    }
+
+    plan.gradient(&phi,&grad);
+    plan.divergence(&vec,&div);
+    plan.laplacian(&phi,&lap);
+
+    for(x.first();x.test();x.next())
+    {
+        for(int i=0;i<3;i++) r[i] = x.coord(i);
+
+        exact = w[0]*cos(w[0]*r[0]) + w[0]*cos(3*w[2]*r[2] + w[0]*r[0]);
+        diffGrad = max(diffGrad,fabs(grad(x,0)/sites - exact));
+        scaleGrad = max(scaleGrad,fabs(exact));
+        exact = -2*w[1]*sin(2*w[1]*r[1]);
+        diffGrad = max(diffGrad,fabs(grad(x,1)/sites - exact));
+        scaleGrad = max(scaleGrad,fabs(exact));
+        exact = 3*w[2]*cos(3*w[2]*r[2] + w[0]*r[0]);
+        diffGrad = max(diffGrad,fabs(grad(x,2)/sites - exact));
+        scaleGrad = max(scaleGrad,fabs(exact));
+
+        exact = w[0]*cos(w[0]*r[0] + w[1]*r[1]) - 2*w[1]*sin(2*w[1]*r[1] + w[0]*r[0]) + w[2]*cos(w[2]*r[2] - w[1]*r[1]);
+        diffDiv = max(diffDiv,fabs(div(x)/sites - exact));
+        scaleDiv = max(scaleDiv,fabs(exact));
+
+        exact = -w[0]*w[0]*sin(w[0]*r[0]) - 4*w[1]*w[1]*cos(2*w[1]*r[1]) - (9*w[2]*w[2] + w[0]*w[0])*sin(3*w[2]*r[2] + w[0]*r[0]);
+        diffLap = max(diffLap,fabs(lap(x)/sites - exact));
+        scaleLap = max(scaleLap,fabs(exact));
+    }
+
+    failed += reportRelative("gradient",diffGrad,scaleGrad);
+    failed += reportRelative("divergence",diffDiv,scaleDiv);
+    failed += reportRelative("laplacian",diffLap,scaleLap);
+
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int n = 1;
+    int m = 1;
+    int size[3] = {9,7,11};
+    bool hasReference = false;
+    double reference = 0;
+    int failed = 0;
+
+    for (int i=1 ; i < argc ; i++ ){
+        if ( argv[i][0] != '-' )
+            continue;
+        switch(argv[i][1]) {
+            case 'n':
+                n = atoi(argv[++i]);
+                break;
+            case 'm':
+                m =  atoi(argv[++i]);
+                break;
+            case 'x':
+                size[0] = atoi(argv[++i]);
+                break;
+            case 'y':
+                size[1] = atoi(argv[++i]);
+                break;
+            case 'z':
+                size[2] = atoi(argv[++i]);
+                break;
+            case 'c':
+                reference = atof(argv[++i]);
+                hasReference = true;
+                break;
+        }
+    }
+
+    if(n * m != parallel.world_size())
+    {
+        if(parallel.world_rank() == 0)
+        {
+            cerr<<"Latfield2d::testPlanFFT : wrong number of process, n*m must be equal to the number of processes"<<endl;
+            cerr<<"Latfield2d : Abort Process Requested"<<endl;
+        }
+        parallel.abortForce();
+    }
+
+    parallel.initialize(n,m);
+
+    Lattice lat(3,size,1);
+
+    failed += testTransforms(lat,"execute 3d");
+    if(parallel.grid_size()[1] == 1)
+    {
+        Lattice lat2d(2,size,1);
+        failed += testTransforms(lat2d,"execute 2d");
+    }
+    else COUT << "execute 2d : skipped, needs a n x 1 grid" << endl;
+    int size4d[4] = {size[0],5,size[2],5};
+    Lattice lat4d(4,size4d,1);
+    failed += testTransforms(lat4d,"execute 4d");
+    failed += testTransforms(lat,"execute 3d single precision transport",true);
+    if(parallel.grid_size()[1] == 1)
+    {
+        Lattice lat2d(2,size,1);
+        failed += testTransforms(lat2d,"execute 2d single precision transport",true);
+    }
+    failed += testTransforms(lat4d,"execute 4d single precision transport",true);
+    failed += testTransposed(lat);
+    failed += testConvolve(lat);
+    failed += testPaddedConvolve(lat);
+    fftw_r2r_kind kinds[3] = {FFTW_REDFT10,FFTW_RODFT10,FFTW_REDFT00};
+    failed += testRealToReal(lat,kinds,"execute R2R REDFT10 RODFT10 REDFT00");
+    fftw_r2r_kind kindsInverse[3] = {FFTW_RODFT00,FFTW_REDFT01,FFTW_REDFT10};
+    failed += testRealToReal(lat,kindsInverse,"execute R2R RODFT00 REDFT01 REDFT10");
+    failed += testDerivatives(lat);
+    failed += testPowerSpectrum(lat);
+    failed += testRandomField(lat,hasReference,reference);
+
+    COUT << failed << " test(s) failed" << endl;
+
+    return failed;
+}
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Runs testPlanFFT on the 1x1 grid and on every n x m process grid with n*m = NPROCS.
+#
+# The gaussian random modes must not depend on the process grid: the checksum printed on the 1x1 grid is given
+# to the runs on the other grids, which check it.
+#
+# usage: ./testPlanFFT.sh NPROCS [testPlanFFT options]
+# the MPI launcher can be changed with the MPIRUN variable (default: mpirun -np)
+
+NPROCS=$1
+MPIRUN=${MPIRUN:-"mpirun -np"}
+
+if [ -z "$NPROCS" ]; then
+    echo "usage: $0 NPROCS [testPlanFFT options]"
+    exit 1
+fi
+shift
+
+GRIDS="1x1"
+for (( n=1; n<=NPROCS; n++ )); do
+    if (( NPROCS % n != 0 )); then continue; fi
+    m=$(( NPROCS / n ))
+    if (( n * m > 1 )); then GRIDS="$GRIDS ${n}x${m}"; fi
+done
+
+failed=0
+checksum=""
+for grid in $GRIDS; do
+    n=${grid%x*}
+    m=${grid#*x}
+    echo "testPlanFFT on a ${n}x${m} grid"
+    if [ -z "$checksum" ]; then
+        output=$($MPIRUN $(( n * m )) ./testPlanFFT -n $n -m $m "$@") || failed=$(( failed + 1 ))
+        echo "$output"
+        checksum=$(echo "$output" | awk -F' : ' '/gaussianRandomModes checksum/ {print $2}')
+    else
+        $MPIRUN $(( n * m )) ./testPlanFFT -n $n -m $m -c $checksum "$@" || failed=$(( failed + 1 ))
+    fi
+done
+
+echo "$failed grid(s) failed"
+exit $failed
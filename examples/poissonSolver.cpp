@@ -56,7 +56,7 @@ int main(int argc, char **argv)
     latK.initializeRealFFT(lat, khalo);
 
     Site x(lat);
-    rKSite k(latK);
+    kSite k(latK);
 
     Field<Real> phi;
     phi.initialize(lat,comp);
@@ -102,12 +102,10 @@ int main(int argc, char **argv)
         phiK(k)=0.0;
         k.next();
     }
+    //the lattice wave numbers 2sin(pi n/N) are the ones of the finite difference laplacian used below
     for(;k.test();k.next())
     {
-        phiK(k)= rhoK(k) /
-        ( 2.0 *(cos(2.0*M_PI*k.coord(0)/BoxSize)
-                + cos(2.0*M_PI*k.coord(1)/BoxSize)
-                + cos(2.0*M_PI*k.coord(2)/BoxSize)-3.0)/res2 );
+        phiK(k)= rhoK(k) * (-res2 / k.k2Lattice());
     }
 
     planPhi.execute(FFT_BACKWARD);
@@ -59,8 +59,70 @@
 #include "LATfield2_particle_rk4.hpp"
 #include "particles_tools.hpp"
 #endif
+
+#ifndef PARTICLES_BATCH_SIZE
+#define PARTICLES_BATCH_SIZE 1024
+#endif
+
+//number of particles of the messages of the migration (see Particles::sendChunk)
+#ifndef PARTICLES_MIGRATION_CHUNK
+#define PARTICLES_MIGRATION_CHUNK 1024
+#endif
+
+/**
+ * \addtogroup prartClass
+ * @{
+ */
+
+/*! \struct partBatch
+ \brief a batch of consecutive particles in structure-of-arrays layout, passed to the batch kernels of Particles::updateVelBatch and Particles::moveParticlesBatch.
+
+ The positions and velocities of the batch are copied in separate arrays (pos[i][p], vel[i][p] for the component i of the particle p), so the kernels can process them with simple loops which compilers vectorize. The kernel modifies pos and vel, which are copied back to the particles after the kernel. The other individual properties are read or modified directly in parts (the AoS particles of the batch, whose pos and vel are those before the kernel). frac and coord are read only.
+ */
+template <typename part>
+struct partBatch{
+    //! number of particles in the batch (at most PARTICLES_BATCH_SIZE).
+    long size;
+    //! positions of the particles.
+    Real * pos[3];
+    //! velocities of the particles.
+    Real * vel[3];
+    //! offset of the particles with respect to the lowest corner of their cell, in units of the lattice resolution.
+    Real * frac[3];
+    //! local coordinates of the cell of the particles in the particle lattice (the index of the cell in a field lattice with halo h is sum_i (coord[i][p]+h)*jump(i)).
+    int * coord[3];
+    //! the particles of the batch.
+    part * parts;
+};
+
+/*! \struct partContext
+ \brief arguments shared by all the particles of an updateVel or moveParticles call, passed to the callable kernels.
+ */
+template <typename part_info>
+struct partContext{
+    //! variation of time.
+    double dtau;
+    //! resolution of the particle lattice.
+    double lat_resolution;
+    //! global properties of the particles.
+    part_info info;
+    //! array of pointer to the fields passed to updateVel or moveParticles.
+    Field<Real> ** fields;
+    //! sites of the fields, set to the cell of the particle.
+    Site * sites;
+    //! size of the array fields.
+    int nfields;
+    //! constants passed to updateVel or moveParticles.
+    double * params;
+    //! outputs of the particle, reduced according to reduce_type.
+    double * output;
+    //! size of the array output.
+    int noutput;
+};
+
+/**@}*/
+
 #include "move_function.hpp"
-#include "updateVel_function.hpp"
 
 #ifdef HDF5
 #include "LATfield2_particlesIO.h"
@@ -87,21 +149,80 @@ CREATE_MEMBER_DETECTOR_MAXI(mass)
 
 #define MAX_NUMBER 9223372036854775807
 
-using namespace LATfield2;
+#define MIGRATION_NEIGHBOUR 0
+#define MIGRATION_MULTIHOP  1
 
-template <typename part, typename part_info, typename part_dataType>
-class Particles;
-#include "projections.hpp"
+using namespace LATfield2;
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
+template <typename  part>
+struct  partRange{
+    typedef part * iterator;
+    part * first;
+    part * last;
+    partRange() : first(NULL), last(NULL){}
+    iterator begin() const {return first;}
+    iterator end() const {return last;}
+};
+
 template <typename  part>
 struct  partList{
+    typedef part * iterator;
     int size;
-    std::list<part>  parts;
-    std::list<part>  partsTemp;
-    partList() : size(0), parts(), partsTemp(){}
+    partRange<part>  parts;
+    partList() : size(0), parts(){}
+};
+
+//adapters of the function pointer kernels to the callable kernels of updateVel and moveParticles.
+template <typename part, typename part_info>
+struct updateVelPointer{
+    Real (*funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int);
+    updateVelPointer(Real (*f)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int)) : funct(f){}
+    Real operator()(part & p, double * frac, partContext<part_info> & c) const
+    {
+        return funct(c.dtau,c.lat_resolution,&p,frac,c.info,c.fields,c.sites,c.nfields,c.params,c.output,c.noutput);
+    }
+};
+
+template <typename part, typename part_info, typename mappingClass>
+struct updateVelPointerMC{
+    Real (*funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,mappingClass *,int,double*,double*,int);
+    mappingClass * mc;
+    updateVelPointerMC(Real (*f)(double,double,part*,double *,part_info,Field<Real> **,Site *,mappingClass *,int,double*,double*,int), mappingClass * m) : funct(f), mc(m){}
+    Real operator()(part & p, double * frac, partContext<part_info> & c) const
+    {
+        return funct(c.dtau,c.lat_resolution,&p,frac,c.info,c.fields,c.sites,mc,c.nfields,c.params,c.output,c.noutput);
+    }
+};
+
+template <typename part, typename part_info>
+struct movePointer{
+    void (*funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int);
+    movePointer(void (*f)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int)) : funct(f){}
+    void operator()(part & p, double * frac, partContext<part_info> & c) const
+    {
+        funct(c.dtau,c.lat_resolution,&p,frac,c.info,c.fields,c.sites,c.nfields,c.params,c.output,c.noutput);
+    }
+};
+
+template <typename part, typename part_info, typename mappingClass>
+struct movePointerMC{
+    void (*funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,mappingClass *,int,double*,double*,int);
+    mappingClass * mc;
+    movePointerMC(void (*f)(double,double,part*,double *,part_info,Field<Real> **,Site *,mappingClass *,int,double*,double*,int), mappingClass * m) : funct(f), mc(m){}
+    void operator()(part & p, double * frac, partContext<part_info> & c) const
+    {
+        funct(c.dtau,c.lat_resolution,&p,frac,c.info,c.fields,c.sites,mc,c.nfields,c.params,c.output,c.noutput);
+    }
 };
 #endif
+
+template <typename part, typename part_info, typename part_dataType>
+class Particles;
+#include "projections.hpp"
+//after projections.hpp: the gravity kicks use the CIC weights and gatherBatch.
+#include "updateVel_function.hpp"
+
 /**
  * \addtogroup prartClass
  * @{
@@ -127,14 +248,18 @@ void set_parts_typename(pInfo *info, string type_name)
 
  The Particles class is a template class. It take as template the 3 structure which describe a particle type. The class maps the particles to a Lattice object and manages the displacement of the particles.
 
+ The particles of a process are stored in a single contiguous array sorted by cell (site index of the particle lattice), with the offset of each cell in the array. The array and the offsets are rebuilt by a counting sort after each moveParticles. Particles added with addParticle_global (or loadHDF5) are kept aside and sorted in the array at the next traversal (sortParticles, field, updateVel, moveParticles, projections...). The Field returned by field() holds for each cell the number of particles (size) and the range of the cell in the array (parts.begin() and parts.end(), iterator: partList<part>::iterator, a pointer), so the particles can still be visited cell by cell; but particles cannot be added or removed through it.
+
  */
 template <typename part, typename part_info, typename part_dataType>
 class Particles
 {
 
 public:
+    //! Iterator over the particles of a cell: field()(x).parts.begin() to field()(x).parts.end(). Replaces std::list<part>::iterator.
+  typedef typename partList<part>::iterator iterator;
     //! Constructor.
-  Particles(){;};
+  Particles():migrationMode_(MIGRATION_NEIGHBOUR){for(int b=0;b<8;b++)recDone_[b] = false;};
     //! destructor.
   ~Particles();
 
@@ -240,6 +365,111 @@ public:
                        int * reduce_type=NULL,
                        int noutput=0);
 
+    /*!
+     updateVel with a callable kernel (functor or lambda), which the compiler can inline in the particle loop. The kernel is called for each particle as kernel(part & p, double * frac, partContext<part_info> & context) and returns the square of the velocity of the particle. The context holds the other arguments of the function pointer kernels (dtau, lattice resolution, global properties, fields and their sites, params, outputs).
+
+     \param kernel : callable kernel.
+     \param double dtau: variation of time.
+     \param Field<Real> ** fields=NULL: array of pointer to field class.
+     \param int nfields: size of the array fields.
+     \param double * params: pointer to an array of double, used to pass constants.
+     \param double * output: pointer to an array of double, reduced over the particles as in the function pointer version (context.output for each particle).
+     \param int * reduce_type: array with same size of the output array: SUM,MIN,MAX,SUM_LOCAL,MIN_LOCAL,MAX_LOCAL
+     \param int noutput: size of the arrays output and reduce_type.
+     \return the maximal velocity of the particles of this process.
+     */
+    template<typename Kernel>
+    Real updateVel(Kernel kernel,
+                   double dtau,
+                   Field<Real> ** fields=NULL,
+                   int nfields=0,
+                   double * params=NULL,
+                   double * output=NULL,
+                   int * reduce_type=NULL,
+                   int noutput=0);
+
+    /*!
+     moveParticles with a callable kernel (functor or lambda), which the compiler can inline in the particle loop. The kernel is called for each particle as kernel(part & p, double * frac, partContext<part_info> & context), see updateVel. Then the particles are moved to their new cell or process.
+     */
+    template<typename Kernel>
+    void moveParticles(Kernel kernel,
+                       double dtau,
+                       Field<Real> ** fields=NULL,
+                       int nfields=0,
+                       double * params=NULL,
+                       double * output=NULL,
+                       int * reduce_type=NULL,
+                       int noutput=0);
+
+    /*!
+     Fused kick and drift: for each particle, the kick kernel (updateVel) and then the drift kernel (moveParticles) are applied in a single traversal of the particles, then the particles are moved to their new cell or process. Equivalent to updateVel followed by moveParticles with the same fields, except that the fields and their sites are the ones before the drift for both kernels (as they are in updateVel). Both kernels write the outputs of the particle in the same array (context.output), which is reduced once per particle after the two kernels, and over the processes once per call, while the particles are migrating. For a kick-drift-kick leapfrog, the closing half kick of a step and the opening half kick of the next one are merged in the kick of this call.
+
+     \param kick : callable kick kernel, see updateVel(Kernel kernel, ...).
+     \param move : callable drift kernel, see moveParticles(Kernel kernel, ...).
+     \param double dtau_kick: variation of time of the kick (context.dtau of the kick kernel).
+     \param double dtau_drift: variation of time of the drift (context.dtau of the drift kernel).
+     \param Field<Real> ** fields=NULL: array of pointer to field class.
+     \param int nfields: size of the array fields.
+     \param double * params: pointer to an array of double, used to pass constants.
+     \param double * output: pointer to an array of double, reduced over the particles (see updateVel).
+     \param int * reduce_type: array with same size of the output array: SUM,MIN,MAX,SUM_LOCAL,MIN_LOCAL,MAX_LOCAL
+     \param int noutput: size of the arrays output and reduce_type.
+     \return the maximal velocity of the particles of this process after the kick.
+     */
+    template<typename KickKernel, typename MoveKernel>
+    Real updateVelMove(KickKernel kick,
+                       MoveKernel move,
+                       double dtau_kick,
+                       double dtau_drift,
+                       Field<Real> ** fields=NULL,
+                       int nfields=0,
+                       double * params=NULL,
+                       double * output=NULL,
+                       int * reduce_type=NULL,
+                       int noutput=0);
+
+    Real updateVelMove(Real (*updateVel_funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int),
+                       void (*move_funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int),
+                       double dtau_kick,
+                       double dtau_drift,
+                       Field<Real> ** fields=NULL,
+                       int nfields=0,
+                       double * params=NULL,
+                       double * output=NULL,
+                       int * reduce_type=NULL,
+                       int noutput=0);
+
+    /*!
+     Batch version of updateVel: the kernel is called once per batch of (up to PARTICLES_BATCH_SIZE) consecutive particles, with their positions and velocities in structure-of-arrays layout (see partBatch), instead of once per particle.
+
+     \param *batch_funct : kernel, arguments: dtau, lattice resolution, batch, global properties, fields, nfields, params.
+     \param double dtau: variation of time.
+     \param Field<Real> ** fields=NULL: array of pointer to field class.
+     \param int nfields: size of the array fields.
+     \param double * params: pointer to an array of double, used to pass constants.
+     \return the maximal velocity of the particles of this process.
+     */
+    Real updateVelBatch(void (*batch_funct)(double,double,partBatch<part>*,part_info,Field<Real> **,int,double*),
+                        double dtau,
+                        Field<Real> ** fields=NULL,
+                        int nfields=0,
+                        double * params=NULL);
+
+    /*!
+     Batch version of moveParticles: the kernel is called once per batch of (up to PARTICLES_BATCH_SIZE) consecutive particles, with their positions and velocities in structure-of-arrays layout (see partBatch). Then the particles are moved to their new cell or process as in moveParticles.
+
+     \param *batch_funct : kernel, arguments: dtau, lattice resolution, batch, global properties, fields, nfields, params.
+     \param double dtau: variation of time.
+     \param Field<Real> ** fields=NULL: array of pointer to field class.
+     \param int nfields: size of the array fields.
+     \param double * params: pointer to an array of double, used to pass constants.
+     */
+    void moveParticlesBatch(void (*batch_funct)(double,double,partBatch<part>*,part_info,Field<Real> **,int,double*),
+                            double dtau,
+                            Field<Real> ** fields=NULL,
+                            int nfields=0,
+                            double * params=NULL);
+
 #ifdef HDF5
     /*!
      Method to save all particles of this instance using HDF5 data format.
@@ -283,10 +513,14 @@ public:
      */
     Lattice & lattice(){return lat_part_;};
     /*!
-     Method to get the Field in which the particles lists are strored.
+     Method to get the Field in which the particles lists are strored. Each site holds the number of particles in the cell and their range in the particle array. The pending particles (addParticle_global) are sorted first.
      \return field_part_
      */
-    Field<partList<part> > & field(){return field_part_;};
+    Field<partList<part> > & field(){sortParticles(); return field_part_;};
+    /*!
+     Method to sort the particles added with addParticle_global into the particle array. Called by every method which traverse the particles, it does nothing if no particle has been added since the last sort.
+     */
+    void sortParticles();
     /*!
      Method to get the resolution of a cell, in units used for the particle positions.
      \return field_part_
@@ -310,6 +544,19 @@ public:
      */
     size_t mass_offset(){return mass_offset_;};
 
+    /*!
+     Method to set how moveParticles handles the particles which have moved by more than one process (of the process grid) during a step.
+     MIGRATION_NEIGHBOUR (default): the particles can only move to the 8 neighbour processes, the others stay in their old cell and an error is printed.
+     MIGRATION_MULTIHOP: the particles are forwarded from neighbour to neighbour until they reach their process (any displacement), at the cost of a global reduction per forwarding round (and one per move).
+     \param int mode: MIGRATION_NEIGHBOUR or MIGRATION_MULTIHOP.
+     */
+    void setMigrationMode(int mode){migrationMode_ = mode;};
+    /*!
+     Method to get the migration mode (see setMigrationMode).
+     \return migrationMode_
+     */
+    int migrationMode(){return migrationMode_;};
+
     long numParticles(){
       long temp = numParticles_;
       parallel.sum(temp);
@@ -329,6 +576,24 @@ protected:
 
   Field<partList<part>> field_part_;
 
+  std::vector<part> parts_;
+  std::vector<part> partsBuffer_;
+  std::vector<long> cellOffset_;
+  std::vector<long> partCell_;
+  std::vector<part> addedParts_;
+  std::vector<long> addedCells_;
+
+  std::vector<Real> batchReal_;
+  std::vector<int> batchCoord_;
+
+  std::vector<part> moveBuffer_[8];
+  std::list<std::vector<part> > sentChunks_;
+  std::list<std::vector<part> > freeChunks_;
+  std::vector<part> recBuffer_[8];
+  bool recDone_[8];
+  std::vector<MPI_Request> exchangeRequest_;
+  int migrationMode_;
+
   int mass_type_;
   size_t mass_offset_;
 
@@ -338,6 +603,27 @@ protected:
     ioserver_file io_file_;
 #endif
 
+  long localCell(part & pcl);
+  void loadBatch(partBatch<part> & batch, long first, long & cell);
+  void storeBatch(partBatch<part> & batch);
+  void initOutput(double * output, int * reduce_type, int noutput);
+  void accumulateOutput(double * output, double * output_temp, int * reduce_type, int noutput);
+  void reduceOutput(double * output, int * reduce_type, int noutput);
+  long moveDestination(part & pcl, long cell, part & partOld);
+  void rebuildCells();
+  void countCells();
+  void sortCells();
+  int routeBuffer(part & pcl);
+  int neighbourRank(int b);
+  int oppositeBuffer(int b);
+  void pushMoving(int b, part & pcl);
+  void sendChunk(int b);
+  void receiveChunks(bool wait);
+  void startExchange();
+  void finishExchange();
+  void finishMigration();
+  void migrateParticles();
+
 };
 
 template <typename part, typename part_info, typename part_dataType>
@@ -369,6 +655,11 @@ void Particles<part,part_info,part_dataType>::initialize(part_info part_global_i
   field_part_.initialize(lat_part_);
   field_part_.alloc();
 
+  parts_.clear();
+  addedParts_.clear();
+  addedCells_.clear();
+  cellOffset_.assign(lat_part_.sitesLocal()+1,0);
+
   //lat_resolution_ = lat_resolution;
   lat_resolution_ = get_lattice_resolution(lat_part->size(),boxSize);
   for(int i = 0;i < 3;i++)boxSize_[i]=boxSize[i];
@@ -473,11 +764,85 @@ void Particles<part,part_info,part_dataType>::getPartCoordLocal(part pcl,int * c
     coord[1]-=lat_part_.coordSkip()[1];
 }
 
+template <typename part, typename part_info, typename part_dataType>
+long Particles<part,part_info,part_dataType>::localCell(part & pcl)
+{
+    int coord[3];
+    getPartCoordLocal(pcl,coord);
+    return coord[0] + coord[1]*lat_part_.jump(1) + coord[2]*lat_part_.jump(2);
+}
+
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::sortParticles()
+{
+    if(addedParts_.size()==0)return;
+
+    long cells = lat_part_.sitesLocal();
+
+    partCell_.resize(parts_.size());
+    for(long c=0;c<cells;c++)
+        for(long p=cellOffset_[c];p<cellOffset_[c+1];p++)partCell_[p]=c;
+
+    rebuildCells();
+}
+
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::rebuildCells()
+{
+    countCells();
+    sortCells();
+}
+
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::countCells()
+{
+    long n = parts_.size();
+
+    cellOffset_.assign(lat_part_.sitesLocal()+1,0);
+    for(long p=0;p<n;p++)if(partCell_[p]>=0)cellOffset_[partCell_[p]+1]++;
+}
+
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::sortCells()
+{
+    //counting sort of parts_ (cell in partCell_, -1 if the particle has left the process, counted by countCells) and of the added particles.
+    long cells = lat_part_.sitesLocal();
+    long n = parts_.size();
+    long nAdded = addedParts_.size();
+    long p;
+    long c;
+
+    for(p=0;p<nAdded;p++)cellOffset_[addedCells_[p]+1]++;
+    for(c=0;c<cells;c++)cellOffset_[c+1]+=cellOffset_[c];
+
+    std::vector<long> next(cellOffset_.begin(),cellOffset_.end()-1);
+    partsBuffer_.resize(cellOffset_[cells]);
+    for(p=0;p<n;p++)if(partCell_[p]>=0)partsBuffer_[next[partCell_[p]]++]=parts_[p];
+    for(p=0;p<nAdded;p++)partsBuffer_[next[addedCells_[p]]++]=addedParts_[p];
+
+    //the old array is kept as the buffer of the next sort
+    parts_.swap(partsBuffer_);
+    partCell_.clear();
+    addedParts_.clear();
+    addedCells_.clear();
+    numParticles_ = parts_.size();
+
+    part * first = parts_.empty() ? NULL : &parts_[0];
+    for(c=0;c<cells;c++)
+    {
+        field_part_(c).size = cellOffset_[c+1]-cellOffset_[c];
+        field_part_(c).parts.first = first + cellOffset_[c];
+        field_part_(c).parts.last = first + cellOffset_[c+1];
+    }
+}
+
 template <typename part, typename part_info, typename part_dataType>
 void Particles<part,part_info,part_dataType>::coutPart(long ID)
 {
     Site x(lat_part_);
-    typename std::list<part>::iterator it;
+    typename partList<part>::iterator it;
+
+    sortParticles();
 
     for(x.first();x.test();x.next())
     {
@@ -504,8 +869,8 @@ bool Particles<part,part_info,part_dataType>::addParticle_global(part newPart)
 
   if(x.setCoord(coord))
     {
-      field_part_(x).size += 1;
-      field_part_(x).parts.push_back(newPart);
+      addedParts_.push_back(newPart);
+      addedCells_.push_back(x.index());
       numParticles_ +=1;
       return true;
     }
@@ -518,29 +883,24 @@ bool Particles<part,part_info,part_dataType>::addParticle_global(part newPart)
 template <typename part, typename part_info, typename part_dataType>
 void Particles<part,part_info,part_dataType>::cout_particle_velocity_stats(const string text)
 {
-  Site  xPart(lat_part_);
-  typename std::list<part>::iterator it;
+  typename std::vector<part>::iterator it;
 
   double min[3] = {1000000000,1000000000,1000000000};
   double max[3] = {-1000000000,-1000000000,-1000000000};
   long count = 0;
   double mean[3] = {0.0,0.0,0.0};
 
-  for(xPart.first() ; xPart.test(); xPart.next())
+  sortParticles();
+
+  for(it=parts_.begin(); it != parts_.end(); ++it)
   {
-    if(field_part_(xPart).size!=0)
+    for(int i=0;i<3;i++)
     {
-      for (it=(field_part_)(xPart).parts.begin(); it != (field_part_)(xPart).parts.end(); ++it)
-      {
-        for(int i=0;i<3;i++)
-        {
-          mean[i] += (*it).vel[i];
-          if((*it).vel[i]<min[i])min[i] = (*it).vel[i];
-          if((*it).vel[i]>max[i])max[i] = (*it).vel[i];
-        }
-        count++;
-      }
+      mean[i] += (*it).vel[i];
+      if((*it).vel[i]<min[i])min[i] = (*it).vel[i];
+      if((*it).vel[i]>max[i])max[i] = (*it).vel[i];
     }
+    count++;
   }
 
   parallel.min(min,3);
@@ -561,21 +921,16 @@ void Particles<part,part_info,part_dataType>::cout_particle_velocity_stats(const
 template <typename part, typename part_info, typename part_dataType>
 void Particles<part,part_info,part_dataType>::prepare_RK()
 {
-  Site  xPart(lat_part_);
-  typename std::list<part>::iterator it;
+  typename std::vector<part>::iterator it;
 
-  for(xPart.first() ; xPart.test(); xPart.next())
+  sortParticles();
+
+  for(it=parts_.begin(); it != parts_.end(); ++it)
   {
-    if(field_part_(xPart).size!=0)
+    for (int l=0; l<3; l++)
     {
-      for (it=(field_part_)(xPart).parts.begin(); it != (field_part_)(xPart).parts.end(); ++it)
-      {
-        for (int l=0; l<3; l++)
-        {
-          (*it).pos_in[l] = (*it).pos[l];
-          (*it).pos_out[l] = (*it).pos[l];
-        }
-      }
+      (*it).pos_in[l] = (*it).pos[l];
+      (*it).pos_out[l] = (*it).pos[l];
     }
   }
 
@@ -593,136 +948,8 @@ Real Particles<part,part_info,part_dataType>::updateVel(Real (*updateVel_funct)(
                int * reduce_type,
                int noutput)
 {
-  Site  xPart(lat_part_);
-  Site * sites = NULL;
-
-  if(nfields!=0)
-  {
-      sites = new LATfield2::Site[nfields];
-      for(int i = 0;i<nfields;i++)
-      {
-          sites[i].initialize(fields[i]->lattice());
-          sites[i].first();
-      }
-  }
-
-  typename std::list<part>::iterator it;
-  double frac[3];
-  Real x0;
-  Real maxvel = 0.;
-  Real v2;
-
-  //cout<<"arg"<<endl;
-
-
-  double * output_temp;
-  output_temp =new double[noutput];
-
-  if(noutput>0)for(int i=0;i<noutput;i++)
-  {
-      //COUT<<reduce_type[i]<<endl;
-      if(reduce_type[i] & (SUM | SUM_LOCAL))
-      {
-          output[i]=0;
-
-          //COUT<< "sum" <<endl;
-      }
-      else if(reduce_type[i] & (MIN | MIN_LOCAL))
-      {
-          output[i]=9223372036854775807;
-          //COUT<<"min"<<endl;
-      }
-      else if(reduce_type[i] & (MAX | MAX_LOCAL))
-      {
-          output[i]=-9223372036854775807;
-          //COUT<<"max"<<endl;
-      }
-  }
-
-  for(xPart.first() ; xPart.test(); xPart.next())
-  {
-      if(field_part_(xPart).size!=0)
-      {
-          for (it=(field_part_)(xPart).parts.begin(); it != (field_part_)(xPart).parts.end(); ++it)
-          {
-              //old fashion uncompatible with runge kutta, frac is in [0,1], but shoud be allowed to be in [-1,2]
-              //to take into account displacements during the runge kutta steps....
-              //when using runge kutta, one have to use the proper projections methods...!!!
-              //what a crap:
-              // new method still compatible with previous methodology.... but! frac is still the offeset of the particles
-              // in respect to the lowest corner of the cell where the particle is. (but in the runge kutta step, it is the cells
-              // where the particle is at the beginning of the runge kutta (NOT THE ONE OF THE RK SUBSTEP!!!!))
-
-              //for (int l=0; l<3; l++)
-              //    frac[l] = modf( (*it).pos[l] / lat_resolution_, &x0);
-              for (int l=0; l<3; l++)
-              {
-                frac[l] =  (*it).pos[l]/lat_resolution_ - xPart.coord(l);
-              }
-
-
-
-              v2 = updateVel_funct(dtau,
-                         lat_resolution_,
-                         &(*it),
-                         frac,
-                         part_global_info_,
-                         fields,
-                         sites,
-                         mc,
-                         nfields,
-                         params,
-                         output_temp,
-                         noutput);
-
-              if(v2>maxvel)maxvel=v2;
-
-              if(noutput>0)for(int i=0;i<noutput;i++)
-              {
-                  //COUT<<reduce_type[i]<<endl;
-                  if(reduce_type[i] & (SUM | SUM_LOCAL))
-                  {
-                      output[i]+=output_temp[i];
-                  }
-                  else if(reduce_type[i] & (MIN | MIN_LOCAL))
-                  {
-                      if(output[i]>output_temp[i])output[i]=output_temp[i];
-                  }
-                  else if(reduce_type[i] & (MAX | MAX_LOCAL))
-                  {
-                      if(output[i]<output_temp[i])output[i]=output_temp[i];
-                  }
-              }
-
-
-
-          }
-      }
-      for(int i=0;i<nfields;i++) sites[i].next();
-  }
-
-  if(noutput>0)for(int i=0;i<noutput;i++)
-  {
-      //COUT<<reduce_type[i]<<endl;
-      if(reduce_type[i] & SUM)
-      {
-          parallel.sum(output[i]);
-      }
-      else if(reduce_type[i] & MIN)
-      {
-          parallel.min(output[i]);
-      }
-      else if(reduce_type[i] & MAX)
-      {
-          parallel.max(output[i]);
-      }
-  }
-
-  delete[] output_temp;
-  if(nfields>0) delete[] sites;
-
-  return sqrt(maxvel);
-
+    updateVelPointerMC<part,part_info,mappingClass> kernel(updateVel_funct,mc);
+    return updateVel(kernel,dtau,fields,nfields,params,output,reduce_type,noutput);
 }
 
 template <typename part, typename part_info, typename part_dataType>
@@ -735,10 +962,27 @@ Real Particles<part,part_info,part_dataType>::updateVel(Real (*updateVel_funct)(
                int * reduce_type,
                int noutput)
 {
+    updateVelPointer<part,part_info> kernel(updateVel_funct);
+    return updateVel(kernel,dtau,fields,nfields,params,output,reduce_type,noutput);
+}
+
+template <typename part, typename part_info, typename part_dataType>
+template <typename Kernel>
+Real Particles<part,part_info,part_dataType>::updateVel(Kernel kernel,
+               double dtau,
+               Field<Real> ** fields,
+               int nfields,
+               double * params,
+               double * output,
+               int * reduce_type,
+               int noutput)
+{
 
     Site  xPart(lat_part_);
     Site * sites = NULL;
 
+    sortParticles();
+
     if(nfields!=0)
     {
         sites = new LATfield2::Site[nfields];
@@ -749,116 +993,56 @@ Real Particles<part,part_info,part_dataType>::updateVel(Real (*updateVel_funct)(
         }
     }
 
-    typename std::list<part>::iterator it;
     double frac[3];
-    Real x0;
     Real maxvel = 0.;
     Real v2;
-
-    //cout<<"arg"<<endl;
-
+    long c,p;
 
     double * output_temp;
     output_temp =new double[noutput];
 
-    if(noutput>0)for(int i=0;i<noutput;i++)
-    {
-        //COUT<<reduce_type[i]<<endl;
-        if(reduce_type[i] & (SUM | SUM_LOCAL))
-        {
-            output[i]=0;
+    partContext<part_info> context;
+    context.dtau = dtau;
+    context.lat_resolution = lat_resolution_;
+    context.info = part_global_info_;
+    context.fields = fields;
+    context.sites = sites;
+    context.nfields = nfields;
+    context.params = params;
+    context.output = output_temp;
+    context.noutput = noutput;
 
-            //COUT<< "sum" <<endl;
-        }
-        else if(reduce_type[i] & (MIN | MIN_LOCAL))
-        {
-            output[i]=9223372036854775807;
-            //COUT<<"min"<<endl;
-        }
-        else if(reduce_type[i] & (MAX | MAX_LOCAL))
-        {
-            output[i]=-9223372036854775807;
-            //COUT<<"max"<<endl;
-        }
-    }
+    initOutput(output,reduce_type,noutput);
 
-    for(xPart.first() ; xPart.test(); xPart.next())
+    for(xPart.first(),c=0 ; xPart.test(); xPart.next(),c++)
     {
-        if(field_part_(xPart).size!=0)
+        for(p=cellOffset_[c];p<cellOffset_[c+1];p++)
         {
-            for (it=(field_part_)(xPart).parts.begin(); it != (field_part_)(xPart).parts.end(); ++it)
+            //old fashion uncompatible with runge kutta, frac is in [0,1], but shoud be allowed to be in [-1,2]
+            //to take into account displacements during the runge kutta steps....
+            //when using runge kutta, one have to use the proper projections methods...!!!
+            //what a crap:
+            // new method still compatible with previous methodology.... but! frac is still the offeset of the particles
+            // in respect to the lowest corner of the cell where the particle is. (but in the runge kutta step, it is the cells
+            // where the particle is at the beginning of the runge kutta (NOT THE ONE OF THE RK SUBSTEP!!!!))
+
+            //for (int l=0; l<3; l++)
+            //    frac[l] = modf( parts_[p].pos[l] / lat_resolution_, &x0);
+            for (int l=0; l<3; l++)
             {
-                //old fashion uncompatible with runge kutta, frac is in [0,1], but shoud be allowed to be in [-1,2]
-                //to take into account displacements during the runge kutta steps....
-                //when using runge kutta, one have to use the proper projections methods...!!!
-                //what a crap:
-                // new method still compatible with previous methodology.... but! frac is still the offeset of the particles
-                // in respect to the lowest corner of the cell where the particle is. (but in the runge kutta step, it is the cells
-                // where the particle is at the beginning of the runge kutta (NOT THE ONE OF THE RK SUBSTEP!!!!))
-
-                //for (int l=0; l<3; l++)
-                //    frac[l] = modf( (*it).pos[l] / lat_resolution_, &x0);
-                for (int l=0; l<3; l++)
-                {
-                  frac[l] =  (*it).pos[l]/lat_resolution_ - xPart.coord(l);
-                }
-
-
-
-                v2 = updateVel_funct(dtau,
-                           lat_resolution_,
-                           &(*it),
-                           frac,
-                           part_global_info_,
-                           fields,
-                           sites,
-                           nfields,
-                           params,
-                           output_temp,
-                           noutput);
-
-                if(v2>maxvel)maxvel=v2;
-
-                if(noutput>0)for(int i=0;i<noutput;i++)
-                {
-                    //COUT<<reduce_type[i]<<endl;
-                    if(reduce_type[i] & (SUM | SUM_LOCAL))
-                    {
-                        output[i]+=output_temp[i];
-                    }
-                    else if(reduce_type[i] & (MIN | MIN_LOCAL))
-                    {
-                        if(output[i]>output_temp[i])output[i]=output_temp[i];
-                    }
-                    else if(reduce_type[i] & (MAX | MAX_LOCAL))
-                    {
-                        if(output[i]<output_temp[i])output[i]=output_temp[i];
-                    }
-                }
+              frac[l] =  parts_[p].pos[l]/lat_resolution_ - xPart.coord(l);
+            }
 
+            v2 = kernel(parts_[p],frac,context);
 
+            if(v2>maxvel)maxvel=v2;
 
-            }
+            accumulateOutput(output,output_temp,reduce_type,noutput);
         }
         for(int i=0;i<nfields;i++) sites[i].next();
     }
 
-    if(noutput>0)for(int i=0;i<noutput;i++)
-    {
-        //COUT<<reduce_type[i]<<endl;
-        if(reduce_type[i] & SUM)
-        {
-            parallel.sum(output[i]);
-        }
-        else if(reduce_type[i] & MIN)
-        {
-            parallel.min(output[i]);
-        }
-        else if(reduce_type[i] & MAX)
-        {
-            parallel.max(output[i]);
-        }
-    }
+    reduceOutput(output,reduce_type,noutput);
 
     delete[] output_temp;
     if(nfields>0) delete[] sites;
@@ -880,907 +1064,8 @@ void Particles<part,part_info,part_dataType>::moveParticles( void (*move_funct)(
                    int * reduce_type,
                    int noutput)
 {
-
-  #ifdef DEBUG_MOVE
-      cout<<parallel.rank()<<"; move start"<<endl;
-  #endif
-
-      parallel.barrier();
-
-      LATfield2::Site x(lat_part_);
-      LATfield2::Site xNew(lat_part_);
-      LATfield2::Site * sites = NULL;
-
-      typename std::list<part>::iterator it,itTemp;
-      //Real b[3];
-      double frac[3];
-      Real x0;
-      int localCoord[3];
-      int newLocalCoord[3];
-
-      bool flag[4];
-
-
-      part **sendBuffer;
-      part **recBuffer;
-
-
-      sendBuffer = new part*[6];
-      recBuffer = new part*[6];
-
-      part * pTemp;
-
-      long p;
-      long bufferSize[6];
-      long bufferSizeRec[6];
-
-      std::list<part>  part_moveProc[8];
-
-
-      if(nfields!=0)
-      {
-          sites = new LATfield2::Site[nfields];
-          for(int i = 0;i<nfields;i++)
-          {
-              sites[i].initialize(fields[i]->lattice());
-              sites[i].first();
-          }
-      }
-
-
-      double * output_temp;
-      output_temp =new double[noutput];
-
-      if(noutput>0)for(int i=0;i<noutput;i++)
-      {
-          //COUT<<reduce_type[i]<<endl;
-          if(reduce_type[i] & (SUM | SUM_LOCAL))
-          {
-              output[i]=0;
-
-              //COUT<< "sum" <<endl;
-          }
-          else if(reduce_type[i] & (MIN | MIN_LOCAL))
-          {
-              output[i]=MAX_NUMBER;
-              //COUT<<"min"<<endl;
-          }
-          else if(reduce_type[i] & (MAX | MAX_LOCAL))
-          {
-              output[i]=-MAX_NUMBER;
-              //COUT<<"max"<<endl;
-          }
-      }
-
-      part partTest;
-
-      for(x.first();x.test();x.next())
-      {
-          if(field_part_(x).size!=0)
-          {
-              for(int i=0;i<3;i++)localCoord[i] = x.coordLocal(i);
-
-              for(it=field_part_(x).parts.begin(); it != field_part_(x).parts.end();)
-              {
-                  itTemp = it;
-                  ++it;
-
-                  partTest = (*itTemp);
-
-  #ifdef DEBUG_CONTROLSPEED
-                  double sizeTest[3]={boxSize_[0], boxSize_[1]/parallel.grid_size()[1], boxSize_[2]/parallel.grid_size()[0]};
-                  for(int l=0;l<3;l++)
-                  {
-                      if(dtau*(*itTemp).vel[l] > sizeTest[l])
-                      {
-                          cout<<"velocity too big, abort request"<<endl;
-                          cout<<"dtau * vel: "<< dtau*(*itTemp).vel[0]*lat_resolution_<<" , "<<dtau*(*itTemp).vel[1]*lat_resolution_<<" , "<<dtau*(*itTemp).vel[2]*lat_resolution_<< " , dtau: "<<dtau<<endl;
-                          parallel.abortForce();
-                      }
-                  }
-  #endif
-                  for (int l=0; l<3; l++)
-                      frac[l] = modf( (*itTemp).pos[l] / lat_resolution_, &x0);
-
-
-                  move_funct(dtau,
-                             lat_resolution_,
-                             &(*itTemp),
-                             frac,
-                             part_global_info_,
-                             fields,
-                             sites,
-                             mc,
-                             nfields,
-                             params,
-                             output_temp,
-                             noutput);
-
-
-                  if(noutput>0)for(int i=0;i<noutput;i++)
-                  {
-                      //COUT<<reduce_type[i]<<endl;
-                      if(reduce_type[i] & (SUM | SUM_LOCAL))
-                      {
-                          output[i]+=output_temp[i];
-                      }
-                      else if(reduce_type[i] & (MIN | MIN_LOCAL))
-                      {
-                          if(output[i]>output_temp[i])output[i]=output_temp[i];
-                      }
-                      else if(reduce_type[i] & (MAX | MAX_LOCAL))
-                      {
-                          if(output[i]<output_temp[i])output[i]=output_temp[i];
-                      }
-                  }
-
-
-
-                  int partRanks[2];
-                  int thisRanks[2];
-                  getPartNewProcess((*itTemp),partRanks);
-                  thisRanks[0] = parallel.grid_rank()[0];
-                  thisRanks[1] = parallel.grid_rank()[1];
-
-                  for(int i=0;i<3;i++)
-                  {
-                      if((*itTemp).pos[i]<0)itTemp->pos[i] +=  boxSize_[i];
-                      if((*itTemp).pos[i]>=boxSize_[i])itTemp->pos[i]-=boxSize_[i];
-                  }
-
-
-                  if(partRanks[0]==thisRanks[0] && partRanks[1]==thisRanks[1])
-                  {
-                      int r[3];
-                      getPartCoord(*itTemp, r);
-                      if(!xNew.setCoord(r))
-                      {
-                          cout<<"arg"<< *itTemp <<" ; "<< partRanks[0]<< " , " << thisRanks[0] <<endl;
-                      }
-
-                      getPartCoordLocal(*itTemp, newLocalCoord);
-                      if(localCoord[0]!=newLocalCoord[0] || localCoord[1]!=newLocalCoord[1] || localCoord[2]!=newLocalCoord[2] )
-                      {
-                          xNew.setCoordLocal(newLocalCoord);
-                          field_part_(xNew).partsTemp.splice(field_part_(xNew).partsTemp.end(),field_part_(x).parts,itTemp);
-                          field_part_(xNew).size += 1;
-                          field_part_(x).size -= 1;
-                      }
-
-                  }
-                  else if(partRanks[1]==thisRanks[1]-1)
-                  {
-                      if(partRanks[0]==thisRanks[0])
-                      {
-                          part_moveProc[2].splice(part_moveProc[2].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else if(partRanks[0]==thisRanks[0]-1)
-                      {
-                          part_moveProc[0].splice(part_moveProc[0].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else if(partRanks[0]==thisRanks[0]+1)
-                      {
-                          part_moveProc[1].splice(part_moveProc[1].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else
-                      {
-                          cout<< "particle : "<<(*itTemp).ID<<" have move to far away (more than 1 proc)."<<endl;
-                          cout<< "particle position: "<< (*itTemp) <<endl;
-                          cout<< "particle position old: "<< partTest <<endl;
-                          cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                      }
-                  }
-                  else if(partRanks[1]==thisRanks[1]+1)
-                  {
-                      if(partRanks[0]==thisRanks[0])
-                      {
-                          part_moveProc[5].splice(part_moveProc[5].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else if(partRanks[0]==thisRanks[0]-1)
-                      {
-                          part_moveProc[3].splice(part_moveProc[3].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else if(partRanks[0]==thisRanks[0]+1)
-                      {
-                          part_moveProc[4].splice(part_moveProc[4].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else
-                      {
-                          cout<< "particle : "<<(*itTemp).ID<<" have move to far away (more than 1 proc)."<<endl;
-                          cout<< "particle position: "<< (*itTemp) <<endl;
-                          cout<< "particle position old: "<< partTest <<endl;
-                          cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                      }
-                  }
-                  else if(partRanks[1]==thisRanks[1])
-                  {
-                      if(partRanks[0]==thisRanks[0]-1)
-                      {
-                          part_moveProc[6].splice(part_moveProc[6].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else if(partRanks[0]==thisRanks[0]+1)
-                      {
-                          part_moveProc[7].splice(part_moveProc[7].end(),field_part_(x).parts,itTemp);
-                          field_part_(x).size -= 1;
-                      }
-                      else
-                      {
-                          cout<< "particle : "<<(*itTemp).ID<<" has moved too much (more than 1 proc)."<<endl;
-                          cout<< "particle position: "<< (*itTemp) <<endl;
-                          cout<< "particle position old: "<< partTest <<endl;
-                          cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                      }
-                  }
-                  else
-                  {
-                      cout<< "particle : "<<(*itTemp).ID<<" has moved too much (more than 1 proc)."<<endl;
-                      cout<< "particle position: "<< (*itTemp) <<endl;
-                      cout<< "particle position old: "<< partTest <<endl;
-                      cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                  }
-
-              }
-          }
-
-          if(nfields!=0) for(int i=0;i<nfields;i++) sites[i].next();
-
-      }
-
-
-
-
-      for(x.first();x.test();x.next())if((field_part_)(x).size!=0)(field_part_)(x).parts.splice((field_part_)(x).parts.end(), (field_part_)(x).partsTemp );
-
-
-       //cout<<"starting first dim"<<endl;
-
-
-      if(noutput>0)for(int i=0;i<noutput;i++)
-      {
-          //COUT<<reduce_type[i]<<endl;
-          if(reduce_type[i] & SUM)
-          {
-              parallel.sum(output[i]);
-          }
-          else if(reduce_type[i] & MIN)
-          {
-              parallel.min(output[i]);
-          }
-          else if(reduce_type[i] & MAX)
-          {
-              parallel.max(output[i]);
-          }
-      }
-      delete[] output_temp;
-      /* this is wrong: sites gets deleted again later */
-      //    if(nfields!=0) {
-      //      if(sites) delete[] sites;
-      //      else { std::cerr << "WTF, nfields != 0, but sites is not initialized.\n"; exit(-1); }
-      //    }
-
-      //remove the number of part...
-      for(int i=0;i<8;i++)
-      {
-          numParticles_ -=  part_moveProc[i].size();
-      }
-
-
-
-      ////////////////////////////////////////////////////////////////
-      //First send Y direction
-
-
-      //cout<<"okokok  move firs statrt pack"<<endl;
-      //pack data
-      for(int i=0;i<6;i++)
-      {
-          bufferSize[i]=part_moveProc[i].size();
-          if( bufferSize[i]!=0 )
-          {
-              sendBuffer[i] = new part[bufferSize[i]];
-              for(it=part_moveProc[i].begin(),p=0; it != part_moveProc[i].end();++it,p++)sendBuffer[i][p] = (*it);
-              part_moveProc[i].clear();
-          }
-
-      }
-
-
-       //cout<<"okokok  move firs statrt comm"<<endl;
-
-      if(parallel.grid_rank()[1]%2==0)
-  	{
-  		////////////////////////////////
-  		///send/rec to/from higher rank
-  		////////////////////////////////
-
-          if(parallel.grid_rank()[1]!=parallel.grid_size()[1]-1)/// si pas le dernier alors envoie au +1
-  	    {
-              //send
-              parallel.send_dim1( &bufferSize[3], 3, parallel.grid_rank()[1]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]+1);
-                  }
-              }
-
-              //recieve
-              parallel.receive_dim1( &bufferSizeRec[3], 3, parallel.grid_rank()[1]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]+1);
-
-                  }
-              }
-  	    }
-
-          //////////////////////////////
-          ///send/rec to/from lower rank
-          //////////////////////////////
-
-          if(parallel.grid_rank()[1] != 0)     /// si pas le premier alors envoie au -1
-  	    {
-              //send
-              parallel.send_dim1( bufferSize, 3, parallel.grid_rank()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_rank()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]-1);
-
-                  }
-              }
-
-  	    }
-          else if(parallel.grid_size()[1]%2==0)  /// si pair et = 0 alors envoi au dernier
-  	    {
-              //send
-              parallel.send_dim1( bufferSize, 3, parallel.grid_size()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_size()[1]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_size()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[1]-1);
-
-                  }
-              }
-  	    }
-
-
-  	}
-      else
-      {
-          //////////////////////////////
-          ///rec/send from/to lower rank
-          //////////////////////////////
-
-          //tous recois du -1 puis envois au -1
-
-          //recieve
-          parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_rank()[1]-1);
-          for(int i=0;i<3;i++)
-          {
-              if(bufferSizeRec[i]!=0)
-              {
-                  recBuffer[i]=new part[bufferSizeRec[i]];
-                  parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]-1);
-              }
-          }
-          //send
-          parallel.send_dim1( bufferSize, 3, parallel.grid_rank()[1]-1);
-          for(int i=0;i<3;i++)
-          {
-              if(bufferSize[i]!=0)
-              {
-                  parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]-1);
-              }
-          }
-
-
-          //////////////////////////////
-          //rec/send from/to higher rank
-          /////////////////////////////
-
-          if(parallel.grid_rank()[1]!=parallel.grid_size()[1]-1)//si pas dernier alors recoi du +1
-          {
-
-              //recieve
-              parallel.receive_dim1( &bufferSizeRec[3], 3, parallel.grid_rank()[1]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]+1);
-                  }
-              }
-
-              //send
-              parallel.send_dim1( &bufferSize[3], 3, parallel.grid_rank()[1]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]+1);
-                  }
-              }
-
-
-          }
-          else // si dernier alors pair et recoi du premier
-          {
-
-              //recieve
-              parallel.receive_dim1( &bufferSizeRec[3], 3, 0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , 0);
-
-                  }
-              }
-
-              //send
-              parallel.send_dim1( &bufferSize[3], 3,0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , 0);
-                  }
-              }
-          }
-      }
-
-  	//if unpair :
-  	/////////////
-
-      if(parallel.grid_size()[1]%2!=0)
-      {
-          if(parallel.grid_rank()[1]==0)
-          {
-              //send
-              parallel.send_dim1( bufferSize, 3, parallel.grid_size()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_size()[1]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_size()[1]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[1]-1);
-                  }
-              }
-          }
-          if(parallel.grid_rank()[1]==parallel.grid_size()[1]-1)
-          {
-
-              //recieve
-              parallel.receive_dim1( &bufferSizeRec[3], 3, 0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , 0);
-                  }
-              }
-
-              //send
-              parallel.send_dim1( &bufferSize[3], 3,0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim1( sendBuffer[i], bufferSize[i] , 0);
-                  }
-              }
-          }
-      }
-
-
-      //cout<<"okokok  move firs statrt unpack"<<endl;
-
-      //unpack local list: rec[2] and rec[5]
-
-      //add partnum
-      numParticles_ += bufferSizeRec[2] + bufferSizeRec[5];
-      for(int i=0;i<bufferSizeRec[2];i++)
-      {
-          this->getPartCoordLocal(recBuffer[2][i],newLocalCoord);
-          x.setCoordLocal(newLocalCoord);
-
-          field_part_(x).size += 1;
-          field_part_(x).parts.push_back(recBuffer[2][i]);
-  #ifdef DEBUG_MOVE
-          int verif;
-          verif=addParticle_global(recBuffer[2][i]);
-
-          if(verif != 1)
-          {
-              cout<<parallel.rank()<<"; MOVEBUF2 partID "<< recBuffer[2][i].ID<<" is not in the correct proc. " << recBuffer[2][i]<<endl;
-          }
-  #endif
-      }
-
-      //cout<<"buffer size: "<<bufferSizeRec[5]<<endl;
-      //if(bufferSizeRec[5]!=0)
-      for(int i=0;i<bufferSizeRec[5];i++)
-      {
-          //cout<<i<<endl;
-
-          this->getPartCoordLocal(recBuffer[5][i],newLocalCoord);
-
-          x.setCoordLocal(newLocalCoord);
-
-          field_part_(x).size += 1;
-          field_part_(x).parts.push_back(recBuffer[5][i]);
-  #ifdef DEBUG_MOVE
-          int verif;
-          verif=addParticle_global(recBuffer[5][i]);
-
-          if(verif != 1)
-          {
-              cout<<parallel.rank()<<"; MOVEBUF5 partID "<< recBuffer[5][i].ID<<" is not in the correct proc. "<<recBuffer[5][i] <<endl;
-          }
-  #endif
-
-      }
-
-
-  #ifdef DEBUG_MOVE
-      cout<<parallel.rank()<<"; move : end of buffer 2 and 5 copy"<<endl;
-  #endif
-
-      //cout<<"unpack done  "<<endl;
-
-      pTemp = sendBuffer[0];
-      sendBuffer[0]=recBuffer[0];
-      recBuffer[0]=pTemp;
-      if(bufferSize[0]!=0)delete[] recBuffer[0];
-      bufferSize[0]=bufferSizeRec[0];
-
-      pTemp = sendBuffer[1];
-      sendBuffer[1]=recBuffer[3];
-      recBuffer[3]=pTemp;
-      if(bufferSize[1]!=0)delete[] recBuffer[3];
-      bufferSize[1]=bufferSizeRec[3];
-
-      pTemp = sendBuffer[3];
-      sendBuffer[3]=recBuffer[1];
-      recBuffer[1]=pTemp;
-      if(bufferSize[3]!=0)delete[] recBuffer[1];
-      bufferSize[3]=bufferSizeRec[1];
-
-      pTemp = sendBuffer[4];
-      sendBuffer[4]=recBuffer[4];
-      recBuffer[4]=pTemp;
-      if(bufferSize[4]!=0)delete[] recBuffer[4];
-      bufferSize[4]=bufferSizeRec[4];
-
-      if(bufferSize[2]!=0)delete[] sendBuffer[2];
-      if(bufferSizeRec[2]!=0)delete[] recBuffer[2];
-      if(bufferSize[5]!=0)delete[] sendBuffer[5];
-      if(bufferSizeRec[5]!=0)delete[] recBuffer[5];
-
-
-
-      //pack list 6 & 7 into buffer 2 & 5
-
-      bufferSize[2]=part_moveProc[6].size();
-      if( bufferSize[2]!=0 )
-      {
-          sendBuffer[2] = new part[bufferSize[2]];
-          for(it=part_moveProc[6].begin(),p=0; it != part_moveProc[6].end();++it,p++)sendBuffer[2][p]=(*it);
-          part_moveProc[6].clear();
-      }
-
-
-      bufferSize[5]=part_moveProc[7].size();
-      if( bufferSize[5]!=0 )
-      {
-          sendBuffer[5] = new part[bufferSize[5]];
-          for(it=part_moveProc[7].begin(),p=0; it != part_moveProc[7].end();++it,p++)sendBuffer[5][p]=(*it);
-          part_moveProc[7].clear();
-      }
-     //send z
-
-      if(parallel.grid_rank()[0]%2==0)
-  	{
-  		////////////////////////////////
-  		///send/rec to/from higher rank
-  		////////////////////////////////
-
-  		if(parallel.grid_rank()[0]!=parallel.grid_size()[0]-1)/// si pas le dernier alors envoie au +1
-  		{
-              //send
-              parallel.send_dim0( &bufferSize[3], 3, parallel.grid_rank()[0]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]+1);
-                  }
-
-              }
-
-              //recieve
-              parallel.receive_dim0( &bufferSizeRec[3], 3, parallel.grid_rank()[0]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]+1);
-
-                  }
-              }
-  		}
-
-  		//////////////////////////////
-  		///send/rec to/from lower rank
-  		//////////////////////////////
-
-  		if(parallel.grid_rank()[0] != 0)     /// si pas le premier alors envoie au -1
-  		{
-              //send
-              parallel.send_dim0( bufferSize, 3, parallel.grid_rank()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_rank()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                     recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]-1);
-
-                  }
-              }
-
-  		}
-  		else if(parallel.grid_size()[0]%2==0)  /// si pair et = 0 alors envoi au dernier
-  		{
-              //send
-              parallel.send_dim0( bufferSize, 3, parallel.grid_size()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_size()[0]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_size()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[0]-1);
-
-                  }
-              }
-  		}
-
-  	}
-  	else
-  	{
-  		//////////////////////////////
-  		///rec/send from/to lower rank
-  		//////////////////////////////
-
-  		//tous recois du -1 puis envois au -1
-
-          //recieve
-          parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_rank()[0]-1);
-          for(int i=0;i<3;i++)
-          {
-              if(bufferSizeRec[i]!=0)
-              {
-                  recBuffer[i]=new part[bufferSizeRec[i]];
-                  parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]-1);
-
-              }
-          }
-          //send
-  		parallel.send_dim0( bufferSize, 3, parallel.grid_rank()[0]-1);
-          for(int i=0;i<3;i++)
-          {
-              if(bufferSize[i]!=0)
-              {
-                  parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]-1);
-              }
-  		}
-
-
-  		//////////////////////////////
-  		//rec/send from/to higher rank
-  		/////////////////////////////
-
-          if(parallel.grid_rank()[0]!=parallel.grid_size()[0]-1)//si pas dernier alors recoi du +1
-  		{
-
-              //recieve
-              parallel.receive_dim0( &bufferSizeRec[3], 3, parallel.grid_rank()[0]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]+1);
-
-                  }
-              }
-
-              //send
-              parallel.send_dim0( &bufferSize[3], 3, parallel.grid_rank()[0]+1);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]+1);
-                  }
-              }
-
-  		}
-  		else // si dernier alors pair et recoi du premier
-  		{
-
-              //recieve
-              parallel.receive_dim0( &bufferSizeRec[3], 3, 0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , 0);
-                  }
-              }
-
-              //send
-              parallel.send_dim0( &bufferSize[3], 3,0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , 0);
-                  }
-  			}
-  		}
-
-  	}
-
-  	//if unpair :
-  	/////////////
-
-  	if(parallel.grid_size()[0]%2!=0)
-  	{
-  		if(parallel.grid_rank()[0]==0)
-  		{
-              //send
-              parallel.send_dim0( bufferSize, 3, parallel.grid_size()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_size()[0]-1);
-                  }
-              }
-              //recieve
-              parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_size()[0]-1);
-              for(int i=0;i<3;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[0]-1);
-
-                  }
-              }
-  		}
-  		if(parallel.grid_rank()[0]==parallel.grid_size()[0]-1)
-  		{
-
-              //recieve
-              parallel.receive_dim0( &bufferSizeRec[3], 3, 0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSizeRec[i]!=0)
-                  {
-                      recBuffer[i]=new part[bufferSizeRec[i]];
-                      parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , 0);
-
-                  }
-              }
-
-              //send
-              parallel.send_dim0( &bufferSize[3], 3,0);
-              for(int i=3;i<6;i++)
-              {
-                  if(bufferSize[i]!=0)
-                  {
-                      parallel.send_dim0( sendBuffer[i], bufferSize[i] , 0);
-                  }
-              }
-  		}
-  	}
-
-      //unpack data
-  	for(int i=0;i<6;i++)
-      {
-  	    numParticles_ += bufferSizeRec[i] ;
-      }
-
-      for(int p=0;p<6;p++)
-      {
-          for(int i=0;i<bufferSizeRec[p];i++)
-          {
-              this->getPartCoordLocal(recBuffer[p][i],newLocalCoord);
-
-              x.setCoordLocal(newLocalCoord);
-
-              field_part_(x).size += 1;
-              field_part_(x).parts.push_back(recBuffer[p][i]);
-          }
-      }
-
-
-      for(int i=0;i<6;i++)
-      {
-          if(bufferSize[i]!=0)delete[] sendBuffer[i];
-          if(bufferSizeRec[i]!=0)delete[] recBuffer[i];
-      }
-      delete[] sendBuffer;
-      delete[] recBuffer;
-
-    if(nfields!=0 && sites) { delete[] sites; sites = NULL; };
+    movePointerMC<part,part_info,mappingClass> kernel(move_funct,mc);
+    moveParticles(kernel,dtau,fields,nfields,params,output,reduce_type,noutput);
 }
 
 template <typename part, typename part_info, typename part_dataType>
@@ -1793,7 +1078,21 @@ void Particles<part,part_info,part_dataType>::moveParticles( void (*move_funct)(
                                                             int * reduce_type,
                                                             int noutput)
 {
+    movePointer<part,part_info> kernel(move_funct);
+    moveParticles(kernel,dtau,fields,nfields,params,output,reduce_type,noutput);
+}
 
+template <typename part, typename part_info, typename part_dataType>
+template <typename Kernel>
+void Particles<part,part_info,part_dataType>::moveParticles( Kernel kernel,
+                                                            double dtau,
+                                                            Field<Real> ** fields,
+                                                            int nfields,
+                                                            double * params,
+                                                            double * output,
+                                                            int * reduce_type,
+                                                            int noutput)
+{
 
 #ifdef DEBUG_MOVE
     cout<<parallel.rank()<<"; move start"<<endl;
@@ -1801,34 +1100,14 @@ void Particles<part,part_info,part_dataType>::moveParticles( void (*move_funct)(
 
     parallel.barrier();
 
+    sortParticles();
+
     LATfield2::Site x(lat_part_);
-    LATfield2::Site xNew(lat_part_);
     LATfield2::Site * sites = NULL;
 
-    typename std::list<part>::iterator it,itTemp;
-    //Real b[3];
     double frac[3];
     Real x0;
-    int localCoord[3];
-    int newLocalCoord[3];
-
-    bool flag[4];
-
-
-    part **sendBuffer;
-    part **recBuffer;
-
-
-    sendBuffer = new part*[6];
-    recBuffer = new part*[6];
-
-    part * pTemp;
-
-    long p;
-    long bufferSize[6];
-    long bufferSizeRec[6];
-
-    std::list<part>  part_moveProc[8];
+    long c,p;
 
 
     if(nfields!=0)
@@ -1845,860 +1124,711 @@ void Particles<part,part_info,part_dataType>::moveParticles( void (*move_funct)(
     double * output_temp;
     output_temp =new double[noutput];
 
-    if(noutput>0)for(int i=0;i<noutput;i++)
-    {
-        //COUT<<reduce_type[i]<<endl;
-        if(reduce_type[i] & (SUM | SUM_LOCAL))
-        {
-            output[i]=0;
+    partContext<part_info> context;
+    context.dtau = dtau;
+    context.lat_resolution = lat_resolution_;
+    context.info = part_global_info_;
+    context.fields = fields;
+    context.sites = sites;
+    context.nfields = nfields;
+    context.params = params;
+    context.output = output_temp;
+    context.noutput = noutput;
 
-            //COUT<< "sum" <<endl;
-        }
-        else if(reduce_type[i] & (MIN | MIN_LOCAL))
-        {
-            output[i]=MAX_NUMBER;
-            //COUT<<"min"<<endl;
-        }
-        else if(reduce_type[i] & (MAX | MAX_LOCAL))
-        {
-            output[i]=-MAX_NUMBER;
-            //COUT<<"max"<<endl;
-        }
-    }
+    initOutput(output,reduce_type,noutput);
 
     part partTest;
 
-    for(x.first();x.test();x.next())
+    partCell_.resize(parts_.size());
+
+    for(x.first(),c=0;x.test();x.next(),c++)
     {
-        if(field_part_(x).size!=0)
+        for(p=cellOffset_[c];p<cellOffset_[c+1];p++)
         {
-            for(int i=0;i<3;i++)localCoord[i] = x.coordLocal(i);
-
-            for(it=field_part_(x).parts.begin(); it != field_part_(x).parts.end();)
-            {
-                itTemp = it;
-                ++it;
-
-                partTest = (*itTemp);
+            partTest = parts_[p];
 
 #ifdef DEBUG_CONTROLSPEED
-                double sizeTest[3]={boxSize_[0], boxSize_[1]/parallel.grid_size()[1], boxSize_[2]/parallel.grid_size()[0]};
-                for(int l=0;l<3;l++)
+            double sizeTest[3]={boxSize_[0], boxSize_[1]/parallel.grid_size()[1], boxSize_[2]/parallel.grid_size()[0]};
+            for(int l=0;l<3;l++)
+            {
+                if(dtau*parts_[p].vel[l] > sizeTest[l])
                 {
-                    if(dtau*(*itTemp).vel[l] > sizeTest[l])
-                    {
-                        cout<<"velocity too big, abort request"<<endl;
-                        cout<<"dtau * vel: "<< dtau*(*itTemp).vel[0]*lat_resolution_<<" , "<<dtau*(*itTemp).vel[1]*lat_resolution_<<" , "<<dtau*(*itTemp).vel[2]*lat_resolution_<< " , dtau: "<<dtau<<endl;
-                        parallel.abortForce();
-                    }
+                    cout<<"velocity too big, abort request"<<endl;
+                    cout<<"dtau * vel: "<< dtau*parts_[p].vel[0]*lat_resolution_<<" , "<<dtau*parts_[p].vel[1]*lat_resolution_<<" , "<<dtau*parts_[p].vel[2]*lat_resolution_<< " , dtau: "<<dtau<<endl;
+                    parallel.abortForce();
                 }
+            }
 #endif
-                for (int l=0; l<3; l++)
-                    frac[l] = modf( (*itTemp).pos[l] / lat_resolution_, &x0);
+            for (int l=0; l<3; l++)
+                frac[l] = modf( parts_[p].pos[l] / lat_resolution_, &x0);
 
+            kernel(parts_[p],frac,context);
 
-                move_funct(dtau,
-                           lat_resolution_,
-                           &(*itTemp),
-                           frac,
-                           part_global_info_,
-                           fields,
-                           sites,
-                           nfields,
-                           params,
-                           output_temp,
-                           noutput);
+            accumulateOutput(output,output_temp,reduce_type,noutput);
 
+            partCell_[p] = moveDestination(parts_[p],c,partTest);
+        }
 
-                if(noutput>0)for(int i=0;i<noutput;i++)
-                {
-                    //COUT<<reduce_type[i]<<endl;
-                    if(reduce_type[i] & (SUM | SUM_LOCAL))
-                    {
-                        output[i]+=output_temp[i];
-                    }
-                    else if(reduce_type[i] & (MIN | MIN_LOCAL))
-                    {
-                        if(output[i]>output_temp[i])output[i]=output_temp[i];
-                    }
-                    else if(reduce_type[i] & (MAX | MAX_LOCAL))
-                    {
-                        if(output[i]<output_temp[i])output[i]=output_temp[i];
-                    }
-                }
+        if(nfields!=0) for(int i=0;i<nfields;i++) sites[i].next();
 
+    }
 
 
-                int partRanks[2];
-                int thisRanks[2];
-                getPartNewProcess((*itTemp),partRanks);
-                thisRanks[0] = parallel.grid_rank()[0];
-                thisRanks[1] = parallel.grid_rank()[1];
+    reduceOutput(output,reduce_type,noutput);
+    delete[] output_temp;
 
-                for(int i=0;i<3;i++)
-                {
-                    if((*itTemp).pos[i]<0)itTemp->pos[i] +=  boxSize_[i];
-                    if((*itTemp).pos[i]>=boxSize_[i])itTemp->pos[i]-=boxSize_[i];
-                }
+    migrateParticles();
 
+  if(nfields!=0 && sites) { delete[] sites; sites = NULL; };
 
-                if(partRanks[0]==thisRanks[0] && partRanks[1]==thisRanks[1])
-                {
-                    int r[3];
-                    getPartCoord(*itTemp, r);
-                    if(!xNew.setCoord(r))
-                    {
-                        cout<<"arg"<< *itTemp <<" ; "<< partRanks[0]<< " , " << thisRanks[0] <<endl;
-                    }
-
-                    getPartCoordLocal(*itTemp, newLocalCoord);
-                    if(localCoord[0]!=newLocalCoord[0] || localCoord[1]!=newLocalCoord[1] || localCoord[2]!=newLocalCoord[2] )
-                    {
-                        xNew.setCoordLocal(newLocalCoord);
-                        field_part_(xNew).partsTemp.splice(field_part_(xNew).partsTemp.end(),field_part_(x).parts,itTemp);
-                        field_part_(xNew).size += 1;
-                        field_part_(x).size -= 1;
-                    }
+}
 
-                }
-                else if(partRanks[1]==thisRanks[1]-1)
-                {
-                    if(partRanks[0]==thisRanks[0])
-                    {
-                        part_moveProc[2].splice(part_moveProc[2].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else if(partRanks[0]==thisRanks[0]-1)
-                    {
-                        part_moveProc[0].splice(part_moveProc[0].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else if(partRanks[0]==thisRanks[0]+1)
-                    {
-                        part_moveProc[1].splice(part_moveProc[1].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else
-                    {
-                        cout<< "particle : "<<(*itTemp).ID<<" have move to far away (more than 1 proc)."<<endl;
-                        cout<< "particle position: "<< (*itTemp) <<endl;
-                        cout<< "particle position old: "<< partTest <<endl;
-                        cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                    }
-                }
-                else if(partRanks[1]==thisRanks[1]+1)
-                {
-                    if(partRanks[0]==thisRanks[0])
-                    {
-                        part_moveProc[5].splice(part_moveProc[5].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else if(partRanks[0]==thisRanks[0]-1)
-                    {
-                        part_moveProc[3].splice(part_moveProc[3].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else if(partRanks[0]==thisRanks[0]+1)
-                    {
-                        part_moveProc[4].splice(part_moveProc[4].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else
-                    {
-                        cout<< "particle : "<<(*itTemp).ID<<" have move to far away (more than 1 proc)."<<endl;
-                        cout<< "particle position: "<< (*itTemp) <<endl;
-                        cout<< "particle position old: "<< partTest <<endl;
-                        cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                    }
-                }
-                else if(partRanks[1]==thisRanks[1])
-                {
-                    if(partRanks[0]==thisRanks[0]-1)
-                    {
-                        part_moveProc[6].splice(part_moveProc[6].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else if(partRanks[0]==thisRanks[0]+1)
-                    {
-                        part_moveProc[7].splice(part_moveProc[7].end(),field_part_(x).parts,itTemp);
-                        field_part_(x).size -= 1;
-                    }
-                    else
-                    {
-                        cout<< "particle : "<<(*itTemp).ID<<" has moved too much (more than 1 proc)."<<endl;
-                        cout<< "particle position: "<< (*itTemp) <<endl;
-                        cout<< "particle position old: "<< partTest <<endl;
-                        cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                    }
-                }
-                else
-                {
-                    cout<< "particle : "<<(*itTemp).ID<<" has moved too much (more than 1 proc)."<<endl;
-                    cout<< "particle position: "<< (*itTemp) <<endl;
-                    cout<< "particle position old: "<< partTest <<endl;
-                    cout<<"particle : "<<(*itTemp).ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
-                }
+template <typename part, typename part_info, typename part_dataType>
+Real Particles<part,part_info,part_dataType>::updateVelMove(Real (*updateVel_funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int),
+                                                            void (*move_funct)(double,double,part*,double *,part_info,Field<Real> **,Site *,int,double*,double*,int),
+                                                            double dtau_kick,
+                                                            double dtau_drift,
+                                                            Field<Real> ** fields,
+                                                            int nfields,
+                                                            double * params,
+                                                            double * output,
+                                                            int * reduce_type,
+                                                            int noutput)
+{
+    updateVelPointer<part,part_info> kick(updateVel_funct);
+    movePointer<part,part_info> move(move_funct);
+    return updateVelMove(kick,move,dtau_kick,dtau_drift,fields,nfields,params,output,reduce_type,noutput);
+}
 
-            }
-        }
+template <typename part, typename part_info, typename part_dataType>
+template <typename KickKernel, typename MoveKernel>
+Real Particles<part,part_info,part_dataType>::updateVelMove(KickKernel kick,
+                                                            MoveKernel move,
+                                                            double dtau_kick,
+                                                            double dtau_drift,
+                                                            Field<Real> ** fields,
+                                                            int nfields,
+                                                            double * params,
+                                                            double * output,
+                                                            int * reduce_type,
+                                                            int noutput)
+{
+    parallel.barrier();
 
-        if(nfields!=0) for(int i=0;i<nfields;i++) sites[i].next();
+    sortParticles();
 
-    }
+    LATfield2::Site x(lat_part_);
+    LATfield2::Site * sites = NULL;
 
+    double frac[3];
+    Real maxvel = 0.;
+    Real v2;
+    long c,p;
 
+    if(nfields!=0)
+    {
+        sites = new LATfield2::Site[nfields];
+        for(int i = 0;i<nfields;i++)
+        {
+            sites[i].initialize(fields[i]->lattice());
+            sites[i].first();
+        }
+    }
 
+    double * output_temp;
+    output_temp =new double[noutput];
 
-    for(x.first();x.test();x.next())if((field_part_)(x).size!=0)(field_part_)(x).parts.splice((field_part_)(x).parts.end(), (field_part_)(x).partsTemp );
+    partContext<part_info> context;
+    context.dtau = dtau_kick;
+    context.lat_resolution = lat_resolution_;
+    context.info = part_global_info_;
+    context.fields = fields;
+    context.sites = sites;
+    context.nfields = nfields;
+    context.params = params;
+    context.output = output_temp;
+    context.noutput = noutput;
 
+    initOutput(output,reduce_type,noutput);
 
-     //cout<<"starting first dim"<<endl;
+    part partTest;
 
+    partCell_.resize(parts_.size());
 
-    if(noutput>0)for(int i=0;i<noutput;i++)
+    for(x.first(),c=0;x.test();x.next(),c++)
     {
-        //COUT<<reduce_type[i]<<endl;
-        if(reduce_type[i] & SUM)
-        {
-            parallel.sum(output[i]);
-        }
-        else if(reduce_type[i] & MIN)
+        for(p=cellOffset_[c];p<cellOffset_[c+1];p++)
         {
-            parallel.min(output[i]);
-        }
-        else if(reduce_type[i] & MAX)
-        {
-            parallel.max(output[i]);
+            for (int l=0; l<3; l++)
+                frac[l] = parts_[p].pos[l]/lat_resolution_ - x.coord(l);
+
+            context.dtau = dtau_kick;
+            v2 = kick(parts_[p],frac,context);
+            if(v2>maxvel)maxvel=v2;
+
+            partTest = parts_[p];
+
+            context.dtau = dtau_drift;
+            move(parts_[p],frac,context);
+
+            accumulateOutput(output,output_temp,reduce_type,noutput);
+
+            partCell_[p] = moveDestination(parts_[p],c,partTest);
         }
+
+        if(nfields!=0) for(int i=0;i<nfields;i++) sites[i].next();
     }
+
+    //the particles leaving the process are sent while the outputs are reduced
+    startExchange();
+
+    reduceOutput(output,reduce_type,noutput);
     delete[] output_temp;
-    /* this is wrong: sites gets deleted again later */
-    //    if(nfields!=0) {
-    //      if(sites) delete[] sites;
-    //      else { std::cerr << "WTF, nfields != 0, but sites is not initialized.\n"; exit(-1); }
-    //    }
-
-    //remove the number of part...
-    for(int i=0;i<8;i++)
-    {
-        numParticles_ -=  part_moveProc[i].size();
-    }
+    if(nfields!=0) delete[] sites;
 
+    finishMigration();
 
+    return sqrt(maxvel);
+}
 
-    ////////////////////////////////////////////////////////////////
-    //First send Y direction
+template <typename part, typename part_info, typename part_dataType>
+Real Particles<part,part_info,part_dataType>::updateVelBatch(void (*batch_funct)(double,double,partBatch<part>*,part_info,Field<Real> **,int,double*),
+                                                             double dtau,
+                                                             Field<Real> ** fields,
+                                                             int nfields,
+                                                             double * params)
+{
+    partBatch<part> batch;
+    long first,p;
+    long cell = 0;
+    Real maxvel = 0.;
+    Real v2;
 
+    sortParticles();
 
-    //cout<<"okokok  move firs statrt pack"<<endl;
-    //pack data
-    for(int i=0;i<6;i++)
+    for(first=0;first<(long)parts_.size();first+=batch.size)
     {
-        bufferSize[i]=part_moveProc[i].size();
-        if( bufferSize[i]!=0 )
+        loadBatch(batch,first,cell);
+
+        batch_funct(dtau,
+                    lat_resolution_,
+                    &batch,
+                    part_global_info_,
+                    fields,
+                    nfields,
+                    params);
+
+        for(p=0;p<batch.size;p++)
         {
-            sendBuffer[i] = new part[bufferSize[i]];
-            for(it=part_moveProc[i].begin(),p=0; it != part_moveProc[i].end();++it,p++)sendBuffer[i][p] = (*it);
-            part_moveProc[i].clear();
+            v2 = batch.vel[0][p]*batch.vel[0][p] + batch.vel[1][p]*batch.vel[1][p] + batch.vel[2][p]*batch.vel[2][p];
+            if(v2>maxvel)maxvel=v2;
         }
 
+        storeBatch(batch);
     }
 
+    return sqrt(maxvel);
+}
 
-     //cout<<"okokok  move firs statrt comm"<<endl;
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::moveParticlesBatch(void (*batch_funct)(double,double,partBatch<part>*,part_info,Field<Real> **,int,double*),
+                                                                 double dtau,
+                                                                 Field<Real> ** fields,
+                                                                 int nfields,
+                                                                 double * params)
+{
+    partBatch<part> batch;
+    long first,p;
+    long cell = 0;
+    part partOld;
 
-    if(parallel.grid_rank()[1]%2==0)
-	{
-		////////////////////////////////
-		///send/rec to/from higher rank
-		////////////////////////////////
+    parallel.barrier();
 
-        if(parallel.grid_rank()[1]!=parallel.grid_size()[1]-1)/// si pas le dernier alors envoie au +1
-	    {
-            //send
-            parallel.send_dim1( &bufferSize[3], 3, parallel.grid_rank()[1]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]+1);
-                }
-            }
+    sortParticles();
 
-            //recieve
-            parallel.receive_dim1( &bufferSizeRec[3], 3, parallel.grid_rank()[1]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]+1);
+    partCell_.resize(parts_.size());
 
-                }
-            }
-	    }
+    for(first=0;first<(long)parts_.size();first+=batch.size)
+    {
+        loadBatch(batch,first,cell);
 
-        //////////////////////////////
-        ///send/rec to/from lower rank
-        //////////////////////////////
+        batch_funct(dtau,
+                    lat_resolution_,
+                    &batch,
+                    part_global_info_,
+                    fields,
+                    nfields,
+                    params);
 
-        if(parallel.grid_rank()[1] != 0)     /// si pas le premier alors envoie au -1
-	    {
-            //send
-            parallel.send_dim1( bufferSize, 3, parallel.grid_rank()[1]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]-1);
-                }
-            }
-            //recieve
-            parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_rank()[1]-1);
+        for(p=0;p<batch.size;p++)
+        {
+            partOld = batch.parts[p];
             for(int i=0;i<3;i++)
             {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]-1);
-
-                }
+                batch.parts[p].pos[i] = batch.pos[i][p];
+                batch.parts[p].vel[i] = batch.vel[i][p];
             }
+            partCell_[first+p] = moveDestination(batch.parts[p],
+                                                 batch.coord[0][p] + batch.coord[1][p]*lat_part_.jump(1) + batch.coord[2][p]*lat_part_.jump(2),
+                                                 partOld);
+        }
+    }
 
-	    }
-        else if(parallel.grid_size()[1]%2==0)  /// si pair et = 0 alors envoi au dernier
-	    {
-            //send
-            parallel.send_dim1( bufferSize, 3, parallel.grid_size()[1]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_size()[1]-1);
-                }
-            }
-            //recieve
-            parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_size()[1]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[1]-1);
+    migrateParticles();
+}
 
-                }
-            }
-	    }
+/*
+ Copies the particles first to first+PARTICLES_BATCH_SIZE (at most) of parts_ in the batch arrays. cell is the cell of the
+ particle first, it is updated to the cell of the last particle of the batch.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::loadBatch(partBatch<part> & batch, long first, long & cell)
+{
+    long n = parts_.size() - first;
+    long p;
+    int coord[3];
+    Real coordGlobal[3];
 
+    if(n>PARTICLES_BATCH_SIZE)n = PARTICLES_BATCH_SIZE;
 
-	}
-    else
+    batchReal_.resize(9*PARTICLES_BATCH_SIZE);
+    batchCoord_.resize(3*PARTICLES_BATCH_SIZE);
+    for(int i=0;i<3;i++)
     {
-        //////////////////////////////
-        ///rec/send from/to lower rank
-        //////////////////////////////
-
-        //tous recois du -1 puis envois au -1
+        batch.pos[i] = &batchReal_[i*PARTICLES_BATCH_SIZE];
+        batch.vel[i] = &batchReal_[(3+i)*PARTICLES_BATCH_SIZE];
+        batch.frac[i] = &batchReal_[(6+i)*PARTICLES_BATCH_SIZE];
+        batch.coord[i] = &batchCoord_[i*PARTICLES_BATCH_SIZE];
+    }
+    batch.size = n;
+    batch.parts = &parts_[first];
 
-        //recieve
-        parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_rank()[1]-1);
-        for(int i=0;i<3;i++)
+    cell--;
+    for(p=0;p<n;p++)
+    {
+        if(first+p>=cellOffset_[cell+1])
         {
-            if(bufferSizeRec[i]!=0)
-            {
-                recBuffer[i]=new part[bufferSizeRec[i]];
-                parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]-1);
-            }
+            do cell++; while(first+p>=cellOffset_[cell+1]);
+            coord[0] = cell % lat_part_.sizeLocal(0);
+            coord[1] = (cell / lat_part_.sizeLocal(0)) % lat_part_.sizeLocal(1);
+            coord[2] = cell / lat_part_.jump(2);
+            coordGlobal[0] = coord[0];
+            coordGlobal[1] = coord[1] + lat_part_.coordSkip()[1];
+            coordGlobal[2] = coord[2] + lat_part_.coordSkip()[0];
         }
-        //send
-        parallel.send_dim1( bufferSize, 3, parallel.grid_rank()[1]-1);
         for(int i=0;i<3;i++)
         {
-            if(bufferSize[i]!=0)
-            {
-                parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]-1);
-            }
+            batch.pos[i][p] = batch.parts[p].pos[i];
+            batch.vel[i][p] = batch.parts[p].vel[i];
+            batch.frac[i][p] = batch.parts[p].pos[i]/lat_resolution_ - coordGlobal[i];
+            batch.coord[i][p] = coord[i];
         }
+    }
+}
 
-
-        //////////////////////////////
-        //rec/send from/to higher rank
-        /////////////////////////////
-
-        if(parallel.grid_rank()[1]!=parallel.grid_size()[1]-1)//si pas dernier alors recoi du +1
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::storeBatch(partBatch<part> & batch)
+{
+    for(long p=0;p<batch.size;p++)
+    {
+        for(int i=0;i<3;i++)
         {
+            batch.parts[p].pos[i] = batch.pos[i][p];
+            batch.parts[p].vel[i] = batch.vel[i][p];
+        }
+    }
+}
 
-            //recieve
-            parallel.receive_dim1( &bufferSizeRec[3], 3, parallel.grid_rank()[1]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[1]+1);
-                }
-            }
-
-            //send
-            parallel.send_dim1( &bufferSize[3], 3, parallel.grid_rank()[1]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[1]+1);
-                }
-            }
-
-
+/*
+ Outputs of updateVel, moveParticles and updateVelMove: initOutput sets each output to the neutral element of its
+ reduction, accumulateOutput reduces the outputs of one particle (output_temp) into output and reduceOutput reduces the
+ outputs over the processes (SUM, MIN and MAX, the _LOCAL reductions stay local).
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::initOutput(double * output, int * reduce_type, int noutput)
+{
+    for(int i=0;i<noutput;i++)
+    {
+        if(reduce_type[i] & (SUM | SUM_LOCAL))
+        {
+            output[i]=0;
         }
-        else // si dernier alors pair et recoi du premier
+        else if(reduce_type[i] & (MIN | MIN_LOCAL))
         {
-
-            //recieve
-            parallel.receive_dim1( &bufferSizeRec[3], 3, 0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , 0);
-
-                }
-            }
-
-            //send
-            parallel.send_dim1( &bufferSize[3], 3,0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , 0);
-                }
-            }
+            output[i]=MAX_NUMBER;
+        }
+        else if(reduce_type[i] & (MAX | MAX_LOCAL))
+        {
+            output[i]=-MAX_NUMBER;
         }
     }
+}
 
-	//if unpair :
-	/////////////
-
-    if(parallel.grid_size()[1]%2!=0)
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::accumulateOutput(double * output, double * output_temp, int * reduce_type, int noutput)
+{
+    for(int i=0;i<noutput;i++)
     {
-        if(parallel.grid_rank()[1]==0)
+        if(reduce_type[i] & (SUM | SUM_LOCAL))
         {
-            //send
-            parallel.send_dim1( bufferSize, 3, parallel.grid_size()[1]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , parallel.grid_size()[1]-1);
-                }
-            }
-            //recieve
-            parallel.receive_dim1( bufferSizeRec, 3, parallel.grid_size()[1]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[1]-1);
-                }
-            }
+            output[i]+=output_temp[i];
         }
-        if(parallel.grid_rank()[1]==parallel.grid_size()[1]-1)
+        else if(reduce_type[i] & (MIN | MIN_LOCAL))
         {
-
-            //recieve
-            parallel.receive_dim1( &bufferSizeRec[3], 3, 0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim1( recBuffer[i], bufferSizeRec[i] , 0);
-                }
-            }
-
-            //send
-            parallel.send_dim1( &bufferSize[3], 3,0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim1( sendBuffer[i], bufferSize[i] , 0);
-                }
-            }
+            if(output[i]>output_temp[i])output[i]=output_temp[i];
+        }
+        else if(reduce_type[i] & (MAX | MAX_LOCAL))
+        {
+            if(output[i]<output_temp[i])output[i]=output_temp[i];
         }
     }
+}
 
-
-    //cout<<"okokok  move firs statrt unpack"<<endl;
-
-    //unpack local list: rec[2] and rec[5]
-
-    //add partnum
-    numParticles_ += bufferSizeRec[2] + bufferSizeRec[5];
-    for(int i=0;i<bufferSizeRec[2];i++)
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::reduceOutput(double * output, int * reduce_type, int noutput)
+{
+    for(int i=0;i<noutput;i++)
     {
-        this->getPartCoordLocal(recBuffer[2][i],newLocalCoord);
-        x.setCoordLocal(newLocalCoord);
-
-        field_part_(x).size += 1;
-        field_part_(x).parts.push_back(recBuffer[2][i]);
-#ifdef DEBUG_MOVE
-        int verif;
-        verif=addParticle_global(recBuffer[2][i]);
-
-        if(verif != 1)
+        if(reduce_type[i] & SUM)
         {
-            cout<<parallel.rank()<<"; MOVEBUF2 partID "<< recBuffer[2][i].ID<<" is not in the correct proc. " << recBuffer[2][i]<<endl;
+            parallel.sum(output[i]);
+        }
+        else if(reduce_type[i] & MIN)
+        {
+            parallel.min(output[i]);
+        }
+        else if(reduce_type[i] & MAX)
+        {
+            parallel.max(output[i]);
         }
-#endif
     }
+}
 
-    //cout<<"buffer size: "<<bufferSizeRec[5]<<endl;
-    //if(bufferSizeRec[5]!=0)
-    for(int i=0;i<bufferSizeRec[5];i++)
-    {
-        //cout<<i<<endl;
-
-        this->getPartCoordLocal(recBuffer[5][i],newLocalCoord);
+/*
+ Cell of a particle after its displacement: the new (local) cell if the particle stays in this process. If it moves to a
+ neighbour process, the particle is copied to the buffer of that neighbour and -1 is returned:
 
-        x.setCoordLocal(newLocalCoord);
+ buffer:                            0    1    2    3    4    5    6    7
+ process grid rank[1] offset:      -1   -1   -1   +1   +1   +1    0    0
+ process grid rank[0] offset:      -1   +1    0   -1   +1    0   -1   +1
 
-        field_part_(x).size += 1;
-        field_part_(x).parts.push_back(recBuffer[5][i]);
-#ifdef DEBUG_MOVE
-        int verif;
-        verif=addParticle_global(recBuffer[5][i]);
+ A particle which has moved by more than one process stays in its old cell. In MIGRATION_MULTIHOP mode, the position is
+ wrapped in the box and the particle is sent to the neighbour in the direction of its process (routeBuffer). The buffers
+ are sent by chunks during the move (pushMoving).
+ */
+template <typename part, typename part_info, typename part_dataType>
+long Particles<part,part_info,part_dataType>::moveDestination(part & pcl, long cell, part & partOld)
+{
+    int partRanks[2];
+    int thisRanks[2];
+    int newLocalCoord[3];
+    int buffer = -1;
 
-        if(verif != 1)
+    if(migrationMode_ == MIGRATION_MULTIHOP)
+    {
+        for(int i=0;i<3;i++)
         {
-            cout<<parallel.rank()<<"; MOVEBUF5 partID "<< recBuffer[5][i].ID<<" is not in the correct proc. "<<recBuffer[5][i] <<endl;
+            if(pcl.pos[i]<0 || pcl.pos[i]>=boxSize_[i])
+            {
+                pcl.pos[i] = fmod(pcl.pos[i],boxSize_[i]);
+                if(pcl.pos[i]<0)pcl.pos[i] += boxSize_[i];
+                if(pcl.pos[i]>=boxSize_[i])pcl.pos[i] -= boxSize_[i];
+            }
         }
-#endif
 
+        buffer = routeBuffer(pcl);
+        if(buffer == -1)
+        {
+            getPartCoordLocal(pcl, newLocalCoord);
+            return newLocalCoord[0] + newLocalCoord[1]*lat_part_.jump(1) + newLocalCoord[2]*lat_part_.jump(2);
+        }
+        pushMoving(buffer,pcl);
+        return -1;
     }
 
+    getPartNewProcess(pcl,partRanks);
+    thisRanks[0] = parallel.grid_rank()[0];
+    thisRanks[1] = parallel.grid_rank()[1];
 
-#ifdef DEBUG_MOVE
-    cout<<parallel.rank()<<"; move : end of buffer 2 and 5 copy"<<endl;
-#endif
-
-    //cout<<"unpack done  "<<endl;
-
-    pTemp = sendBuffer[0];
-    sendBuffer[0]=recBuffer[0];
-    recBuffer[0]=pTemp;
-    if(bufferSize[0]!=0)delete[] recBuffer[0];
-    bufferSize[0]=bufferSizeRec[0];
-
-    pTemp = sendBuffer[1];
-    sendBuffer[1]=recBuffer[3];
-    recBuffer[3]=pTemp;
-    if(bufferSize[1]!=0)delete[] recBuffer[3];
-    bufferSize[1]=bufferSizeRec[3];
-
-    pTemp = sendBuffer[3];
-    sendBuffer[3]=recBuffer[1];
-    recBuffer[1]=pTemp;
-    if(bufferSize[3]!=0)delete[] recBuffer[1];
-    bufferSize[3]=bufferSizeRec[1];
-
-    pTemp = sendBuffer[4];
-    sendBuffer[4]=recBuffer[4];
-    recBuffer[4]=pTemp;
-    if(bufferSize[4]!=0)delete[] recBuffer[4];
-    bufferSize[4]=bufferSizeRec[4];
-
-    if(bufferSize[2]!=0)delete[] sendBuffer[2];
-    if(bufferSizeRec[2]!=0)delete[] recBuffer[2];
-    if(bufferSize[5]!=0)delete[] sendBuffer[5];
-    if(bufferSizeRec[5]!=0)delete[] recBuffer[5];
-
-
-
-    //pack list 6 & 7 into buffer 2 & 5
-
-    bufferSize[2]=part_moveProc[6].size();
-    if( bufferSize[2]!=0 )
+    for(int i=0;i<3;i++)
     {
-        sendBuffer[2] = new part[bufferSize[2]];
-        for(it=part_moveProc[6].begin(),p=0; it != part_moveProc[6].end();++it,p++)sendBuffer[2][p]=(*it);
-        part_moveProc[6].clear();
+        if(pcl.pos[i]<0)pcl.pos[i] +=  boxSize_[i];
+        if(pcl.pos[i]>=boxSize_[i])pcl.pos[i]-=boxSize_[i];
     }
 
-
-    bufferSize[5]=part_moveProc[7].size();
-    if( bufferSize[5]!=0 )
+    if(partRanks[0]==thisRanks[0] && partRanks[1]==thisRanks[1])
     {
-        sendBuffer[5] = new part[bufferSize[5]];
-        for(it=part_moveProc[7].begin(),p=0; it != part_moveProc[7].end();++it,p++)sendBuffer[5][p]=(*it);
-        part_moveProc[7].clear();
-    }
-   //send z
-
-    if(parallel.grid_rank()[0]%2==0)
-	{
-		////////////////////////////////
-		///send/rec to/from higher rank
-		////////////////////////////////
-
-		if(parallel.grid_rank()[0]!=parallel.grid_size()[0]-1)/// si pas le dernier alors envoie au +1
-		{
-            //send
-            parallel.send_dim0( &bufferSize[3], 3, parallel.grid_rank()[0]+1);
-            for(int i=3;i<6;i++)
+        getPartCoordLocal(pcl, newLocalCoord);
+        for(int i=0;i<3;i++)
+        {
+            if(newLocalCoord[i]<0 || newLocalCoord[i]>=lat_part_.sizeLocal(i))
             {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]+1);
-                }
-
+                return cell;
             }
+        }
+        return newLocalCoord[0] + newLocalCoord[1]*lat_part_.jump(1) + newLocalCoord[2]*lat_part_.jump(2);
+    }
+    else if(partRanks[1]==thisRanks[1]-1)
+    {
+        if(partRanks[0]==thisRanks[0])buffer = 2;
+        else if(partRanks[0]==thisRanks[0]-1)buffer = 0;
+        else if(partRanks[0]==thisRanks[0]+1)buffer = 1;
+    }
+    else if(partRanks[1]==thisRanks[1]+1)
+    {
+        if(partRanks[0]==thisRanks[0])buffer = 5;
+        else if(partRanks[0]==thisRanks[0]-1)buffer = 3;
+        else if(partRanks[0]==thisRanks[0]+1)buffer = 4;
+    }
+    else if(partRanks[1]==thisRanks[1])
+    {
+        if(partRanks[0]==thisRanks[0]-1)buffer = 6;
+        else if(partRanks[0]==thisRanks[0]+1)buffer = 7;
+    }
 
-            //recieve
-            parallel.receive_dim0( &bufferSizeRec[3], 3, parallel.grid_rank()[0]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]+1);
+    if(buffer == -1)
+    {
+        cout<< "particle : "<<pcl.ID<<" has moved too much (more than 1 proc)."<<endl;
+        cout<< "particle position: "<< pcl <<endl;
+        cout<< "particle position old: "<< partOld <<endl;
+        cout<<"particle : "<<pcl.ID<< " "<< thisRanks[0]<<" , "<< thisRanks[1]<<" , "<< partRanks[0]<<" , "<< partRanks[1]<<endl;
+        return cell;
+    }
 
-                }
-            }
-		}
+    pushMoving(buffer,pcl);
+    return -1;
+}
 
-		//////////////////////////////
-		///send/rec to/from lower rank
-		//////////////////////////////
+/*
+ Buffer of the neighbour in the direction of the process of a particle (position within the box): one step in each
+ dimension of the process grid, along the shortest way on the torus. -1 if the particle is in this process.
+ */
+template <typename part, typename part_info, typename part_dataType>
+int Particles<part,part_info,part_dataType>::routeBuffer(part & pcl)
+{
+    const int buffer[3][3] = {{0,2,1},{6,-1,7},{3,5,4}};
+    int ranks[2];
+    int step[2];
 
-		if(parallel.grid_rank()[0] != 0)     /// si pas le premier alors envoie au -1
-		{
-            //send
-            parallel.send_dim0( bufferSize, 3, parallel.grid_rank()[0]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]-1);
-                }
-            }
-            //recieve
-            parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_rank()[0]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                   recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]-1);
+    getPartProcess(pcl,ranks);
+    for(int i=0;i<2;i++)
+    {
+        int n = parallel.grid_size()[i];
+        int d = (ranks[i] - parallel.grid_rank()[i] + n) % n;
+        if(d==0)step[i] = 0;
+        else if(2*d <= n)step[i] = 1;
+        else step[i] = -1;
+    }
+    return buffer[step[1]+1][step[0]+1];
+}
 
-                }
-            }
+/*
+ Neighbour process of the buffer b of moveDestination, and index of the buffer of the opposite direction.
+ */
+template <typename part, typename part_info, typename part_dataType>
+int Particles<part,part_info,part_dataType>::neighbourRank(int b)
+{
+    const int offset1[8] = {-1,-1,-1, 1, 1, 1, 0, 0};
+    const int offset0[8] = {-1, 1, 0,-1, 1, 0,-1, 1};
+    int r0 = (parallel.grid_rank()[0] + offset0[b] + parallel.grid_size()[0]) % parallel.grid_size()[0];
+    int r1 = (parallel.grid_rank()[1] + offset1[b] + parallel.grid_size()[1]) % parallel.grid_size()[1];
+    return r0 + r1 * parallel.grid_size()[0];
+}
 
-		}
-		else if(parallel.grid_size()[0]%2==0)  /// si pair et = 0 alors envoi au dernier
-		{
-            //send
-            parallel.send_dim0( bufferSize, 3, parallel.grid_size()[0]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_size()[0]-1);
-                }
-            }
-            //recieve
-            parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_size()[0]-1);
-            for(int i=0;i<3;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[0]-1);
+template <typename part, typename part_info, typename part_dataType>
+int Particles<part,part_info,part_dataType>::oppositeBuffer(int b)
+{
+    const int opposite[8] = {4,3,5,1,0,2,7,6};
+    return opposite[b];
+}
 
-                }
-            }
-		}
+/*
+ The particles leaving the process are sent to the 8 neighbour processes by messages of PARTICLES_MIGRATION_CHUNK
+ particles, with non-blocking sends. pushMoving adds a particle to the buffer of a neighbour during the move and sends
+ the buffer as soon as it is full (sendChunk), so that the exchange overlaps with the rest of the move. startExchange
+ sends what is left in the buffers, the last message of each direction is shorter than PARTICLES_MIGRATION_CHUNK
+ (possibly empty) and ends the exchange in that direction. The receives do not need the number of particles in
+ advance: the messages are received as they arrive (MPI_Iprobe and MPI_Get_count, receiveChunks) during the move and
+ in finishExchange. The message from a neighbour is identified by its direction (tag), so a neighbour which appears in
+ several directions (process grid of size 1 or 2) is not an issue.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::pushMoving(int b, part & pcl)
+{
+    moveBuffer_[b].push_back(pcl);
+    if(moveBuffer_[b].size() == PARTICLES_MIGRATION_CHUNK)sendChunk(b);
+}
 
-	}
-	else
-	{
-		//////////////////////////////
-		///rec/send from/to lower rank
-		//////////////////////////////
+/*
+ Sends the full buffer b, which is replaced by an empty one (the buffers keep their capacity from a move to the other),
+ and receives the messages which have arrived.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::sendChunk(int b)
+{
+    if(freeChunks_.empty())freeChunks_.push_back(std::vector<part>());
+    sentChunks_.splice(sentChunks_.end(),freeChunks_,freeChunks_.begin());
+    sentChunks_.back().swap(moveBuffer_[b]);
+    moveBuffer_[b].clear();
 
-		//tous recois du -1 puis envois au -1
+    exchangeRequest_.push_back(MPI_REQUEST_NULL);
+    MPI_Isend(&sentChunks_.back()[0],sentChunks_.back().size()*sizeof(part),MPI_BYTE,neighbourRank(b),8+b,
+              parallel.lat_world_comm(),&exchangeRequest_.back());
 
-        //recieve
-        parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_rank()[0]-1);
-        for(int i=0;i<3;i++)
-        {
-            if(bufferSizeRec[i]!=0)
-            {
-                recBuffer[i]=new part[bufferSizeRec[i]];
-                parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]-1);
+    receiveChunks(false);
+}
 
-            }
-        }
-        //send
-		parallel.send_dim0( bufferSize, 3, parallel.grid_rank()[0]-1);
-        for(int i=0;i<3;i++)
+/*
+ Receives the messages of the neighbours in recBuffer_ until the last message of each direction. If wait is false, only
+ the messages which have already arrived are received.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::receiveChunks(bool wait)
+{
+    MPI_Status status;
+    int arrived;
+    int bytes;
+    long n;
+
+    for(int b=0;b<8;b++)
+    {
+        while(!recDone_[b])
         {
-            if(bufferSize[i]!=0)
+            if(wait)MPI_Probe(neighbourRank(b),8+oppositeBuffer(b),parallel.lat_world_comm(),&status);
+            else
             {
-                parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]-1);
+                MPI_Iprobe(neighbourRank(b),8+oppositeBuffer(b),parallel.lat_world_comm(),&arrived,&status);
+                if(!arrived)break;
             }
-		}
-
+            MPI_Get_count(&status,MPI_BYTE,&bytes);
 
-		//////////////////////////////
-		//rec/send from/to higher rank
-		/////////////////////////////
+            n = recBuffer_[b].size();
+            recBuffer_[b].resize(n + bytes/sizeof(part));
+            MPI_Recv(bytes != 0 ? &recBuffer_[b][n] : NULL,bytes,MPI_BYTE,neighbourRank(b),8+oppositeBuffer(b),
+                     parallel.lat_world_comm(),MPI_STATUS_IGNORE);
 
-        if(parallel.grid_rank()[0]!=parallel.grid_size()[0]-1)//si pas dernier alors recoi du +1
-		{
+            if(bytes < (int)(PARTICLES_MIGRATION_CHUNK*sizeof(part)))recDone_[b] = true;
+        }
+    }
+}
 
-            //recieve
-            parallel.receive_dim0( &bufferSizeRec[3], 3, parallel.grid_rank()[0]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_rank()[0]+1);
+/*
+ Sends the particles left in the buffers moveBuffer_ (see moveDestination): the full chunks first (only in
+ MIGRATION_MULTIHOP mode, the forwarded particles are added to the buffers without being sent), then the last message
+ of each direction. The buffers are not modified until finishExchange.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::startExchange()
+{
+    long n,first;
 
-                }
-            }
+    for(int b=0;b<8;b++)
+    {
+        n = moveBuffer_[b].size();
+        for(first=0;first+PARTICLES_MIGRATION_CHUNK<=n;first+=PARTICLES_MIGRATION_CHUNK)
+        {
+            exchangeRequest_.push_back(MPI_REQUEST_NULL);
+            MPI_Isend(&moveBuffer_[b][first],PARTICLES_MIGRATION_CHUNK*sizeof(part),MPI_BYTE,neighbourRank(b),8+b,
+                      parallel.lat_world_comm(),&exchangeRequest_.back());
+        }
+        exchangeRequest_.push_back(MPI_REQUEST_NULL);
+        MPI_Isend(n > first ? &moveBuffer_[b][first] : NULL,(n-first)*sizeof(part),MPI_BYTE,neighbourRank(b),8+b,
+                  parallel.lat_world_comm(),&exchangeRequest_.back());
+    }
 
-            //send
-            parallel.send_dim0( &bufferSize[3], 3, parallel.grid_rank()[0]+1);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_rank()[0]+1);
-                }
-            }
+    receiveChunks(false);
+}
 
-		}
-		else // si dernier alors pair et recoi du premier
-		{
+/*
+ Waits for the exchange and adds the received particles to addedParts_. In MIGRATION_MULTIHOP mode, the particles which
+ are not in this process are put in moveBuffer_ to be forwarded.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::finishExchange()
+{
+    long p;
 
-            //recieve
-            parallel.receive_dim0( &bufferSizeRec[3], 3, 0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , 0);
-                }
-            }
+    int route;
 
-            //send
-            parallel.send_dim0( &bufferSize[3], 3,0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , 0);
-                }
-			}
-		}
+    receiveChunks(true);
 
-	}
+    MPI_Waitall(exchangeRequest_.size(),exchangeRequest_.data(),MPI_STATUSES_IGNORE);
+    exchangeRequest_.clear();
 
-	//if unpair :
-	/////////////
+    //the buffers keep their capacity for the next move
+    freeChunks_.splice(freeChunks_.end(),sentChunks_);
+    for(int b=0;b<8;b++)moveBuffer_[b].clear();
 
-	if(parallel.grid_size()[0]%2!=0)
-	{
-		if(parallel.grid_rank()[0]==0)
-		{
-            //send
-            parallel.send_dim0( bufferSize, 3, parallel.grid_size()[0]-1);
-            for(int i=0;i<3;i++)
+    for(int b=0;b<8;b++)
+    {
+        for(p=0;p<(long)recBuffer_[b].size();p++)
+        {
+            if(migrationMode_ == MIGRATION_MULTIHOP)
             {
-                if(bufferSize[i]!=0)
+                route = routeBuffer(recBuffer_[b][p]);
+                if(route != -1)
                 {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , parallel.grid_size()[0]-1);
+                    moveBuffer_[route].push_back(recBuffer_[b][p]);
+                    continue;
                 }
             }
-            //recieve
-            parallel.receive_dim0( bufferSizeRec, 3, parallel.grid_size()[0]-1);
-            for(int i=0;i<3;i++)
+            addedParts_.push_back(recBuffer_[b][p]);
+            addedCells_.push_back(localCell(recBuffer_[b][p]));
+#ifdef DEBUG_MOVE
+            Site xVerif(lat_part_);
+            int coordVerif[3];
+            getPartCoord(recBuffer_[b][p],coordVerif);
+            if(!xVerif.setCoord(coordVerif))
             {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , parallel.grid_size()[0]-1);
-
-                }
+                cout<<parallel.rank()<<"; MOVEBUF"<<b<<" partID "<< recBuffer_[b][p].ID<<" is not in the correct proc. " << recBuffer_[b][p]<<endl;
             }
-		}
-		if(parallel.grid_rank()[0]==parallel.grid_size()[0]-1)
-		{
-
-            //recieve
-            parallel.receive_dim0( &bufferSizeRec[3], 3, 0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSizeRec[i]!=0)
-                {
-                    recBuffer[i]=new part[bufferSizeRec[i]];
-                    parallel.receive_dim0( recBuffer[i], bufferSizeRec[i] , 0);
+#endif
+        }
+        recBuffer_[b].clear();
+        recDone_[b] = false;
+    }
+}
 
-                }
-            }
+/*
+ Migration at the end of a move: the new cell of the particles of parts_ is in partCell_ (-1 for the particles in
+ moveBuffer_). The local particles are counted by cell while the particles are exchanged, then the received particles are
+ added and the particle array is rebuilt. In MIGRATION_MULTIHOP mode, the particles are forwarded from neighbour to
+ neighbour until they all have reached their process.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::migrateParticles()
+{
+    startExchange();
+    finishMigration();
+}
 
-            //send
-            parallel.send_dim0( &bufferSize[3], 3,0);
-            for(int i=3;i<6;i++)
-            {
-                if(bufferSize[i]!=0)
-                {
-                    parallel.send_dim0( sendBuffer[i], bufferSize[i] , 0);
-                }
-            }
-		}
-	}
+/*
+ Second part of migrateParticles, after startExchange: callers can do other work while the first exchange is in flight.
+ */
+template <typename part, typename part_info, typename part_dataType>
+void Particles<part,part_info,part_dataType>::finishMigration()
+{
+    long transit;
 
-    //unpack data
-	for(int i=0;i<6;i++)
-    {
-	    numParticles_ += bufferSizeRec[i] ;
-    }
+    countCells();
+    finishExchange();
 
-    for(int p=0;p<6;p++)
+    if(migrationMode_ == MIGRATION_MULTIHOP)
     {
-        for(int i=0;i<bufferSizeRec[p];i++)
+        for(;;)
         {
-            this->getPartCoordLocal(recBuffer[p][i],newLocalCoord);
-
-            x.setCoordLocal(newLocalCoord);
-
-            field_part_(x).size += 1;
-            field_part_(x).parts.push_back(recBuffer[p][i]);
+            transit = 0;
+            for(int b=0;b<8;b++)transit += moveBuffer_[b].size();
+            parallel.sum(transit);
+            if(transit == 0)break;
+            startExchange();
+            finishExchange();
         }
     }
 
-
-    for(int i=0;i<6;i++)
-    {
-        if(bufferSize[i]!=0)delete[] sendBuffer[i];
-        if(bufferSizeRec[i]!=0)delete[] recBuffer[i];
-    }
-    delete[] sendBuffer;
-    delete[] recBuffer;
-
-  if(nfields!=0 && sites) { delete[] sites; sites = NULL; };
-
+    sortCells();
 }
 
-
-
 #ifdef HDF5
 template <typename part, typename part_info, typename part_dataType>
 void Particles<part,part_info,part_dataType>::saveHDF5(string filename_base, int fileNumber)
@@ -2721,13 +1851,12 @@ void Particles<part,part_info,part_dataType>::saveHDF5(string filename_base, int
     MPI_Comm fileComm;
     MPI_Group fileGroup;
     part * partlist;
-    partlist = new part[numParticles_];
-    long index;
-
-    LATfield2::Site x(lat_part_);
-    typename std::list<part>::iterator it;
+    part empty;
     int rang[3];
 
+    sortParticles();
+    partlist = parts_.empty() ? &empty : &parts_[0];
+
 
     rang[0]= whichFile * numProcPerFile ;
     rang[1]= ((whichFile+1) * numProcPerFile) -1;
@@ -2735,19 +1864,6 @@ void Particles<part,part_info,part_dataType>::saveHDF5(string filename_base, int
     MPI_Group_range_incl(parallel.lat_world_group(),1,&rang,&fileGroup);
     MPI_Comm_create(parallel.lat_world_comm(),fileGroup , &fileComm);
 
-  index=0;
-  for(x.first();x.test();x.next())
-    {
-      if(field_part_(x).size!=0)
-        {
-	         for(it=field_part_(x).parts.begin(); it != field_part_(x).parts.end();++it)
-           {
-	             partlist[index]=(*it);
-               index++;
-           }
-        }
-    }
-
   fileDsc fd;
   fd.fileNumber=fileNumber;
   fd.numParts=numParticles_;
@@ -2796,8 +1912,6 @@ void Particles<part,part_info,part_dataType>::saveHDF5(string filename_base, int
   MPI_Comm_free(&fileComm);
   MPI_Group_free(&fileGroup);
 
-  delete[] partlist;
-
 }
 
 
@@ -2933,6 +2047,8 @@ void Particles<part,part_info,part_dataType>::loadHDF5(string filename_base, int
 
     }
 
+    sortParticles();
+
 
 }
 #endif
@@ -2950,28 +2066,8 @@ void Particles<part,part_info,part_dataType>::saveHDF5_server_write(string filen
         io_file_ = ioserver.openFile(filename_base.c_str() ,UNSTRUCTURED_H5_FILE, part_datatype_.part_memType, part_datatype_.part_fileType);
 
 
-    part * partlist;
-    partlist = new part[numParticles_];
-    LATfield2::Site x(lat_part_);
-    typename std::list<part>::iterator it;
-    long index=0;
-    for(x.first();x.test();x.next())
-    {
-        if(field_part_(x).size!=0)
-        {
-            for(it=field_part_(x).parts.begin(); it != field_part_(x).parts.end();++it)
-            {
-
-                for(int i=0;i<3;i++)
-                {
-                    partlist[index]=(*it);
-                }
-                index++;
-            }
-        }
-    }
-    ioserver.sendData(io_file_,(char*)partlist,numParticles_ * H5Tget_size(part_datatype_.part_memType));
-    delete[] partlist;
+    sortParticles();
+    ioserver.sendData(io_file_,(char*)parts_.data(),numParticles_ * H5Tget_size(part_datatype_.part_memType));
 
     hsize_t dim;
     hsize_t size[3];
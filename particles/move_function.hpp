@@ -31,6 +31,25 @@ void move_particles_simple(double dtau,
    
 }
 
+/*!
+ Batch kernel of the drift of "part_simple" (see Particles::moveParticlesBatch): pos += dtau * vel.
+ */
+void move_particles_simple_batch(double dtau,
+                                 double lat_resolution,
+                                 partBatch<part_simple> * batch,
+                                 part_simple_info partInfo,
+                                 Field<Real> ** fields,
+                                 int nfield,
+                                 double * params)
+{
+    for(int l=0;l<3;l++)
+    {
+        Real * pos = batch->pos[l];
+        Real * vel = batch->vel[l];
+        for(long p=0;p<batch->size;p++) pos[p] += dtau*vel[p];
+    }
+}
+
 /**@}*/
 
 #endif
@@ -6,6 +6,8 @@
 /*! \file projections.hpp
  \brief projection function for scalar, vector and tensor particle properties.
 
+ When compiled with OpenMP the projections are threaded over the planes of the particle lattice: the planes are coloured such that planes deposited concurrently never write the same site (see projection_colours).
+
  */
 
 
@@ -24,6 +26,55 @@ inline long setIndex(long * size, long i, long j,long k)
     return i + size[0] *( j+size[1]*k) ;
 }
 
+/*! \fn inline int projection_colours(int reach)
+ Number of colours used to deposit the particles with the threads, reach being the number of planes (along the last dimension) written by the deposition of a single cell.
+ Planes of the same colour are reach planes apart and are deposited concurrently, the colours are deposited one after the other, hence no two threads ever write the same site.
+ Without OpenMP (or with a single thread) there is a single colour and the planes are deposited in order.
+ */
+inline int projection_colours(int reach)
+{
+#ifdef _OPENMP
+    if(omp_get_max_threads()>1)return reach;
+#endif
+    return 1;
+}
+
+/*! \fn inline void projection_planeFirst(Site & xPart, Site & xField, int plane)
+ Set xPart and xField to the first site of the local plane "plane" (local coordinate along the last dimension).
+ */
+inline void projection_planeFirst(Site & xPart, Site & xField, int plane)
+{
+    int r[3] = {0,0,plane};
+    xPart.setCoordLocal(r);
+    xField.setCoordLocal(r);
+}
+
+/*! \fn inline bool projection_planeTest(Site & xPart, int plane)
+ \return true while xPart is within the local plane "plane".
+ */
+inline bool projection_planeTest(Site & xPart, int plane)
+{
+    return xPart.test() && xPart.coordLocal(2) == plane;
+}
+
+/*! \fn inline void projection_cicWeights(double * down, double * up, double * weight)
+ Product of the 1d weights down/up of each direction for the 8 corners of a cell, XYZ = 000 | 001 | 010 | 011 | 100 | 101 | 110 | 111.
+ Written as fixed length loops so that the compiler vectorizes them.
+ */
+inline void projection_cicWeights(double * down, double * up, double * weight)
+{
+    double w[2][3];
+    double wxy[4];
+
+    for(int i=0;i<3;i++)
+    {
+        w[0][i] = down[i];
+        w[1][i] = up[i];
+    }
+    for(int i=0;i<4;i++) wxy[i] = w[i>>1][0] * w[i&1][1];
+    for(int i=0;i<8;i++) weight[i] = wxy[i>>1] * w[i&1][2];
+}
+
 /*! \fn void projection_init(Field<Real> * f)
  Set to zero all components of the field f on the entire lattice (including the halo).
  Have to be performed before any projection.
@@ -86,7 +137,7 @@ void scalarProjectionCIC_project(Particles<part,part_info,part_dataType> * parts
     Site xPart(parts->lattice());
     Site xField(rho->lattice());
 
-    typename std::list<part>::iterator it;
+    typename partList<part>::iterator it;
 
     //size_t offset;
     //*offset = oset;
@@ -128,55 +179,53 @@ void scalarProjectionCIC_project(Particles<part,part_info,part_dataType> * parts
 
 
 
-    for(xPart.first(),xField.first();xPart.test();xPart.next(),xField.next())
-    {
-
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(2);
+    double weight[8];
 
-        if(parts->field()(xPart).size!=0)
+    for(int colour=0;colour<colours;colour++)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xField,mass) private(it,referPos,rescalPos,rescalPosDown,localCube,weight)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
         {
-            for(int i=0;i<3;i++)referPos[i]=xPart.coord(i)*latresolution;
-            for(int i=0;i<8;i++)localCube[i]=0;
-
-            for (it=(parts->field())(xPart).parts.begin(); it != (parts->field())(xPart).parts.end(); ++it)
+            for(projection_planeFirst(xPart,xField,plane);projection_planeTest(xPart,plane);xPart.next(),xField.next())
             {
-                for(int i =0;i<3;i++)
+                if(cells(xPart).size!=0)
                 {
-                    rescalPos[i]=(*it).pos[i]-referPos[i];
-                    rescalPosDown[i]=latresolution -rescalPos[i];
-                }
+                    for(int i=0;i<3;i++)referPos[i]=xPart.coord(i)*latresolution;
+                    for(int i=0;i<8;i++)localCube[i]=0;
 
-                if(sfrom==FROM_PART)
-                {
-                    mass = *(double*)((char*)&(*it)+offset);
-                    mass /=cicVol;
-                }
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+                        for(int i =0;i<3;i++)
+                        {
+                            rescalPos[i]=(*it).pos[i]-referPos[i];
+                            rescalPosDown[i]=latresolution -rescalPos[i];
+                        }
+
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset);
+                            mass /=cicVol;
+                        }
+
+                        projection_cicWeights(rescalPosDown,rescalPos,weight);
+                        for(int i=0;i<8;i++)localCube[i] += weight[i] * mass;
+                    }
 
-                //000
-                localCube[0] += rescalPosDown[0]*rescalPosDown[1]*rescalPosDown[2] * mass;
-                //001
-                localCube[1] += rescalPosDown[0]*rescalPosDown[1]*rescalPos[2] * mass;
-                //010
-                localCube[2] += rescalPosDown[0]*rescalPos[1]*rescalPosDown[2] * mass;
-                //011
-                localCube[3] += rescalPosDown[0]*rescalPos[1]*rescalPos[2] * mass;
-                //100
-                localCube[4] += rescalPos[0]*rescalPosDown[1]*rescalPosDown[2] * mass;
-                //101
-                localCube[5] += rescalPos[0]*rescalPosDown[1]*rescalPos[2] * mass;
-                //110
-                localCube[6] += rescalPos[0]*rescalPos[1]*rescalPosDown[2] * mass;
-                //111
-                localCube[7] += rescalPos[0]*rescalPos[1]*rescalPos[2] * mass;
+                    (*rho)(xField)+=localCube[0];
+                    (*rho)(xField+2)+=localCube[1];
+                    (*rho)(xField+1)+=localCube[2];
+                    (*rho)(xField+1+2)+=localCube[3];
+                    (*rho)(xField+0)+=localCube[4];
+                    (*rho)(xField+0+2)+=localCube[5];
+                    (*rho)(xField+0+1)+=localCube[6];
+                    (*rho)(xField+0+1+2)+=localCube[7];
+                }
             }
-
-            (*rho)(xField)+=localCube[0];
-            (*rho)(xField+2)+=localCube[1];
-            (*rho)(xField+1)+=localCube[2];
-            (*rho)(xField+1+2)+=localCube[3];
-            (*rho)(xField+0)+=localCube[4];
-            (*rho)(xField+0+2)+=localCube[5];
-            (*rho)(xField+0+1)+=localCube[6];
-            (*rho)(xField+0+1+2)+=localCube[7];
         }
     }
 
@@ -424,7 +473,7 @@ void vectorProjectionCICNGP_project(Particles<part,part_info,part_dataType> * pa
     Site xPart(parts->lattice());
     Site xVel(vel->lattice());
 
-    typename std::list<part>::iterator it;
+    typename partList<part>::iterator it;
 
     double vi[36];//3 * 4 v0:0..3 v1:4..7 v2:8..11
 
@@ -468,81 +517,94 @@ void vectorProjectionCICNGP_project(Particles<part,part_info,part_dataType> * pa
 
 
 
-    for(xPart.first(),xVel.first();xPart.test();xPart.next(),xVel.next())
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(2);
+
+    for(int colour=0;colour<colours;colour++)
     {
-        if(parts->field()(xPart).size!=0)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xVel,mass) private(it,vi,weightScalarGridDown,weightScalarGridUp,referPos)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
         {
-            for(int i=0;i<3;i++)
+            for(projection_planeFirst(xPart,xVel,plane);projection_planeTest(xPart,plane);xPart.next(),xVel.next())
+            {
+                if(cells(xPart).size!=0)
+                {
+                    for(int i=0;i<3;i++)
 
-                referPos[i] = xPart.coord(i)*latresolution;
+                        referPos[i] = xPart.coord(i)*latresolution;
 
-            for(int i=0;i<12;i++)vi[i]=0.0;
+                    for(int i=0;i<12;i++)vi[i]=0.0;
 
-            for (it=(parts->field())(xPart).parts.begin(); it != (parts->field())(xPart).parts.end(); ++it)
-            {
-                for(int i =0;i<3;i++)
-                {
-                    weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
-                    weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
-                }
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+                        for(int i =0;i<3;i++)
+                        {
+                            weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
+                            weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+                        }
 
 
-                double massVel;
-                Real * v;
+                        double massVel;
+                        Real * v;
 
-                if(sfrom==FROM_PART)
-                {
-                    mass = *(double*)((char*)&(*it)+offset_mass);
-                    mass /= cicVol;
-                }
-                v = (Real*)((char*)&(*it)+offset_vel);
-                //cout<< v[0]<<" , "<<v[1]<<" , "<<v[2]<<endl;
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset_mass);
+                            mass /= cicVol;
+                        }
+                        v = (Real*)((char*)&(*it)+offset_vel);
+                        //cout<< v[0]<<" , "<<v[1]<<" , "<<v[2]<<endl;
 
-                massVel = mass*v[0];
+                        massVel = mass*v[0];
 
-                vi[0] +=  massVel * weightScalarGridDown[1] * weightScalarGridDown[2] ;
-                vi[1] +=  massVel * weightScalarGridUp[1]   * weightScalarGridDown[2] ;
-                vi[2] +=  massVel * weightScalarGridDown[1] * weightScalarGridUp[2] ;
-                vi[3] +=  massVel * weightScalarGridUp[1]   * weightScalarGridUp[2] ;
+                        vi[0] +=  massVel * weightScalarGridDown[1] * weightScalarGridDown[2] ;
+                        vi[1] +=  massVel * weightScalarGridUp[1]   * weightScalarGridDown[2] ;
+                        vi[2] +=  massVel * weightScalarGridDown[1] * weightScalarGridUp[2] ;
+                        vi[3] +=  massVel * weightScalarGridUp[1]   * weightScalarGridUp[2] ;
 
-                //working on v1
+                        //working on v1
 
-                massVel = mass*v[1];
+                        massVel = mass*v[1];
 
-                vi[4] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[2] ;
-                vi[5] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[2] ;
-                vi[6] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[2] ;
-                vi[7] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[2] ;
+                        vi[4] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[2] ;
+                        vi[5] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[2] ;
+                        vi[6] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[2] ;
+                        vi[7] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[2] ;
 
-                //working on v2
+                        //working on v2
 
-                massVel = mass*v[2];
+                        massVel = mass*v[2];
 
-                vi[8] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] ;
-                vi[9] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] ;
-                vi[10]+=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1] ;
-                vi[11]+=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1] ;
+                        vi[8] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] ;
+                        vi[9] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] ;
+                        vi[10]+=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1] ;
+                        vi[11]+=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1] ;
 
-            }
+                    }
 
 
-            (*vel)(xVel,0)+=vi[0];
-            (*vel)(xVel,1)+=vi[4];
-            (*vel)(xVel,2)+=vi[8];
+                    (*vel)(xVel,0)+=vi[0];
+                    (*vel)(xVel,1)+=vi[4];
+                    (*vel)(xVel,2)+=vi[8];
 
-            (*vel)(xVel+0,1)+=vi[5];
-            (*vel)(xVel+0,2)+=vi[9];
+                    (*vel)(xVel+0,1)+=vi[5];
+                    (*vel)(xVel+0,2)+=vi[9];
 
-            (*vel)(xVel+1,0)+=vi[1];
-            (*vel)(xVel+1,2)+=vi[10];
+                    (*vel)(xVel+1,0)+=vi[1];
+                    (*vel)(xVel+1,2)+=vi[10];
 
-            (*vel)(xVel+2,0)+=vi[2];
-            (*vel)(xVel+2,1)+=vi[6];
+                    (*vel)(xVel+2,0)+=vi[2];
+                    (*vel)(xVel+2,1)+=vi[6];
 
-            (*vel)(xVel+1+2,0)+=vi[3];
-            (*vel)(xVel+0+2,1)+=vi[7];
-            (*vel)(xVel+0+1,2)+=vi[11];
+                    (*vel)(xVel+1+2,0)+=vi[3];
+                    (*vel)(xVel+0+2,1)+=vi[7];
+                    (*vel)(xVel+0+1,2)+=vi[11];
 
+                }
+            }
         }
     }
 
@@ -712,7 +774,7 @@ void symtensorProjectionCICNGP_project(Particles<part,part_info,part_dataType> *
     Site xPart(parts->lattice() );
     Site xTij(Tij->lattice() );
 
-    typename std::list<part>::iterator it;
+    typename partList<part>::iterator it;
 
     double mass;
     double latresolution = parts->res();
@@ -720,6 +782,7 @@ void symtensorProjectionCICNGP_project(Particles<part,part_info,part_dataType> *
 
     double  tij[6];
     double  tii[24];
+    double  weight[8];
 
     double weightScalarGridDown[3];
     double weightScalarGridUp[3];
@@ -756,91 +819,90 @@ void symtensorProjectionCICNGP_project(Particles<part,part_info,part_dataType> *
 
 
 
-    for(xPart.first(),xTij.first();xPart.test();xPart.next(),xTij.next())
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(2);
+
+    for(int colour=0;colour<colours;colour++)
     {
-        if(parts->field()(xPart).size!=0)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xTij,mass) private(it,tij,tii,weightScalarGridDown,weightScalarGridUp,weight,referPos)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
         {
-            for(int i=0;i<3;i++)
-                referPos[i] = (double)xPart.coord(i)*latresolution;
-
-            for(int i=0;i<6;i++)tij[i]=0.0;
-            for(int i=0;i<24;i++)tii[i]=0.0;
-
-            for (it=(parts->field())(xPart).parts.begin(); it != (parts->field())(xPart).parts.end(); ++it)
+            for(projection_planeFirst(xPart,xTij,plane);projection_planeTest(xPart,plane);xPart.next(),xTij.next())
             {
-                for(int i =0;i<3;i++)
+                if(cells(xPart).size!=0)
                 {
-                    weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
-                    weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
-                }
+                    for(int i=0;i<3;i++)
+                        referPos[i] = (double)xPart.coord(i)*latresolution;
 
-                Real * vel;
-                if(sfrom==FROM_PART)
-                {
-                    mass = *(double*)((char*)&(*it)+offset_mass);
-                    mass /= cicVol;
-                }
-                vel = (Real*)((char*)&(*it)+offset_vel);
+                    for(int i=0;i<6;i++)tij[i]=0.0;
+                    for(int i=0;i<24;i++)tii[i]=0.0;
+
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+                        for(int i =0;i<3;i++)
+                        {
+                            weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
+                            weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+                        }
 
+                        Real * vel;
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset_mass);
+                            mass /= cicVol;
+                        }
+                        vel = (Real*)((char*)&(*it)+offset_vel);
 
-                //working on scalars mass * v_i * v_i
 
-                for(int i=0;i<3;i++)
-                {
-                    double massVel2 = mass * vel[i] * vel[i];
-                    //000
-                    tii[0+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridDown[1] * weightScalarGridDown[2];
-                    //001
-                    tii[1+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridDown[1] * weightScalarGridUp[2];
-                    //010
-                    tii[2+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                    //011
-                    tii[3+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightScalarGridUp[2];
-                    //100
-                    tii[4+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightScalarGridDown[2];
-                    //101
-                    tii[5+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightScalarGridUp[2];
-                    //110
-                    tii[6+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                    //111
-                    tii[7+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridUp[2];
-                }
+                        //working on scalars mass * v_i * v_i
 
-                double massVelVel;
+                        projection_cicWeights(weightScalarGridDown,weightScalarGridUp,weight);
+                        for(int i=0;i<3;i++)
+                        {
+                            double massVel2 = mass * vel[i] * vel[i];
+                            for(int j=0;j<8;j++)tii[j+i*8] += massVel2 * weight[j];
+                        }
 
-                massVelVel = mass * vel[0] * vel[1];
-                tij[0] +=  massVelVel * weightScalarGridDown[2];
-                tij[1] +=  massVelVel * weightScalarGridUp[2];
+                        double massVelVel;
 
-                massVelVel = mass * vel[0] * vel[2];
-                tij[2] +=  massVelVel * weightScalarGridDown[1];
-                tij[3] +=  massVelVel * weightScalarGridUp[1];
+                        massVelVel = mass * vel[0] * vel[1];
+                        tij[0] +=  massVelVel * weightScalarGridDown[2];
+                        tij[1] +=  massVelVel * weightScalarGridUp[2];
 
-                massVelVel = mass * vel[1] * vel[2];
-                tij[4] +=  massVelVel * weightScalarGridDown[0];
-                tij[5] +=  massVelVel * weightScalarGridUp[0];
+                        massVelVel = mass * vel[0] * vel[2];
+                        tij[2] +=  massVelVel * weightScalarGridDown[1];
+                        tij[3] +=  massVelVel * weightScalarGridUp[1];
 
-            }
+                        massVelVel = mass * vel[1] * vel[2];
+                        tij[4] +=  massVelVel * weightScalarGridDown[0];
+                        tij[5] +=  massVelVel * weightScalarGridUp[0];
+
+                    }
 
 
-            for(int i=0;i<3;i++)(*Tij)(xTij,i,i)+=tii[8*i];
-            (*Tij)(xTij,0,1)+=tij[0];
-            (*Tij)(xTij,0,2)+=tij[2];
-            (*Tij)(xTij,1,2)+=tij[4];
+                    for(int i=0;i<3;i++)(*Tij)(xTij,i,i)+=tii[8*i];
+                    (*Tij)(xTij,0,1)+=tij[0];
+                    (*Tij)(xTij,0,2)+=tij[2];
+                    (*Tij)(xTij,1,2)+=tij[4];
 
-            for(int i=0;i<3;i++)(*Tij)(xTij+0,i,i)+=tii[4+8*i];
-            (*Tij)(xTij+0,1,2)+=tij[5];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0,i,i)+=tii[4+8*i];
+                    (*Tij)(xTij+0,1,2)+=tij[5];
 
-            for(int i=0;i<3;i++)(*Tij)(xTij+1,i,i)+=tii[2+8*i];
-            (*Tij)(xTij+1,0,2)+=tij[3];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+1,i,i)+=tii[2+8*i];
+                    (*Tij)(xTij+1,0,2)+=tij[3];
 
-            for(int i=0;i<3;i++)(*Tij)(xTij+2,i,i)+=tii[1+8*i];
-            (*Tij)(xTij+2,0,1)+=tij[1];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+2,i,i)+=tii[1+8*i];
+                    (*Tij)(xTij+2,0,1)+=tij[1];
 
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+1,i,i)+=tii[6+8*i];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+2,i,i)+=tii[5+8*i];
-            for(int i=0;i<3;i++)(*Tij)(xTij+1+2,i,i)+=tii[3+8*i];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+1+2,i,i)+=tii[7+8*i];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+1,i,i)+=tii[6+8*i];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+2,i,i)+=tii[5+8*i];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+1+2,i,i)+=tii[3+8*i];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+1+2,i,i)+=tii[7+8*i];
+                }
+            }
         }
     }
 
@@ -975,43 +1037,64 @@ void symtensorProjectionCICNGP_comm(Field<Real> * Tij)
 
 }
 
-#ifndef DOXYGEN_SHOULD_SKIP_THIS
+//////fused projection
+
+
+/*! \fn template<typename part, typename part_info, typename part_dataType> void projectionCICNGP_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, Field<Real> * T0i, Field<Real> * Tij, size_t * oset = NULL,int flag_where = FROM_INFO)
+
+ \brief fused scalar, vector and symmetric tensor projection.
+
+ Perform in a single pass over the particles the projections of scalarProjectionCIC_project, vectorProjectionCICNGP_project and symtensorProjectionCICNGP_project, i.e. \f$\rho\f$, \f$\rho v_i\f$ and \f$\rho v_i v_j\f$. The cloud-in-cell weights are computed once per particle and used for all the fields. Any of the three fields can be NULL, in which case it is not projected. The fields have to be defined on the same lattice. After the call of this method, the method projectionCICNGP_comm(...) have to be called to perform the reduction of the halo.
+
+ \param Particles<part,part_info,part_dataType> * parts: the particles to project.
+ \param Field<Real> * rho: pointer to the real scalar field on which \f$\rho\f$ is projected (or NULL).
+ \param Field<Real> * T0i: pointer to the real vector field (3 components) on which \f$\rho v_i\f$ is projected (or NULL).
+ \param Field<Real> * Tij: pointer to the real symmetric tensor field on which \f$\rho v_i v_j\f$ is projected (or NULL).
+ \param size_t * oset: pointer to array of two elements. First element is the offset of the \f$\rho\f$ property, and second of the \f$\vec{v}\f$ property. If set to NULL, the projection will project the properties "mass" and "vel" of the particles.
+ \param int flag_where: Flag to set if the property \f$\rho\f$ is a global or a individual one. FROM_INFO set the property to be global and FROM_PART set the property to be individual. The property \f$\vec{v}\f$ is always individual
+
+ \sa projectionCICNGP_comm(Field<Real> * rho, Field<Real> * T0i, Field<Real> * Tij)
+ \sa projection_init(Field<Real> * f)
+ */
 template<typename part, typename part_info, typename part_dataType>
-void vectorProjectionCIC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * vel, size_t * oset = NULL,int flag_where = FROM_INFO)
+void projectionCICNGP_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, Field<Real> * T0i, Field<Real> * Tij, size_t * oset = NULL,int flag_where = FROM_INFO)
 {
+    Field<Real> * target = (rho != NULL ? rho : (T0i != NULL ? T0i : Tij));
+
+    if(target == NULL) return;
+
+    if(target->lattice().halo() == 0)
+    {
+        cout<< "LATfield2::projectionCICNGP_project: the fields have to have at least a halo of 1" <<endl;
+        cout<< "LATfield2::projectionCICNGP_project: aborting" <<endl;
+        exit(-1);
+    }
 
     Site xPart(parts->lattice());
-    Site xVel(vel->lattice());
+    Site xField(target->lattice());
 
-    typename std::list<part>::iterator it;
+    typename partList<part>::iterator it;
 
     double mass;
     double latresolution = parts->res();
     double cicVol = latresolution * latresolution * latresolution;
 
-    double vi[36]; // 3 * 12 v0:0..11 v1:12..23 v2:24..35
-
-    int gridChoice[3];
+    double  localCube[8];
+    double  vi[12];
+    double  tij[6];
+    double  tii[24];
+    double  weight[8];
 
     double weightScalarGridDown[3];
     double weightScalarGridUp[3];
-    double weightTensorGridDown[3];
-    double weightTensorGridUp[3];
-
-    double referDistShift;
 
     double referPos[3];
-    double referPosShift[3];
-
-
 
     int sfrom;
 
     size_t offset_mass;
     size_t offset_vel;
 
-
-
     if(oset == NULL)
     {
         sfrom = parts->mass_type();
@@ -1029,182 +1112,202 @@ void vectorProjectionCIC_project(Particles<part,part_info,part_dataType> * parts
     {
         mass = *(double*)((char*)parts->parts_info() + offset_mass);
         mass /= cicVol;
-        //cout << mass<<endl;
     }
 
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(2);
 
-    for(xPart.first(),xVel.first();xPart.test();xPart.next(),xVel.next())
+    for(int colour=0;colour<colours;colour++)
     {
-        if(parts->field()(xPart).size!=0)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xField,mass) private(it,localCube,vi,tij,tii,weight,weightScalarGridDown,weightScalarGridUp,referPos)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
         {
-            for(int i=0;i<3;i++)
-            {
-                referPos[i] = xPart.coord(i)*latresolution;
-                referPosShift[i] = referPos[i] +  latresolution* 0.5 ;
-            }
-
-            for(int i=0;i<36;i++)vi[i]=0.0;
-
-
-            for (it=(parts->field())(xPart).parts.begin(); it != (parts->field())(xPart).parts.end(); ++it)
+            for(projection_planeFirst(xPart,xField,plane);projection_planeTest(xPart,plane);xPart.next(),xField.next())
             {
-
-                for(int i =0;i<3;i++)
+                if(cells(xPart).size!=0)
                 {
-                    weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
-                    weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+                    for(int i=0;i<3;i++)
+                        referPos[i] = (double)xPart.coord(i)*latresolution;
+
+                    for(int i=0;i<8;i++)localCube[i]=0.0;
+                    for(int i=0;i<12;i++)vi[i]=0.0;
+                    for(int i=0;i<6;i++)tij[i]=0.0;
+                    for(int i=0;i<24;i++)tii[i]=0.0;
 
-                    referDistShift = ((*it).pos[i] - referPosShift[i]) / latresolution;
-                    if(referDistShift<0)
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
                     {
-                        gridChoice[i]=0;
-                        weightTensorGridDown[i] = -referDistShift;
-                        weightTensorGridUp[i] = 1.0l - weightTensorGridDown[i];
+                        for(int i =0;i<3;i++)
+                        {
+                            weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
+                            weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+                        }
+
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset_mass);
+                            mass /= cicVol;
+                        }
+                        Real * v = (Real*)((char*)&(*it)+offset_vel);
+
+                        projection_cicWeights(weightScalarGridDown,weightScalarGridUp,weight);
+
+                        if(rho != NULL)
+                        {
+                            for(int j=0;j<8;j++)localCube[j] += weight[j] * mass;
+                        }
+
+                        if(T0i != NULL)
+                        {
+                            double massVel;
+
+                            massVel = mass*v[0];
+                            vi[0] +=  massVel * weightScalarGridDown[1] * weightScalarGridDown[2] ;
+                            vi[1] +=  massVel * weightScalarGridUp[1]   * weightScalarGridDown[2] ;
+                            vi[2] +=  massVel * weightScalarGridDown[1] * weightScalarGridUp[2] ;
+                            vi[3] +=  massVel * weightScalarGridUp[1]   * weightScalarGridUp[2] ;
+
+                            massVel = mass*v[1];
+                            vi[4] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[2] ;
+                            vi[5] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[2] ;
+                            vi[6] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[2] ;
+                            vi[7] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[2] ;
+
+                            massVel = mass*v[2];
+                            vi[8] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] ;
+                            vi[9] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] ;
+                            vi[10]+=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1] ;
+                            vi[11]+=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1] ;
+                        }
+
+                        if(Tij != NULL)
+                        {
+                            for(int i=0;i<3;i++)
+                            {
+                                double massVel2 = mass * v[i] * v[i];
+                                for(int j=0;j<8;j++)tii[j+i*8] += massVel2 * weight[j];
+                            }
+
+                            double massVelVel;
+
+                            massVelVel = mass * v[0] * v[1];
+                            tij[0] +=  massVelVel * weightScalarGridDown[2];
+                            tij[1] +=  massVelVel * weightScalarGridUp[2];
+
+                            massVelVel = mass * v[0] * v[2];
+                            tij[2] +=  massVelVel * weightScalarGridDown[1];
+                            tij[3] +=  massVelVel * weightScalarGridUp[1];
+
+                            massVelVel = mass * v[1] * v[2];
+                            tij[4] +=  massVelVel * weightScalarGridDown[0];
+                            tij[5] +=  massVelVel * weightScalarGridUp[0];
+                        }
                     }
-                    else
+
+                    if(rho != NULL)
                     {
-                        gridChoice[i]=1;
-                        weightTensorGridUp[i] = referDistShift;
-                        weightTensorGridDown[i] = 1.0l - weightTensorGridUp[i];
+                        (*rho)(xField)+=localCube[0];
+                        (*rho)(xField+2)+=localCube[1];
+                        (*rho)(xField+1)+=localCube[2];
+                        (*rho)(xField+1+2)+=localCube[3];
+                        (*rho)(xField+0)+=localCube[4];
+                        (*rho)(xField+0+2)+=localCube[5];
+                        (*rho)(xField+0+1)+=localCube[6];
+                        (*rho)(xField+0+1+2)+=localCube[7];
                     }
 
-                }
-
-                Real * v;
-                double massVel;
-
-
-                if(sfrom==FROM_PART)
-                {
-                    mass = *(double*)((char*)&(*it)+offset_mass);
-                    mass /= cicVol;
-                }
-
-                v = (Real*)((char*)&(*it)+offset_vel);
-
-                //do the projection into the buffer
-
-                //working on v0
-                massVel = mass*v[0];
-                vi[ CIC_mapv0[gridChoice[0]][0][0][0] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightScalarGridDown[2];
-                vi[ CIC_mapv0[gridChoice[0]][0][0][1] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightScalarGridUp[2];
-                vi[ CIC_mapv0[gridChoice[0]][0][1][0] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                vi[ CIC_mapv0[gridChoice[0]][0][1][1] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightScalarGridUp[2];
-                vi[ CIC_mapv0[gridChoice[0]][1][0][0] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightScalarGridDown[2];
-                vi[ CIC_mapv0[gridChoice[0]][1][0][1] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightScalarGridUp[2];
-                vi[ CIC_mapv0[gridChoice[0]][1][1][0] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                vi[ CIC_mapv0[gridChoice[0]][1][1][1] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridUp[2];
-
-                //working on v1
-                massVel = mass*v[1];
-                vi[ CIC_mapv1[gridChoice[1]][0][0][0] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightScalarGridDown[2];
-                vi[ CIC_mapv1[gridChoice[1]][0][0][1] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightScalarGridUp[2];
-                vi[ CIC_mapv1[gridChoice[1]][0][1][0] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightScalarGridDown[2];
-                vi[ CIC_mapv1[gridChoice[1]][0][1][1] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightScalarGridUp[2];
-                vi[ CIC_mapv1[gridChoice[1]][1][0][0] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightScalarGridDown[2];
-                vi[ CIC_mapv1[gridChoice[1]][1][0][1] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightScalarGridUp[2];
-                vi[ CIC_mapv1[gridChoice[1]][1][1][0] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridDown[2];
-                vi[ CIC_mapv1[gridChoice[1]][1][1][1] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridUp[2];
-
-
-                //working on v2
-                massVel = mass*v[2];
-                vi[ CIC_mapv2[gridChoice[2]][0][0][0] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] * weightTensorGridDown[2];
-                vi[ CIC_mapv2[gridChoice[2]][0][0][1] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] * weightTensorGridUp[2];
-                vi[ CIC_mapv2[gridChoice[2]][0][1][0] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightTensorGridDown[2];
-                vi[ CIC_mapv2[gridChoice[2]][0][1][1] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightTensorGridUp[2];
-                vi[ CIC_mapv2[gridChoice[2]][1][0][0] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightTensorGridDown[2];
-                vi[ CIC_mapv2[gridChoice[2]][1][0][1] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightTensorGridUp[2];
-                vi[ CIC_mapv2[gridChoice[2]][1][1][0] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridDown[2];
-                vi[ CIC_mapv2[gridChoice[2]][1][1][1] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridUp[2];
-
-            }
-
-            //copy to field
-
-            (*vel)(xVel -0       ,0) += vi[0];//v0
-
-            (*vel)(xVel -0    +2 ,0) += vi[1];//v0
-
-            (*vel)(xVel -0 +1    ,0) += vi[2];//v0
-
-            (*vel)(xVel -0 +1 +2 ,0) += vi[3];//v0
-
-            //--------------------------------------------
-
-            (*vel)(xVel    -1    ,1) += vi[12];//v1
-
-            (*vel)(xVel    -1 +2 ,1) += vi[14];//v1
-
-            (*vel)(xVel       -2 ,2) += vi[24];//v2
-
-            (*vel)(xVel          ,0) += vi[4];//v0
-            (*vel)(xVel          ,1) += vi[16];//v1
-            (*vel)(xVel          ,2) += vi[28];//v2
-
-            (*vel)(xVel       +2 ,0) += vi[5];//v0
-            (*vel)(xVel       +2 ,1) += vi[18];//v1
-            (*vel)(xVel       +2 ,2) += vi[32];//v2
-
-            (*vel)(xVel    +1 -2 ,2) += vi[25];//v2
-
-            (*vel)(xVel    +1    ,0) += vi[6];//v0
-            (*vel)(xVel    +1    ,1) += vi[20];//v1
-            (*vel)(xVel    +1    ,2) += vi[29];//v2
-
-            (*vel)(xVel    +1 +2 ,0) += vi[7];//v0
-            (*vel)(xVel    +1 +2 ,1) += vi[22];//v1
-            (*vel)(xVel    +1 +2 ,2) += vi[33];//v2
-
-            //--------------------------------------------
+                    if(T0i != NULL)
+                    {
+                        (*T0i)(xField,0)+=vi[0];
+                        (*T0i)(xField,1)+=vi[4];
+                        (*T0i)(xField,2)+=vi[8];
 
-            (*vel)(xVel +0 -1    ,1) += vi[13];//v1
+                        (*T0i)(xField+0,1)+=vi[5];
+                        (*T0i)(xField+0,2)+=vi[9];
 
-            (*vel)(xVel +0 -1 +2 ,1) += vi[15];//v1
+                        (*T0i)(xField+1,0)+=vi[1];
+                        (*T0i)(xField+1,2)+=vi[10];
 
-            (*vel)(xVel +0    -2 ,2) += vi[26];//v2
+                        (*T0i)(xField+2,0)+=vi[2];
+                        (*T0i)(xField+2,1)+=vi[6];
 
-            (*vel)(xVel +0       ,0) += vi[8];//v0
-            (*vel)(xVel +0       ,1) += vi[17];//v1
-            (*vel)(xVel +0       ,2) += vi[30];//v2
+                        (*T0i)(xField+1+2,0)+=vi[3];
+                        (*T0i)(xField+0+2,1)+=vi[7];
+                        (*T0i)(xField+0+1,2)+=vi[11];
+                    }
 
-            (*vel)(xVel +0    +2 ,0) += vi[9];//v0
-            (*vel)(xVel +0    +2 ,1) += vi[19];//v1
-            (*vel)(xVel +0    +2 ,2) += vi[34];//v2
+                    if(Tij != NULL)
+                    {
+                        for(int i=0;i<3;i++)(*Tij)(xField,i,i)+=tii[8*i];
+                        (*Tij)(xField,0,1)+=tij[0];
+                        (*Tij)(xField,0,2)+=tij[2];
+                        (*Tij)(xField,1,2)+=tij[4];
 
-            (*vel)(xVel +0 +1 -2 ,2) += vi[27];//v2
+                        for(int i=0;i<3;i++)(*Tij)(xField+0,i,i)+=tii[4+8*i];
+                        (*Tij)(xField+0,1,2)+=tij[5];
 
-            (*vel)(xVel +0 +1    ,0) += vi[10];//v0
-            (*vel)(xVel +0 +1    ,1) += vi[21];//v1
-            (*vel)(xVel +0 +1    ,2) += vi[31];//v2
+                        for(int i=0;i<3;i++)(*Tij)(xField+1,i,i)+=tii[2+8*i];
+                        (*Tij)(xField+1,0,2)+=tij[3];
 
-            (*vel)(xVel +0 +1 +2 ,0) += vi[11];//v0
-            (*vel)(xVel +0 +1 +2 ,1) += vi[23];//v1
-            (*vel)(xVel +0 +1 +2 ,2) += vi[35];//v2
+                        for(int i=0;i<3;i++)(*Tij)(xField+2,i,i)+=tii[1+8*i];
+                        (*Tij)(xField+2,0,1)+=tij[1];
 
+                        for(int i=0;i<3;i++)(*Tij)(xField+0+1,i,i)+=tii[6+8*i];
+                        for(int i=0;i<3;i++)(*Tij)(xField+0+2,i,i)+=tii[5+8*i];
+                        for(int i=0;i<3;i++)(*Tij)(xField+1+2,i,i)+=tii[3+8*i];
+                        for(int i=0;i<3;i++)(*Tij)(xField+0+1+2,i,i)+=tii[7+8*i];
+                    }
+                }
+            }
         }
     }
 
-
 }
 
+/*! \fn projectionCICNGP_comm(Field<Real> * rho, Field<Real> * T0i, Field<Real> * Tij)
+ \brief communication method associated to the fused projection.
 
-void vectorProjectionCIC_comm(Field<Real> * vel)
+ Perform the halo reduction of scalarProjectionCIC_comm, vectorProjectionCICNGP_comm and symtensorProjectionCICNGP_comm for the three fields at once: the components of all fields are packed in the same buffers, hence a single message is sent in each direction. NULL fields are skipped.
+
+ \sa projectionCICNGP_project(...)
+ */
+void projectionCICNGP_comm(Field<Real> * rho, Field<Real> * T0i, Field<Real> * Tij)
 {
+    Field<Real> * fields[3] = {rho,T0i,Tij};
+    Field<Real> * target = NULL;
+    int comp = 0;
+
+    for(int f=0;f<3;f++)
+    {
+        if(fields[f] == NULL) continue;
+        if(target == NULL) target = fields[f];
+        else
+        {
+            bool sameLattice = (fields[f]->lattice().halo() == target->lattice().halo());
+            for(int i=0;i<3;i++) sameLattice = sameLattice && (fields[f]->lattice().sizeLocal(i) == target->lattice().sizeLocal(i));
+            if(!sameLattice)
+            {
+                cout<< "LATfield2::projectionCICNGP_comm: the fields have to be defined on the same lattice" <<endl;
+                cout<< "LATfield2::projectionCICNGP_comm: aborting" <<endl;
+                exit(-1);
+            }
+        }
+        comp += fields[f]->components();
+    }
 
+    if(target == NULL) return;
 
-    if(vel->lattice().halo() == 0)
+    if(target->lattice().halo() == 0)
     {
-        cout<< "LATfield2::scalarProjectionCIC_proj: the field has to have at least a halo of 1" <<endl;
-        cout<< "LATfield2::scalarProjectionCIC_proj: aborting" <<endl;
+        cout<< "LATfield2::projectionCICNGP_comm: the fields have to have at least a halo of 1" <<endl;
+        cout<< "LATfield2::projectionCICNGP_comm: aborting" <<endl;
         exit(-1);
     }
 
-    Real *bufferSendUp;
-    Real *bufferSendDown;
-
-    Real *bufferRecUp;
-    Real *bufferRecDown;
+    Real *bufferSend;
+    Real *bufferRec;
 
 
     long bufferSizeY;
@@ -1214,151 +1317,1000 @@ void vectorProjectionCIC_comm(Field<Real> * vel)
     int sizeLocal[3];
     long sizeLocalGross[3];
     int sizeLocalOne[3];
-    int halo = vel->lattice().halo();
+    int halo = target->lattice().halo();
 
     for(int i=0;i<3;i++)
     {
-        sizeLocal[i]=vel->lattice().sizeLocal(i);
+        sizeLocal[i]=target->lattice().sizeLocal(i);
         sizeLocalGross[i] = sizeLocal[i] + 2 * halo;
         sizeLocalOne[i]=sizeLocal[i]+2;
     }
 
     int distHaloOne = halo - 1;
 
+    int iref;
     int imax;
-    //update from halo data in X;
-
-    int iref1=sizeLocalGross[0]-halo;
-    int iref2=sizeLocalGross[0]-halo-1;
+    int c;
 
+    iref = sizeLocalGross[0]-halo;
     for(int k=distHaloOne;k<sizeLocalOne[2]+distHaloOne;k++)
     {
         for(int j=distHaloOne;j<sizeLocalOne[1]+distHaloOne;j++)
         {
-            for(int comp=0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,halo,j,k),comp) += (*vel)(setIndex(sizeLocalGross,iref1,j,k),comp);
-
-            for(int comp=0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,iref2,j,k),comp) += (*vel)(setIndex(sizeLocalGross,distHaloOne,j,k),comp);
+            for(int f=0;f<3;f++)if(fields[f] != NULL)
+                for(int fc=0;fc<fields[f]->components();fc++)(*fields[f])(setIndex(sizeLocalGross,halo,j,k),fc) += (*fields[f])(setIndex(sizeLocalGross,iref,j,k),fc);
         }
     }
 
-    //communication
-
-
-
-    //build buffer size
-
-    bufferSizeY = (long)(sizeLocalOne[2]) * sizeLocal[0];
-    bufferSizeZ = sizeLocal[0] * sizeLocal[1];
 
+    //send halo in direction Y
+    bufferSizeY =  (long)(sizeLocalOne[2]-1)*sizeLocal[0] * comp;
+    bufferSizeZ = (long)sizeLocal[0] * sizeLocal[1] * comp;
     if(bufferSizeY>bufferSizeZ)
     {
-        bufferSendUp = (Real*)malloc(3*bufferSizeY * sizeof(Real));
-        bufferRecUp = (Real*)malloc(3*bufferSizeY * sizeof(Real));
-        bufferSendDown = (Real*)malloc(3*bufferSizeY * sizeof(Real));
-        bufferRecDown = (Real*)malloc(3*bufferSizeY * sizeof(Real));
+        bufferSend = (Real*)malloc(sizeof(Real)*bufferSizeY);
+        bufferRec = (Real*)malloc(sizeof(Real)*bufferSizeY);
     }
     else
     {
-        bufferSendUp = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
-        bufferRecUp = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
-        bufferSendDown = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
-        bufferRecDown = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
+        bufferSend = (Real*)malloc(sizeof(Real)*bufferSizeZ);
+        bufferRec = (Real*)malloc(sizeof(Real)*bufferSizeZ);
     }
 
 
-    //working on Y dimension
-
-
-    imax=sizeLocal[0];
-    iref1 = sizeLocalGross[1]- halo;
-
-
-    for(int k=0;k<sizeLocalOne[2];k++)
+    //pack data
+    imax=sizeLocalGross[0]-2* halo;
+    iref=sizeLocalGross[1]- halo;
+    for(int k=0;k<(sizeLocalOne[2]-1);k++)
     {
         for(int i=0;i<imax;i++)
         {
-            for(int comp =0;comp<3;comp++)bufferSendUp[comp + 3l * (i+k*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,iref1,k+distHaloOne),comp);
-        }
-        for(int i=0;i<imax;i++)
-        {
-            for(int comp =0;comp<3;comp++)bufferSendDown[comp + 3l * (i+k*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,distHaloOne,k+distHaloOne),comp);
+            c = 0;
+            for(int f=0;f<3;f++)if(fields[f] != NULL)
+                for(int fc=0;fc<fields[f]->components();fc++,c++)bufferSend[c+comp*(i+k*imax)]=(*fields[f])(setIndex(sizeLocalGross,i+halo,iref,k+halo),fc);
         }
     }
 
-    parallel.sendUpDown_dim1(bufferSendUp,bufferRecUp,bufferSizeY * 3l,bufferSendDown,bufferRecDown,bufferSizeY * 3l);
 
-    //unpack data
-    iref1 = sizeLocalGross[1]- halo - 1;
+    parallel.sendUp_dim1(bufferSend,bufferRec,bufferSizeY);
 
-    for(int k=0;k<sizeLocalOne[2];k++)
+
+    //unpack data
+    for(int k=0;k<(sizeLocalOne[2]-1);k++)
     {
         for(int i=0;i<imax;i++)
         {
-            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,halo,k+distHaloOne),comp) += bufferRecUp[comp + 3l * (i+k*imax)];
+            c = 0;
+            for(int f=0;f<3;f++)if(fields[f] != NULL)
+                for(int fc=0;fc<fields[f]->components();fc++,c++)(*fields[f])(setIndex(sizeLocalGross,i+halo,halo,k+halo),fc)+=bufferRec[c+comp*(i+k*imax)];
         }
-        for(int i=0;i<imax;i++)
-        {
-            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,iref1,k+distHaloOne),comp) += bufferRecDown[comp + 3l * (i+k*imax)];
 
-        }
     }
 
-    //workin on dim z
+    //send halo in direction Z
 
     //pack data
-
-    iref1=sizeLocalGross[2]- halo;
-
+    iref=sizeLocalGross[2]-halo;
     for(int j=0;j<(sizeLocalOne[1]-2);j++)
     {
         for(int i=0;i<imax;i++)
         {
-            for(int comp =0;comp<3;comp++)bufferSendUp[comp + 3l * (i+j*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,iref1),comp);
-        }
-        for(int i=0;i<imax;i++)
-        {
-            for(int comp =0;comp<3;comp++)bufferSendDown[comp + 3l * (i+j*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,distHaloOne),comp);
+            c = 0;
+            for(int f=0;f<3;f++)if(fields[f] != NULL)
+                for(int fc=0;fc<fields[f]->components();fc++,c++)bufferSend[c+comp*(i+j*imax)]=(*fields[f])(setIndex(sizeLocalGross,i+halo,j+halo,iref),fc);
         }
-
     }
 
-    parallel.sendUpDown_dim0(bufferSendUp,bufferRecUp,bufferSizeY * 3l,bufferSendDown,bufferRecDown,bufferSizeY * 3l);
+    parallel.sendUp_dim0(bufferSend,bufferRec,bufferSizeZ);
 
-    //unpack data
 
-    iref1 = sizeLocalGross[2]- halo - 1;
+    //unpack data
 
     for(int j=0;j<(sizeLocalOne[1]-2);j++)
     {
         for(int i=0;i<imax;i++)
         {
-            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,halo),comp) += bufferRecUp[comp + 3l * (i+j*imax)];
-        }
-        for(int i=0;i<imax;i++)
-        {
-            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,iref1),comp) += bufferRecDown[comp + 3l * (i+j*imax)];
+            c = 0;
+            for(int f=0;f<3;f++)if(fields[f] != NULL)
+                for(int fc=0;fc<fields[f]->components();fc++,c++)(*fields[f])(setIndex(sizeLocalGross,i+halo,j+halo,halo),fc)+=bufferRec[c+comp*(i+j*imax)];
         }
-
     }
 
-
-    free(bufferSendUp);
-    free(bufferSendDown);
-    free(bufferRecUp);
-    free(bufferRecDown);
-
+    free(bufferRec);
+    free(bufferSend);
 
 }
 
+//////higher order scalar projection
 
 
-template<typename part, typename part_info, typename part_dataType>
-void VecVecProjectionCIC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * Tij, size_t * oset = NULL,int flag_where = FROM_INFO)
+/*! \fn inline void projection_stencil4Weights(int order, double u, double * weight)
+ 1d weights of the 4 sites (offsets -1, 0, +1, +2 from the lowest corner of the cell) for a particle at the fraction u in [0,1) of its cell.
+ order 3 is the triangular-shaped cloud (one of the 4 weights is zero), order 4 the piecewise cubic spline.
+ */
+inline void projection_stencil4Weights(int order, double u, double * weight)
 {
-    Site xPart(parts->lattice());
-    Site xTij(Tij->lattice());
-    typename std::list<part>::iterator it;
-
+    double d;
+
+    if(order == 3)
+    {
+        if(u < 0.5)
+        {
+            d = u;
+            weight[0] = 0.5 * (0.5 - d) * (0.5 - d);
+            weight[1] = 0.75 - d * d;
+            weight[2] = 0.5 * (0.5 + d) * (0.5 + d);
+            weight[3] = 0.;
+        }
+        else
+        {
+            d = u - 1.;
+            weight[0] = 0.;
+            weight[1] = 0.5 * (0.5 - d) * (0.5 - d);
+            weight[2] = 0.75 - d * d;
+            weight[3] = 0.5 * (0.5 + d) * (0.5 + d);
+        }
+    }
+    else
+    {
+        d = 1. - u;
+        weight[0] = d * d * d / 6.;
+        weight[1] = (4. - 6. * u * u + 3. * u * u * u) / 6.;
+        weight[2] = (1. + 3. * u + 3. * u * u - 3. * u * u * u) / 6.;
+        weight[3] = u * u * u / 6.;
+    }
+}
+
+/*! \fn inline void projection_stencil4Cube(int order, double * frac, double * weight)
+ 3d weights of the 4x4x4 sites around the cell for a particle at the fraction frac[3] of its cell, weight[c + 4 * (b + 4 * a)] being the weight of the site at offset (a-1,b-1,c-1).
+ Written as fixed length loops so that the compiler vectorizes them.
+ */
+inline void projection_stencil4Cube(int order, double * frac, double * weight)
+{
+    double w[3][4];
+    double wxy[16];
+
+    for(int i=0;i<3;i++) projection_stencil4Weights(order,frac[i],w[i]);
+    for(int i=0;i<16;i++) wxy[i] = w[0][i>>2] * w[1][i&3];
+    for(int i=0;i<64;i++) weight[i] = wxy[i>>2] * w[2][i&3];
+}
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+template<typename part, typename part_info, typename part_dataType>
+void scalarProjectionStencil4_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, size_t * oset, int flag_where, int order)
+{
+    if(rho->lattice().halo() < 2)
+    {
+        cout<< "LATfield2::scalarProjection"<<(order == 3 ? "TSC" : "PCS")<<"_project: the field has to have at least a halo of 2" <<endl;
+        cout<< "LATfield2::scalarProjection"<<(order == 3 ? "TSC" : "PCS")<<"_project: aborting" <<endl;
+        exit(-1);
+    }
+
+    Site xPart(parts->lattice());
+    Site xField(rho->lattice());
+
+    typename partList<part>::iterator it;
+
+    double mass;
+    double latresolution = parts->res();
+    double cicVol = latresolution * latresolution * latresolution;
+
+    double localCube[64];
+    double weight[64];
+    double frac[3];
+
+    long jump[3];
+    for(int i=0;i<3;i++)jump[i] = rho->lattice().jump(i);
+
+    int sfrom;
+    size_t offset;
+
+    if(oset == NULL)
+    {
+        sfrom = parts->mass_type();
+        offset = parts->mass_offset();
+    }
+    else
+    {
+        sfrom =  flag_where;
+        offset = *oset;
+    }
+
+    if(sfrom == FROM_INFO)
+    {
+        mass = *(double*)((char*)parts->parts_info() + offset);
+        mass /= cicVol;
+    }
+
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(4);
+
+    for(int colour=0;colour<colours;colour++)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xField,mass) private(it,localCube,weight,frac)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
+        {
+            for(projection_planeFirst(xPart,xField,plane);projection_planeTest(xPart,plane);xPart.next(),xField.next())
+            {
+                if(cells(xPart).size!=0)
+                {
+                    for(int i=0;i<64;i++)localCube[i]=0.0;
+
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+                        for(int i=0;i<3;i++) frac[i] = (*it).pos[i] / latresolution - xPart.coord(i);
+
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset);
+                            mass /= cicVol;
+                        }
+
+                        projection_stencil4Cube(order,frac,weight);
+                        for(int i=0;i<64;i++)localCube[i] += weight[i] * mass;
+                    }
+
+                    long index = xField.index() - jump[0] - jump[1] - jump[2];
+                    for(int a=0;a<4;a++)
+                        for(int b=0;b<4;b++)
+                            for(int c=0;c<4;c++)
+                                (*rho)(index + a * jump[0] + b * jump[1] + c * jump[2]) += localCube[c + 4 * (b + 4 * a)];
+                }
+            }
+        }
+    }
+}
+
+inline Real scalarInterpolationStencil4(Field<Real> * f, Site & x, double * frac, int order)
+{
+    double weight[64];
+    double value = 0;
+    long jump[3];
+
+    for(int i=0;i<3;i++)jump[i] = f->lattice().jump(i);
+
+    projection_stencil4Cube(order,frac,weight);
+
+    long index = x.index() - jump[0] - jump[1] - jump[2];
+    for(int a=0;a<4;a++)
+        for(int b=0;b<4;b++)
+            for(int c=0;c<4;c++)
+                value += weight[c + 4 * (b + 4 * a)] * (*f)(index + a * jump[0] + b * jump[1] + c * jump[2]);
+
+    return value;
+}
+#endif
+
+
+/*! \fn template<typename part, typename part_info, typename part_dataType> void scalarProjectionTSC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, size_t * oset = NULL,int flag_where = FROM_INFO)
+
+ \brief triangular-shaped-cloud scalar projection.
+
+ Same as scalarProjectionCIC_project(...) with the second order (triangular-shaped cloud) assignment: each particle is deposited on the 27 sites closest to it. The field has to have a halo of at least 2. After the call of this method, the method scalarProjectionTSC_comm(Field<Real> * rho) have to be called to perform the reduction of the halo.
+
+ \param Particles<part,part_info,part_dataType> * parts: the particles to project.
+ \param Field<Real> * rho: pointer to the real scalar field on which the property is projected.
+ \param size_t * oset: pointer to a integer which store the offset of the scalar property in the structure it belong to. If set to NULL, the projection will project the property "mass" of the particles.
+ \param int flag_where: Flag to set if the property is a global or a individual one. FROM_INFO set the property to be global and FROM_PART set the property to be individual.
+
+ \sa scalarProjectionTSC_comm(Field<Real> * rho)
+ \sa scalarInterpolationTSC(Field<Real> * f, Site & x, double * frac)
+ \sa projection_init(Field<Real> * f)
+ */
+template<typename part, typename part_info, typename part_dataType>
+void scalarProjectionTSC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, size_t * oset = NULL,int flag_where = FROM_INFO)
+{
+    scalarProjectionStencil4_project(parts,rho,oset,flag_where,3);
+}
+
+/*! \fn template<typename part, typename part_info, typename part_dataType> void scalarProjectionPCS_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, size_t * oset = NULL,int flag_where = FROM_INFO)
+
+ \brief piecewise-cubic-spline scalar projection.
+
+ Same as scalarProjectionCIC_project(...) with the third order (piecewise cubic spline) assignment: each particle is deposited on the 64 sites closest to it. The field has to have a halo of at least 2. After the call of this method, the method scalarProjectionPCS_comm(Field<Real> * rho) have to be called to perform the reduction of the halo.
+
+ \param Particles<part,part_info,part_dataType> * parts: the particles to project.
+ \param Field<Real> * rho: pointer to the real scalar field on which the property is projected.
+ \param size_t * oset: pointer to a integer which store the offset of the scalar property in the structure it belong to. If set to NULL, the projection will project the property "mass" of the particles.
+ \param int flag_where: Flag to set if the property is a global or a individual one. FROM_INFO set the property to be global and FROM_PART set the property to be individual.
+
+ \sa scalarProjectionPCS_comm(Field<Real> * rho)
+ \sa scalarInterpolationPCS(Field<Real> * f, Site & x, double * frac)
+ \sa projection_init(Field<Real> * f)
+ */
+template<typename part, typename part_info, typename part_dataType>
+void scalarProjectionPCS_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * rho, size_t * oset = NULL,int flag_where = FROM_INFO)
+{
+    scalarProjectionStencil4_project(parts,rho,oset,flag_where,4);
+}
+
+/*! \fn void projection_stencil4_comm(Field<Real> * f)
+ \brief communication method associated to the TSC and PCS projections.
+
+ Reduce the lower halo layer and the 2 upper halo layers of the field (all components) onto the sites they belong to, along the 3 dimensions.
+
+ \sa scalarProjectionTSC_comm(Field<Real> * rho)
+ \sa scalarProjectionPCS_comm(Field<Real> * rho)
+ */
+void projection_stencil4_comm(Field<Real> * f)
+{
+    if(f->lattice().halo() < 2)
+    {
+        cout<< "LATfield2::projection_stencil4_comm: the field has to have at least a halo of 2" <<endl;
+        cout<< "LATfield2::projection_stencil4_comm: aborting" <<endl;
+        exit(-1);
+    }
+
+    Real *bufferSendUp;
+    Real *bufferRecUp;
+    Real *bufferSendDown;
+    Real *bufferRecDown;
+
+    int sizeLocal[3];
+    long sizeLocalGross[3];
+    int halo = f->lattice().halo();
+    int comp = f->components();
+
+    for(int i=0;i<3;i++)
+    {
+        sizeLocal[i]=f->lattice().sizeLocal(i);
+        sizeLocalGross[i] = sizeLocal[i] + 2 * halo;
+    }
+
+    long bufferSizeY = (long)sizeLocal[0] * sizeLocalGross[2] * comp;
+    long bufferSizeZ = (long)sizeLocal[0] * sizeLocal[1] * comp;
+    long bufferSize = (bufferSizeY > bufferSizeZ ? bufferSizeY : bufferSizeZ);
+
+    bufferSendUp = (Real*)malloc(sizeof(Real)*2*bufferSize);
+    bufferRecUp = (Real*)malloc(sizeof(Real)*2*bufferSize);
+    bufferSendDown = (Real*)malloc(sizeof(Real)*bufferSize);
+    bufferRecDown = (Real*)malloc(sizeof(Real)*bufferSize);
+
+    Real * recUp;
+    Real * recDown;
+    long n;
+
+    //direction X, local
+    for(long k=0;k<sizeLocalGross[2];k++)
+    {
+        for(long j=0;j<sizeLocalGross[1];j++)
+        {
+            for(int c=0;c<comp;c++)
+            {
+                (*f)(setIndex(sizeLocalGross,halo+sizeLocal[0]-1,j,k),c) += (*f)(setIndex(sizeLocalGross,halo-1,j,k),c);
+                (*f)(setIndex(sizeLocalGross,halo,j,k),c) += (*f)(setIndex(sizeLocalGross,halo+sizeLocal[0],j,k),c);
+                (*f)(setIndex(sizeLocalGross,halo+1,j,k),c) += (*f)(setIndex(sizeLocalGross,halo+sizeLocal[0]+1,j,k),c);
+            }
+        }
+    }
+
+    //direction Y
+
+    //pack data
+    n=0;
+    for(long k=0;k<sizeLocalGross[2];k++)
+    {
+        for(int i=0;i<sizeLocal[0];i++)
+        {
+            for(int c=0;c<comp;c++,n++)
+            {
+                bufferSendUp[2*n]=(*f)(setIndex(sizeLocalGross,i+halo,halo+sizeLocal[1],k),c);
+                bufferSendUp[2*n+1]=(*f)(setIndex(sizeLocalGross,i+halo,halo+sizeLocal[1]+1,k),c);
+                bufferSendDown[n]=(*f)(setIndex(sizeLocalGross,i+halo,halo-1,k),c);
+            }
+        }
+    }
+
+    if(parallel.grid_size()[1]>1)
+    {
+        parallel.sendUpDown_dim1(bufferSendUp,bufferRecUp,2*bufferSizeY,bufferSendDown,bufferRecDown,bufferSizeY);
+        recUp = bufferRecUp;
+        recDown = bufferRecDown;
+    }
+    else
+    {
+        recUp = bufferSendUp;
+        recDown = bufferSendDown;
+    }
+
+    //unpack data
+    n=0;
+    for(long k=0;k<sizeLocalGross[2];k++)
+    {
+        for(int i=0;i<sizeLocal[0];i++)
+        {
+            for(int c=0;c<comp;c++,n++)
+            {
+                (*f)(setIndex(sizeLocalGross,i+halo,halo,k),c) += recUp[2*n];
+                (*f)(setIndex(sizeLocalGross,i+halo,halo+1,k),c) += recUp[2*n+1];
+                (*f)(setIndex(sizeLocalGross,i+halo,halo+sizeLocal[1]-1,k),c) += recDown[n];
+            }
+        }
+    }
+
+    //direction Z
+
+    //pack data
+    n=0;
+    for(int j=0;j<sizeLocal[1];j++)
+    {
+        for(int i=0;i<sizeLocal[0];i++)
+        {
+            for(int c=0;c<comp;c++,n++)
+            {
+                bufferSendUp[2*n]=(*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo+sizeLocal[2]),c);
+                bufferSendUp[2*n+1]=(*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo+sizeLocal[2]+1),c);
+                bufferSendDown[n]=(*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo-1),c);
+            }
+        }
+    }
+
+    if(parallel.grid_size()[0]>1)
+    {
+        parallel.sendUpDown_dim0(bufferSendUp,bufferRecUp,2*bufferSizeZ,bufferSendDown,bufferRecDown,bufferSizeZ);
+        recUp = bufferRecUp;
+        recDown = bufferRecDown;
+    }
+    else
+    {
+        recUp = bufferSendUp;
+        recDown = bufferSendDown;
+    }
+
+    //unpack data
+    n=0;
+    for(int j=0;j<sizeLocal[1];j++)
+    {
+        for(int i=0;i<sizeLocal[0];i++)
+        {
+            for(int c=0;c<comp;c++,n++)
+            {
+                (*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo),c) += recUp[2*n];
+                (*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo+1),c) += recUp[2*n+1];
+                (*f)(setIndex(sizeLocalGross,i+halo,j+halo,halo+sizeLocal[2]-1),c) += recDown[n];
+            }
+        }
+    }
+
+    free(bufferSendUp);
+    free(bufferRecUp);
+    free(bufferSendDown);
+    free(bufferRecDown);
+}
+
+/*! \fn scalarProjectionTSC_comm(Field<Real> * rho)
+ \brief communication method associated to the triangular-shaped-cloud projection of scalars.
+
+ \sa scalarProjectionTSC_project(...)
+ */
+void scalarProjectionTSC_comm(Field<Real> * rho)
+{
+    projection_stencil4_comm(rho);
+}
+
+/*! \fn scalarProjectionPCS_comm(Field<Real> * rho)
+ \brief communication method associated to the piecewise-cubic-spline projection of scalars.
+
+ \sa scalarProjectionPCS_project(...)
+ */
+void scalarProjectionPCS_comm(Field<Real> * rho)
+{
+    projection_stencil4_comm(rho);
+}
+
+/*! \fn inline Real scalarInterpolationTSC(Field<Real> * f, Site & x, double * frac)
+ \brief triangular-shaped-cloud interpolation of a scalar field at a particle position, matching scalarProjectionTSC_project(...).
+
+ \param Field<Real> * f: the scalar field, with a halo of at least 2 which has to be updated (updateHalo()) beforehand.
+ \param Site & x: site of f at the lowest corner of the cell of the particle.
+ \param double * frac: position of the particle in the cell, in units of the lattice resolution (in [0,1)), as given to the updateVel and move kernels.
+ \return the interpolated value.
+ */
+inline Real scalarInterpolationTSC(Field<Real> * f, Site & x, double * frac)
+{
+    return scalarInterpolationStencil4(f,x,frac,3);
+}
+
+/*! \fn inline Real scalarInterpolationPCS(Field<Real> * f, Site & x, double * frac)
+ \brief piecewise-cubic-spline interpolation of a scalar field at a particle position, matching scalarProjectionPCS_project(...).
+
+ \param Field<Real> * f: the scalar field, with a halo of at least 2 which has to be updated (updateHalo()) beforehand.
+ \param Site & x: site of f at the lowest corner of the cell of the particle.
+ \param double * frac: position of the particle in the cell, in units of the lattice resolution (in [0,1)), as given to the updateVel and move kernels.
+ \return the interpolated value.
+ */
+inline Real scalarInterpolationPCS(Field<Real> * f, Site & x, double * frac)
+{
+    return scalarInterpolationStencil4(f,x,frac,4);
+}
+
+
+//////gather
+
+
+#define GATHER_CIC 2
+#define GATHER_TSC 3
+#define GATHER_PCS 4
+
+/*! \fn template<typename part> void gatherBatch(Field<Real> * field, partBatch<part> * batch, Real ** values, int ncomp = 1, int * comp = NULL, int order = GATHER_CIC)
+ \brief interpolation of field components at the positions of a batch of particles (see Particles::updateVelBatch and Particles::moveParticlesBatch).
+
+ The values of the field on the sites around a cell (2x2x2 for CIC, 4x4x4 for TSC and PCS) are loaded once for each run of consecutive particles of the batch in the same cell, and reused for all of them. The weights are the ones of scalarProjectionCIC_project, scalarProjectionTSC_project and scalarProjectionPCS_project.
+
+ The field has to be defined on a lattice with the same local sizes as the particle lattice, with a halo of at least 1 (CIC) or 2 (TSC, PCS), and its halo has to be updated (updateHalo()) beforehand.
+
+ \param Field<Real> * field: the field to interpolate.
+ \param partBatch<part> * batch: the batch of particles.
+ \param Real ** values: array of ncomp arrays of (at least) batch->size elements, values[c][p] is set to the component comp[c] of the field interpolated at the particle p.
+ \param int ncomp: number of components to interpolate.
+ \param int * comp: components of the field to interpolate, if set to NULL the components 0 to ncomp-1 are interpolated.
+ \param int order: GATHER_CIC, GATHER_TSC or GATHER_PCS.
+ */
+template<typename part>
+void gatherBatch(Field<Real> * field, partBatch<part> * batch, Real ** values, int ncomp = 1, int * comp = NULL, int order = GATHER_CIC)
+{
+    int width = (order == GATHER_CIC ? 2 : 4);
+    int low = (order == GATHER_CIC ? 0 : 1);
+    int nsites = width * width * width;
+    int halo = field->lattice().halo();
+
+    if(halo < width - low - 1)
+    {
+        cout<< "LATfield2::gatherBatch: the field has to have at least a halo of "<< width - low - 1 <<endl;
+        cout<< "LATfield2::gatherBatch: aborting" <<endl;
+        exit(-1);
+    }
+
+    long jump[3];
+    long offset[64];
+    double weight[64];
+    double frac[3];
+    double down[3];
+    std::vector<Real> neighbourhood(ncomp * nsites);
+
+    for(int i=0;i<3;i++)jump[i] = field->lattice().jump(i);
+
+    for(int a=0;a<width;a++)
+        for(int b=0;b<width;b++)
+            for(int c=0;c<width;c++)
+                offset[c + width * (b + width * a)] = (a - low) * jump[0] + (b - low) * jump[1] + (c - low) * jump[2];
+
+    long index;
+    long cellIndex = -1;
+
+    for(long p=0;p<batch->size;p++)
+    {
+        index = 0;
+        for(int i=0;i<3;i++) index += (batch->coord[i][p] + halo) * jump[i];
+
+        if(index != cellIndex)
+        {
+            for(int c=0;c<ncomp;c++)
+                for(int s=0;s<nsites;s++)
+                    neighbourhood[c * nsites + s] = (*field)(index + offset[s], (comp == NULL ? c : comp[c]));
+            cellIndex = index;
+        }
+
+        for(int i=0;i<3;i++) frac[i] = batch->frac[i][p];
+
+        if(order == GATHER_CIC)
+        {
+            for(int i=0;i<3;i++) down[i] = 1. - frac[i];
+            projection_cicWeights(down,frac,weight);
+        }
+        else projection_stencil4Cube(order,frac,weight);
+
+        for(int c=0;c<ncomp;c++)
+        {
+            double value = 0;
+            for(int s=0;s<nsites;s++) value += weight[s] * neighbourhood[c * nsites + s];
+            values[c][p] = value;
+        }
+    }
+}
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+template<typename part, typename part_info, typename part_dataType>
+void vectorProjectionCIC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * vel, size_t * oset = NULL,int flag_where = FROM_INFO)
+{
+
+    Site xPart(parts->lattice());
+    Site xVel(vel->lattice());
+
+    typename partList<part>::iterator it;
+
+    double mass;
+    double latresolution = parts->res();
+    double cicVol = latresolution * latresolution * latresolution;
+
+    double vi[36]; // 3 * 12 v0:0..11 v1:12..23 v2:24..35
+
+    int gridChoice[3];
+
+    double weightScalarGridDown[3];
+    double weightScalarGridUp[3];
+    double weightTensorGridDown[3];
+    double weightTensorGridUp[3];
+
+    double referDistShift;
+
+    double referPos[3];
+    double referPosShift[3];
+
+
+
+    int sfrom;
+
+    size_t offset_mass;
+    size_t offset_vel;
+
+
+
+    if(oset == NULL)
+    {
+        sfrom = parts->mass_type();
+        offset_mass = parts->mass_offset();
+        offset_vel = offsetof(part,vel);
+    }
+    else
+    {
+        sfrom =  flag_where;
+        offset_mass = oset[0];
+        offset_vel = oset[1];
+    }
+
+    if(sfrom == FROM_INFO)
+    {
+        mass = *(double*)((char*)parts->parts_info() + offset_mass);
+        mass /= cicVol;
+        //cout << mass<<endl;
+    }
+
+
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(3);
+
+    for(int colour=0;colour<colours;colour++)
+    {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xVel,mass) private(it,vi,gridChoice,weightScalarGridDown,weightScalarGridUp,weightTensorGridDown,weightTensorGridUp,referDistShift,referPos,referPosShift)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
+        {
+            for(projection_planeFirst(xPart,xVel,plane);projection_planeTest(xPart,plane);xPart.next(),xVel.next())
+            {
+                if(cells(xPart).size!=0)
+                {
+                    for(int i=0;i<3;i++)
+                    {
+                        referPos[i] = xPart.coord(i)*latresolution;
+                        referPosShift[i] = referPos[i] +  latresolution* 0.5 ;
+                    }
+
+                    for(int i=0;i<36;i++)vi[i]=0.0;
+
+
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+
+                        for(int i =0;i<3;i++)
+                        {
+                            weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
+                            weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+
+                            referDistShift = ((*it).pos[i] - referPosShift[i]) / latresolution;
+                            if(referDistShift<0)
+                            {
+                                gridChoice[i]=0;
+                                weightTensorGridDown[i] = -referDistShift;
+                                weightTensorGridUp[i] = 1.0l - weightTensorGridDown[i];
+                            }
+                            else
+                            {
+                                gridChoice[i]=1;
+                                weightTensorGridUp[i] = referDistShift;
+                                weightTensorGridDown[i] = 1.0l - weightTensorGridUp[i];
+                            }
+
+                        }
+
+                        Real * v;
+                        double massVel;
+
+
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset_mass);
+                            mass /= cicVol;
+                        }
+
+                        v = (Real*)((char*)&(*it)+offset_vel);
+
+                        //do the projection into the buffer
+
+                        //working on v0
+                        massVel = mass*v[0];
+                        vi[ CIC_mapv0[gridChoice[0]][0][0][0] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightScalarGridDown[2];
+                        vi[ CIC_mapv0[gridChoice[0]][0][0][1] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightScalarGridUp[2];
+                        vi[ CIC_mapv0[gridChoice[0]][0][1][0] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightScalarGridDown[2];
+                        vi[ CIC_mapv0[gridChoice[0]][0][1][1] ] +=  massVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightScalarGridUp[2];
+                        vi[ CIC_mapv0[gridChoice[0]][1][0][0] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightScalarGridDown[2];
+                        vi[ CIC_mapv0[gridChoice[0]][1][0][1] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightScalarGridUp[2];
+                        vi[ CIC_mapv0[gridChoice[0]][1][1][0] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridDown[2];
+                        vi[ CIC_mapv0[gridChoice[0]][1][1][1] ] +=  massVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridUp[2];
+
+                        //working on v1
+                        massVel = mass*v[1];
+                        vi[ CIC_mapv1[gridChoice[1]][0][0][0] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightScalarGridDown[2];
+                        vi[ CIC_mapv1[gridChoice[1]][0][0][1] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightScalarGridUp[2];
+                        vi[ CIC_mapv1[gridChoice[1]][0][1][0] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightScalarGridDown[2];
+                        vi[ CIC_mapv1[gridChoice[1]][0][1][1] ] +=  massVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightScalarGridUp[2];
+                        vi[ CIC_mapv1[gridChoice[1]][1][0][0] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightScalarGridDown[2];
+                        vi[ CIC_mapv1[gridChoice[1]][1][0][1] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightScalarGridUp[2];
+                        vi[ CIC_mapv1[gridChoice[1]][1][1][0] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridDown[2];
+                        vi[ CIC_mapv1[gridChoice[1]][1][1][1] ] +=  massVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridUp[2];
+
+
+                        //working on v2
+                        massVel = mass*v[2];
+                        vi[ CIC_mapv2[gridChoice[2]][0][0][0] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] * weightTensorGridDown[2];
+                        vi[ CIC_mapv2[gridChoice[2]][0][0][1] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridDown[1] * weightTensorGridUp[2];
+                        vi[ CIC_mapv2[gridChoice[2]][0][1][0] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightTensorGridDown[2];
+                        vi[ CIC_mapv2[gridChoice[2]][0][1][1] ] +=  massVel * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightTensorGridUp[2];
+                        vi[ CIC_mapv2[gridChoice[2]][1][0][0] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightTensorGridDown[2];
+                        vi[ CIC_mapv2[gridChoice[2]][1][0][1] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightTensorGridUp[2];
+                        vi[ CIC_mapv2[gridChoice[2]][1][1][0] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridDown[2];
+                        vi[ CIC_mapv2[gridChoice[2]][1][1][1] ] +=  massVel * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridUp[2];
+
+                    }
+
+                    //copy to field
+
+                    (*vel)(xVel -0       ,0) += vi[0];//v0
+
+                    (*vel)(xVel -0    +2 ,0) += vi[1];//v0
+
+                    (*vel)(xVel -0 +1    ,0) += vi[2];//v0
+
+                    (*vel)(xVel -0 +1 +2 ,0) += vi[3];//v0
+
+                    //--------------------------------------------
+
+                    (*vel)(xVel    -1    ,1) += vi[12];//v1
+
+                    (*vel)(xVel    -1 +2 ,1) += vi[14];//v1
+
+                    (*vel)(xVel       -2 ,2) += vi[24];//v2
+
+                    (*vel)(xVel          ,0) += vi[4];//v0
+                    (*vel)(xVel          ,1) += vi[16];//v1
+                    (*vel)(xVel          ,2) += vi[28];//v2
+
+                    (*vel)(xVel       +2 ,0) += vi[5];//v0
+                    (*vel)(xVel       +2 ,1) += vi[18];//v1
+                    (*vel)(xVel       +2 ,2) += vi[32];//v2
+
+                    (*vel)(xVel    +1 -2 ,2) += vi[25];//v2
+
+                    (*vel)(xVel    +1    ,0) += vi[6];//v0
+                    (*vel)(xVel    +1    ,1) += vi[20];//v1
+                    (*vel)(xVel    +1    ,2) += vi[29];//v2
+
+                    (*vel)(xVel    +1 +2 ,0) += vi[7];//v0
+                    (*vel)(xVel    +1 +2 ,1) += vi[22];//v1
+                    (*vel)(xVel    +1 +2 ,2) += vi[33];//v2
+
+                    //--------------------------------------------
+
+                    (*vel)(xVel +0 -1    ,1) += vi[13];//v1
+
+                    (*vel)(xVel +0 -1 +2 ,1) += vi[15];//v1
+
+                    (*vel)(xVel +0    -2 ,2) += vi[26];//v2
+
+                    (*vel)(xVel +0       ,0) += vi[8];//v0
+                    (*vel)(xVel +0       ,1) += vi[17];//v1
+                    (*vel)(xVel +0       ,2) += vi[30];//v2
+
+                    (*vel)(xVel +0    +2 ,0) += vi[9];//v0
+                    (*vel)(xVel +0    +2 ,1) += vi[19];//v1
+                    (*vel)(xVel +0    +2 ,2) += vi[34];//v2
+
+                    (*vel)(xVel +0 +1 -2 ,2) += vi[27];//v2
+
+                    (*vel)(xVel +0 +1    ,0) += vi[10];//v0
+                    (*vel)(xVel +0 +1    ,1) += vi[21];//v1
+                    (*vel)(xVel +0 +1    ,2) += vi[31];//v2
+
+                    (*vel)(xVel +0 +1 +2 ,0) += vi[11];//v0
+                    (*vel)(xVel +0 +1 +2 ,1) += vi[23];//v1
+                    (*vel)(xVel +0 +1 +2 ,2) += vi[35];//v2
+
+                }
+            }
+        }
+    }
+
+
+}
+
+
+void vectorProjectionCIC_comm(Field<Real> * vel)
+{
+
+
+    if(vel->lattice().halo() == 0)
+    {
+        cout<< "LATfield2::scalarProjectionCIC_proj: the field has to have at least a halo of 1" <<endl;
+        cout<< "LATfield2::scalarProjectionCIC_proj: aborting" <<endl;
+        exit(-1);
+    }
+
+    Real *bufferSendUp;
+    Real *bufferSendDown;
+
+    Real *bufferRecUp;
+    Real *bufferRecDown;
+
+
+    long bufferSizeY;
+    long bufferSizeZ;
+
+
+    int sizeLocal[3];
+    long sizeLocalGross[3];
+    int sizeLocalOne[3];
+    int halo = vel->lattice().halo();
+
+    for(int i=0;i<3;i++)
+    {
+        sizeLocal[i]=vel->lattice().sizeLocal(i);
+        sizeLocalGross[i] = sizeLocal[i] + 2 * halo;
+        sizeLocalOne[i]=sizeLocal[i]+2;
+    }
+
+    int distHaloOne = halo - 1;
+
+    int imax;
+    //update from halo data in X;
+
+    int iref1=sizeLocalGross[0]-halo;
+    int iref2=sizeLocalGross[0]-halo-1;
+
+    for(int k=distHaloOne;k<sizeLocalOne[2]+distHaloOne;k++)
+    {
+        for(int j=distHaloOne;j<sizeLocalOne[1]+distHaloOne;j++)
+        {
+            for(int comp=0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,halo,j,k),comp) += (*vel)(setIndex(sizeLocalGross,iref1,j,k),comp);
+
+            for(int comp=0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,iref2,j,k),comp) += (*vel)(setIndex(sizeLocalGross,distHaloOne,j,k),comp);
+        }
+    }
+
+    //communication
+
+
+
+    //build buffer size
+
+    bufferSizeY = (long)(sizeLocalOne[2]) * sizeLocal[0];
+    bufferSizeZ = sizeLocal[0] * sizeLocal[1];
+
+    if(bufferSizeY>bufferSizeZ)
+    {
+        bufferSendUp = (Real*)malloc(3*bufferSizeY * sizeof(Real));
+        bufferRecUp = (Real*)malloc(3*bufferSizeY * sizeof(Real));
+        bufferSendDown = (Real*)malloc(3*bufferSizeY * sizeof(Real));
+        bufferRecDown = (Real*)malloc(3*bufferSizeY * sizeof(Real));
+    }
+    else
+    {
+        bufferSendUp = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
+        bufferRecUp = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
+        bufferSendDown = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
+        bufferRecDown = (Real*)malloc(3*bufferSizeZ * sizeof(Real));
+    }
+
+
+    //working on Y dimension
+
+
+    imax=sizeLocal[0];
+    iref1 = sizeLocalGross[1]- halo;
+
+
+    for(int k=0;k<sizeLocalOne[2];k++)
+    {
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)bufferSendUp[comp + 3l * (i+k*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,iref1,k+distHaloOne),comp);
+        }
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)bufferSendDown[comp + 3l * (i+k*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,distHaloOne,k+distHaloOne),comp);
+        }
+    }
+
+    parallel.sendUpDown_dim1(bufferSendUp,bufferRecUp,bufferSizeY * 3l,bufferSendDown,bufferRecDown,bufferSizeY * 3l);
+
+    //unpack data
+    iref1 = sizeLocalGross[1]- halo - 1;
+
+    for(int k=0;k<sizeLocalOne[2];k++)
+    {
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,halo,k+distHaloOne),comp) += bufferRecUp[comp + 3l * (i+k*imax)];
+        }
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,iref1,k+distHaloOne),comp) += bufferRecDown[comp + 3l * (i+k*imax)];
+
+        }
+    }
+
+    //workin on dim z
+
+    //pack data
+
+    iref1=sizeLocalGross[2]- halo;
+
+    for(int j=0;j<(sizeLocalOne[1]-2);j++)
+    {
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)bufferSendUp[comp + 3l * (i+j*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,iref1),comp);
+        }
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)bufferSendDown[comp + 3l * (i+j*imax)]=(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,distHaloOne),comp);
+        }
+
+    }
+
+    parallel.sendUpDown_dim0(bufferSendUp,bufferRecUp,bufferSizeY * 3l,bufferSendDown,bufferRecDown,bufferSizeY * 3l);
+
+    //unpack data
+
+    iref1 = sizeLocalGross[2]- halo - 1;
+
+    for(int j=0;j<(sizeLocalOne[1]-2);j++)
+    {
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,halo),comp) += bufferRecUp[comp + 3l * (i+j*imax)];
+        }
+        for(int i=0;i<imax;i++)
+        {
+            for(int comp =0;comp<3;comp++)(*vel)(setIndex(sizeLocalGross,i+halo,j+halo,iref1),comp) += bufferRecDown[comp + 3l * (i+j*imax)];
+        }
+
+    }
+
+
+    free(bufferSendUp);
+    free(bufferSendDown);
+    free(bufferRecUp);
+    free(bufferRecDown);
+
+
+}
+
+
+
+template<typename part, typename part_info, typename part_dataType>
+void VecVecProjectionCIC_project(Particles<part,part_info,part_dataType> * parts,Field<Real> * Tij, size_t * oset = NULL,int flag_where = FROM_INFO)
+{
+    Site xPart(parts->lattice());
+    Site xTij(Tij->lattice());
+    typename partList<part>::iterator it;
+
 
     double mass;
     double latresolution = parts->res();
@@ -1367,6 +2319,7 @@ void VecVecProjectionCIC_project(Particles<part,part_info,part_dataType> * parts
 
     double  tij[54];
     double  tii[24];
+    double  weight[8];
 
     int gridChoice[3];
 
@@ -1409,213 +2362,212 @@ void VecVecProjectionCIC_project(Particles<part,part_info,part_dataType> * parts
 
 
 
-    for(xPart.first(),xTij.first();xPart.test();xPart.next(),xTij.next())
+    Field<partList<part> > & cells = parts->field();
+    int planes = parts->lattice().sizeLocal(2);
+    int colours = projection_colours(3);
+
+    for(int colour=0;colour<colours;colour++)
     {
-        if(parts->field()(xPart).size!=0)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) firstprivate(xPart,xTij,mass) private(it,tij,tii,gridChoice,weightScalarGridDown,weightScalarGridUp,weightTensorGridDown,weightTensorGridUp,weight,referDistShift,referPos,referPosShift)
+#endif
+        for(int plane=colour;plane<planes;plane+=colours)
         {
-            for(int i=0;i<3;i++)
-            {
-                referPos[i] = (double)xPart.coord(i)*latresolution;
-                referPosShift[i] = referPos[i] +  latresolution* 0.5 ;
-            }
-
-            for(int i=0;i<54;i++)tij[i]=0.0;
-            for(int i=0;i<24;i++)tii[i]=0.0;
-
-            for (it=(parts->field())(xPart).parts.begin(); it != (parts->field())(xPart).parts.end(); ++it)
+            for(projection_planeFirst(xPart,xTij,plane);projection_planeTest(xPart,plane);xPart.next(),xTij.next())
             {
-                for(int i =0;i<3;i++)
+                if(cells(xPart).size!=0)
                 {
-                    weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
-                    weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
-
-                    referDistShift = ((*it).pos[i] - referPosShift[i]) / latresolution;
-                    if(referDistShift<0)
-                    {
-                        gridChoice[i]=0;
-                        weightTensorGridDown[i] = -referDistShift;
-                        weightTensorGridUp[i] = 1.0l - weightTensorGridDown[i];
-                    }
-                    else
+                    for(int i=0;i<3;i++)
                     {
-                        gridChoice[i]=1;
-                        weightTensorGridUp[i] = referDistShift;
-                        weightTensorGridDown[i] = 1.0l - weightTensorGridUp[i];
+                        referPos[i] = (double)xPart.coord(i)*latresolution;
+                        referPosShift[i] = referPos[i] +  latresolution* 0.5 ;
                     }
 
-                }
-                Real * vel;
-                if(sfrom==FROM_PART)
-                {
-                    mass = *(double*)((char*)&(*it)+offset_mass);
-                    mass /= cicVol;
-                }
-                vel = (Real*)((char*)&(*it)+offset_vel);
-
-
-                //working on scalars mass * v_i * v_i
+                    for(int i=0;i<54;i++)tij[i]=0.0;
+                    for(int i=0;i<24;i++)tii[i]=0.0;
 
-                for(int i=0;i<3;i++)
-                {
-                    double massVel2 = mass * vel[i] * vel[i];
-                    //000
-                    tii[0+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridDown[1] * weightScalarGridDown[2];
-                    //001
-                    tii[1+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridDown[1] * weightScalarGridUp[2];
-                    //010
-                    tii[2+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                    //011
-                    tii[3+i*8] += massVel2 * weightScalarGridDown[0] * weightScalarGridUp[1]   * weightScalarGridUp[2];
-                    //100
-                    tii[4+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightScalarGridDown[2];
-                    //101
-                    tii[5+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridDown[1] * weightScalarGridUp[2];
-                    //110
-                    tii[6+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridDown[2];
-                    //111
-                    tii[7+i*8] += massVel2 * weightScalarGridUp[0]   * weightScalarGridUp[1]   * weightScalarGridUp[2];
-                }
-
-                //working on plaquette mass * v_i * v_j
-                int whichCube;
-                double massVelVel;
-
-                //1) m * v_1 * v_2
-                whichCube  = gridChoice[1] + 2 * gridChoice[2];
-                massVelVel = mass * vel[1] * vel[2];
-
-                tij[ mapv1v2[whichCube][0][0][0] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightTensorGridDown[2];
-                tij[ mapv1v2[whichCube][0][0][1] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightTensorGridUp[2];
-                tij[ mapv1v2[whichCube][0][1][0] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightTensorGridDown[2];
-                tij[ mapv1v2[whichCube][0][1][1] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightTensorGridUp[2];
-                tij[ mapv1v2[whichCube][1][0][0] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightTensorGridDown[2];
-                tij[ mapv1v2[whichCube][1][0][1] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightTensorGridUp[2];
-                tij[ mapv1v2[whichCube][1][1][0] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightTensorGridDown[2];
-                tij[ mapv1v2[whichCube][1][1][1] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightTensorGridUp[2];
-
-                //2) m * v_0 * v_1
-                whichCube  = gridChoice[0] + 2 * gridChoice[1];
-                massVelVel = mass * vel[0] * vel[1];
-
-                tij[ mapv0v1[whichCube][0][0][0] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridDown[1] * weightScalarGridDown[2];
-                tij[ mapv0v1[whichCube][0][0][1] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridDown[1] * weightScalarGridUp[2];
-                tij[ mapv0v1[whichCube][0][1][0] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridUp[1]   * weightScalarGridDown[2];
-                tij[ mapv0v1[whichCube][0][1][1] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridUp[1]   * weightScalarGridUp[2];
-                tij[ mapv0v1[whichCube][1][0][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridDown[1] * weightScalarGridDown[2];
-                tij[ mapv0v1[whichCube][1][0][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridDown[1] * weightScalarGridUp[2];
-                tij[ mapv0v1[whichCube][1][1][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridDown[2];
-                tij[ mapv0v1[whichCube][1][1][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridUp[2];
-
-
-                //3) m * v_0 * v_2
-                whichCube = gridChoice[0] + 2 * gridChoice[2];
-                massVelVel = mass * vel[0] * vel[2];
-
-                tij[ mapv0v2[whichCube][0][0][0] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightTensorGridDown[2];
-                tij[ mapv0v2[whichCube][0][0][1] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightTensorGridUp[2];
-                tij[ mapv0v2[whichCube][0][1][0] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightTensorGridDown[2];
-                tij[ mapv0v2[whichCube][0][1][1] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightTensorGridUp[2];
-                tij[ mapv0v2[whichCube][1][0][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightTensorGridDown[2];
-                tij[ mapv0v2[whichCube][1][0][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightTensorGridUp[2];
-                tij[ mapv0v2[whichCube][1][1][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridDown[2];
-                tij[ mapv0v2[whichCube][1][1][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridUp[2];
+                    for (it=cells(xPart).parts.begin(); it != cells(xPart).parts.end(); ++it)
+                    {
+                        for(int i =0;i<3;i++)
+                        {
+                            weightScalarGridUp[i] = ((*it).pos[i] - referPos[i]) / latresolution;
+                            weightScalarGridDown[i] = 1.0l - weightScalarGridUp[i];
+
+                            referDistShift = ((*it).pos[i] - referPosShift[i]) / latresolution;
+                            if(referDistShift<0)
+                            {
+                                gridChoice[i]=0;
+                                weightTensorGridDown[i] = -referDistShift;
+                                weightTensorGridUp[i] = 1.0l - weightTensorGridDown[i];
+                            }
+                            else
+                            {
+                                gridChoice[i]=1;
+                                weightTensorGridUp[i] = referDistShift;
+                                weightTensorGridDown[i] = 1.0l - weightTensorGridUp[i];
+                            }
+
+                        }
+                        Real * vel;
+                        if(sfrom==FROM_PART)
+                        {
+                            mass = *(double*)((char*)&(*it)+offset_mass);
+                            mass /= cicVol;
+                        }
+                        vel = (Real*)((char*)&(*it)+offset_vel);
+
+
+                        //working on scalars mass * v_i * v_i
+
+                        projection_cicWeights(weightScalarGridDown,weightScalarGridUp,weight);
+                        for(int i=0;i<3;i++)
+                        {
+                            double massVel2 = mass * vel[i] * vel[i];
+                            for(int j=0;j<8;j++)tii[j+i*8] += massVel2 * weight[j];
+                        }
+
+                        //working on plaquette mass * v_i * v_j
+                        int whichCube;
+                        double massVelVel;
+
+                        //1) m * v_1 * v_2
+                        whichCube  = gridChoice[1] + 2 * gridChoice[2];
+                        massVelVel = mass * vel[1] * vel[2];
+
+                        tij[ mapv1v2[whichCube][0][0][0] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightTensorGridDown[2];
+                        tij[ mapv1v2[whichCube][0][0][1] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridDown[1] * weightTensorGridUp[2];
+                        tij[ mapv1v2[whichCube][0][1][0] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightTensorGridDown[2];
+                        tij[ mapv1v2[whichCube][0][1][1] ] +=  massVelVel * weightScalarGridDown[0] * weightTensorGridUp[1]   * weightTensorGridUp[2];
+                        tij[ mapv1v2[whichCube][1][0][0] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightTensorGridDown[2];
+                        tij[ mapv1v2[whichCube][1][0][1] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridDown[1] * weightTensorGridUp[2];
+                        tij[ mapv1v2[whichCube][1][1][0] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightTensorGridDown[2];
+                        tij[ mapv1v2[whichCube][1][1][1] ] +=  massVelVel * weightScalarGridUp[0]   * weightTensorGridUp[1]   * weightTensorGridUp[2];
+
+                        //2) m * v_0 * v_1
+                        whichCube  = gridChoice[0] + 2 * gridChoice[1];
+                        massVelVel = mass * vel[0] * vel[1];
+
+                        tij[ mapv0v1[whichCube][0][0][0] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridDown[1] * weightScalarGridDown[2];
+                        tij[ mapv0v1[whichCube][0][0][1] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridDown[1] * weightScalarGridUp[2];
+                        tij[ mapv0v1[whichCube][0][1][0] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridUp[1]   * weightScalarGridDown[2];
+                        tij[ mapv0v1[whichCube][0][1][1] ] +=  massVelVel * weightTensorGridDown[0] * weightTensorGridUp[1]   * weightScalarGridUp[2];
+                        tij[ mapv0v1[whichCube][1][0][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridDown[1] * weightScalarGridDown[2];
+                        tij[ mapv0v1[whichCube][1][0][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridDown[1] * weightScalarGridUp[2];
+                        tij[ mapv0v1[whichCube][1][1][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridDown[2];
+                        tij[ mapv0v1[whichCube][1][1][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightTensorGridUp[1]   * weightScalarGridUp[2];
+
+
+                        //3) m * v_0 * v_2
+                        whichCube = gridChoice[0] + 2 * gridChoice[2];
+                        massVelVel = mass * vel[0] * vel[2];
+
+                        tij[ mapv0v2[whichCube][0][0][0] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightTensorGridDown[2];
+                        tij[ mapv0v2[whichCube][0][0][1] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridDown[1] * weightTensorGridUp[2];
+                        tij[ mapv0v2[whichCube][0][1][0] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightTensorGridDown[2];
+                        tij[ mapv0v2[whichCube][0][1][1] ] +=  massVelVel * weightTensorGridDown[0] * weightScalarGridUp[1]   * weightTensorGridUp[2];
+                        tij[ mapv0v2[whichCube][1][0][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightTensorGridDown[2];
+                        tij[ mapv0v2[whichCube][1][0][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridDown[1] * weightTensorGridUp[2];
+                        tij[ mapv0v2[whichCube][1][1][0] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridDown[2];
+                        tij[ mapv0v2[whichCube][1][1][1] ] +=  massVelVel * weightTensorGridUp[0]   * weightScalarGridUp[1]   * weightTensorGridUp[2];
 
-            }
+                    }
 
-            //add to the field T_ij
+                    //add to the field T_ij
 
-            (*Tij)(xTij -0 -1    ,0,1) += tij[36];
+                    (*Tij)(xTij -0 -1    ,0,1) += tij[36];
 
-            (*Tij)(xTij -0 -1 +2 ,0,1) += tij[37];
+                    (*Tij)(xTij -0 -1 +2 ,0,1) += tij[37];
 
-            (*Tij)(xTij -0    -2 ,0,2) += tij[18];
+                    (*Tij)(xTij -0    -2 ,0,2) += tij[18];
 
-            (*Tij)(xTij -0       ,0,1) += tij[42];
-            (*Tij)(xTij -0       ,0,2) += tij[24];
+                    (*Tij)(xTij -0       ,0,1) += tij[42];
+                    (*Tij)(xTij -0       ,0,2) += tij[24];
 
-            (*Tij)(xTij -0    +2 ,0,1) += tij[43];
-            (*Tij)(xTij -0    +2 ,0,2) += tij[30];
+                    (*Tij)(xTij -0    +2 ,0,1) += tij[43];
+                    (*Tij)(xTij -0    +2 ,0,2) += tij[30];
 
-            (*Tij)(xTij -0 +1 -2 ,0,2) += tij[19];
+                    (*Tij)(xTij -0 +1 -2 ,0,2) += tij[19];
 
-            (*Tij)(xTij -0 +1    ,0,1) += tij[48];
-            (*Tij)(xTij -0 +1    ,0,2) += tij[25];
+                    (*Tij)(xTij -0 +1    ,0,1) += tij[48];
+                    (*Tij)(xTij -0 +1    ,0,2) += tij[25];
 
-            (*Tij)(xTij -0 +1 +2 ,0,1) += tij[49];
-            (*Tij)(xTij -0 +1 +2 ,0,2) += tij[31];
+                    (*Tij)(xTij -0 +1 +2 ,0,1) += tij[49];
+                    (*Tij)(xTij -0 +1 +2 ,0,2) += tij[31];
 
-            //--------------------------------------------
+                    //--------------------------------------------
 
-            (*Tij)(xTij    -1 -2 ,1,2) += tij[0];
+                    (*Tij)(xTij    -1 -2 ,1,2) += tij[0];
 
-            (*Tij)(xTij    -1    ,0,1) += tij[38];
-            (*Tij)(xTij    -1    ,1,2) += tij[6];
+                    (*Tij)(xTij    -1    ,0,1) += tij[38];
+                    (*Tij)(xTij    -1    ,1,2) += tij[6];
 
-            (*Tij)(xTij    -1 +2 ,0,1) += tij[39];
-            (*Tij)(xTij    -1 +2 ,1,2) += tij[12];
+                    (*Tij)(xTij    -1 +2 ,0,1) += tij[39];
+                    (*Tij)(xTij    -1 +2 ,1,2) += tij[12];
 
-            (*Tij)(xTij       -2 ,0,2) += tij[20];
-            (*Tij)(xTij       -2 ,1,2) += tij[2];
+                    (*Tij)(xTij       -2 ,0,2) += tij[20];
+                    (*Tij)(xTij       -2 ,1,2) += tij[2];
 
-            (*Tij)(xTij          ,0,1) += tij[44];
-            (*Tij)(xTij          ,0,2) += tij[26];
-            (*Tij)(xTij          ,1,2) += tij[8];
-            for(int i=0;i<3;i++)(*Tij)(xTij,i,i)+=tii[8*i];
+                    (*Tij)(xTij          ,0,1) += tij[44];
+                    (*Tij)(xTij          ,0,2) += tij[26];
+                    (*Tij)(xTij          ,1,2) += tij[8];
+                    for(int i=0;i<3;i++)(*Tij)(xTij,i,i)+=tii[8*i];
 
-            (*Tij)(xTij       +2 ,0,1) += tij[45];
-            (*Tij)(xTij       +2 ,0,2) += tij[32];
-            (*Tij)(xTij       +2 ,1,2) += tij[14];
-            for(int i=0;i<3;i++)(*Tij)(xTij+2,i,i)+=tii[1+8*i];
+                    (*Tij)(xTij       +2 ,0,1) += tij[45];
+                    (*Tij)(xTij       +2 ,0,2) += tij[32];
+                    (*Tij)(xTij       +2 ,1,2) += tij[14];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+2,i,i)+=tii[1+8*i];
 
-            (*Tij)(xTij    +1 -2 ,0,2) += tij[21];
-            (*Tij)(xTij    +1 -2 ,1,2) += tij[4];
+                    (*Tij)(xTij    +1 -2 ,0,2) += tij[21];
+                    (*Tij)(xTij    +1 -2 ,1,2) += tij[4];
 
-            (*Tij)(xTij    +1    ,0,1) += tij[50];
-            (*Tij)(xTij    +1    ,0,2) += tij[27];
-            (*Tij)(xTij    +1    ,1,2) += tij[10];
-            for(int i=0;i<3;i++)(*Tij)(xTij+1,i,i)+=tii[2+8*i];
+                    (*Tij)(xTij    +1    ,0,1) += tij[50];
+                    (*Tij)(xTij    +1    ,0,2) += tij[27];
+                    (*Tij)(xTij    +1    ,1,2) += tij[10];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+1,i,i)+=tii[2+8*i];
 
-            (*Tij)(xTij    +1 +2 ,0,1) += tij[51];
-            (*Tij)(xTij    +1 +2 ,0,2) += tij[33];
-            (*Tij)(xTij    +1 +2 ,1,2) += tij[16];
-            for(int i=0;i<3;i++)(*Tij)(xTij+1+2,i,i)+=tii[3+8*i];
+                    (*Tij)(xTij    +1 +2 ,0,1) += tij[51];
+                    (*Tij)(xTij    +1 +2 ,0,2) += tij[33];
+                    (*Tij)(xTij    +1 +2 ,1,2) += tij[16];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+1+2,i,i)+=tii[3+8*i];
 
-            //--------------------------------------------
+                    //--------------------------------------------
 
-            (*Tij)(xTij +0 -1 -2 ,1,2) += tij[1];
+                    (*Tij)(xTij +0 -1 -2 ,1,2) += tij[1];
 
-            (*Tij)(xTij +0 -1    ,0,1) += tij[40];
-            (*Tij)(xTij +0 -1    ,1,2) += tij[7];
+                    (*Tij)(xTij +0 -1    ,0,1) += tij[40];
+                    (*Tij)(xTij +0 -1    ,1,2) += tij[7];
 
-            (*Tij)(xTij +0 -1 +2 ,0,1) += tij[41];
-            (*Tij)(xTij +0 -1 +2 ,1,2) += tij[13];
+                    (*Tij)(xTij +0 -1 +2 ,0,1) += tij[41];
+                    (*Tij)(xTij +0 -1 +2 ,1,2) += tij[13];
 
-            (*Tij)(xTij +0    -2 ,0,2) += tij[22];
-            (*Tij)(xTij +0    -2 ,1,2) += tij[3];
+                    (*Tij)(xTij +0    -2 ,0,2) += tij[22];
+                    (*Tij)(xTij +0    -2 ,1,2) += tij[3];
 
-            (*Tij)(xTij +0       ,0,1) += tij[46];
-            (*Tij)(xTij +0       ,0,2) += tij[28];
-            (*Tij)(xTij +0       ,1,2) += tij[9];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0,i,i)+=tii[4+8*i];
+                    (*Tij)(xTij +0       ,0,1) += tij[46];
+                    (*Tij)(xTij +0       ,0,2) += tij[28];
+                    (*Tij)(xTij +0       ,1,2) += tij[9];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0,i,i)+=tii[4+8*i];
 
-            (*Tij)(xTij +0    +2 ,0,1) += tij[47];
-            (*Tij)(xTij +0    +2 ,0,2) += tij[34];
-            (*Tij)(xTij +0    +2 ,1,2) += tij[15];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+2,i,i)+=tii[5+8*i];
+                    (*Tij)(xTij +0    +2 ,0,1) += tij[47];
+                    (*Tij)(xTij +0    +2 ,0,2) += tij[34];
+                    (*Tij)(xTij +0    +2 ,1,2) += tij[15];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+2,i,i)+=tii[5+8*i];
 
-            (*Tij)(xTij +0 +1 -2 ,0,2) += tij[23];
-            (*Tij)(xTij +0 +1 -2 ,1,2) += tij[5];
+                    (*Tij)(xTij +0 +1 -2 ,0,2) += tij[23];
+                    (*Tij)(xTij +0 +1 -2 ,1,2) += tij[5];
 
-            (*Tij)(xTij +0 +1    ,0,1) += tij[52];
-            (*Tij)(xTij +0 +1    ,0,2) += tij[29];
-            (*Tij)(xTij +0 +1    ,1,2) += tij[11];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+1,i,i)+=tii[6+8*i];
+                    (*Tij)(xTij +0 +1    ,0,1) += tij[52];
+                    (*Tij)(xTij +0 +1    ,0,2) += tij[29];
+                    (*Tij)(xTij +0 +1    ,1,2) += tij[11];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+1,i,i)+=tii[6+8*i];
 
-            (*Tij)(xTij +0 +1 +2 ,0,1) += tij[53];
-            (*Tij)(xTij +0 +1 +2 ,0,2) += tij[35];
-            (*Tij)(xTij +0 +1 +2 ,1,2) += tij[17];
-            for(int i=0;i<3;i++)(*Tij)(xTij+0+1+2,i,i)+=tii[7+8*i];
+                    (*Tij)(xTij +0 +1 +2 ,0,1) += tij[53];
+                    (*Tij)(xTij +0 +1 +2 ,0,2) += tij[35];
+                    (*Tij)(xTij +0 +1 +2 ,1,2) += tij[17];
+                    for(int i=0;i<3;i++)(*Tij)(xTij+0+1+2,i,i)+=tii[7+8*i];
 
+                }
+            }
         }
     }
 
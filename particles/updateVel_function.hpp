@@ -37,6 +37,69 @@ Real updateVel_simple(double dtau,
 
 }
 
+/*!
+ Gravity kick of "part_simple": vel += dtau * g, with g the acceleration field fields[0] (3 components, halo of at least 1, halo updated) interpolated at the particle with the CIC weights of scalarProjectionCIC_project. fields[0] has to be defined on a lattice with the same local sizes as the particle lattice.
+ */
+Real updateVel_gravity(double dtau,
+                       double lat_resolution,
+                       part_simple * part,
+                       double * ref_dist,
+                       part_simple_info partInfo,
+                       Field<Real> ** fields,
+                       Site * sites,
+                       int nfield,
+                       double * params,
+                       double * outputs,
+                       int noutputs)
+{
+    double down[3];
+    double weight[8];
+    double acc;
+    long jump[3];
+    long index = sites[0].index();
+    Real v2 = 0;
+
+    for(int i=0;i<3;i++)
+    {
+        down[i] = 1. - ref_dist[i];
+        jump[i] = fields[0]->lattice().jump(i);
+    }
+    projection_cicWeights(down,ref_dist,weight);
+
+    for(int l=0;l<3;l++)
+    {
+        acc = 0;
+        for(int s=0;s<8;s++) acc += weight[s] * (*fields[0])(index + (s>>2) * jump[0] + ((s>>1)&1) * jump[1] + (s&1) * jump[2], l);
+        (*part).vel[l] += dtau * acc;
+        v2 += (*part).vel[l] * (*part).vel[l];
+    }
+
+    return v2;
+}
+
+/*!
+ Batch kernel of updateVel_gravity (see Particles::updateVelBatch): the acceleration of the whole batch is interpolated by gatherBatch, then vel[l][p] += dtau * g[l][p].
+ */
+void updateVel_gravity_batch(double dtau,
+                             double lat_resolution,
+                             partBatch<part_simple> * batch,
+                             part_simple_info partInfo,
+                             Field<Real> ** fields,
+                             int nfield,
+                             double * params)
+{
+    Real acc[3][PARTICLES_BATCH_SIZE];
+    Real * values[3] = {acc[0],acc[1],acc[2]};
+
+    gatherBatch(fields[0],batch,values,3);
+
+    for(int l=0;l<3;l++)
+    {
+        Real * vel = batch->vel[l];
+        for(long p=0;p<batch->size;p++) vel[p] += dtau * acc[l][p];
+    }
+}
+
 /**@}*/
 
 #endif